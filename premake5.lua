@@ -1,3 +1,10 @@
+newoption
+{
+	trigger = "shaderc",
+	value = "PATH",
+	description = "shaderc executable compiling resources/shaders, shaderc on PATH by default"
+}
+
 local BUILD_DIR = path.join("build", _ACTION)
 if _OPTIONS["cc"] ~= nil then
 	BUILD_DIR = BUILD_DIR .. "_" .. _OPTIONS["cc"]
@@ -8,6 +15,9 @@ local BX_DIR = "bx"
 local GLFW_DIR = "glfw"
 local IMGUI_DIR = "imgui"
 local SRC_DIR = "src"
+local TOOLS_DIR = "tools"
+local SHADER_DIR = "resources/shaders"
+local SHADERC = _OPTIONS["shaderc"] or "shaderc"
 
 solution "rpg"
 	location(BUILD_DIR)
@@ -69,6 +79,7 @@ project "terrain"
 		path.join(GLFW_DIR, "include")
 	}
 	links { "bgfx", "bimg", "bx", "glfw" }
+	dependson { "shaders" }
 	filter "system:windows"
 		links { "gdi32", "kernel32", "psapi" }
 	filter "system:linux"
@@ -77,7 +88,85 @@ project "terrain"
 	filter "action:vs*"
 		defines {"_CRT_SECURE_NO_WARNINGS", "__STDC_LIMIT_MACROS", "__STDC_FORMAT_MACROS", "__STDC_CONSTANT_MACROS"}
 
+project "terrainc"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "C++14"
+	exceptionhandling "Off"
+	rtti "Off"
+	files
+	{
+		path.join(TOOLS_DIR, "terrainc/*.cpp"),
+		path.join(TOOLS_DIR, "terrainc/*.h"),
+		path.join(SRC_DIR, "height_codec.cpp"),
+		path.join(SRC_DIR, "terrain_file.cpp"),
+	}
+	includedirs
+	{
+		path.join(BX_DIR, "include"),
+		SRC_DIR
+	}
+	links { "bx" }
+	filter "system:windows"
+		links { "psapi" }
+	filter "system:linux"
+		links { "dl", "pthread" }
+	setBxCompat()
+	filter "action:vs*"
+		defines {"_CRT_SECURE_NO_WARNINGS", "__STDC_LIMIT_MACROS", "__STDC_FORMAT_MACROS", "__STDC_CONSTANT_MACROS"}
 	
+-- Shaders are compiled into runtime/shaders/<renderer>, where the app loads them from. HLSL
+-- needs the D3D compiler and is only built on Windows. GLSL is 4.3 throughout, resolve and
+-- scatter read compute buffers.
+local SHADER_TARGETS =
+{
+	{ dir = "glsl",  platform = "linux", vertex = "430",   fragment = "430",   compute = "430"   },
+	{ dir = "spirv", platform = "linux", vertex = "spirv", fragment = "spirv", compute = "spirv" },
+	{ dir = "metal", platform = "osx",   vertex = "metal", fragment = "metal", compute = "metal" },
+}
+if os.host() == "windows" then
+	table.insert(SHADER_TARGETS, { dir = "dx11", platform = "windows", vertex = "vs_5_0", fragment = "ps_5_0", compute = "cs_5_0" })
+end
+
+local function shaderRule(_prefix, _type)
+	local commands = {}
+	local outputs = {}
+	for _, target in ipairs(SHADER_TARGETS) do
+		local outDir = path.getabsolute(path.join("runtime/shaders", target.dir))
+		local output = path.join(outDir, "%{file.basename}.bin")
+		table.insert(commands, "{MKDIR} " .. outDir)
+		table.insert(commands, SHADERC
+			.. " -f %{file.abspath}"
+			.. " -o " .. output
+			.. " --type " .. _type
+			.. " --platform " .. target.platform
+			.. " -p " .. target[_type]
+			.. " -i " .. path.getabsolute(path.join(BGFX_DIR, "src"))
+			.. " --varyingdef " .. path.getabsolute(path.join(SHADER_DIR, "varying.def.sc"))
+			)
+		table.insert(outputs, output)
+	end
+
+	filter("files:" .. SHADER_DIR .. "/" .. _prefix .. "_*.sc")
+		buildmessage "shaderc %{file.name}"
+		buildcommands(commands)
+		buildoutputs(outputs)
+		buildinputs(table.join(os.matchfiles(path.join(SHADER_DIR, "*.sh") ), { path.join(SHADER_DIR, "varying.def.sc") }) )
+	filter {}
+end
+
+project "shaders"
+	kind "Utility"
+	files
+	{
+		path.join(SHADER_DIR, "*.sc"),
+		path.join(SHADER_DIR, "*.sh"),
+	}
+	removefiles { path.join(SHADER_DIR, "varying.def.sc") }
+	shaderRule("vs", "vertex")
+	shaderRule("fs", "fragment")
+	shaderRule("cs", "compute")
+
 project "bgfx"
 	kind "StaticLib"
 	language "C++"
@@ -0,0 +1,52 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef BRUSH_SH_HEADER_GUARD
+#define BRUSH_SH_HEADER_GUARD
+
+// Needs u_myInvViewProj, u_params (xy - mouse uv, z - mouse buttons, w - brush size) and
+// u_mouseBuffer declared by the including shader.
+
+vec3 GetWorldPositionFromDepth (vec2 tid, float depth)
+{
+    vec4 ndc;
+    ndc.xy = tid;
+    ndc.xy = ndc.xy * 2 - 1;
+    ndc.y *= -1;
+    
+    ndc.z = depth;
+    ndc.w = 1;
+    
+    vec4 worldPosition = mul(u_myInvViewProj , ndc);
+    worldPosition.xyz /= worldPosition.w;
+   
+    return worldPosition.xyz;
+}
+
+inline float evaluateModificationBrush (    vec2             worldPosition,
+                                            vec2             mousePosition,
+                                            float                    size)
+{
+    float dist = length(worldPosition - mousePosition);
+    dist /= size;
+    return saturate(min(2-dist, 1.0 / (1.0 + pow(dist*2.0, 4))));
+	//if (dist > size) { return 0;}
+	//return 1;
+}
+
+// rgb - overlay color, a - coverage
+vec4 brushOverlay(vec3 worldPosition)
+{
+	const vec3 worldMousePosition = u_mouseBuffer[0].xyz;
+	float mouseState = u_params.z;
+	float brushSize = u_params.w;
+
+	vec4 brushColor;
+	// if left mouse button pressed - green. if right pressed red . none pressed - gray
+	brushColor.xyz = mouseState == 1 ? vec3(0.5, 0.9, 0.5) : mouseState == 2 ? vec3(0.9, 0.5, 0.5) : vec3(0.5, 0.5, 0.7);
+	brushColor.w = evaluateModificationBrush(worldPosition.xz, worldMousePosition.xz, brushSize);
+	return brushColor;
+}
+
+#endif // BRUSH_SH_HEADER_GUARD
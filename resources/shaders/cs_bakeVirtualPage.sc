@@ -0,0 +1,31 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include "bgfx_compute.sh"
+#include "common.sh"
+
+IMAGE2D_WR(s_atlas, rgba8, 0);
+#include "terrain_splat.sh"
+
+// [0] xy - page world origin, z - page world size, w - height map world size
+// [1] xy - page origin in atlas texels, z - page size in texels
+uniform vec4 u_virtualPageParams[2];
+
+NUM_THREADS(8, 8, 1)
+void main()
+{
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	float pageSize = u_virtualPageParams[1].z;
+
+	vec2 local = (vec2(texel) + 0.5) / pageSize;
+	vec2 world = u_virtualPageParams[0].xy + local * u_virtualPageParams[0].z;
+	vec2 heightUv = world / u_virtualPageParams[0].w;
+
+	// one page texel covers this many albedo texels (512 texel materials over 8 meters),
+	// pick matching mip to avoid aliasing
+	float lod = max(0.0, log2(u_virtualPageParams[0].z / pageSize * 64.0) );
+	vec3 col = splatAlbedoLod(heightUv, lod);
+
+	imageStore(s_atlas, ivec2(u_virtualPageParams[1].xy) + texel, vec4(col, 1.0) );
+}
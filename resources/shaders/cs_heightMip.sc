@@ -0,0 +1,33 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include "bgfx_compute.sh"
+
+IMAGE2D_RO(s_heightSrc, r8, 0);
+IMAGE2D_WR(s_heightDst, r8, 1);
+
+uniform vec4 u_heightMipParams; // xy - first texel of the level, zw - end of the region
+
+// Must match heightMipDownsampleRef in terrain_heightmips.cpp.
+NUM_THREADS(8, 8, 1)
+void main()
+{
+	ivec2 coord = ivec2(gl_GlobalInvocationID.xy) + ivec2(u_heightMipParams.xy);
+	if (coord.x >= int(u_heightMipParams.z) || coord.y >= int(u_heightMipParams.w) )
+	{
+		return;
+	}
+
+	ivec2 dim = ivec2(imageSize(s_heightSrc).xy) - ivec2(1, 1);
+	ivec2 c0 = min(coord * 2, dim);
+	ivec2 c1 = min(coord * 2 + ivec2(1, 1), dim);
+
+	// sum in R16 units so rounding is the same as on the CPU
+	float sum = imageLoad(s_heightSrc, c0).x
+		+ imageLoad(s_heightSrc, ivec2(c1.x, c0.y) ).x
+		+ imageLoad(s_heightSrc, ivec2(c0.x, c1.y) ).x
+		+ imageLoad(s_heightSrc, c1).x
+		;
+	imageStore(s_heightDst, coord, vec4(floor(sum * 65535.0 * 0.25 + 0.5) / 65535.0, 0.0, 0.0, 0.0) );
+}
@@ -0,0 +1,33 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include "bgfx_compute.sh"
+
+BUFFER_RO(u_counters, uint, 0);
+BUFFER_RW(u_drawArgs, uvec4, 1);
+
+// [0] y - max visible per type
+// [1] w - first counter and draw of the view
+uniform vec4 u_scatterParams[2];
+// per type, x - number of indices, y - start index
+uniform vec4 u_scatterMeshes[2];
+
+NUM_THREADS(1, 1, 1)
+void main()
+{
+	uint maxVisible = uint(u_scatterParams[0].y);
+	uint first = uint(u_scatterParams[1].w);
+	for (uint ii = 0; ii < 2; ++ii)
+	{
+		drawIndexedIndirect(
+			  u_drawArgs
+			, first + ii
+			, uint(u_scatterMeshes[ii].x)
+			, min(u_counters[first + ii], maxVisible)
+			, uint(u_scatterMeshes[ii].y)
+			, 0
+			, 0
+			);
+	}
+}
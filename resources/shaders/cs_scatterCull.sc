@@ -0,0 +1,63 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include "bgfx_compute.sh"
+
+// xyz - position, w - type * 16 + scale, negative for empty entries
+BUFFER_RO(u_instances, vec4, 0);
+BUFFER_WR(u_visible, vec4, 1);
+BUFFER_RW(u_counters, uint, 2);
+
+// left, right, bottom, top, near, far, normals point inside
+uniform vec4 u_frustumPlanes[6];
+// [0] x - number of instances, y - max visible per type, zw - max distance per type
+// [1] xyz - camera position, w - first counter and visible list of the view, one per type
+uniform vec4 u_scatterParams[2];
+
+// Must match ScatterSystem layout in terrain_scatter.h.
+NUM_THREADS(64, 1, 1)
+void main()
+{
+	uint index = gl_GlobalInvocationID.x;
+	if (index >= uint(u_scatterParams[0].x) )
+	{
+		return;
+	}
+
+	vec4 instance = u_instances[index];
+	if (instance.w < 0.0)
+	{
+		return;
+	}
+
+	float type  = floor(instance.w / 16.0);
+	float scale = instance.w - type * 16.0;
+	float maxDistance = type < 0.5 ? u_scatterParams[0].z : u_scatterParams[0].w;
+
+	vec3 toCamera = instance.xyz - u_scatterParams[1].xyz;
+	if (dot(toCamera, toCamera) > maxDistance * maxDistance)
+	{
+		return;
+	}
+
+	// meshes fit in a sphere of radius 0.7 above their origin
+	vec3 center = instance.xyz + vec3(0.0, 0.35 * scale, 0.0);
+	float radius = 0.7 * scale;
+	for (int ii = 0; ii < 6; ++ii)
+	{
+		if (dot(u_frustumPlanes[ii].xyz, center) + u_frustumPlanes[ii].w < -radius)
+		{
+			return;
+		}
+	}
+
+	uint list = uint(u_scatterParams[1].w) + uint(type);
+	uint slot;
+	atomicFetchAndAdd(u_counters[list], 1, slot);
+	uint maxVisible = uint(u_scatterParams[0].y);
+	if (slot < maxVisible)
+	{
+		u_visible[list * maxVisible + slot] = instance;
+	}
+}
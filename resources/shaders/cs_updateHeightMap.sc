@@ -7,10 +7,9 @@
 #include "common.sh"
 
 IMAGE2D_RW(s_height, r8, 0);
-//SAMPLER2D(s_depth, 0);
-BUFFER_RO(u_mouseBuffer, vec4, 1);
+BUFFER_RO(u_brushSamples, vec4, 1); // xy - world xz, z - brush size, w - normalized height added
 
-uniform vec4 u_params;
+uniform vec4 u_sculptParams; // x - number of samples, yz - first texel, w - world size
 
 
 
@@ -25,23 +24,28 @@ inline float evaluateModificationBrush (    vec2             worldPosition,
 
 }
 
-//gl_GlobalInvocationID
-
+// every sample of the frame's stroke is applied at once, dispatch covers only texels they touch
 NUM_THREADS(8, 8, 1)
 void main()
 {
-	ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
-	const vec3 worldMousePosition = u_mouseBuffer[0].xyz;
-	uvec2 dim = imageSize(s_height).xy;
-	vec2 uv = vec2(gl_GlobalInvocationID.xy) / dim;
-	const vec2 worldPosition_xz =  uv * 64.0;
-	float brushSize = u_params.z;
-	
-	float displacement = evaluateModificationBrush(worldPosition_xz, worldMousePosition.xz, brushSize) * 0.000015;
+	ivec2 coord = ivec2(gl_GlobalInvocationID.xy) + ivec2(u_sculptParams.yz);
+	ivec2 dim = ivec2(imageSize(s_height).xy);
+	if (coord.x >= dim.x || coord.y >= dim.y)
+	{
+		return;
+	}
+
+	const vec2 worldPosition_xz = (vec2(coord) + 0.5) / vec2(dim) * u_sculptParams.w;
+
+	float displacement = 0.0;
+	int numSamples = int(u_sculptParams.x);
+	for (int ii = 0; ii < numSamples; ++ii)
+	{
+		vec4 brushSample = u_brushSamples[ii];
+		displacement += evaluateModificationBrush(worldPosition_xz, brushSample.xy, brushSample.z) * brushSample.w;
+	}
 
 	float h = imageLoad(s_height,coord).x ;
-	
-	//displacement = worldMousePosition.x / 64.0;
 
 	imageStore(s_height, coord, h +  displacement);
 }
@@ -14,6 +14,8 @@ BUFFER_WR(u_mouseBuffer, vec4, 1);
 uniform mat4 u_myInvViewProj;
 uniform vec4 u_params;
 
+#include "gbuffer.sh"
+
 
 
 vec3 GetWorldPositionFromDepth (vec2 tid, float depth)
@@ -47,7 +49,7 @@ void main()
 {
 	vec2 mousePosScreen = u_params.xy;
 	
-	const float mouseDepth = texture2DLod(s_depth, mousePosScreen, 0);
+	const float mouseDepth = texture2DLod(s_depth, gbufferUv(mousePosScreen), 0);
 
     const vec3 worldMousePosition = GetWorldPositionFromDepth (mousePosScreen, mouseDepth);
 	u_mouseBuffer[0] = vec4(worldMousePosition, 1);
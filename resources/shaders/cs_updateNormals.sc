@@ -0,0 +1,48 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include "bgfx_compute.sh"
+#include "common.sh"
+
+IMAGE2D_RO(s_height, r8, 0);
+IMAGE2D_WR(s_normal, rg8, 1);
+BUFFER_RO(u_mouseBuffer, vec4, 2);
+
+// [0] xy - region origin in texels, z - 1 if region is centered on brush, w - region half size in texels
+// [1] x - normalized height difference to world gradient scale, y - height map size in world units
+uniform vec4 u_normalParams[2];
+
+float heightAt(ivec2 coord, ivec2 dim)
+{
+	coord = clamp(coord, ivec2(0, 0), dim - ivec2(1, 1) );
+	return imageLoad(s_height, coord).x;
+}
+
+// Must match normalsComputeRG8 in terrain_normals.cpp.
+NUM_THREADS(8, 8, 1)
+void main()
+{
+	ivec2 dim = ivec2(imageSize(s_height).xy);
+	ivec2 origin = ivec2(u_normalParams[0].xy);
+
+	if (u_normalParams[0].z > 0.0)
+	{
+		vec2 brushTexel = u_mouseBuffer[0].xz / u_normalParams[1].y * vec2(dim);
+		int halfSize = int(u_normalParams[0].w);
+		origin = ivec2(brushTexel) - ivec2(halfSize, halfSize);
+	}
+
+	ivec2 coord = origin + ivec2(gl_GlobalInvocationID.xy);
+	if (coord.x < 0 || coord.y < 0 || coord.x >= dim.x || coord.y >= dim.y)
+	{
+		return;
+	}
+
+	float gradScale = u_normalParams[1].x;
+	float dx = (heightAt(coord + ivec2(1, 0), dim) - heightAt(coord - ivec2(1, 0), dim) ) * gradScale;
+	float dz = (heightAt(coord + ivec2(0, 1), dim) - heightAt(coord - ivec2(0, 1), dim) ) * gradScale;
+
+	vec3 normal = normalize(vec3(-dx, 1.0, -dz) );
+	imageStore(s_normal, coord, vec4(normal.xz * 0.5 + 0.5, 0.0, 0.0) );
+}
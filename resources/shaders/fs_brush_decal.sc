@@ -0,0 +1,30 @@
+$input v_texcoord0
+
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include "bgfx_compute.sh"
+#include "common.sh"
+
+uniform mat4 u_myInvViewProj;
+uniform vec4 u_params;
+
+SAMPLER2D(s_depth, 1);
+BUFFER_RO(u_mouseBuffer, vec4, 2);
+
+#include "gbuffer.sh"
+#include "brush.sh"
+
+// Drawn over the resolved image, scissored to the brush bounds and alpha blended.
+void main()
+{
+	const float pixelDepth = texture2D(s_depth, gbufferUv(v_texcoord0) );
+	if (pixelDepth >= 1.0)
+	{
+		discard;
+	}
+
+	vec4 brushColor = brushOverlay(GetWorldPositionFromDepth(v_texcoord0, pixelDepth) );
+	gl_FragColor = brushColor;
+}
@@ -17,6 +17,19 @@ uniform vec4 u_params;
 SAMPLER2D(s_albedo, 0);
 SAMPLER2D(s_depth, 1);
 BUFFER_RO(u_mouseBuffer, vec4, 2);
+SAMPLER2DSHADOW(s_shadowMap, 3);
+SAMPLER2D(s_gbufferMaterial, 4);
+
+// Must match ShadowCascades::kNumCascades, cascades sit side by side in the atlas.
+#define NUM_SHADOW_CASCADES 3
+uniform mat4 u_shadowMtx[NUM_SHADOW_CASCADES];
+// x - depth bias, y - 1 if shadows are enabled, z - texel size in cascade uv, w - cascades in use
+uniform vec4 u_shadowParams;
+// xyz - direction towards the sun, w - ambient term
+uniform vec4 u_sunDirection;
+
+#include "gbuffer.sh"
+#include "brush.sh"
 
 
 float LinearizeDepth(vec2 uv)
@@ -28,65 +41,71 @@ float LinearizeDepth(vec2 uv)
 }
 
 
-vec3 GetWorldPositionFromDepth (vec2 tid, float depth)
+// Returns 0 in shadow, 1 in sunlight. First cascade holding the point wins, cascades get
+// coarser with distance from the camera.
+float sunVisibility(vec3 worldPosition)
 {
-    vec4 ndc;
-    ndc.xy = tid;
-    ndc.xy = ndc.xy * 2 - 1;
-    ndc.y *= -1;
-    
-    ndc.z = depth;
-    ndc.w = 1;
-    
-    vec4 worldPosition = mul(u_myInvViewProj , ndc);
-    worldPosition.xyz /= worldPosition.w;
-   
-    return worldPosition.xyz;
-}
-
-inline float evaluateModificationBrush (    vec2             worldPosition,
-                                            vec2             mousePosition,
-                                            float                    size)
-{
-    float dist = length(worldPosition - mousePosition);
-    dist /= size;
-    return saturate(min(2-dist, 1.0 / (1.0 + pow(dist*2.0, 4))));
-	//if (dist > size) { return 0;}
-	//return 1;
+	for (int ii = 0; ii < NUM_SHADOW_CASCADES; ++ii)
+	{
+		// cascades past w are left to horizon maps in fs_terrain
+		if (float(ii) >= u_shadowParams.w)
+		{
+			break;
+		}
+
+		vec4 coord = mul(u_shadowMtx[ii], vec4(worldPosition, 1.0) );
+		float margin = u_shadowParams.z * 2.0;
+		if (all(greaterThan(coord.xy, vec2_splat(margin) ) )
+		&&  all(lessThan(coord.xy, vec2_splat(1.0 - margin) ) ) )
+		{
+			vec2 uv = vec2( (float(ii) + coord.x) / float(NUM_SHADOW_CASCADES), coord.y);
+			float depth = coord.z - u_shadowParams.x;
+			vec2 texel = vec2(u_shadowParams.z / float(NUM_SHADOW_CASCADES), u_shadowParams.z);
+
+			// 2x2 taps, each filtered by the comparison sampler
+			float visibility = 0.0;
+			visibility += shadow2D(s_shadowMap, vec3(uv + vec2(-0.5, -0.5) * texel, depth) );
+			visibility += shadow2D(s_shadowMap, vec3(uv + vec2( 0.5, -0.5) * texel, depth) );
+			visibility += shadow2D(s_shadowMap, vec3(uv + vec2(-0.5,  0.5) * texel, depth) );
+			visibility += shadow2D(s_shadowMap, vec3(uv + vec2( 0.5,  0.5) * texel, depth) );
+			return visibility * 0.25;
+		}
+	}
+
+	return 1.0;
 }
 
 void main()
 {
-	//vec2 mousePos = u_mouseBuffer[0].xy;
-	//vec2 invScreenSize = u_params.xy;
-	vec2 uv = u_params.xy;
-	const float mouseDepth = texture2D(s_depth, uv);
-
-#if 1	
-    
-    //const vec3 worldMousePosition = GetWorldPositionFromDepth (uv, mouseDepth);
-	const vec3 worldMousePosition = u_mouseBuffer[0].xyz;
-
-	const float pixelDepth = texture2D(s_depth, v_texcoord0);
+	// G-buffer may be smaller than the screen, color is upscaled with bilinear filtering
+	vec2 gbufferTexcoord = gbufferUv(v_texcoord0);
+	const float pixelDepth = texture2D(s_depth, gbufferTexcoord);
 	const float3 worldPosition = GetWorldPositionFromDepth (v_texcoord0, pixelDepth);
-    float mouseState = u_params.z;
-	float brushSize = u_params.w;
-	float brush = evaluateModificationBrush(worldPosition.xz, worldMousePosition.xz, brushSize);
-	
-	
-	vec4 brushColor;
-	// if left mouse button pressed - green. if right pressed red . none pressed - gray
-	brushColor.xyz = mouseState == 1 ? vec3(0.5, 0.9, 0.5) : mouseState == 2 ? vec3(0.9, 0.5, 0.5) : vec3(0.5, 0.5, 0.7);
-	brushColor.w = brush;
-	vec4 color  = texture2D(s_albedo, v_texcoord0);
-
-	//float d = LinearizeDepth(v_texcoord0);
-
-
-	//color = vec4(brush, brush, brush, 1.0);
-	//color.x *= u_mouseBuffer[0];
-	color.xyz = mix(color.xyz, brushColor.xyz, brushColor.w);
-
-#endif
-	gl_FragColor = color;
+	vec4 color  = texture2D(s_albedo, gbufferTexcoord);
+
+	if (pixelDepth < 1.0)
+	{
+		float visibility = u_shadowParams.y > 0.0 ? sunVisibility(worldPosition) : 1.0;
+		if (u_gbufferParams[0].x > 0.0)
+		{
+			// Packed: x - normal, y - normal, z - horizon sun visibility, w - occlusion
+			vec4 material = texture2D(s_gbufferMaterial, gbufferTexcoord);
+			vec3 normal = decodeNormalOct(material.xy);
+			color.xyz = gbufferLit(color.xyz, normal, material.z * visibility, material.w, u_sunDirection).xyz;
+		}
+		else
+		{
+			// Lit: only the direct share in alpha is shadowed
+			color.xyz *= 1.0 - color.w * (1.0 - visibility);
+		}
+	}
+
+	// otherwise drawn as a decal over the brush bounds
+	if (u_gbufferParams[0].y > 0.0)
+	{
+		vec4 brushColor = brushOverlay(worldPosition);
+		color.xyz = mix(color.xyz, brushColor.xyz, brushColor.w);
+	}
+
+	gl_FragColor = vec4(color.xyz, 1.0);
 }
@@ -0,0 +1,26 @@
+$input v_normal, v_color0
+
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include "common.sh"
+#include "gbuffer.sh"
+
+// xyz - direction towards the sun, w - ambient term
+uniform vec4 u_sunDirection;
+
+void main()
+{
+	vec3 normal = normalize(v_normal);
+	if (u_gbufferParams[0].x > 0.0)
+	{
+		gl_FragData[0] = vec4(v_color0.rgb, 1.0);
+		gl_FragData[1] = vec4(encodeNormalOct(normal), 1.0, 1.0);
+	}
+	else
+	{
+		gl_FragData[0] = gbufferLit(v_color0.rgb, normal, 1.0, 1.0, u_sunDirection);
+		gl_FragData[1] = vec4_splat(0.0);
+	}
+}
@@ -0,0 +1,10 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include "common.sh"
+
+void main()
+{
+	gl_FragColor = vec4_splat(0.0);
+}
@@ -1,4 +1,4 @@
-$input v_position, v_texcoord0, v_bc
+$input v_position, v_texcoord0, v_texcoord1, v_virtualPage, v_bc
 
 /*
  * Copyright 2015 Andrew Mac. All rights reserved.
@@ -6,14 +6,79 @@ $input v_position, v_texcoord0, v_bc
  */
 
 #include "common.sh"
+#include "terrain_splat.sh"
+#include "gbuffer.sh"
 
-SAMPLER2D(albedoTexture, 1);
+SAMPLER2D(s_normalTexture, 2);
+SAMPLER2D(s_virtualAtlas, 5);
+// sine of horizon elevation, directions 0-3 and 4-7 at 45 degree steps
+SAMPLER2D(s_horizon0, 6);
+SAMPLER2D(s_horizon1, 7);
 uniform vec4 u_renderParams;
+// xyz - direction towards the sun, w - ambient term
+uniform vec4 u_sunDirection;
+// x - pages per atlas row, y - page size in texels, z - atlas size in texels
+uniform vec4 u_virtualParams;
+// [0], [1] - weights of the directions next to the sun azimuth
+// [2] - x sine of sun elevation, y softness, z occlusion strength, w 1 if enabled
+// [3] - xy camera position xz, zw distance range horizon shadows fade in over
+uniform vec4 u_horizonParams[4];
+
+// normals are cached as RG8 by cs_updateNormals, y always points up
+vec3 decodeNormal(vec2 _rg)
+{
+	vec2 xz = _rg * 2.0 - 1.0;
+	return vec3(xz.x, sqrt(saturate(1.0 - dot(xz, xz) ) ), xz.y);
+}
 
 void main()
 {
 	//vec3 col = vec3(1.0, 0.0, 0.0);
-	vec3 col = texture2D(albedoTexture, v_texcoord0).rgb;
+	vec3 col;
+	if (v_virtualPage.z > 0.5)
+	{
+		float slot = v_virtualPage.z - 1.0;
+		float pageSize = u_virtualParams.y;
+		vec2 page = vec2(mod(slot, u_virtualParams.x), floor(slot / u_virtualParams.x) );
+		vec2 texel = clamp(v_virtualPage.xy * pageSize, vec2_splat(0.5), vec2_splat(pageSize - 0.5) );
+		col = texture2D(s_virtualAtlas, (page * pageSize + texel) / u_virtualParams.z).rgb;
+	}
+	else
+	{
+		col = splatAlbedo(v_texcoord1);
+	}
+	vec3 normal = decodeNormal(texture2D(s_normalTexture, v_texcoord1).xy);
+	float sunVisibility = 1.0;
+	float ao = 1.0;
+	if (u_horizonParams[2].w > 0.0)
+	{
+		vec4 horizon0 = texture2D(s_horizon0, v_texcoord1);
+		vec4 horizon1 = texture2D(s_horizon1, v_texcoord1);
+		float horizonSin = dot(horizon0, u_horizonParams[0]) + dot(horizon1, u_horizonParams[1]);
+		float softness = u_horizonParams[2].y;
+		float visibility = smoothstep(-softness, softness, u_horizonParams[2].x - horizonSin);
+
+		// near terrain is covered by shadow cascades in the combine pass
+		float dist = distance(v_position.xz, u_horizonParams[3].xy);
+		float fade = saturate( (dist - u_horizonParams[3].z) / (u_horizonParams[3].w - u_horizonParams[3].z) );
+		sunVisibility = mix(1.0, visibility, fade);
+
+		ao = 1.0 - u_horizonParams[2].z * dot(horizon0 + horizon1, vec4_splat(0.125) );
+	}
+
+	vec4 color;
+	vec4 material = vec4_splat(0.0);
+	if (u_gbufferParams[0].x > 0.0)
+	{
+		color = vec4(col, 1.0);
+		material = vec4(encodeNormalOct(normal), sunVisibility, ao);
+	}
+	else
+	{
+		color = gbufferLit(col, normal, sunVisibility, ao, u_sunDirection);
+	}
+	col = color.xyz;
+
 	if (u_renderParams.x > 0.0)
 	{
 		vec3  wfColor   = vec3(0.0,0.0,0.0);
@@ -34,5 +99,6 @@ void main()
 	//	{
 	//	col = vec3(1.0, 0.0, 0.0);
 	//}
-	gl_FragColor = vec4(col, 1.0);
+	gl_FragData[0] = vec4(col, color.w);
+	gl_FragData[1] = material;
 }
@@ -0,0 +1,60 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef GBUFFER_SH_HEADER_GUARD
+#define GBUFFER_SH_HEADER_GUARD
+
+// [0] - x 1 for GBufferLayout::Packed, 0 for Lit, y 1 if resolve draws the brush
+// [1] - xy rendered part of the targets in uv, zw texel size
+uniform vec4 u_gbufferParams[2];
+
+// Maps screen uv to G-buffer uv, the scene is rendered into the top left corner of the targets
+// at dynamic resolution. Lookups stay half a texel inside so filtering doesn't pick up texels
+// left over from larger frames.
+vec2 gbufferUv(vec2 _uv)
+{
+	vec2 scale = u_gbufferParams[1].xy;
+	vec2 halfTexel = u_gbufferParams[1].zw * 0.5;
+#if BGFX_SHADER_LANGUAGE_GLSL
+	// texture origin is bottom left, the rendered corner sits at the top
+	vec2 uv = vec2(_uv.x * scale.x, 1.0 - (1.0 - _uv.y) * scale.y);
+	return clamp(uv, vec2(halfTexel.x, 1.0 - scale.y + halfTexel.y), vec2(scale.x - halfTexel.x, 1.0 - halfTexel.y) );
+#else
+	return clamp(_uv * scale, halfTexel, scale - halfTexel);
+#endif // BGFX_SHADER_LANGUAGE_GLSL
+}
+
+// Octahedral normal around +y, two unorm channels.
+vec2 encodeNormalOct(vec3 _normal)
+{
+	vec3 n = _normal / (abs(_normal.x) + abs(_normal.y) + abs(_normal.z) );
+	vec2 oct = n.xz;
+	if (n.y < 0.0)
+	{
+		vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);
+		oct = (1.0 - abs(n.zx) ) * signs;
+	}
+
+	return oct * 0.5 + 0.5;
+}
+
+vec3 decodeNormalOct(vec2 _rg)
+{
+	vec2 oct = _rg * 2.0 - 1.0;
+	vec3 n = vec3(oct.x, 1.0 - abs(oct.x) - abs(oct.y), oct.y);
+	float t = saturate(-n.y);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.z += n.z >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+// Lit layout keeps the share of direct light in alpha, so resolve can shadow it alone.
+vec4 gbufferLit(vec3 _albedo, vec3 _normal, float _sunVisibility, float _occlusion, vec4 _sunDirection)
+{
+	float ambient = _sunDirection.w * _occlusion;
+	float direct  = (1.0 - _sunDirection.w) * saturate(dot(_normal, _sunDirection.xyz) ) * _sunVisibility;
+	return vec4(_albedo * (ambient + direct), direct / max(ambient + direct, 1e-4) );
+}
+
+#endif // GBUFFER_SH_HEADER_GUARD
@@ -0,0 +1,98 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_PATCH_SH_HEADER_GUARD
+#define TERRAIN_PATCH_SH_HEADER_GUARD
+
+// Patch grid is 17x17 vertices, shared by all terrain vertex shaders.
+
+SAMPLER2D(s_heightTexture, 0);
+// x - height scale
+// y = "sea level"
+// z - height map uv per meter
+// w - height mip sampled, log2 of texels between vertices of the finest patches
+uniform vec4 u_heightMapParams;
+// [0] x - start of the morph range, fraction of its end, y - 1 if geomorphing, 0 otherwise
+// [1], [2] - xy and zw, camera xz of up to 4 views the patches were selected for, unused ones
+// repeat the first
+uniform vec4 u_lodMorphParams[3];
+
+// displacement map, _mip is picked per draw so vertices shared between patches read the
+// same heights
+float dmap(vec2 pos, float _mip)
+{
+	return (texture2DLod(s_heightTexture, pos , _mip).x) * 65536;
+}
+
+// LOD difference to the coarser neighbour a vertex on the patch edge is shared with, 0 inside
+// the patch. _lodTransition packs LOD difference to west, east, north and south neighbours,
+// 4 bits each.
+float patchEdgeLodDifference(int _vertexId, float _lodTransition)
+{
+	int column = _vertexId % 17;
+
+	// left edge - id % 17 == 0
+	// right edge - id % 17 == 16
+	// top edge - id >= 272
+	// bottom edge - id < 17
+	if (column == 0)
+	{
+		return _lodTransition % 16;
+	}
+	else if (column == 16)
+	{
+		return floor(_lodTransition / 16.0) % 16;
+	}
+	else if (_vertexId >= 272)
+	{
+		return floor(_lodTransition / 256.0) % 16;
+	}
+	else if (_vertexId < 17)
+	{
+		return floor(_lodTransition / 4096.0) % 16;
+	}
+
+	return 0.0;
+}
+
+// Moves edge vertex onto the edge of a coarser neighbour. Returns offset in patch space.
+vec2 stitchPatchEdge(int _vertexId, float _lodTransition, float _scale)
+{
+	int column = _vertexId % 17;
+	bool alongX = column != 0 && column != 16;
+	float edgeIndex = alongX ? float(column) : float(_vertexId / 17);
+
+	float f = pow(2, patchEdgeLodDifference(_vertexId, _lodTransition) );
+	float m = mod(edgeIndex, f);
+	// s will hold 1 if verex needs to move, 0 otherwise
+	float s = 1.0 - step(m, 0.5);
+	float shift = (f - m) * s * 0.0625 * _scale;
+	return alongX ? vec2(shift, 0.0) : vec2(0.0, shift);
+}
+
+// Blends odd grid vertices onto the grid of the parent LOD as the camera moves away, so the patch
+// matches its parent by the time the quadtree merges them. Morph is taken per vertex from its
+// distance to the nearest camera, vertices shared with a neighbour of the same LOD move alike and
+// every view draws the same surface. Stitched edge vertices
+// sit on the grid of the coarser neighbour and morph like it does, _lodDifference coarser.
+// _gridPos is in patch space, 0 to 1, _patchPos and _scale place the patch in the world.
+vec2 morphPatchVertex(vec2 _gridPos, vec2 _patchPos, float _scale, float _morphEnd, float _lodDifference)
+{
+	float coarsen = pow(2, _lodDifference);
+	vec2 worldPos = _patchPos + _gridPos * _scale;
+	float morphEnd = _morphEnd * coarsen;
+	float morphStart = morphEnd * u_lodMorphParams[0].x;
+	float distance = min(
+		  min(length(worldPos - u_lodMorphParams[1].xy), length(worldPos - u_lodMorphParams[1].zw) )
+		, min(length(worldPos - u_lodMorphParams[2].xy), length(worldPos - u_lodMorphParams[2].zw) )
+		);
+	float morph = saturate( (distance - morphStart) / (morphEnd - morphStart) ) * u_lodMorphParams[0].y;
+
+	// odd vertices are one cell past the parent grid, 16 cells per patch, patches start on even ones
+	float cell = _scale * coarsen * 0.0625;
+	vec2 odd = mod(floor(worldPos / cell + 0.5), 2.0) * cell;
+	return _gridPos - odd * (morph / _scale);
+}
+
+#endif // TERRAIN_PATCH_SH_HEADER_GUARD
@@ -0,0 +1,42 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+// Splat material blending shared by fs_terrain and cs_bakeVirtualPage. Stages must match
+// in both, images and samplers share binding stages.
+SAMPLER2DARRAY(s_materials, 1);
+SAMPLER2D(s_splatIndices, 3);
+SAMPLER2D(s_splatWeights, 4);
+
+// albedo repeats every 8 meters, i.e. 8 times per height map
+#define SPLAT_ALBEDO_REPEAT 8.0
+
+vec3 splatAlbedoLod(vec2 _heightUv, float _lod)
+{
+	vec4 layers  = floor(texture2DLod(s_splatIndices, _heightUv, 0.0) * 255.0 + 0.5);
+	vec4 weights = texture2DLod(s_splatWeights, _heightUv, 0.0);
+	weights /= max(dot(weights, vec4_splat(1.0) ), 0.0001);
+
+	vec2 uv = _heightUv * SPLAT_ALBEDO_REPEAT;
+	vec3 col = vec3_splat(0.0);
+	col += texture2DArrayLod(s_materials, vec3(uv, layers.x), _lod).rgb * weights.x;
+	col += texture2DArrayLod(s_materials, vec3(uv, layers.y), _lod).rgb * weights.y;
+	col += texture2DArrayLod(s_materials, vec3(uv, layers.z), _lod).rgb * weights.z;
+	col += texture2DArrayLod(s_materials, vec3(uv, layers.w), _lod).rgb * weights.w;
+	return col;
+}
+
+vec3 splatAlbedo(vec2 _heightUv)
+{
+	vec4 layers  = floor(texture2D(s_splatIndices, _heightUv) * 255.0 + 0.5);
+	vec4 weights = texture2D(s_splatWeights, _heightUv);
+	weights /= max(dot(weights, vec4_splat(1.0) ), 0.0001);
+
+	vec2 uv = _heightUv * SPLAT_ALBEDO_REPEAT;
+	vec3 col = vec3_splat(0.0);
+	col += texture2DArray(s_materials, vec3(uv, layers.x) ).rgb * weights.x;
+	col += texture2DArray(s_materials, vec3(uv, layers.y) ).rgb * weights.y;
+	col += texture2DArray(s_materials, vec3(uv, layers.z) ).rgb * weights.z;
+	col += texture2DArray(s_materials, vec3(uv, layers.w) ).rgb * weights.w;
+	return col;
+}
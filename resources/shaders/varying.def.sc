@@ -1,5 +1,7 @@
 vec2 v_texcoord0 : TEXCOORD0 = vec2(0.0, 0.0);
+vec2 v_texcoord1 : TEXCOORD3 = vec2(0.0, 0.0);
 vec3 v_position  : TEXCOORD1 = vec3(0.0, 0.0, 0.0);
+vec3 v_virtualPage : TEXCOORD4 = vec3(0.0, 0.0, 0.0);
 vec3 v_view      : TEXCOORD2 = vec3(0.0, 0.0, 0.0);
 vec3 v_normal    : NORMAL    = vec3(0.0, 0.0, 1.0);
 vec3 v_tangent   : TANGENT   = vec3(1.0, 0.0, 0.0);
@@ -0,0 +1,34 @@
+$input a_position, a_normal, a_color0, i_data0
+$output v_normal, v_color0
+
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include "common.sh"
+
+float hash(vec2 _p)
+{
+	return fract(sin(dot(_p, vec2(12.9898, 78.233) ) ) * 43758.5453);
+}
+
+void main()
+{
+	float type  = floor(i_data0.w / 16.0);
+	float scale = i_data0.w - type * 16.0;
+
+	// yaw and tint vary per instance so repeating meshes don't line up
+	float random = hash(i_data0.xz);
+	float yaw = random * 6.2831853;
+	float s = sin(yaw);
+	float c = cos(yaw);
+
+	vec3 pos = a_position * scale;
+	pos.xz = vec2(c * pos.x - s * pos.z, s * pos.x + c * pos.z);
+	vec3 normal = a_normal.xyz;
+	normal.xz = vec2(c * normal.x - s * normal.z, s * normal.x + c * normal.z);
+
+	gl_Position = mul(u_viewProj, vec4(pos + i_data0.xyz, 1.0) );
+	v_normal = normal;
+	v_color0 = vec4(a_color0.rgb * (0.85 + 0.3 * random), 1.0);
+}
@@ -1,5 +1,5 @@
 $input a_position, a_color1, i_data0, i_data1
-$output v_position, v_texcoord0, v_bc
+$output v_position, v_texcoord0, v_texcoord1, v_virtualPage, v_bc
 
 /*
  * Copyright 2015 Andrew Mac. All rights reserved.
@@ -7,103 +7,39 @@ $output v_position, v_texcoord0, v_bc
  */
 
 #include "common.sh"
-
-SAMPLER2D(s_heightTexture, 0);
-// x - height scale
-// y = "sea level"
-uniform vec4 u_heightMapParams;
-
-// displacement map
-float dmap(vec2 pos)
-{
-	return (texture2DLod(s_heightTexture, pos , 0).x) * 65536;
-}
+#include "terrain_patch.sh"
 
 void main()
 {
 	float scale = i_data0.z;
-
-	v_texcoord0.x = a_position.x;
-	v_texcoord0.y = a_position.z;
-	// 17 / 1024
-	v_texcoord0 *= u_heightMapParams.z;
-	v_position = a_position.xyz;
-	v_position.x *= scale;
-	v_position.z *= scale;
 	float loadTransition = i_data0.w;
 
-	v_texcoord0.xy += i_data1.xy;
-	
-	//v_texcoord0.xy = i_data1.xy;
-	// left edge- id % 16 == 0
-	// right edge - id % 16 == 15
-	// top edge id >= 250
-	// bottom edge id < 16
-	
+	vec2 gridPos = a_position.xz;
+	float lodDifference = 0.0;
 	if (loadTransition > 0.0)
 	{
-		int isLeftEdge = gl_VertexID  % 17;
-		int isRightEdge = isLeftEdge;
-		int isTopEdge = gl_VertexID;
-		int isBottomEdge = gl_VertexID;
-
-		if (isLeftEdge == 0)
-		{
-			int edgeIndex = gl_VertexID / 17;
-
-			float f = loadTransition % 16;
-			f = pow(2,f);
-			float m = mod(edgeIndex, f);
-			// s will hold 1 if verex needs to move, 0 otherwise
-			float s = 1.0 - step(m, 0.5);
-			
-			v_position.z +=  (f - m) * s * 0.0625 * scale;
-		
-		}
-		else if (isRightEdge == 16)
-		{
-			int edgeIndex = gl_VertexID / 17;
-			// extract value from bits 4-7 in loadTranstion
-			float f = floor(loadTransition / 16.0) % 16;
-			f = pow(2,f);
-			float m = mod(edgeIndex, f);
-			// s will hold 1 if verex needs to move, 0 otherwise
-			float s = 1.0 - step(m, 0.5);
-			
-			v_position.z +=  (f - m) * s * 0.0625 * scale;
-		}
-		else if (isTopEdge >= 272)
-		{
-			int edgeIndex = isTopEdge - 272;
-			// extract value from bits 4-7 in loadTranstion
-			float f = floor(loadTransition / 256.0) % 16;
-			f = pow(2,f);
-			float m = mod(edgeIndex, f);
-			// s will hold 1 if verex needs to move, 0 otherwise
-			float s = 1.0 - step(m, 0.5);
-			
-			v_position.x +=  (f - m) * s * 0.0625 * scale;
-		}
-		else if (isBottomEdge < 17)
-		{
-			int edgeIndex = isBottomEdge;
-			// extract value from bits 4-7 in loadTranstion
-			float f = floor(loadTransition / 4096.0) % 16;
-			f = pow(2,f);
-			float m = mod(edgeIndex, f);
-			// s will hold 1 if verex needs to move, 0 otherwise
-			float s = 1.0 - step(m, 0.5);
-			
-			v_position.x +=  (f - m) * s * 0.0625 * scale;
-		}
-		
+		gridPos += stitchPatchEdge(gl_VertexID, loadTransition, 1.0);
+		lodDifference = patchEdgeLodDifference(gl_VertexID, loadTransition);
 	}
+	gridPos = morphPatchVertex(gridPos, i_data0.xy, scale, i_data1.w, lodDifference);
 
+	// patch corner uv plus the offset inside the patch
+	v_texcoord0 = gridPos * scale * u_heightMapParams.z;
+	v_position = a_position.xyz;
+	v_position.xz = gridPos * scale;
+
+	v_texcoord0.xy += i_data1.xy;
 
 	//v_position.xz *= u_scale;
 	v_bc = a_color1;
 
-	v_position.y = dmap(v_texcoord0) * u_heightMapParams.x;
+	// z - baked virtual texture page + 1, 0 if patch blends splat layers
+	v_virtualPage.xy = v_position.xz / scale;
+	v_virtualPage.z = i_data1.z;
+
+	v_position.y = dmap(v_texcoord0, u_heightMapParams.w) * u_heightMapParams.x;
+	// height map uv, used to fetch cached normals
+	v_texcoord1 = v_texcoord0;
 	v_texcoord0 *= 8.0;
 	vec4 worldPos = vec4(v_position.xyz, 1.0);
 	worldPos.x += i_data0.x;
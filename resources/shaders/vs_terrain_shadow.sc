@@ -0,0 +1,30 @@
+$input a_position, i_data0, i_data1
+
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include "common.sh"
+#include "terrain_patch.sh"
+
+// Depth only version of vs_terrain_height_texture, drawn into shadow cascades.
+void main()
+{
+	float scale = i_data0.z;
+	float loadTransition = i_data0.w;
+
+	vec2 gridPos = a_position.xz;
+	float lodDifference = 0.0;
+	if (loadTransition > 0.0)
+	{
+		gridPos += stitchPatchEdge(gl_VertexID, loadTransition, 1.0);
+		lodDifference = patchEdgeLodDifference(gl_VertexID, loadTransition);
+	}
+	gridPos = morphPatchVertex(gridPos, i_data0.xy, scale, i_data1.w, lodDifference);
+
+	vec2 uv = gridPos * scale * u_heightMapParams.z + i_data1.xy;
+	vec3 position;
+	position.xz = gridPos * scale + i_data0.xy;
+	position.y = dmap(uv, u_heightMapParams.w) * u_heightMapParams.x;
+	gl_Position = mul(u_viewProj, vec4(position, 1.0) );
+}
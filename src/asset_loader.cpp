@@ -0,0 +1,491 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <bx/allocator.h>
+#include <bx/file.h>
+#include <bx/mutex.h>
+#include <bx/semaphore.h>
+#include <bx/string.h>
+#include <bx/thread.h>
+#include <bx/timer.h>
+#include <bimg/decode.h>
+#include "asset_loader.h"
+#include "terrain_memory.h"
+
+void* load(bx::FileReaderI* _reader, bx::AllocatorI* _allocator, const char* _filePath, uint32_t* _size);
+bx::FileReaderI* createFileReader();
+void destroyFileReader(bx::FileReaderI* _reader);
+void getShaderFilePath(char* _outFilePath, int32_t _max, const char* _name);
+bgfx::TextureHandle createTextureFromImage(bimg::ImageContainer* _image, const char* _name, uint64_t _flags, bgfx::TextureInfo* _info);
+
+namespace
+{
+	struct AssetType
+	{
+		enum Enum
+		{
+			Texture,
+			Program,
+			Image,
+			Job,
+		};
+	};
+
+	struct AssetJob
+	{
+		AssetJob* m_next;
+		AssetType::Enum m_type;
+
+		char m_filePath[2][256];
+		void* m_data[2];
+		uint32_t m_size[2];
+		bimg::ImageContainer* m_image;
+
+		void* m_target;
+		uint64_t m_flags;
+
+		AssetJobFn   m_work;
+		AssetDoneFn  m_done;
+		AssetImageFn m_imageDone;
+		void* m_userData;
+
+		int64_t m_ioTime;
+		int64_t m_decodeTime;
+	};
+
+	// intrusive FIFO, guarded by the owner's mutex
+	struct AssetQueue
+	{
+		void push(AssetJob* _job)
+		{
+			_job->m_next = NULL;
+			if (NULL == m_tail)
+			{
+				m_head = _job;
+			}
+			else
+			{
+				m_tail->m_next = _job;
+			}
+			m_tail = _job;
+		}
+
+		AssetJob* pop()
+		{
+			AssetJob* job = m_head;
+			if (NULL != job)
+			{
+				m_head = job->m_next;
+				m_tail = NULL == m_head ? NULL : m_tail;
+			}
+			return job;
+		}
+
+		AssetJob* m_head;
+		AssetJob* m_tail;
+	};
+
+	struct AssetLoader
+	{
+		static constexpr uint32_t kMaxThreads = 8;
+
+		bx::Thread m_thread[kMaxThreads];
+		uint32_t m_numThreads;
+
+		bx::Mutex m_mutex;
+		bx::Semaphore m_sem;
+		AssetQueue m_pending;   //!< Waiting for a loader thread.
+		AssetQueue m_completed; //!< Waiting for the API thread.
+		bool m_exit;
+
+		Pool m_jobPool;
+
+		int64_t m_startTime;
+		int64_t m_ioTime;
+		int64_t m_decodeTime;
+		AssetLoaderStats m_stats;
+	};
+
+	static AssetLoader* s_loader = NULL;
+}
+
+static double toMs(int64_t _ticks)
+{
+	return double(_ticks) * 1000.0 / double(bx::getHPFrequency() );
+}
+
+static void releaseCb(void* _ptr, void* /*_userData*/)
+{
+	BX_FREE(getAllocator(MemoryCategory::Assets), _ptr);
+}
+
+static void loadJob(bx::FileReaderI* _reader, AssetJob* _job)
+{
+	const uint32_t numFiles = AssetType::Program == _job->m_type ? 2 : 1;
+
+	int64_t start = bx::getHPCounter();
+	for (uint32_t ii = 0; ii < numFiles; ++ii)
+	{
+		if ('\0' != _job->m_filePath[ii][0])
+		{
+			_job->m_data[ii] = load(_reader, getAllocator(MemoryCategory::Assets), _job->m_filePath[ii], &_job->m_size[ii]);
+		}
+	}
+	_job->m_ioTime = bx::getHPCounter() - start;
+
+	if (AssetType::Texture == _job->m_type
+	||  AssetType::Image   == _job->m_type)
+	{
+		start = bx::getHPCounter();
+		if (NULL != _job->m_data[0])
+		{
+			_job->m_image = bimg::imageParse(getAllocator(MemoryCategory::Assets), _job->m_data[0], _job->m_size[0]);
+			BX_FREE(getAllocator(MemoryCategory::Assets), _job->m_data[0]);
+			_job->m_data[0] = NULL;
+		}
+		_job->m_decodeTime = bx::getHPCounter() - start;
+	}
+	else if (AssetType::Job == _job->m_type
+	     &&  NULL != _job->m_work)
+	{
+		_job->m_work(_job->m_userData);
+		_job->m_decodeTime = bx::getHPCounter() - start;
+	}
+}
+
+static int32_t loaderThreadFunc(bx::Thread* /*_self*/, void* _userData)
+{
+	AssetLoader* loader = (AssetLoader*)_userData;
+	bx::FileReaderI* reader = createFileReader();
+
+	for (;;)
+	{
+		loader->m_sem.wait();
+
+		AssetJob* job;
+		{
+			bx::MutexScope lock(loader->m_mutex);
+			if (loader->m_exit)
+			{
+				break;
+			}
+			job = loader->m_pending.pop();
+		}
+
+		if (NULL == job)
+		{
+			continue;
+		}
+
+		loadJob(reader, job);
+
+		bx::MutexScope lock(loader->m_mutex);
+		loader->m_completed.push(job);
+	}
+
+	destroyFileReader(reader);
+	return 0;
+}
+
+static void freeJob(AssetJob* _job)
+{
+	for (uint32_t ii = 0; ii < BX_COUNTOF(_job->m_data); ++ii)
+	{
+		if (NULL != _job->m_data[ii])
+		{
+			BX_FREE(getAllocator(MemoryCategory::Assets), _job->m_data[ii]);
+		}
+	}
+
+	if (NULL != _job->m_image)
+	{
+		bimg::imageFree(_job->m_image);
+	}
+
+	bx::MutexScope lock(s_loader->m_mutex);
+	poolFree(s_loader->m_jobPool, _job);
+}
+
+static AssetJob* createJob(AssetType::Enum _type)
+{
+	AssetJob* job;
+	{
+		bx::MutexScope lock(s_loader->m_mutex);
+		job = (AssetJob*)poolAlloc(s_loader->m_jobPool);
+	}
+
+	bx::memSet(job, 0, sizeof(AssetJob) );
+	job->m_type = _type;
+	return job;
+}
+
+static void submitJob(AssetJob* _job)
+{
+	BX_CHECK(NULL != s_loader, "Asset loader is not created.");
+
+	{
+		bx::MutexScope lock(s_loader->m_mutex);
+		s_loader->m_pending.push(_job);
+	}
+
+	++s_loader->m_stats.m_numPending;
+	s_loader->m_sem.post();
+}
+
+static bgfx::ShaderHandle createShader(AssetJob* _job, uint32_t _index)
+{
+	bgfx::ShaderHandle handle = BGFX_INVALID_HANDLE;
+	if (NULL != _job->m_data[_index])
+	{
+		const bgfx::Memory* mem = bgfx::makeRef(_job->m_data[_index], _job->m_size[_index], releaseCb);
+		_job->m_data[_index] = NULL;
+
+		handle = bgfx::createShader(mem);
+		bgfx::setName(handle, _job->m_filePath[_index]);
+	}
+
+	return handle;
+}
+
+// returns false if the asset failed to load
+static bool completeJob(AssetJob* _job)
+{
+	switch (_job->m_type)
+	{
+	case AssetType::Texture:
+		if (NULL != _job->m_image)
+		{
+			bgfx::TextureHandle* target = (bgfx::TextureHandle*)_job->m_target;
+			bgfx::TextureHandle handle = createTextureFromImage(_job->m_image, _job->m_filePath[0], _job->m_flags, NULL);
+			_job->m_image = NULL;
+
+			if (bgfx::isValid(handle) )
+			{
+				if (bgfx::isValid(*target) )
+				{
+					bgfx::destroy(*target);
+				}
+				*target = handle;
+				return true;
+			}
+		}
+		return false;
+
+	case AssetType::Program:
+		{
+			const bool compute = '\0' == _job->m_filePath[1][0];
+			bgfx::ShaderHandle vsh = createShader(_job, 0);
+			bgfx::ShaderHandle fsh = createShader(_job, 1);
+
+			if (!bgfx::isValid(vsh)
+			|| (!compute && !bgfx::isValid(fsh) ) )
+			{
+				if (bgfx::isValid(vsh) ) { bgfx::destroy(vsh); }
+				if (bgfx::isValid(fsh) ) { bgfx::destroy(fsh); }
+				return false;
+			}
+
+			bgfx::ProgramHandle* target = (bgfx::ProgramHandle*)_job->m_target;
+			*target = compute
+				? bgfx::createProgram(vsh, true)
+				: bgfx::createProgram(vsh, fsh, true)
+				;
+			return bgfx::isValid(*target);
+		}
+
+	case AssetType::Image:
+		{
+			bimg::ImageContainer* image = _job->m_image;
+			_job->m_image = NULL;
+			_job->m_imageDone(image, _job->m_userData);
+			return NULL != image;
+		}
+
+	case AssetType::Job:
+		if (NULL != _job->m_done)
+		{
+			_job->m_done(_job->m_userData);
+		}
+		return true;
+	}
+
+	return false;
+}
+
+void assetLoaderCreate(uint32_t _numThreads)
+{
+	BX_CHECK(NULL == s_loader, "Asset loader is already created.");
+
+	s_loader = BX_NEW(getAllocator(MemoryCategory::Assets), AssetLoader);
+	poolCreate(s_loader->m_jobPool, sizeof(AssetJob), 64, 0, getAllocator(MemoryCategory::Assets) );
+	s_loader->m_pending   = { NULL, NULL };
+	s_loader->m_completed = { NULL, NULL };
+	s_loader->m_exit = false;
+	s_loader->m_startTime  = bx::getHPCounter();
+	s_loader->m_ioTime     = 0;
+	s_loader->m_decodeTime = 0;
+	bx::memSet(&s_loader->m_stats, 0, sizeof(AssetLoaderStats) );
+
+	s_loader->m_numThreads = bx::clamp<uint32_t>(_numThreads, 1, AssetLoader::kMaxThreads);
+	for (uint32_t ii = 0; ii < s_loader->m_numThreads; ++ii)
+	{
+		s_loader->m_thread[ii].init(loaderThreadFunc, s_loader, 0, "asset loader");
+	}
+}
+
+void assetLoaderDestroy()
+{
+	if (NULL == s_loader)
+	{
+		return;
+	}
+
+	{
+		bx::MutexScope lock(s_loader->m_mutex);
+		s_loader->m_exit = true;
+	}
+
+	for (uint32_t ii = 0; ii < s_loader->m_numThreads; ++ii)
+	{
+		s_loader->m_sem.post();
+	}
+
+	for (uint32_t ii = 0; ii < s_loader->m_numThreads; ++ii)
+	{
+		s_loader->m_thread[ii].shutdown();
+	}
+
+	// owners of jobs and images get their payloads back through the usual callbacks
+	while (AssetJob* job = s_loader->m_pending.pop() )
+	{
+		switch (job->m_type)
+		{
+		case AssetType::Job:
+			loadJob(NULL, job);
+			s_loader->m_completed.push(job);
+			break;
+
+		case AssetType::Image:
+			s_loader->m_completed.push(job);
+			break;
+
+		default:
+			--s_loader->m_stats.m_numPending;
+			freeJob(job);
+			break;
+		}
+	}
+
+	assetLoaderUpdate();
+
+	poolDestroy(s_loader->m_jobPool);
+	BX_DELETE(getAllocator(MemoryCategory::Assets), s_loader);
+	s_loader = NULL;
+}
+
+uint32_t assetLoaderUpdate()
+{
+	AssetLoaderStats& stats = s_loader->m_stats;
+
+	AssetQueue completed;
+	{
+		bx::MutexScope lock(s_loader->m_mutex);
+		completed = s_loader->m_completed;
+		s_loader->m_completed = { NULL, NULL };
+	}
+
+	uint32_t num = 0;
+	while (AssetJob* job = completed.pop() )
+	{
+		const int64_t start = bx::getHPCounter();
+		const bool loaded = completeJob(job);
+		const int64_t createTime = bx::getHPCounter() - start;
+
+		if (loaded)
+		{
+			++stats.m_numLoaded;
+		}
+		else
+		{
+			++stats.m_numFailed;
+			BX_TRACE("Failed to load %s.", job->m_filePath[0]);
+		}
+
+		s_loader->m_ioTime     += job->m_ioTime;
+		s_loader->m_decodeTime += job->m_decodeTime;
+		stats.m_ioMs     = toMs(s_loader->m_ioTime);
+		stats.m_decodeMs = toMs(s_loader->m_decodeTime);
+		stats.m_createMs += toMs(createTime);
+
+		const double totalMs = toMs(job->m_ioTime + job->m_decodeTime + createTime);
+		if (totalMs > stats.m_slowestMs
+		&&  AssetType::Job != job->m_type)
+		{
+			stats.m_slowestMs = totalMs;
+			bx::strCopy(stats.m_slowest, BX_COUNTOF(stats.m_slowest), job->m_filePath[0]);
+		}
+
+		--stats.m_numPending;
+		if (0 == stats.m_numPending
+		&&  0.0 == stats.m_startupMs)
+		{
+			stats.m_startupMs = toMs(bx::getHPCounter() - s_loader->m_startTime);
+		}
+
+		freeJob(job);
+		++num;
+	}
+
+	return num;
+}
+
+void assetLoadTexture(bgfx::TextureHandle* _handle, const char* _filePath, uint64_t _flags)
+{
+	static const uint32_t s_placeholder = UINT32_C(0xff808080);
+	*_handle = bgfx::createTexture2D(1, 1, false, 1, bgfx::TextureFormat::RGBA8, _flags, bgfx::copy(&s_placeholder, sizeof(s_placeholder) ) );
+
+	AssetJob* job = createJob(AssetType::Texture);
+	bx::strCopy(job->m_filePath[0], BX_COUNTOF(job->m_filePath[0]), _filePath);
+	job->m_target = _handle;
+	job->m_flags  = _flags;
+	submitJob(job);
+}
+
+void assetLoadProgram(bgfx::ProgramHandle* _handle, const char* _vsName, const char* _fsName)
+{
+	_handle->idx = bgfx::kInvalidHandle;
+
+	// renderer type is only known on the API thread, resolve paths here
+	AssetJob* job = createJob(AssetType::Program);
+	getShaderFilePath(job->m_filePath[0], BX_COUNTOF(job->m_filePath[0]), _vsName);
+	if (NULL != _fsName)
+	{
+		getShaderFilePath(job->m_filePath[1], BX_COUNTOF(job->m_filePath[1]), _fsName);
+	}
+	job->m_target = _handle;
+	submitJob(job);
+}
+
+void assetLoadImage(const char* _filePath, AssetImageFn _done, void* _userData)
+{
+	AssetJob* job = createJob(AssetType::Image);
+	bx::strCopy(job->m_filePath[0], BX_COUNTOF(job->m_filePath[0]), _filePath);
+	job->m_imageDone = _done;
+	job->m_userData  = _userData;
+	submitJob(job);
+}
+
+void assetSubmitJob(AssetJobFn _work, AssetDoneFn _done, void* _userData)
+{
+	AssetJob* job = createJob(AssetType::Job);
+	job->m_work     = _work;
+	job->m_done     = _done;
+	job->m_userData = _userData;
+	submitJob(job);
+}
+
+const AssetLoaderStats& assetLoaderGetStats()
+{
+	return s_loader->m_stats;
+}
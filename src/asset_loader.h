@@ -0,0 +1,65 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef ASSET_LOADER_H_HEADER_GUARD
+#define ASSET_LOADER_H_HEADER_GUARD
+
+#include <bgfx/bgfx.h>
+
+namespace bimg { struct ImageContainer; }
+
+/// Runs on a loader thread.
+typedef void (*AssetJobFn)(void* _userData);
+
+/// Runs on the API thread from assetLoaderUpdate, after the job finished.
+typedef void (*AssetDoneFn)(void* _userData);
+
+/// Runs on the API thread with the decoded image, or NULL if it couldn't be loaded. Callee
+/// owns the image.
+typedef void (*AssetImageFn)(bimg::ImageContainer* _image, void* _userData);
+
+struct AssetLoaderStats
+{
+	uint32_t m_numPending;
+	uint32_t m_numLoaded;
+	uint32_t m_numFailed;
+	double   m_ioMs;       //!< Summed file read time over all loader threads.
+	double   m_decodeMs;   //!< Summed image parse time over all loader threads.
+	double   m_createMs;   //!< Time spent creating bgfx resources on the API thread.
+	double   m_startupMs;  //!< From assetLoaderCreate until the queue first ran empty.
+	double   m_slowestMs;
+	char     m_slowest[128];
+};
+
+/// Starts _numThreads loader threads. Files are read and decoded there, only bgfx resource
+/// creation happens on the API thread.
+void assetLoaderCreate(uint32_t _numThreads);
+
+/// Stops loader threads and completes what they finished. Jobs that didn't start run here, so
+/// every job and image callback runs exactly once, images that didn't start pass NULL. Texture
+/// and program loads that didn't start are dropped and their targets are left untouched.
+void assetLoaderDestroy();
+
+/// Call once per frame on the API thread, completes finished requests. Returns number of
+/// completed requests.
+uint32_t assetLoaderUpdate();
+
+/// Sets *_handle to a 1x1 placeholder right away and replaces it with the texture once it's
+/// loaded. _handle must stay valid until the request completes.
+void assetLoadTexture(bgfx::TextureHandle* _handle, const char* _filePath, uint64_t _flags);
+
+/// Sets *_handle to invalid and to the program once both shaders are loaded. Compute program
+/// is created when _fsName is NULL.
+void assetLoadProgram(bgfx::ProgramHandle* _handle, const char* _vsName, const char* _fsName = NULL);
+
+/// Reads and decodes image on a loader thread and passes it to _done.
+void assetLoadImage(const char* _filePath, AssetImageFn _done, void* _userData);
+
+/// Runs _work on a loader thread and then _done on the API thread. Either can be NULL.
+void assetSubmitJob(AssetJobFn _work, AssetDoneFn _done, void* _userData);
+
+///
+const AssetLoaderStats& assetLoaderGetStats();
+
+#endif // ASSET_LOADER_H_HEADER_GUARD
@@ -0,0 +1,1313 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <bx/math.h>
+#include <bx/os.h>
+#include <bx/string.h>
+#include <bx/timer.h>
+#include "asset_loader.h"
+#include "benchmark.h"
+#include "height_codec.h"
+#include "terrain_document.h"
+#include "terrain_file.h"
+#include "terrain_heightfield.h"
+#include "terrain_heightmips.h"
+#include "terrain_memory.h"
+#include "terrain_occlusion.h"
+#include "terrain_prefetch.h"
+#include "terrain_quadtree.h"
+#include "terrain_streaming.h"
+#include "terrain_views.h"
+
+static const uint32_t s_referenceMapSize  = 1024;
+static const uint32_t s_referenceTileSize = 32;
+
+// set by every check against a reference, so the exit code can gate CI
+static bool s_failed = false;
+
+static double toSeconds(int64_t _ticks)
+{
+	return double(_ticks) / double(bx::getHPFrequency() );
+}
+
+static float hashNoise(int32_t _x, int32_t _y, uint32_t _seed)
+{
+	uint32_t hash = uint32_t(_x) * 0x8da6b343u ^ uint32_t(_y) * 0xd8163841u ^ _seed * 0xcb1ab31fu;
+	hash ^= hash >> 13;
+	hash *= 0x5bd1e995u;
+	hash ^= hash >> 15;
+	return float(hash & 0xffff) / 65535.0f;
+}
+
+static float valueNoise(float _x, float _y, uint32_t _seed)
+{
+	const int32_t x0 = int32_t(bx::floor(_x) );
+	const int32_t y0 = int32_t(bx::floor(_y) );
+	const float fx = _x - float(x0);
+	const float fy = _y - float(y0);
+	const float sx = fx * fx * (3.0f - 2.0f * fx);
+	const float sy = fy * fy * (3.0f - 2.0f * fy);
+
+	const float top    = bx::lerp(hashNoise(x0, y0,     _seed), hashNoise(x0 + 1, y0,     _seed), sx);
+	const float bottom = bx::lerp(hashNoise(x0, y0 + 1, _seed), hashNoise(x0 + 1, y0 + 1, _seed), sx);
+	return bx::lerp(top, bottom, sy);
+}
+
+void generateReferenceHeightMap(uint16_t* _dst, uint32_t _size, uint32_t _seed)
+{
+	// ridged hills on top of smooth plains, roughly what artists sculpt
+	for (uint32_t yy = 0; yy < _size; ++yy)
+	{
+		for (uint32_t xx = 0; xx < _size; ++xx)
+		{
+			float height = 0.0f;
+			float amplitude = 0.5f;
+			float frequency = 4.0f / float(_size);
+			for (uint32_t octave = 0; octave < 8; ++octave)
+			{
+				const float noise = valueNoise(xx * frequency, yy * frequency, _seed + octave);
+				height += amplitude * (octave < 3 ? noise : 1.0f - bx::abs(noise * 2.0f - 1.0f) );
+				amplitude *= 0.5f;
+				frequency *= 2.0f;
+			}
+
+			_dst[xx + yy * _size] = uint16_t(bx::clamp(height, 0.0f, 1.0f) * 65535.0f);
+		}
+	}
+}
+
+struct DecodeJob
+{
+	const uint8_t* m_src;
+	uint32_t m_srcSize;
+	uint16_t* m_dst;
+	uint32_t m_width;
+	uint32_t m_height;
+	uint32_t m_dstPitch;
+	bool m_failed;
+};
+
+static void decodeTileJob(void* _userData)
+{
+	DecodeJob* job = (DecodeJob*)_userData;
+	job->m_failed = !heightTileDecompress(job->m_dst, job->m_width, job->m_height, job->m_dstPitch, job->m_src, job->m_srcSize);
+}
+
+// a tile decodes in microseconds, loader jobs take a row of tiles to amortize queueing
+static void decodeTileRowJob(void* _userData)
+{
+	DecodeJob* jobs = (DecodeJob*)_userData;
+	for (uint32_t ii = 0; ii < s_referenceMapSize / s_referenceTileSize; ++ii)
+	{
+		decodeTileJob(&jobs[ii]);
+	}
+}
+
+static void benchHeightCodec()
+{
+	const uint32_t size = s_referenceMapSize;
+	const uint32_t tileSize = s_referenceTileSize;
+	const uint32_t numTilesX = size / tileSize;
+	const uint32_t numTiles = numTilesX * numTilesX;
+	const uint32_t rawSize = size * size * sizeof(uint16_t);
+	const double rawMb = double(rawSize) / (1024.0 * 1024.0);
+
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::General);
+	uint16_t* heights = (uint16_t*)BX_ALLOC(allocator, rawSize);
+	uint16_t* decoded = (uint16_t*)BX_ALLOC(allocator, rawSize);
+	generateReferenceHeightMap(heights, size, 1);
+
+	const uint32_t tileBound = heightTileCompressBound(tileSize, tileSize);
+	uint8_t* compressed = (uint8_t*)BX_ALLOC(allocator, tileBound * numTiles);
+	DecodeJob* jobs = (DecodeJob*)BX_ALLOC(allocator, sizeof(DecodeJob) * numTiles);
+
+	printf("height codec, %dx%d reference map, %dx%d tiles\n", size, size, tileSize, tileSize);
+	printf("%9s %8s %12s %12s %12s %10s\n", "max error", "ratio", "encode MB/s", "decode MB/s", "4 loaders", "error");
+
+	static const uint16_t s_maxErrors[] = { 0, 1, 4, 16 };
+	for (uint32_t ee = 0; ee < BX_COUNTOF(s_maxErrors); ++ee)
+	{
+		uint32_t compressedSize = 0;
+
+		int64_t start = bx::getHPCounter();
+		for (uint32_t ii = 0; ii < numTiles; ++ii)
+		{
+			const uint32_t tx = ii % numTilesX;
+			const uint32_t ty = ii / numTilesX;
+			DecodeJob& job = jobs[ii];
+			job.m_src      = &compressed[ii * tileBound];
+			job.m_srcSize  = heightTileCompress(&compressed[ii * tileBound], tileBound, &heights[tx * tileSize + ty * tileSize * size], tileSize, tileSize, size, s_maxErrors[ee]);
+			job.m_dst      = &decoded[tx * tileSize + ty * tileSize * size];
+			job.m_width    = tileSize;
+			job.m_height   = tileSize;
+			job.m_dstPitch = size;
+			compressedSize += job.m_srcSize;
+		}
+		const double encodeTime = toSeconds(bx::getHPCounter() - start);
+
+		// best of a few runs, first one warms caches
+		double decodeTime = 1e9;
+		for (uint32_t run = 0; run < 4; ++run)
+		{
+			start = bx::getHPCounter();
+			for (uint32_t ii = 0; ii < numTiles; ++ii)
+			{
+				decodeTileJob(&jobs[ii]);
+			}
+			decodeTime = bx::min(decodeTime, toSeconds(bx::getHPCounter() - start) );
+		}
+
+		int32_t maxError = 0;
+		for (uint32_t ii = 0; ii < size * size; ++ii)
+		{
+			const int32_t error = int32_t(heights[ii]) - int32_t(decoded[ii]);
+			maxError = bx::max(maxError, 0 > error ? -error : error);
+		}
+
+		uint32_t numFailed = 0;
+		for (uint32_t ii = 0; ii < numTiles; ++ii)
+		{
+			numFailed += jobs[ii].m_failed;
+		}
+		if (0 != numFailed)
+		{
+			printf("  %u tiles FAILED to decode\n", numFailed);
+		}
+		s_failed |= 0 != numFailed || maxError > s_maxErrors[ee];
+
+		assetLoaderCreate(4);
+		start = bx::getHPCounter();
+		for (uint32_t ii = 0; ii < numTiles; ii += numTilesX)
+		{
+			assetSubmitJob(decodeTileRowJob, NULL, &jobs[ii]);
+		}
+		while (0 != assetLoaderGetStats().m_numPending)
+		{
+			assetLoaderUpdate();
+		}
+		const double threadedTime = toSeconds(bx::getHPCounter() - start);
+		assetLoaderDestroy();
+
+		printf("%9d %8.2f %12.1f %12.1f %12.1f %10d\n"
+			, s_maxErrors[ee]
+			, double(rawSize) / double(compressedSize)
+			, rawMb / encodeTime
+			, rawMb / decodeTime
+			, rawMb / threadedTime
+			, maxError
+			);
+	}
+
+	BX_FREE(allocator, jobs);
+	BX_FREE(allocator, compressed);
+	BX_FREE(allocator, decoded);
+	BX_FREE(allocator, heights);
+}
+
+struct RaycastJob
+{
+	const Heightfield* m_field;
+	const bx::Vec3* m_origins;
+	const bx::Vec3* m_dirs;
+	RayHit* m_hits;
+	uint32_t m_num;
+};
+
+static void raycastJob(void* _userData)
+{
+	const RaycastJob* job = (const RaycastJob*)_userData;
+	terrainRaycastBatch(*job->m_field, job->m_origins, job->m_dirs, job->m_num, 1000.0f, job->m_hits);
+}
+
+static void benchRaycast()
+{
+	const uint32_t size = s_referenceMapSize;
+	const uint32_t numRays = 1 << 16;
+	const uint32_t numJobs = 64;
+	const float texelSize = 0.5f;
+	const float worldSize = size * texelSize;
+
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::General);
+	uint16_t* heights = (uint16_t*)BX_ALLOC(allocator, size * size * sizeof(uint16_t) );
+	generateReferenceHeightMap(heights, size, 1);
+
+	// 100m of relief over 512m, similar slopes as sculpted maps
+	Heightfield field;
+	heightfieldCreate(field, size, size, texelSize, 100.0f / 65535.0f);
+	const TileRect full = { 0, 0, int32_t(size), int32_t(size) };
+
+	int64_t start = bx::getHPCounter();
+	heightfieldUpdate(field, heights, full);
+	const double buildTime = toSeconds(bx::getHPCounter() - start);
+
+	// rays from camera heights looking down at 5 to 60 degrees, like picking and line of sight
+	bx::Vec3* origins = (bx::Vec3*)BX_ALLOC(allocator, numRays * sizeof(bx::Vec3) );
+	bx::Vec3* dirs = (bx::Vec3*)BX_ALLOC(allocator, numRays * sizeof(bx::Vec3) );
+	RayHit* hits = (RayHit*)BX_ALLOC(allocator, numRays * sizeof(RayHit) );
+	for (uint32_t ii = 0; ii < numRays; ++ii)
+	{
+		const float yaw   = hashNoise(ii, 0, 7) * bx::kPi2;
+		const float pitch = bx::toRad(5.0f + 55.0f * hashNoise(ii, 1, 7) );
+		origins[ii] = { hashNoise(ii, 2, 7) * worldSize, 110.0f + 40.0f * hashNoise(ii, 3, 7), hashNoise(ii, 4, 7) * worldSize };
+		dirs[ii] = { bx::cos(yaw) * bx::cos(pitch), -bx::sin(pitch), bx::sin(yaw) * bx::cos(pitch) };
+	}
+
+	double singleTime = 1e9;
+	uint32_t numHits = 0;
+	for (uint32_t run = 0; run < 4; ++run)
+	{
+		start = bx::getHPCounter();
+		numHits = terrainRaycastBatch(field, origins, dirs, numRays, 1000.0f, hits);
+		singleTime = bx::min(singleTime, toSeconds(bx::getHPCounter() - start) );
+	}
+
+	RaycastJob jobs[numJobs];
+	const uint32_t raysPerJob = numRays / numJobs;
+	assetLoaderCreate(4);
+	start = bx::getHPCounter();
+	for (uint32_t ii = 0; ii < numJobs; ++ii)
+	{
+		jobs[ii].m_field   = &field;
+		jobs[ii].m_origins = &origins[ii * raysPerJob];
+		jobs[ii].m_dirs    = &dirs[ii * raysPerJob];
+		jobs[ii].m_hits    = &hits[ii * raysPerJob];
+		jobs[ii].m_num     = raysPerJob;
+		assetSubmitJob(raycastJob, NULL, &jobs[ii]);
+	}
+	while (0 != assetLoaderGetStats().m_numPending)
+	{
+		assetLoaderUpdate();
+	}
+	const double threadedTime = toSeconds(bx::getHPCounter() - start);
+	assetLoaderDestroy();
+
+	printf("raycast, %dx%d reference map, %d rays, %d hits\n", size, size, numRays, numHits);
+	printf("pyramid build %.2fms, %.3fus per ray, %.2f Mrays/s, %.2f Mrays/s on 4 loaders\n"
+		, buildTime * 1000.0
+		, singleTime * 1e6 / numRays
+		, numRays / singleTime * 1e-6
+		, numRays / threadedTime * 1e-6
+		);
+
+	heightfieldDestroy(field);
+	BX_FREE(allocator, hits);
+	BX_FREE(allocator, dirs);
+	BX_FREE(allocator, origins);
+	BX_FREE(allocator, heights);
+}
+
+struct SampleJob
+{
+	const Heightfield* m_field;
+	const float* m_xz;
+	float* m_heights;
+	uint32_t m_num;
+};
+
+static void sampleJob(void* _userData)
+{
+	const SampleJob* job = (const SampleJob*)_userData;
+	sampleHeights(*job->m_field, job->m_xz, job->m_heights, job->m_num);
+}
+
+static float heightRef(const uint16_t* _heights, uint32_t _width, uint32_t _height, int32_t _x, int32_t _z)
+{
+	const uint32_t xx = uint32_t(bx::clamp(_x, 0, int32_t(_width)  - 1) );
+	const uint32_t zz = uint32_t(bx::clamp(_z, 0, int32_t(_height) - 1) );
+	return float(_heights[size_t(zz) * _width + xx]);
+}
+
+// Scalar bilinear height and central difference normal, as sampleHeights and sampleNormals
+// compute them.
+static void sampleRef(const uint16_t* _heights, uint32_t _width, uint32_t _height, float _texelSize, float _heightScale, float _x, float _z, float& _outHeight, float* _outNormal)
+{
+	const float tx = bx::clamp(_x / _texelSize - 0.5f, 0.0f, float(_width  - 1) );
+	const float tz = bx::clamp(_z / _texelSize - 0.5f, 0.0f, float(_height - 1) );
+	const int32_t x0 = int32_t(tx);
+	const int32_t z0 = int32_t(tz);
+	const float fx = tx - float(x0);
+	const float fz = tz - float(z0);
+
+	float height[2][2];
+	float dx[2][2];
+	float dz[2][2];
+	for (int32_t jj = 0; jj < 2; ++jj)
+	{
+		for (int32_t ii = 0; ii < 2; ++ii)
+		{
+			const int32_t xx = bx::min(x0 + ii, int32_t(_width)  - 1);
+			const int32_t zz = bx::min(z0 + jj, int32_t(_height) - 1);
+			height[jj][ii] = heightRef(_heights, _width, _height, xx, zz);
+			dx[jj][ii] = heightRef(_heights, _width, _height, xx + 1, zz) - heightRef(_heights, _width, _height, xx - 1, zz);
+			dz[jj][ii] = heightRef(_heights, _width, _height, xx, zz + 1) - heightRef(_heights, _width, _height, xx, zz - 1);
+		}
+	}
+
+	_outHeight = bx::lerp(bx::lerp(height[0][0], height[0][1], fx), bx::lerp(height[1][0], height[1][1], fx), fz) * _heightScale;
+
+	const float gradScale = _heightScale / (2.0f * _texelSize);
+	const float gx = bx::lerp(bx::lerp(dx[0][0], dx[0][1], fx), bx::lerp(dx[1][0], dx[1][1], fx), fz) * gradScale;
+	const float gz = bx::lerp(bx::lerp(dz[0][0], dz[0][1], fx), bx::lerp(dz[1][0], dz[1][1], fx), fz) * gradScale;
+	const float invLen = 1.0f / bx::sqrt(gx * gx + gz * gz + 1.0f);
+	_outNormal[0] = -gx * invLen;
+	_outNormal[1] = invLen;
+	_outNormal[2] = -gz * invLen;
+}
+
+// Texel index of the last rows of a map past 2^24 texels isn't exact in float.
+static void checkWideSampling()
+{
+	const uint32_t width  = 8192;
+	const uint32_t height = 2304;
+	const uint32_t numSamples = 4096;
+	const float texelSize = 0.5f;
+	const float heightScale = 100.0f / 65535.0f;
+
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::General);
+	uint16_t* heights = (uint16_t*)BX_ALLOC(allocator, width * height * sizeof(uint16_t) );
+	for (uint32_t zz = 0; zz < height; ++zz)
+	{
+		for (uint32_t xx = 0; xx < width; ++xx)
+		{
+			heights[zz * width + xx] = uint16_t(hashNoise(int32_t(xx), int32_t(zz), 5) * 65535.0f);
+		}
+	}
+
+	Heightfield field;
+	heightfieldCreate(field, width, height, texelSize, heightScale);
+	const TileRect full = { 0, 0, int32_t(width), int32_t(height) };
+	heightfieldUpdate(field, heights, full);
+
+	// rows past texel 2^24 / width
+	float* xz = (float*)BX_ALLOC(allocator, numSamples * 2 * sizeof(float) );
+	float* results = (float*)BX_ALLOC(allocator, numSamples * 4 * sizeof(float) );
+	for (uint32_t ii = 0; ii < numSamples; ++ii)
+	{
+		xz[ii * 2 + 0] = hashNoise(int32_t(ii), 0, 13) * width * texelSize;
+		xz[ii * 2 + 1] = (2048.0f + hashNoise(int32_t(ii), 1, 13) * 256.0f) * texelSize;
+	}
+
+	sampleHeights(field, xz, results, numSamples, HeightFilter::Bilinear);
+	sampleNormals(field, xz, &results[numSamples], numSamples);
+
+	float maxHeightError = 0.0f;
+	float maxNormalError = 0.0f;
+	for (uint32_t ii = 0; ii < numSamples; ++ii)
+	{
+		float refHeight;
+		float refNormal[3];
+		sampleRef(heights, width, height, texelSize, heightScale, xz[ii * 2 + 0], xz[ii * 2 + 1], refHeight, refNormal);
+		maxHeightError = bx::max(maxHeightError, bx::abs(results[ii] - refHeight) );
+		for (uint32_t jj = 0; jj < 3; ++jj)
+		{
+			maxNormalError = bx::max(maxNormalError, bx::abs(results[numSamples + ii * 3 + jj] - refNormal[jj]) );
+		}
+	}
+
+	const bool match = maxHeightError < 1e-3f
+		&& maxNormalError < 1e-3f
+		;
+	s_failed |= !match;
+	printf("%dx%d map, heights and normals %s scalar reference, max error %g %g\n"
+		, width
+		, height
+		, match ? "match" : "DON'T MATCH"
+		, maxHeightError
+		, maxNormalError
+		);
+
+	heightfieldDestroy(field);
+	BX_FREE(allocator, results);
+	BX_FREE(allocator, xz);
+	BX_FREE(allocator, heights);
+}
+
+static void benchSampleHeights()
+{
+	const uint32_t size = s_referenceMapSize;
+	const uint32_t numSamples = 1 << 20;
+	const uint32_t numJobs = 64;
+	const float texelSize = 0.5f;
+	const float worldSize = size * texelSize;
+
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::General);
+	uint16_t* heights = (uint16_t*)BX_ALLOC(allocator, size * size * sizeof(uint16_t) );
+	generateReferenceHeightMap(heights, size, 1);
+
+	Heightfield field;
+	heightfieldCreate(field, size, size, texelSize, 100.0f / 65535.0f);
+	const TileRect full = { 0, 0, int32_t(size), int32_t(size) };
+	heightfieldUpdate(field, heights, full);
+
+	// agents spread over the whole map, no locality to help caches
+	float* xz = (float*)BX_ALLOC(allocator, numSamples * 2 * sizeof(float) );
+	float* results = (float*)BX_ALLOC(allocator, numSamples * 3 * sizeof(float) );
+	for (uint32_t ii = 0; ii < numSamples; ++ii)
+	{
+		xz[ii * 2 + 0] = hashNoise(ii, 0, 11) * worldSize;
+		xz[ii * 2 + 1] = hashNoise(ii, 1, 11) * worldSize;
+	}
+
+	printf("height sampling, %dx%d reference map, %d random positions\n", size, size, numSamples);
+	printf("%10s %12s\n", "query", "Msamples/s");
+
+	static const char* s_names[] = { "bilinear", "bicubic", "normals" };
+	for (uint32_t query = 0; query < BX_COUNTOF(s_names); ++query)
+	{
+		double time = 1e9;
+		for (uint32_t run = 0; run < 4; ++run)
+		{
+			const int64_t start = bx::getHPCounter();
+			if (2 == query)
+			{
+				sampleNormals(field, xz, results, numSamples);
+			}
+			else
+			{
+				sampleHeights(field, xz, results, numSamples, 0 == query ? HeightFilter::Bilinear : HeightFilter::Bicubic);
+			}
+			time = bx::min(time, toSeconds(bx::getHPCounter() - start) );
+		}
+
+		printf("%10s %12.1f\n", s_names[query], numSamples / time * 1e-6);
+	}
+
+	SampleJob jobs[numJobs];
+	const uint32_t samplesPerJob = numSamples / numJobs;
+	assetLoaderCreate(4);
+	const int64_t start = bx::getHPCounter();
+	for (uint32_t ii = 0; ii < numJobs; ++ii)
+	{
+		jobs[ii].m_field   = &field;
+		jobs[ii].m_xz      = &xz[ii * samplesPerJob * 2];
+		jobs[ii].m_heights = &results[ii * samplesPerJob];
+		jobs[ii].m_num     = samplesPerJob;
+		assetSubmitJob(sampleJob, NULL, &jobs[ii]);
+	}
+	while (0 != assetLoaderGetStats().m_numPending)
+	{
+		assetLoaderUpdate();
+	}
+	const double threadedTime = toSeconds(bx::getHPCounter() - start);
+	assetLoaderDestroy();
+
+	printf("%10s %12.1f\n", "4 loaders", numSamples / threadedTime * 1e-6);
+
+	checkWideSampling();
+
+	heightfieldDestroy(field);
+	BX_FREE(allocator, results);
+	BX_FREE(allocator, xz);
+	BX_FREE(allocator, heights);
+}
+
+typedef void (*DownsampleFn)(uint16_t*, uint32_t, const uint16_t*, uint32_t, uint32_t, const TileRect&);
+
+static void buildHeightMips(HeightMips& _mips, const uint16_t* _heights, const TileRect& _rect, DownsampleFn _downsample)
+{
+	const uint16_t* src = _heights;
+	for (uint32_t level = 1; level < _mips.m_numLevels; ++level)
+	{
+		uint16_t* dst = &_mips.m_data[_mips.m_levelOffset[level] ];
+		_downsample(dst, _mips.m_levelWidth[level], src, _mips.m_levelWidth[level - 1], _mips.m_levelHeight[level - 1], heightMipsGetRect(_mips, _rect, level) );
+		src = dst;
+	}
+}
+
+static void benchHeightMips()
+{
+	const uint32_t size = s_referenceMapSize;
+	const uint32_t brushSize = 48;
+	const uint32_t numBrushes = 1024;
+
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::General);
+	uint16_t* heights = (uint16_t*)BX_ALLOC(allocator, size * size * sizeof(uint16_t) );
+	generateReferenceHeightMap(heights, size, 1);
+
+	HeightMips mips;
+	HeightMips reference;
+	heightMipsCreate(mips, size, size);
+	heightMipsCreate(reference, size, size);
+	const uint32_t mipTexels = mips.m_levelOffset[mips.m_numLevels - 1] + 1;
+	const TileRect full = { 0, 0, int32_t(size), int32_t(size) };
+
+	printf("height mips, %dx%d reference map, %d levels\n", size, size, mips.m_numLevels);
+	printf("%12s %12s %12s\n", "downsample", "full ms", "Mtexels/s");
+
+	static const char* s_names[] = { "scalar", "simd" };
+	static const DownsampleFn s_downsample[] = { heightMipDownsampleRef, heightMipDownsample };
+	HeightMips* s_mips[] = { &reference, &mips };
+	for (uint32_t ii = 0; ii < BX_COUNTOF(s_names); ++ii)
+	{
+		double time = 1e9;
+		for (uint32_t run = 0; run < 8; ++run)
+		{
+			const int64_t start = bx::getHPCounter();
+			buildHeightMips(*s_mips[ii], heights, full, s_downsample[ii]);
+			time = bx::min(time, toSeconds(bx::getHPCounter() - start) );
+		}
+
+		printf("%12s %12.3f %12.1f\n", s_names[ii], time * 1e3, mipTexels / time * 1e-6);
+	}
+
+	// brush sized edits all over the map, mips rebuilt only above the touched texels
+	TileRect* rects = (TileRect*)BX_ALLOC(allocator, numBrushes * sizeof(TileRect) );
+	for (uint32_t ii = 0; ii < numBrushes; ++ii)
+	{
+		const int32_t x = int32_t(hashNoise(ii, 0, 23) * (size - brushSize) );
+		const int32_t y = int32_t(hashNoise(ii, 1, 23) * (size - brushSize) );
+		rects[ii] = { x, y, x + int32_t(brushSize), y + int32_t(brushSize) };
+	}
+
+	for (uint32_t ii = 0; ii < numBrushes; ++ii)
+	{
+		heights[rects[ii].m_x0 + rects[ii].m_y0 * size] += 4099;
+		heightMipsUpdate(mips, heights, rects[ii]);
+	}
+
+	int64_t start = bx::getHPCounter();
+	for (uint32_t ii = 0; ii < numBrushes; ++ii)
+	{
+		heightMipsUpdate(mips, heights, rects[ii]);
+	}
+	const double incrementalTime = toSeconds(bx::getHPCounter() - start);
+
+	buildHeightMips(reference, heights, full, heightMipDownsampleRef);
+	const bool match = 0 == bx::memCmp(mips.m_data, reference.m_data, mipTexels * sizeof(uint16_t) );
+	s_failed |= !match;
+
+	printf("%dx%d edit: %.2f us, %s scalar reference\n"
+		, brushSize
+		, brushSize
+		, incrementalTime * 1e6 / numBrushes
+		, match ? "matches" : "DOESN'T MATCH"
+		);
+
+	BX_FREE(allocator, rects);
+	heightMipsDestroy(reference);
+	heightMipsDestroy(mips);
+	BX_FREE(allocator, heights);
+}
+
+static bool isBoxVisible(OcclusionBuffer& _buffer, const Heightfield& _field, float _x, float _z, float _size)
+{
+	float minHeight;
+	float maxHeight;
+	heightfieldGetRectRange(_field, _x, _z, _x + _size, _z + _size, minHeight, maxHeight);
+	return OcclusionResult::Visible == occlusionTest(_buffer, { _x, minHeight, _z }, { _x + _size, maxHeight, _z + _size });
+}
+
+static void benchOcclusion()
+{
+	const uint32_t size = s_referenceMapSize;
+	const uint32_t numCameras = 16;
+	const uint32_t numHelpers = 3;
+	const float texelSize = 0.5f;
+	const float worldSize = size * texelSize;
+	const float patchSize = 8.0f;
+	const uint32_t patchesPerNode = 8;
+	const float nodeSize = patchSize * patchesPerNode;
+	const uint32_t nodesPerSide = uint32_t(worldSize / nodeSize);
+
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::General);
+	uint16_t* heights = (uint16_t*)BX_ALLOC(allocator, size * size * sizeof(uint16_t) );
+	generateReferenceHeightMap(heights, size, 1);
+
+	Heightfield field;
+	heightfieldCreate(field, size, size, texelSize, 100.0f / 65535.0f);
+	const TileRect full = { 0, 0, int32_t(size), int32_t(size) };
+	heightfieldUpdate(field, heights, full);
+
+	float proj[16];
+	bx::mtxProj(proj, 60.0f, 16.0f / 9.0f, 0.1f, 2000.0f, false);
+
+	printf("occlusion, %dx%d reference map, %d cameras, %d patches of %.0fm in nodes of %.0fm\n"
+		, size
+		, size
+		, numCameras
+		, nodesPerSide * nodesPerSide * patchesPerNode * patchesPerNode
+		, patchSize
+		, nodeSize
+		);
+	printf("%10s %10s %10s %10s %12s %10s %10s\n", "threads", "triangles", "setup ms", "raster ms", "Mtri/s", "culled", "test us");
+
+	// calling thread alone, then with helpers on loader threads
+	for (uint32_t pass = 0; pass < 2; ++pass)
+	{
+		OcclusionBuffer buffer;
+		occlusionCreate(buffer, 32, 0 == pass ? 0 : numHelpers);
+		if (0 != pass)
+		{
+			assetLoaderCreate(4);
+		}
+
+		double setupTime = 0.0;
+		double rasterTime = 0.0;
+		double testTime = 0.0;
+		uint32_t numTriangles = 0;
+		uint32_t numPatches = 0;
+		uint32_t numCulled = 0;
+		uint32_t numTested = 0;
+		for (uint32_t ii = 0; ii < numCameras; ++ii)
+		{
+			// walking height looking along the ground, where hills hide most of the map
+			const float xz[2] = { (0.1f + 0.8f * hashNoise(ii, 0, 13) ) * worldSize, (0.1f + 0.8f * hashNoise(ii, 1, 13) ) * worldSize };
+			float ground;
+			sampleHeights(field, xz, &ground, 1);
+
+			const float yaw = hashNoise(ii, 2, 13) * bx::kPi2;
+			const bx::Vec3 eye = { xz[0], ground + 2.0f + 8.0f * hashNoise(ii, 3, 13), xz[1] };
+			const bx::Vec3 at = bx::add(eye, { bx::cos(yaw), -0.1f, bx::sin(yaw) });
+
+			float view[16];
+			float viewProj[16];
+			bx::mtxLookAt(view, eye, at);
+			bx::mtxMul(viewProj, view, proj);
+
+			double setup = 1e9;
+			double raster = 1e9;
+			for (uint32_t run = 0; run < 4; ++run)
+			{
+				occlusionBegin(buffer, viewProj);
+				occlusionRasterizeHeightfield(buffer, field);
+				occlusionFlush(buffer);
+				setup  = bx::min(setup,  double(buffer.m_setupMs) );
+				raster = bx::min(raster, double(buffer.m_rasterMs) );
+			}
+			setupTime += setup;
+			rasterTime += raster;
+			numTriangles += buffer.m_numTriangles;
+
+			const int64_t start = bx::getHPCounter();
+			for (uint32_t nodeY = 0; nodeY < nodesPerSide; ++nodeY)
+			{
+				for (uint32_t nodeX = 0; nodeX < nodesPerSide; ++nodeX)
+				{
+					numPatches += patchesPerNode * patchesPerNode;
+					if (!isBoxVisible(buffer, field, nodeX * nodeSize, nodeY * nodeSize, nodeSize) )
+					{
+						numCulled += patchesPerNode * patchesPerNode;
+						continue;
+					}
+
+					for (uint32_t yy = 0; yy < patchesPerNode; ++yy)
+					{
+						for (uint32_t xx = 0; xx < patchesPerNode; ++xx)
+						{
+							numCulled += isBoxVisible(buffer, field, nodeX * nodeSize + xx * patchSize, nodeY * nodeSize + yy * patchSize, patchSize) ? 0 : 1;
+						}
+					}
+				}
+			}
+			testTime += toSeconds(bx::getHPCounter() - start);
+			numTested += buffer.m_numTested;
+		}
+
+		if (0 != pass)
+		{
+			assetLoaderDestroy();
+		}
+		occlusionDestroy(buffer);
+
+		printf("%10d %10d %10.3f %10.3f %12.1f %9.1f%% %10.3f\n"
+			, 0 == pass ? 1 : 1 + numHelpers
+			, numTriangles / numCameras
+			, setupTime / numCameras
+			, rasterTime / numCameras
+			, numTriangles / (setupTime + rasterTime) * 1e-3
+			, 100.0 * numCulled / numPatches
+			, testTime * 1e6 / numTested
+			);
+	}
+
+	heightfieldDestroy(field);
+	BX_FREE(allocator, heights);
+}
+
+static void benchQuadTree()
+{
+	const uint32_t numFrames = 2000;
+	const float sectorSize = 64.0f;
+	const float range = 0.75f;
+	const float worldSize = sectorSize * (1 << (QuadTree::kNumLods - 1) );
+
+	struct Config
+	{
+		const char* name;
+		float hysteresis;
+		uint32_t maxChanges;
+	};
+
+	const Config configs[] =
+	{
+		{ "none",       0.0f,  UINT32_MAX },
+		{ "hysteresis", 0.15f, UINT32_MAX },
+		{ "budget",     0.15f, 8          },
+	};
+
+	FrameArena arena;
+	frameArenaCreate(arena, (sizeof(QuadTreeNode) + sizeof(uint16_t) ) * QuadTree::kMaxNodes + 32, getAllocator(MemoryCategory::LodFrame) );
+
+	printf("quadtree, %.0fm world, %d frames of a camera hovering along a walk then flying circles, range %.2f node sizes\n"
+		, worldSize
+		, numFrames
+		, range
+		);
+	printf("%12s %10s %10s %10s %10s %10s %10s\n", "", "nodes", "changes", "max", "frames", "held back", "build us");
+
+	for (uint32_t config = 0; config < BX_COUNTOF(configs); ++config)
+	{
+		QuadTree tree;
+		quadTreeCreate(tree, QuadTree::kNumLods - 1, sectorSize, range, configs[config].hysteresis, configs[config].maxChanges);
+
+		uint64_t numNodes = 0;
+		uint32_t numChanges = 0;
+		uint32_t maxChanges = 0;
+		uint32_t numFramesChanged = 0;
+		uint32_t numDeferred = 0;
+		double buildTime = 0.0;
+		for (uint32_t frame = 0; frame < numFrames; ++frame)
+		{
+			// slow walk with a couple of metres of jitter on top crosses many split distances,
+			// fast circles over the second half change many nodes at once
+			const float t = float(frame);
+			bx::Vec3 position =
+			{
+				worldSize * 0.2f + t * 0.25f + 2.0f * bx::sin(t * 0.9f),
+				0.0f,
+				worldSize * 0.3f + t * 0.15f + 2.0f * bx::cos(t * 1.3f),
+			};
+			if (frame >= numFrames / 2)
+			{
+				const float angle = (t - numFrames * 0.5f) * 0.05f;
+				position.x = worldSize * (0.5f + 0.3f * bx::cos(angle) );
+				position.z = worldSize * (0.5f + 0.3f * bx::sin(angle) );
+			}
+
+			frameArenaReset(arena);
+			const int64_t start = bx::getHPCounter();
+			quadTreeBuild(tree, arena, position);
+			buildTime += toSeconds(bx::getHPCounter() - start);
+
+			// first build refines from scratch, it isn't a change of LOD
+			if (0 != frame)
+			{
+				const uint32_t changes = tree.m_numSplits + tree.m_numMerges;
+				numChanges += changes;
+				maxChanges = bx::max(maxChanges, changes);
+				numFramesChanged += 0 != changes ? 1 : 0;
+				numDeferred += tree.m_numDeferred;
+			}
+			numNodes += tree.m_numNodes;
+		}
+
+		printf("%12s %10.1f %10.3f %10d %9.1f%% %10.3f %10.3f\n"
+			, configs[config].name
+			, double(numNodes) / numFrames
+			, double(numChanges) / (numFrames - 1)
+			, maxChanges
+			, 100.0 * numFramesChanged / (numFrames - 1)
+			, double(numDeferred) / (numFrames - 1)
+			, buildTime * 1e6 / numFrames
+			);
+	}
+
+	frameArenaDestroy(arena, getAllocator(MemoryCategory::LodFrame) );
+}
+
+// stands in for patch instance data of terrain.cpp
+struct BenchPatch
+{
+	float m_x;
+	float m_z;
+	float m_size;
+	float m_lodTransition;
+	float m_u;
+	float m_v;
+	float m_virtualPage;
+	float m_morphEnd;
+};
+
+static void generatePatches(const QuadTree& _tree, const QuadTreeNode* const* _nodes, uint32_t _numNodes, uint32_t _patchesPerSide, float _sectorSize, BenchPatch* _outPatches)
+{
+	for (uint32_t nodeIndex = 0; nodeIndex < _numNodes; ++nodeIndex)
+	{
+		const QuadTreeNode& node = *_nodes[nodeIndex];
+		const float patchSize = _sectorSize * float(1 << node.lod) / float(_patchesPerSide);
+		const float morphEnd = quadTreeGetMorphEnd(_tree, node.lod);
+		for (uint32_t jj = 0; jj < _patchesPerSide; ++jj)
+		{
+			for (uint32_t ii = 0; ii < _patchesPerSide; ++ii)
+			{
+				BenchPatch& patch = *_outPatches++;
+				patch.m_x = node.x + float(ii) * patchSize;
+				patch.m_z = node.z + float(jj) * patchSize;
+				patch.m_size = patchSize;
+				patch.m_lodTransition = 0.0f;
+				patch.m_u = float(ii) / float(_patchesPerSide);
+				patch.m_v = float(jj) / float(_patchesPerSide);
+				patch.m_virtualPage = 0.0f;
+				patch.m_morphEnd = morphEnd;
+			}
+		}
+	}
+}
+
+static uint32_t collectLeaves(const QuadTree& _tree, const QuadTreeNode** _outNodes)
+{
+	uint32_t num = 0;
+	for (uint32_t ii = 0; ii < _tree.m_numNodes; ++ii)
+	{
+		if (_tree.m_nodes[ii].firstChildIndex < 0)
+		{
+			_outNodes[num++] = &_tree.m_nodes[ii];
+		}
+	}
+
+	return num;
+}
+
+static void benchViews()
+{
+	const uint32_t numFrames = 1000;
+	const float sectorSize = 64.0f;
+	const float range = 0.75f;
+	const float worldSize = sectorSize * (1 << (QuadTree::kNumLods - 1) );
+	const uint32_t patchesPerSide = 8;
+	const uint32_t maxViews = TerrainView::kMaxViews;
+
+	struct Config
+	{
+		const char* name;
+		float spacing; // angle between neighbour players on the circle
+	};
+
+	const Config configs[] =
+	{
+		{ "together", 0.05f       },
+		{ "apart",    bx::kPiHalf },
+	};
+
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::LodFrame);
+	const QuadTreeNode** leaves = (const QuadTreeNode**)BX_ALLOC(allocator, sizeof(QuadTreeNode*) * QuadTree::kMaxNodes);
+	uint32_t* patches = (uint32_t*)BX_ALLOC(allocator, sizeof(uint32_t) * QuadTree::kMaxNodes * patchesPerSide * patchesPerSide);
+	BenchPatch* instances = (BenchPatch*)BX_ALLOC(allocator, sizeof(BenchPatch) * QuadTree::kMaxNodes * patchesPerSide * patchesPerSide);
+
+	// shared tree and one per view are built every frame
+	FrameArena arena;
+	frameArenaCreate(arena, ( (sizeof(QuadTreeNode) + sizeof(uint16_t) ) * QuadTree::kMaxNodes + 32) * (maxViews + 1), allocator);
+
+	printf("views, %.0fm world, %d frames of players flying a circle, one quadtree and patches for all views against a tree and patches per view\n"
+		, worldSize
+		, numFrames
+		);
+	printf("%10s %6s %10s %10s %10s %10s %10s %10s %10s %10s\n", "", "views", "nodes", "drawn", "lod us", "cull us", "total us", "own nodes", "own us", "+view");
+
+	for (uint32_t config = 0; config < BX_COUNTOF(configs); ++config)
+	{
+		double sharedBase = 0.0;
+		for (uint32_t numViews = 1; numViews <= maxViews; ++numViews)
+		{
+			QuadTree sharedTree;
+			quadTreeCreate(sharedTree, QuadTree::kNumLods - 1, sectorSize, range, 0.15f, UINT32_MAX);
+
+			QuadTree ownTrees[maxViews];
+			for (uint32_t ii = 0; ii < numViews; ++ii)
+			{
+				quadTreeCreate(ownTrees[ii], QuadTree::kNumLods - 1, sectorSize, range, 0.15f, UINT32_MAX);
+			}
+
+			uint64_t numNodes = 0;
+			uint64_t numOwnNodes = 0;
+			uint64_t numDrawn = 0;
+			double lodTime = 0.0;
+			double cullTime = 0.0;
+			double ownTime = 0.0;
+			for (uint32_t frame = 0; frame < numFrames; ++frame)
+			{
+				// every player looks where it goes
+				TerrainView views[maxViews];
+				bx::Vec3 positions[maxViews];
+				for (uint32_t ii = 0; ii < numViews; ++ii)
+				{
+					const float angle = float(frame) * 0.002f + float(ii) * configs[config].spacing;
+					const float radius = worldSize * 0.3f;
+					const bx::Vec3 eye = { worldSize * 0.5f + radius * bx::cos(angle), 50.0f, worldSize * 0.5f + radius * bx::sin(angle) };
+					const bx::Vec3 at  = { eye.x - bx::sin(angle), 49.8f, eye.z + bx::cos(angle) };
+
+					float view[16];
+					float proj[16];
+					bx::mtxLookAt(view, eye, at);
+					bx::mtxProj(proj, 60.0f, 1.0f, 0.1f, 2000.0f, false);
+
+					const float rect[] = { 0.0f, 0.0f, 1.0f, 1.0f };
+					viewSetup(views[ii], rect, view, proj, eye, false);
+					views[ii].m_selectsLod = true;
+					views[ii].m_patches = patches;
+					positions[ii] = eye;
+				}
+
+				frameArenaReset(arena);
+				int64_t start = bx::getHPCounter();
+				quadTreeBuild(sharedTree, arena, positions, numViews);
+				const uint32_t numLeaves = collectLeaves(sharedTree, leaves);
+				generatePatches(sharedTree, leaves, numLeaves, patchesPerSide, sectorSize, instances);
+				lodTime += toSeconds(bx::getHPCounter() - start);
+				numNodes += numLeaves;
+
+				start = bx::getHPCounter();
+				for (uint32_t ii = 0; ii < numViews; ++ii)
+				{
+					numDrawn += viewCullPatches(views[ii], leaves, numLeaves, sectorSize, patchesPerSide, 0.0f, 200.0f);
+				}
+				cullTime += toSeconds(bx::getHPCounter() - start);
+
+				start = bx::getHPCounter();
+				for (uint32_t ii = 0; ii < numViews; ++ii)
+				{
+					quadTreeBuild(ownTrees[ii], arena, positions[ii]);
+					const uint32_t numOwnLeaves = collectLeaves(ownTrees[ii], leaves);
+					generatePatches(ownTrees[ii], leaves, numOwnLeaves, patchesPerSide, sectorSize, instances);
+					viewCullPatches(views[ii], leaves, numOwnLeaves, sectorSize, patchesPerSide, 0.0f, 200.0f);
+					numOwnNodes += numOwnLeaves;
+				}
+				ownTime += toSeconds(bx::getHPCounter() - start);
+			}
+
+			// cost of every view past the first, in views of one
+			const double sharedUs = (lodTime + cullTime) * 1e6 / numFrames;
+			if (1 == numViews)
+			{
+				sharedBase = sharedUs;
+			}
+
+			printf("%10s %6d %10.1f %10.1f %10.3f %10.3f %10.3f %10.1f %10.3f %10.2f\n"
+				, 1 == numViews ? configs[config].name : ""
+				, numViews
+				, double(numNodes) / numFrames
+				, double(numDrawn) / numFrames
+				, lodTime * 1e6 / numFrames
+				, cullTime * 1e6 / numFrames
+				, sharedUs
+				, double(numOwnNodes) / numFrames
+				, ownTime * 1e6 / numFrames
+				, 1 == numViews ? 1.0 : (sharedUs - sharedBase) / (numViews - 1) / sharedBase
+				);
+		}
+	}
+
+	frameArenaDestroy(arena, allocator);
+	BX_FREE(allocator, instances);
+	BX_FREE(allocator, patches);
+	BX_FREE(allocator, leaves);
+}
+
+// stands in for reading a tile from disk
+static bool loadDelayedTile(const TileKey& _key, void* _dst, uint32_t _size, void* _userData)
+{
+	bx::sleep(*(const uint32_t*)_userData);
+	memset(_dst, _key.m_lod, _size);
+	return true;
+}
+
+static void benchPrefetch()
+{
+	const uint32_t numFrames = 360;
+	const float frameTime = 1.0f / 60.0f;
+	const float speed = 60.0f;
+	const float tileSize = 16.0f;
+	const uint32_t numTiles = 1024;
+	const uint8_t numLods = 5;
+	const float range = 1.5f;
+	uint32_t latencyMs = 30;
+
+	struct Config
+	{
+		const char* name;
+		float lookahead;
+		uint32_t numSteps;
+		uint32_t maxInFlight;
+	};
+
+	const Config configs[] =
+	{
+		{ "demand",        0.0f,  0, 8 },
+		{ "0.5s ahead",    0.5f,  4, 8 },
+		{ "1s ahead",      1.0f,  4, 8 },
+		{ "1s, 4 loads",   1.0f,  4, 4 },
+	};
+
+	printf("prefetch, %d frames of a %.0f m/s weaving flight, %.0fm tiles, %d LODs, %d ms per tile load\n"
+		, numFrames
+		, speed
+		, tileSize
+		, numLods
+		, latencyMs
+		);
+	printf("%12s %10s %10s %10s %10s %10s %10s %10s\n", "", "fallback", "tiles", "hit rate", "loads", "prefetched", "used", "in flight");
+
+	for (uint32_t config = 0; config < BX_COUNTOF(configs); ++config)
+	{
+		assetLoaderCreate(8);
+
+		TileStreamer streamer;
+		tileStreamerCreate(streamer, 2048, 32 * 32 * 4, configs[config].maxInFlight, loadDelayedTile, &latencyMs);
+
+		TilePrefetcher prefetcher;
+		tilePrefetcherCreate(prefetcher, tileSize, numTiles, numLods, range, configs[config].lookahead, configs[config].numSteps);
+
+		bx::Vec3 position = { tileSize * numTiles * 0.5f, 0.0f, tileSize * numTiles * 0.5f };
+		uint32_t numFallbackFrames = 0;
+		uint32_t numFallbackTiles = 0;
+		TileStreamerStats start;
+		bool warm = false;
+		uint32_t frame = 0;
+		int64_t frameStart = bx::getHPCounter();
+		while (frame < numFrames)
+		{
+			// camera flies forward and weaves left and right like a player would, it waits
+			// at the start until its tiles are in so only the flight counts
+			const float t = float(frame) * frameTime;
+			const float yaw = 1.2f * bx::sin(t * 0.5f) + 0.6f * bx::sin(t * 1.7f);
+			const bx::Vec3 dir = { bx::sin(yaw), 0.0f, bx::cos(yaw) };
+			const bx::Vec3 at = bx::add(position, dir);
+
+			assetLoaderUpdate();
+			tileStreamerBeginFrame(streamer);
+			tilePrefetcherAddSample(prefetcher, position, at, t);
+
+			uint32_t numFallbacks = 0;
+			for (uint32_t layer = 0; layer < TileLayer::Count; ++layer)
+			{
+				TileKey keys[256];
+				const uint32_t numKeys = tilePrefetcherGetNeeded(prefetcher, position, TileLayer::Enum(layer), keys, BX_COUNTOF(keys) );
+				for (uint32_t ii = 0; ii < numKeys; ++ii)
+				{
+					uint8_t lod;
+					tileStreamerAcquire(streamer, keys[ii], numLods - 1, &lod);
+					numFallbacks += keys[ii].m_lod != lod ? 1 : 0;
+				}
+			}
+
+			tilePrefetcherUpdate(prefetcher, streamer);
+			tileStreamerUpdate(streamer);
+
+			if (!warm)
+			{
+				warm = 0 == numFallbacks;
+				start = streamer.m_stats;
+				prefetcher.m_numSamples = 0;
+			}
+			else
+			{
+				numFallbackFrames += 0 != numFallbacks ? 1 : 0;
+				numFallbackTiles += numFallbacks;
+				position = bx::add(position, bx::mul(dir, speed * frameTime) );
+				++frame;
+			}
+
+			const int64_t frameTicks = int64_t(frameTime * bx::getHPFrequency() );
+			while (bx::getHPCounter() - frameStart < frameTicks)
+			{
+				bx::sleep(1);
+			}
+			frameStart += frameTicks;
+		}
+
+		assetLoaderDestroy();
+
+		const TileStreamerStats& stats = streamer.m_stats;
+		const uint32_t numHits = stats.m_numHits - start.m_numHits;
+		const uint32_t numMisses = stats.m_numMisses - start.m_numMisses;
+		const uint32_t numPrefetchLoads = stats.m_numPrefetchLoads - start.m_numPrefetchLoads;
+		printf("%12s %9.1f%% %10.2f %9.1f%% %10d %10d %9.1f%% %10d\n"
+			, configs[config].name
+			, 100.0 * numFallbackFrames / numFrames
+			, double(numFallbackTiles) / numFrames
+			, 100.0 * numHits / bx::max(numHits + numMisses, 1u)
+			, stats.m_numLoads - start.m_numLoads
+			, numPrefetchLoads
+			, 100.0 * (stats.m_numPrefetchUsed - start.m_numPrefetchUsed) / bx::max(numPrefetchLoads, 1u)
+			, stats.m_maxInFlight
+			);
+
+		tileStreamerDestroy(streamer);
+	}
+}
+
+static void documentLoadedCb(const uint16_t* _heights, void* _userData)
+{
+	const Heightfield& field = *(const Heightfield*)_userData;
+	const bool match = NULL != _heights
+		&& 0 == bx::memCmp(_heights, field.m_heights, field.m_width * field.m_height * sizeof(uint16_t) )
+		;
+	s_failed |= !match;
+	printf("%12s %s\n", "", match ? "loaded map matches" : "loaded map DIFFERS");
+}
+
+static void printDocumentStats(const char* _name, const TerrainDocument& _doc)
+{
+	s_failed |= _doc.m_failed;
+	printf("%12s %10d %10.1f %10.3f %10.2f %10s\n"
+		, _name
+		, _doc.m_numTiles
+		, _doc.m_numBytes / 1024.0
+		, _doc.m_copyMs
+		, _doc.m_ioMs
+		, _doc.m_failed ? "failed" : "ok"
+		);
+}
+
+static void waitForDocument(const TerrainDocument& _doc)
+{
+	while (documentIsBusy(_doc) )
+	{
+		assetLoaderUpdate();
+	}
+}
+
+static void benchDocument()
+{
+	const uint32_t size = s_referenceMapSize;
+	const uint32_t tileSize = s_referenceTileSize;
+
+	// nothing is left behind in the working directory
+	char dir[512];
+	if (!fileMakeTempDir(dir, BX_COUNTOF(dir), "terrain-bench-") )
+	{
+		printf("document, can't create temp directory\n");
+		s_failed = true;
+		return;
+	}
+	char path[512];
+	bx::snprintf(path, BX_COUNTOF(path), "%s/bench.terrain", dir);
+
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::General);
+	uint16_t* heights = (uint16_t*)BX_ALLOC(allocator, size * size * sizeof(uint16_t) );
+	generateReferenceHeightMap(heights, size, 1);
+
+	Heightfield field;
+	heightfieldCreate(field, size, size, 1.0f, 1.0f);
+	const TileRect full = { 0, 0, int32_t(size), int32_t(size) };
+	heightfieldUpdate(field, heights, full);
+
+	TerrainDocument doc;
+	documentCreate(doc, path, size, size, tileSize);
+	assetLoaderCreate(1);
+
+	printf("document, %dx%d reference map in %dx%d tiles, saved to %s\n", size, size, tileSize, tileSize, path);
+	printf("%12s %10s %10s %10s %10s %10s\n", "", "tiles", "KB", "copy ms", "io ms", "");
+
+	documentSave(doc, field);
+	waitForDocument(doc);
+	printDocumentStats("first save", doc);
+
+	// a brush dab in the middle, what a save after a short sculpting session writes
+	const TileRect edit = { int32_t(size / 2 - 12), int32_t(size / 2 - 12), int32_t(size / 2 + 12), int32_t(size / 2 + 12) };
+	for (int32_t yy = edit.m_y0; yy < edit.m_y1; ++yy)
+	{
+		for (int32_t xx = edit.m_x0; xx < edit.m_x1; ++xx)
+		{
+			heights[xx + yy * size] = uint16_t(bx::min(heights[xx + yy * size] + 500, 65535) );
+		}
+	}
+	heightfieldUpdate(field, heights, edit);
+	documentInvalidate(doc, edit);
+
+	documentSave(doc, field);
+	waitForDocument(doc);
+	printDocumentStats("edit save", doc);
+
+	documentSave(doc, field);
+	waitForDocument(doc);
+	printDocumentStats("clean save", doc);
+
+	documentLoad(doc, documentLoadedCb, &field);
+	waitForDocument(doc);
+	printDocumentStats("load", doc);
+
+	// Restart and crash a save after it wrote its tiles, before the manifest was replaced. The
+	// tiles are garbage, the previous save must still load.
+	documentDestroy(doc);
+	documentCreate(doc, path, size, size, tileSize);
+	const uint32_t numTiles = doc.m_grid.m_numTilesX * doc.m_grid.m_numTilesY;
+	for (uint32_t tile = 0; tile < numTiles; ++tile)
+	{
+		char tilePath[512];
+		documentGetTilePath(doc, tile, doc.m_numSaves + 1, tilePath, BX_COUNTOF(tilePath) );
+		FILE* file = fopen(tilePath, "wb");
+		if (NULL != file)
+		{
+			fwrite(heights, tileSize, 1, file);
+			fclose(file);
+		}
+	}
+
+	documentLoad(doc, documentLoadedCb, &field);
+	waitForDocument(doc);
+	printDocumentStats("crash load", doc);
+
+	assetLoaderDestroy();
+	documentDestroy(doc);
+	heightfieldDestroy(field);
+	BX_FREE(allocator, heights);
+
+	fileRemoveDir(path);
+	fileRemoveDir(dir);
+}
+
+int32_t runBenchmarks(const bx::CommandLine& _cmdLine)
+{
+	const char* name = _cmdLine.findOption("bench", "");
+	const bool all = '\0' == name[0];
+
+	if (all || 0 == bx::strCmp(name, "heightcodec") )
+	{
+		benchHeightCodec();
+	}
+
+	if (all || 0 == bx::strCmp(name, "raycast") )
+	{
+		benchRaycast();
+	}
+
+	if (all || 0 == bx::strCmp(name, "sample") )
+	{
+		benchSampleHeights();
+	}
+
+	if (all || 0 == bx::strCmp(name, "mips") )
+	{
+		benchHeightMips();
+	}
+
+	if (all || 0 == bx::strCmp(name, "occlusion") )
+	{
+		benchOcclusion();
+	}
+
+	if (all || 0 == bx::strCmp(name, "lod") )
+	{
+		benchQuadTree();
+	}
+
+	if (all || 0 == bx::strCmp(name, "views") )
+	{
+		benchViews();
+	}
+
+	if (all || 0 == bx::strCmp(name, "prefetch") )
+	{
+		benchPrefetch();
+	}
+
+	if (all || 0 == bx::strCmp(name, "document") )
+	{
+		benchDocument();
+	}
+
+	return s_failed ? 1 : 0;
+}
@@ -0,0 +1,19 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef BENCHMARK_H_HEADER_GUARD
+#define BENCHMARK_H_HEADER_GUARD
+
+#include <bx/commandline.h>
+
+/// Fills _size x _size heights with deterministic fractal terrain, same for every _seed.
+/// Used as reference map so results are comparable between runs and machines.
+void generateReferenceHeightMap(uint16_t* _dst, uint32_t _size, uint32_t _seed);
+
+/// Runs headless benchmarks and prints results to stdout. `--bench` runs all of them,
+/// `--bench <name>` only one. Returns process exit code, 1 if any result doesn't match its
+/// reference.
+int32_t runBenchmarks(const bx::CommandLine& _cmdLine);
+
+#endif // BENCHMARK_H_HEADER_GUARD
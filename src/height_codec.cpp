@@ -0,0 +1,323 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <bx/simd_t.h>
+#include <bx/uint32_t.h>
+#include "height_codec.h"
+
+namespace
+{
+	static constexpr uint32_t kMaxWidth   = 512;
+	static constexpr uint32_t kMaxRiceK   = 17;
+	static constexpr uint32_t kEscape     = 24; //!< Quotient from which value is stored raw.
+	static constexpr uint32_t kRawBits    = 18; //!< Zigzag of gradient residual of 16-bit data.
+	static constexpr uint32_t kMaxBits    = kEscape + kRawBits;
+	static constexpr uint32_t kPadding    = 8;
+
+	struct BitWriter
+	{
+		void put(uint32_t _value, uint32_t _numBits)
+		{
+			m_bits |= uint64_t(_value) << m_numBits;
+			m_numBits += _numBits;
+			while (8 <= m_numBits)
+			{
+				if (m_ptr < m_end)
+				{
+					*m_ptr = uint8_t(m_bits);
+				}
+				++m_ptr;
+				m_bits >>= 8;
+				m_numBits -= 8;
+			}
+		}
+
+		void flush()
+		{
+			put(0, 7);
+		}
+
+		uint8_t* m_ptr;
+		uint8_t* m_end;
+		uint64_t m_bits;
+		uint32_t m_numBits;
+	};
+
+	struct BitReader
+	{
+		void refill()
+		{
+			while (56 >= m_numBits)
+			{
+				const uint64_t byte = m_ptr < m_end ? *m_ptr : 0;
+				m_bits |= byte << m_numBits;
+				m_numBits += 8;
+				++m_ptr;
+			}
+		}
+
+		uint32_t get(uint32_t _numBits)
+		{
+			const uint32_t value = uint32_t(m_bits & ( (UINT64_C(1) << _numBits) - 1) );
+			m_bits >>= _numBits;
+			m_numBits -= _numBits;
+			return value;
+		}
+
+		const uint8_t* m_ptr;
+		const uint8_t* m_end;
+		uint64_t m_bits;
+		uint32_t m_numBits;
+	};
+}
+
+static inline uint32_t zigzag(int32_t _value)
+{
+	return (uint32_t(_value) << 1) ^ uint32_t(_value >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t _value)
+{
+	return int32_t(_value >> 1) ^ -int32_t(_value & 1);
+}
+
+static uint32_t riceCost(const uint32_t* _values, uint32_t _num, uint32_t _k)
+{
+	uint32_t cost = 0;
+	for (uint32_t ii = 0; ii < _num; ++ii)
+	{
+		const uint32_t quotient = _values[ii] >> _k;
+		cost += quotient < kEscape ? quotient + 1 + _k : kMaxBits;
+	}
+	return cost;
+}
+
+uint32_t heightTileCompressBound(uint32_t _width, uint32_t _height)
+{
+	return sizeof(HeightTileHeader) + _height + (_width * _height * kMaxBits + 7) / 8 + kPadding;
+}
+
+uint32_t heightTileCompress(
+	  void* _dst
+	, uint32_t _dstSize
+	, const uint16_t* _src
+	, uint32_t _width
+	, uint32_t _height
+	, uint32_t _srcPitch
+	, uint16_t _maxError
+	)
+{
+	BX_CHECK(_width <= kMaxWidth, "Tile width %d is over limit of %d.", _width, kMaxWidth);
+	const uint32_t headerSize = sizeof(HeightTileHeader) + _height;
+	if (_width > kMaxWidth
+	||  _dstSize < headerSize)
+	{
+		return 0;
+	}
+
+	uint8_t* dst = (uint8_t*)_dst;
+	uint8_t* riceK = &dst[sizeof(HeightTileHeader)];
+
+	BitWriter writer;
+	writer.m_ptr = &dst[headerSize];
+	writer.m_end = &dst[_dstSize];
+	writer.m_bits = 0;
+	writer.m_numBits = 0;
+
+	// quantizing with step 2e+1 keeps every height within e of the original
+	const uint32_t step = 2 * uint32_t(_maxError) + 1;
+
+	uint32_t prevRow[kMaxWidth] = {};
+	uint32_t row[kMaxWidth];
+	uint32_t residuals[kMaxWidth];
+
+	for (uint32_t yy = 0; yy < _height; ++yy)
+	{
+		const uint16_t* src = &_src[yy * _srcPitch];
+		for (uint32_t xx = 0; xx < _width; ++xx)
+		{
+			row[xx] = (uint32_t(src[xx]) + _maxError) / step;
+		}
+
+		// gradient predictor, decoder undoes it as prefix sum along the row and add of row above
+		for (uint32_t xx = 0; xx < _width; ++xx)
+		{
+			const int32_t left    = 0 < xx ? int32_t(row[xx - 1])     : 0;
+			const int32_t topLeft = 0 < xx ? int32_t(prevRow[xx - 1]) : 0;
+			const int32_t residual = int32_t(row[xx]) - left - int32_t(prevRow[xx]) + topLeft;
+			residuals[xx] = zigzag(residual);
+		}
+
+		uint32_t bestK = 0;
+		uint32_t bestCost = UINT32_MAX;
+		for (uint32_t kk = 0; kk <= kMaxRiceK; ++kk)
+		{
+			const uint32_t cost = riceCost(residuals, _width, kk);
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestK = kk;
+			}
+		}
+		riceK[yy] = uint8_t(bestK);
+
+		for (uint32_t xx = 0; xx < _width; ++xx)
+		{
+			const uint32_t value = residuals[xx];
+			const uint32_t quotient = value >> bestK;
+			if (quotient < kEscape)
+			{
+				writer.put( (1u << quotient) - 1, quotient + 1);
+				writer.put(value & ( (1u << bestK) - 1), bestK);
+			}
+			else
+			{
+				writer.put( (1u << kEscape) - 1, kEscape);
+				writer.put(value, kRawBits);
+			}
+		}
+
+		bx::memCopy(prevRow, row, _width * sizeof(uint32_t) );
+	}
+
+	writer.flush();
+	if (writer.m_ptr > writer.m_end)
+	{
+		return 0;
+	}
+
+	HeightTileHeader header;
+	header.m_magic    = HeightTileHeader::kMagic;
+	header.m_width    = uint16_t(_width);
+	header.m_height   = uint16_t(_height);
+	header.m_maxError = _maxError;
+	header.m_reserved = 0;
+	header.m_size     = uint32_t(writer.m_ptr - dst);
+	bx::memCopy(dst, &header, sizeof(header) );
+
+	return header.m_size;
+}
+
+bool heightTileGetHeader(HeightTileHeader& _outHeader, const void* _src, uint32_t _srcSize)
+{
+	if (_srcSize < sizeof(HeightTileHeader) )
+	{
+		return false;
+	}
+
+	bx::memCopy(&_outHeader, _src, sizeof(HeightTileHeader) );
+	return HeightTileHeader::kMagic == _outHeader.m_magic
+		&& kMaxWidth >= _outHeader.m_width
+		&& _outHeader.m_size <= _srcSize
+		&& sizeof(HeightTileHeader) + _outHeader.m_height <= _outHeader.m_size
+		;
+}
+
+bool heightTileDecompress(
+	  uint16_t* _dst
+	, uint32_t _width
+	, uint32_t _height
+	, uint32_t _dstPitch
+	, const void* _src
+	, uint32_t _srcSize
+	)
+{
+	BX_CHECK(_width <= _dstPitch, "Pitch %d is narrower than tile width %d.", _dstPitch, _width);
+
+	// size comes from the file, the caller's buffer only fits the tile it expects
+	HeightTileHeader header;
+	if (!heightTileGetHeader(header, _src, _srcSize)
+	||  _width  != header.m_width
+	||  _height != header.m_height)
+	{
+		return false;
+	}
+
+	const uint8_t* src = (const uint8_t*)_src;
+	const uint8_t* riceK = &src[sizeof(HeightTileHeader)];
+
+	BitReader reader;
+	reader.m_ptr = &src[sizeof(HeightTileHeader) + header.m_height];
+	reader.m_end = &src[header.m_size];
+	reader.m_bits = 0;
+	reader.m_numBits = 0;
+
+	const uint32_t width = header.m_width;
+	const uint32_t width4 = (width + 3) & ~3u;
+
+	BX_ALIGN_DECL_16(int32_t) residuals[kMaxWidth];
+	BX_ALIGN_DECL_16(int32_t) prevRow[kMaxWidth] = {};
+	BX_ALIGN_DECL_16(int32_t) heights[4];
+
+	const bx::simd128_t maskYzw  = bx::simd_ild(0, UINT32_MAX, UINT32_MAX, UINT32_MAX);
+	const bx::simd128_t maskZw   = bx::simd_ild(0, 0, UINT32_MAX, UINT32_MAX);
+	const bx::simd128_t step     = bx::simd_splat(float(2 * uint32_t(header.m_maxError) + 1) );
+	const bx::simd128_t maxValue = bx::simd_splat(65535.0f);
+
+	for (uint32_t yy = 0; yy < header.m_height; ++yy)
+	{
+		const uint32_t kk = riceK[yy];
+		if (kk > kMaxRiceK)
+		{
+			return false;
+		}
+
+		// entropy decode is inherently serial, everything after it works on 4 texels at once
+		for (uint32_t xx = 0; xx < width; ++xx)
+		{
+			reader.refill();
+
+			const uint32_t quotient = bx::min<uint32_t>(bx::uint64_cnttz(~reader.m_bits), kEscape);
+			uint32_t value;
+			if (quotient < kEscape)
+			{
+				reader.get(quotient + 1);
+				value = (quotient << kk) | reader.get(kk);
+			}
+			else
+			{
+				reader.get(kEscape);
+				value = reader.get(kRawBits);
+			}
+
+			residuals[xx] = unzigzag(value);
+		}
+
+		for (uint32_t xx = width; xx < width4; ++xx)
+		{
+			residuals[xx] = 0;
+		}
+
+		if (reader.m_ptr > reader.m_end + kPadding)
+		{
+			return false;
+		}
+
+		uint16_t* dst = &_dst[yy * _dstPitch];
+		bx::simd128_t carry = bx::simd_zero();
+		for (uint32_t xx = 0; xx < width4; xx += 4)
+		{
+			// inclusive prefix sum of 4 lanes, plus running sum of previous lanes
+			bx::simd128_t sum = bx::simd_ld(&residuals[xx]);
+			sum = bx::simd_iadd(sum, bx::simd_and(bx::simd_swiz_xxyz(sum), maskYzw) );
+			sum = bx::simd_iadd(sum, bx::simd_and(bx::simd_swiz_xxxy(sum), maskZw) );
+			sum = bx::simd_iadd(sum, carry);
+			carry = bx::simd_swiz_wwww(sum);
+
+			const bx::simd128_t quantized = bx::simd_iadd(bx::simd_ld(&prevRow[xx]), sum);
+			bx::simd_st(&prevRow[xx], quantized);
+
+			const bx::simd128_t height = bx::simd_clamp(bx::simd_mul(bx::simd_itof(quantized), step), bx::simd_zero(), maxValue);
+			bx::simd_st(heights, bx::simd_ftoi(height) );
+
+			const uint32_t num = bx::min(4u, width - xx);
+			for (uint32_t ii = 0; ii < num; ++ii)
+			{
+				dst[xx + ii] = uint16_t(heights[ii]);
+			}
+		}
+	}
+
+	return true;
+}
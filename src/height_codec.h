@@ -0,0 +1,57 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef HEIGHT_CODEC_H_HEADER_GUARD
+#define HEIGHT_CODEC_H_HEADER_GUARD
+
+#include <bx/bx.h>
+
+/// Compressed R16 height tile. Heights are quantized to the error bound, predicted from the
+/// left, top and top-left neighbours and the residuals are Rice coded with one parameter
+/// per row. Error bound 0 is lossless.
+///
+/// Layout: HeightTileHeader, m_height Rice parameters (one byte per row), bit stream.
+struct HeightTileHeader
+{
+	static constexpr uint32_t kMagic = BX_MAKEFOURCC('H', 'T', 'C', '0');
+
+	uint32_t m_magic;
+	uint16_t m_width;
+	uint16_t m_height;
+	uint16_t m_maxError;  //!< Max absolute difference of any decoded height, in R16 units.
+	uint16_t m_reserved;
+	uint32_t m_size;      //!< Size of whole tile including header.
+};
+
+/// Worst case compressed size of a _width x _height tile.
+uint32_t heightTileCompressBound(uint32_t _width, uint32_t _height);
+
+/// Compresses _width x _height heights read with _srcPitch (in texels) from _src. Returns
+/// compressed size, or 0 if _dstSize is too small.
+uint32_t heightTileCompress(
+	  void* _dst
+	, uint32_t _dstSize
+	, const uint16_t* _src
+	, uint32_t _width
+	, uint32_t _height
+	, uint32_t _srcPitch
+	, uint16_t _maxError
+	);
+
+/// Reads header of compressed tile, returns false if _src isn't a valid tile.
+bool heightTileGetHeader(HeightTileHeader& _outHeader, const void* _src, uint32_t _srcSize);
+
+/// Decompresses _width x _height tile into _dst with _dstPitch (in texels). Row reconstruction
+/// is vectorized, safe to call from loader threads. Returns false if data is corrupt, or
+/// without touching _dst if tile isn't _width x _height.
+bool heightTileDecompress(
+	  uint16_t* _dst
+	, uint32_t _width
+	, uint32_t _height
+	, uint32_t _dstPitch
+	, const void* _src
+	, uint32_t _srcSize
+	);
+
+#endif // HEIGHT_CODEC_H_HEADER_GUARD
@@ -4,11 +4,14 @@
  */
 #include <stdio.h>
 #include <bx/bx.h>
+#include <bx/commandline.h>
 #include <bx/spscqueue.h>
+#include <bx/string.h>
 #include <bx/thread.h>
 #include <bx/file.h>
 #include <bx/timer.h>
 #include <bx/math.h>
+#include <bx/uint32_t.h>
 
 #include <bgfx/bgfx.h>
 #include <bgfx/platform.h>
@@ -22,7 +25,26 @@
 
 
 #include "../bgfx/examples/common/imgui/imgui.h"
+#include "asset_loader.h"
+#include "benchmark.h"
 #include "camera.h"
+#include "terrain_batch.h"
+#include "terrain_heightfield.h"
+#include "terrain_heightmips.h"
+#include "terrain_materials.h"
+#include "terrain_memory.h"
+#include "terrain_normals.h"
+#include "terrain_scatter.h"
+#include "terrain_shadow.h"
+#include "terrain_horizon.h"
+#include "terrain_budget.h"
+#include "terrain_diskcache.h"
+#include "terrain_document.h"
+#include "terrain_gbuffer.h"
+#include "terrain_occlusion.h"
+#include "terrain_quadtree.h"
+#include "terrain_sculpt.h"
+#include "terrain_views.h"
 
 #define MAX(a, b) ((a) > (b)) ? (a) : (b)
 
@@ -31,12 +53,7 @@
 
 bx::AllocatorI* getDefaultAllocator()
 {
-	BX_PRAGMA_DIAGNOSTIC_PUSH();
-	BX_PRAGMA_DIAGNOSTIC_IGNORED_MSVC(4459); // warning C4459: declaration of 's_allocator' hides global declaration
-	BX_PRAGMA_DIAGNOSTIC_IGNORED_CLANG_GCC("-Wshadow");
-	static bx::DefaultAllocator s_allocator;
-	return &s_allocator;
-	BX_PRAGMA_DIAGNOSTIC_POP();
+	return getAllocator(MemoryCategory::General);
 }
 bx::AllocatorI* g_allocator = getDefaultAllocator();
 
@@ -64,7 +81,18 @@ public:
 
 static bx::FileReaderI* s_fileReader = NULL;
 
-static const bgfx::Memory* loadMem(bx::FileReaderI* _reader, const char* _filePath)
+// loader threads need their own reader, bx::FileReader isn't shareable between threads
+bx::FileReaderI* createFileReader()
+{
+	return BX_NEW(g_allocator, FileReader);
+}
+
+void destroyFileReader(bx::FileReaderI* _reader)
+{
+	BX_DELETE(g_allocator, _reader);
+}
+
+const bgfx::Memory* loadMem(bx::FileReaderI* _reader, const char* _filePath)
 {
 	if (bx::open(_reader, _filePath))
 	{
@@ -80,10 +108,8 @@ static const bgfx::Memory* loadMem(bx::FileReaderI* _reader, const char* _filePa
 	return NULL;
 }
 
-static bgfx::ShaderHandle loadShader(bx::FileReaderI* _reader, const char* _name)
+void getShaderFilePath(char* _outFilePath, int32_t _max, const char* _name)
 {
-	char filePath[512];
-
 	const char* shaderPath = "???";
 
 	switch (bgfx::getRendererType())
@@ -104,9 +130,15 @@ static bgfx::ShaderHandle loadShader(bx::FileReaderI* _reader, const char* _name
 		break;
 	}
 
-	bx::strCopy(filePath, BX_COUNTOF(filePath), shaderPath);
-	bx::strCat(filePath, BX_COUNTOF(filePath), _name);
-	bx::strCat(filePath, BX_COUNTOF(filePath), ".bin");
+	bx::strCopy(_outFilePath, _max, shaderPath);
+	bx::strCat(_outFilePath, _max, _name);
+	bx::strCat(_outFilePath, _max, ".bin");
+}
+
+static bgfx::ShaderHandle loadShader(bx::FileReaderI* _reader, const char* _name)
+{
+	char filePath[512];
+	getShaderFilePath(filePath, BX_COUNTOF(filePath), _name);
 
 	bgfx::ShaderHandle handle = bgfx::createShader(loadMem(_reader, filePath));
 	bgfx::setName(handle, _name);
@@ -172,6 +204,12 @@ void unload(void* _ptr)
 	BX_FREE(getDefaultAllocator(), _ptr);
 }
 
+static void releaseHeightMapCb(void* _ptr, void* _userData)
+{
+	BX_UNUSED(_userData);
+	BX_FREE(getAllocator(MemoryCategory::HeightMap), _ptr);
+}
+
 static void imageReleaseCb(void* _ptr, void* _userData)
 {
 	BX_UNUSED(_ptr);
@@ -179,7 +217,75 @@ static void imageReleaseCb(void* _ptr, void* _userData)
 	bimg::imageFree(imageContainer);
 }
 
+// takes ownership of the image, it's released once bgfx is done with it
+bgfx::TextureHandle createTextureFromImage(bimg::ImageContainer* imageContainer, const char* _name, uint64_t _flags, bgfx::TextureInfo* _info)
+{
+	bgfx::TextureHandle handle = BGFX_INVALID_HANDLE;
+
+	const bgfx::Memory* mem = bgfx::makeRef(
+		imageContainer->m_data
+		, imageContainer->m_size
+		, imageReleaseCb
+		, imageContainer
+	);
+
+	if (imageContainer->m_cubeMap)
+	{
+		handle = bgfx::createTextureCube(
+			uint16_t(imageContainer->m_width)
+			, 1 < imageContainer->m_numMips
+			, imageContainer->m_numLayers
+			, bgfx::TextureFormat::Enum(imageContainer->m_format)
+			, _flags
+			, mem
+		);
+	}
+	else if (1 < imageContainer->m_depth)
+	{
+		handle = bgfx::createTexture3D(
+			uint16_t(imageContainer->m_width)
+			, uint16_t(imageContainer->m_height)
+			, uint16_t(imageContainer->m_depth)
+			, 1 < imageContainer->m_numMips
+			, bgfx::TextureFormat::Enum(imageContainer->m_format)
+			, _flags
+			, mem
+		);
+	}
+	else if (bgfx::isTextureValid(0, false, imageContainer->m_numLayers, bgfx::TextureFormat::Enum(imageContainer->m_format), _flags))
+	{
+		handle = bgfx::createTexture2D(
+			uint16_t(imageContainer->m_width)
+			, uint16_t(imageContainer->m_height)
+			, 1 < imageContainer->m_numMips
+			, imageContainer->m_numLayers
+			, bgfx::TextureFormat::Enum(imageContainer->m_format)
+			, _flags
+			, mem
+		);
+	}
+
+	if (bgfx::isValid(handle))
+	{
+		bgfx::setName(handle, _name);
+	}
+
+	if (NULL != _info)
+	{
+		bgfx::calcTextureSize(
+			*_info
+			, uint16_t(imageContainer->m_width)
+			, uint16_t(imageContainer->m_height)
+			, uint16_t(imageContainer->m_depth)
+			, imageContainer->m_cubeMap
+			, 1 < imageContainer->m_numMips
+			, imageContainer->m_numLayers
+			, bgfx::TextureFormat::Enum(imageContainer->m_format)
+		);
+	}
 
+	return handle;
+}
 
 bgfx::TextureHandle loadTexture(bx::FileReaderI* _reader, const char* _filePath, uint64_t _flags, uint8_t _skip, bgfx::TextureInfo* _info, bimg::Orientation::Enum* _orientation)
 {
@@ -191,6 +297,7 @@ bgfx::TextureHandle loadTexture(bx::FileReaderI* _reader, const char* _filePath,
 	if (NULL != data)
 	{
 		bimg::ImageContainer* imageContainer = bimg::imageParse(getDefaultAllocator(), data, size);
+		unload(data);
 
 		if (NULL != imageContainer)
 		{
@@ -199,68 +306,7 @@ bgfx::TextureHandle loadTexture(bx::FileReaderI* _reader, const char* _filePath,
 				*_orientation = imageContainer->m_orientation;
 			}
 
-			const bgfx::Memory* mem = bgfx::makeRef(
-				imageContainer->m_data
-				, imageContainer->m_size
-				, imageReleaseCb
-				, imageContainer
-			);
-			unload(data);
-
-			if (imageContainer->m_cubeMap)
-			{
-				handle = bgfx::createTextureCube(
-					uint16_t(imageContainer->m_width)
-					, 1 < imageContainer->m_numMips
-					, imageContainer->m_numLayers
-					, bgfx::TextureFormat::Enum(imageContainer->m_format)
-					, _flags
-					, mem
-				);
-			}
-			else if (1 < imageContainer->m_depth)
-			{
-				handle = bgfx::createTexture3D(
-					uint16_t(imageContainer->m_width)
-					, uint16_t(imageContainer->m_height)
-					, uint16_t(imageContainer->m_depth)
-					, 1 < imageContainer->m_numMips
-					, bgfx::TextureFormat::Enum(imageContainer->m_format)
-					, _flags
-					, mem
-				);
-			}
-			else if (bgfx::isTextureValid(0, false, imageContainer->m_numLayers, bgfx::TextureFormat::Enum(imageContainer->m_format), _flags))
-			{
-				handle = bgfx::createTexture2D(
-					uint16_t(imageContainer->m_width)
-					, uint16_t(imageContainer->m_height)
-					, 1 < imageContainer->m_numMips
-					, imageContainer->m_numLayers
-					, bgfx::TextureFormat::Enum(imageContainer->m_format)
-					, _flags
-					, mem
-				);
-			}
-
-			if (bgfx::isValid(handle))
-			{
-				bgfx::setName(handle, _filePath);
-			}
-
-			if (NULL != _info)
-			{
-				bgfx::calcTextureSize(
-					*_info
-					, uint16_t(imageContainer->m_width)
-					, uint16_t(imageContainer->m_height)
-					, uint16_t(imageContainer->m_depth)
-					, imageContainer->m_cubeMap
-					, 1 < imageContainer->m_numMips
-					, imageContainer->m_numLayers
-					, bgfx::TextureFormat::Enum(imageContainer->m_format)
-				);
-			}
+			handle = createTextureFromImage(imageContainer, _filePath, _flags, _info);
 		}
 	}
 
@@ -666,18 +712,101 @@ void screenSpaceQuad(float _textureWidth, float _textureHeight, float _texelHalf
 	}
 }
 
+// Pixel rectangle x, y, width, height covering world box around the brush, the whole screen if
+// the box reaches behind the camera and zero size if it's off screen.
+static void brushScreenRect(uint16_t* _outRect, const float* _viewProj, const bx::Vec3& _center, float _radius, float _minY, float _maxY, uint32_t _width, uint32_t _height)
+{
+	float minX =  bx::kFloatMax;
+	float minY =  bx::kFloatMax;
+	float maxX = -bx::kFloatMax;
+	float maxY = -bx::kFloatMax;
+	for (uint32_t ii = 0; ii < 8; ++ii)
+	{
+		const bx::Vec3 corner =
+		{
+			_center.x + (0 != (ii & 1) ? _radius : -_radius),
+			0 != (ii & 2) ? _maxY : _minY,
+			_center.z + (0 != (ii & 4) ? _radius : -_radius),
+		};
+
+		const float ww = corner.x * _viewProj[3] + corner.y * _viewProj[7] + corner.z * _viewProj[11] + _viewProj[15];
+		if (ww <= 0.0f)
+		{
+			_outRect[0] = 0;
+			_outRect[1] = 0;
+			_outRect[2] = uint16_t(_width);
+			_outRect[3] = uint16_t(_height);
+			return;
+		}
+
+		const bx::Vec3 ndc = bx::mulH(corner, _viewProj);
+		minX = bx::min(minX, ndc.x);
+		minY = bx::min(minY, ndc.y);
+		maxX = bx::max(maxX, ndc.x);
+		maxY = bx::max(maxY, ndc.y);
+	}
+
+	// ndc y points up, pixel rows down
+	const float x0 = bx::clamp( (minX * 0.5f + 0.5f) * _width,  0.0f, float(_width) );
+	const float x1 = bx::clamp( (maxX * 0.5f + 0.5f) * _width,  0.0f, float(_width) );
+	const float y0 = bx::clamp( (0.5f - maxY * 0.5f) * _height, 0.0f, float(_height) );
+	const float y1 = bx::clamp( (0.5f - minY * 0.5f) * _height, 0.0f, float(_height) );
+	_outRect[0] = uint16_t(x0);
+	_outRect[1] = uint16_t(y0);
+	_outRect[2] = uint16_t(bx::ceil(x1) - bx::floor(x0) );
+	_outRect[3] = uint16_t(bx::ceil(y1) - bx::floor(y0) );
+}
+
 
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 static const uint16_t s_terrainSize = 16;
-static const uint32_t s_worldNumSectorsX = 32;
-static const uint32_t s_worldNumSectorsY = 32;
+// root node of the quadtree covers the height map, 2^s_rootLod sectors a side
+static const uint8_t s_rootLod = 2;
+static const uint32_t s_worldNumSectorsX = 1 << s_rootLod;
+static const uint32_t s_worldNumSectorsY = 1 << s_rootLod;
 static const uint32_t s_maxPatchesPerSector = 64;
-static const uint32_t s_sectorSizeInMeters = 64;
+static const uint32_t s_sectorSizeInMeters = 16;
 static const uint32_t s_maxPatchesPerSectorRow = 8;
 static const uint32_t s_maxPatchesPerSectorCol = 8;
-static const uint32_t s_maxNodesInTree = 1 + 4 + 16 + 64 + 256 + 1024;
+static const float s_finestPatchSize = float(s_sectorSizeInMeters) / float(s_maxPatchesPerSectorRow);
+static const uint32_t s_maxNodesInTree = QuadTree::kMaxNodes;
+static const float s_heightMapWorldSize = float(s_sectorSizeInMeters << s_rootLod);
+static const float s_heightScale = 0.1f;
+static const uint32_t s_heightTileSize = 32;
+static const float s_scatterCellSize = 4.0f;
+static const uint32_t s_horizonRadius = 32; // texels
+static const char* s_diskCacheDir = "cache";
+static const char* s_documentPath = "terrain.doc";
+static const float s_minResolutionScale = 0.5f;
+static const uint32_t s_occluderCells = 32; // height field occluders, cells per side at most
+static const uint32_t s_occlusionHelpers = 3; // loader jobs rasterising occluder tiles
+static const float s_sculptRate = 0.0009f;     // normalized height per second at brush centre
+static const float s_strokeSpacing = 0.25f;    // brush samples along a stroke, in brush sizes
+static const uint32_t s_maxCursorTrail = 64;
+// Node splits while the camera is closer than s_lodRange node sizes to it, give or take
+// s_lodHysteresis of that. Patches morph into the grid of their parent from s_lodMorphStart
+// of the parent's split distance on, and are fully morphed by the time the parent splits.
+static const float s_lodRange = 0.75f;
+static const float s_lodHysteresis = 0.15f;
+static const float s_lodMorphStart = 0.6f;
+static const uint32_t s_maxLodChanges = 8; // nodes split or merged per frame
+static const float s_cpuBudgetUs = 2000.0f;   // terrain work that can wait a frame
+
+// Views run in id order. Scatter culling feeds indirect draws of the G-buffer view, shadow
+// cascades are read by the resolve pass. Height edits, readback and baking run after the
+// G-buffer is drawn, resolve and brush decal last. Batch runs copy the resolved image out after
+// that.
+static const bgfx::ViewId kScatterCullView = 0;
+static const bgfx::ViewId kShadowView      = 1; // one per cascade
+static const bgfx::ViewId kGBufferView     = kShadowView + ShadowCascades::kNumCascades; // one per camera
+static const bgfx::ViewId kMousePosView    = kGBufferView + TerrainView::kMaxViews;
+static const bgfx::ViewId kCombineView     = kMousePosView + 1;
+static const bgfx::ViewId kResolveView     = kMousePosView + 2;
+static const bgfx::ViewId kBatchView       = kMousePosView + 3;
+
+BX_STATIC_ASSERT(ScatterSystem::kMaxViews >= TerrainView::kMaxViews);
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -690,16 +819,8 @@ struct InstanceData
 	float lodTransition;
 	float heightMapAtlasU;
 	float heightMapAtlasV;
-	float pad0;
-	float pad1;
-};
-
-struct QuadTreeNode
-{
-	float x;
-	float z;
-	int32_t	firstChildIndex;
-	uint8_t lod;
+	float virtualPage; // baked virtual texture page + 1, 0 if patch blends splat layers
+	float lodMorphEnd; // camera distance of full morph into the parent grid
 };
 
 struct TerrainData
@@ -715,6 +836,18 @@ struct TerrainData
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
+// LOD data is rebuilt every frame, all of it lives in the frame arena
+static const uint32_t s_frameArenaSize = 0
+	+ s_worldNumSectorsX * s_worldNumSectorsY
+	+ sizeof(QuadTreeNode) * s_maxNodesInTree
+	+ sizeof(uint16_t) * s_maxNodesInTree
+	+ sizeof(QuadTreeNode*) * s_maxNodesInTree
+	+ sizeof(InstanceData) * s_maxNodesInTree * 64
+	+ sizeof(uint32_t) * s_maxNodesInTree * 64 * TerrainView::kMaxViews
+	+ 16 * (5 + TerrainView::kMaxViews) // alignment
+	;
+static FrameArena s_frameArena;
+
 static QuadTreeNode* s_quadTree;
 static QuadTreeNode** s_nodesToRender;
 static uint32_t s_numNodesToRender = 0;
@@ -726,94 +859,7 @@ static uint32_t s_heightMapSize = 128;
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-void buildQuadTree(float* playerPosition)
-{
-
-	uint16_t nodeIndex = 0;
-	QuadTreeNode* node = &s_quadTree[nodeIndex];
-	// hack for height testing
-	node->lod = 0;
-	node->firstChildIndex = -1;
-	node->x = 0;
-	node->z = 0;
-	++nodeIndex;
-
-	uint16_t* nodesQueue = (uint16_t*)alloca(sizeof(uint16_t) * s_maxNodesInTree);
-	uint16_t queueHead = 0;
-	uint16_t queueSize = 0;
-	// add head to queue
-	queueSize++;
-	nodesQueue[queueHead] = 0;
-
-	while (queueSize > 0)
-	{
-		// pop from queue
-		node = &s_quadTree[nodesQueue[queueHead]];
-		++queueHead;
-		--queueSize;
-
-		float nodeSize = 64.0f * (1 << node->lod);
-		float halfNodeSize = nodeSize * 0.5f;
-		float nodeCenterX = node->x + halfNodeSize;
-		float nodeCenterZ = node->z + halfNodeSize;
-		float distance = (nodeCenterX - playerPosition[0]) * ((nodeCenterX - playerPosition[0])) +
-			(nodeCenterZ - playerPosition[2]) * ((nodeCenterZ - playerPosition[2]));
-		// check if distance is less than the sqrt(2) of the half (corner of the rect is the furtherest point from the center)
-		if (node->lod > 0 && distance < halfNodeSize * halfNodeSize * 2.0f)
-		{
-			// split node to 4 child nodes
-			// point parent node to first child
-			node->firstChildIndex = nodeIndex;
-			uint8_t nextLOD = node->lod - 1;
-			QuadTreeNode* childNode;
-			// first child
-			childNode = &s_quadTree[nodeIndex];
-
-			childNode->lod = nextLOD;
-			childNode->firstChildIndex = -1;
-			childNode->x = node->x;
-			childNode->z = node->z;
-			nodesQueue[queueHead + queueSize] = nodeIndex;
-			++queueSize;
-			++nodeIndex;
-			// second child
-			childNode = &s_quadTree[nodeIndex];
-
-			childNode->lod = nextLOD;
-			childNode->firstChildIndex = -1;
-			childNode->x = node->x + halfNodeSize;
-			childNode->z = node->z;
-			nodesQueue[queueHead + queueSize] = nodeIndex;
-			++queueSize;
-			++nodeIndex;
-
-			// third child
-			childNode = &s_quadTree[nodeIndex];
-
-			childNode->lod = nextLOD;
-			childNode->firstChildIndex = -1;
-			childNode->x = node->x;
-			childNode->z = node->z + halfNodeSize;
-			nodesQueue[queueHead + queueSize] = nodeIndex;
-			++queueSize;
-			++nodeIndex;
-
-			// forth child
-			childNode = &s_quadTree[nodeIndex];
-
-			childNode->lod = nextLOD;
-			childNode->firstChildIndex = -1;
-			childNode->x = node->x + halfNodeSize;
-			childNode->z = node->z + halfNodeSize;
-			nodesQueue[queueHead + queueSize] = nodeIndex;
-			++queueSize;
-			++nodeIndex;
-		}
-	}
-
-}
-
-void generatePatchesFromNodes(QuadTreeNode** nodes, uint32_t numNodes)
+void generatePatchesFromNodes(const QuadTree& tree, QuadTreeNode** nodes, uint32_t numNodes)
 {
 	// generate patches from node
 	uint8_t* sectorsLODMap = s_sectorsLODMap;
@@ -821,8 +867,8 @@ void generatePatchesFromNodes(QuadTreeNode** nodes, uint32_t numNodes)
 	for (uint32_t nodeIndex = 0; nodeIndex < numNodes; ++nodeIndex)
 	{
 		QuadTreeNode* node = nodes[nodeIndex];
-		float patchSize = 8.0f * (1 << node->lod);
-		//float nodeSize = patchSize * 8.0f;
+		float patchSize = s_finestPatchSize * (1 << node->lod);
+		float lodMorphEnd = quadTreeGetMorphEnd(tree, node->lod);
 		for (int j = 0; j < s_maxPatchesPerSectorCol; ++j)
 		{
 			for (int i = 0; i < s_maxPatchesPerSectorRow; ++i)
@@ -831,21 +877,23 @@ void generatePatchesFromNodes(QuadTreeNode** nodes, uint32_t numNodes)
 				instanceData->worldPosX = node->x + i * patchSize;
 				instanceData->worldPosY = node->z + j * patchSize;
 				instanceData->lodTransition = 0;
-				instanceData->heightMapAtlasU = 0.125f * i;
-				instanceData->heightMapAtlasV = 0.125f * j;
+				instanceData->heightMapAtlasU = instanceData->worldPosX / s_heightMapWorldSize;
+				instanceData->heightMapAtlasV = instanceData->worldPosY / s_heightMapWorldSize;
+				instanceData->virtualPage = 0;
+				instanceData->lodMorphEnd = lodMorphEnd;
 
 
 
 
-				uint32_t sectorX = ((uint32_t)instanceData->worldPosX) / 64;
-				uint32_t sectorZ = ((uint32_t)instanceData->worldPosY) / 64;
+				uint32_t sectorX = ((uint32_t)instanceData->worldPosX) / s_sectorSizeInMeters;
+				uint32_t sectorZ = ((uint32_t)instanceData->worldPosY) / s_sectorSizeInMeters;
 
 				uint8_t mylod = sectorsLODMap[sectorX + sectorZ * s_worldNumSectorsX];
 				uint8_t westlod = sectorX > 0 ? sectorsLODMap[sectorX - 1 + sectorZ * s_worldNumSectorsX] : 0;
-				uint32_t nextSctorX = ((uint32_t)(instanceData->worldPosX + patchSize) / 64);
+				uint32_t nextSctorX = ((uint32_t)(instanceData->worldPosX + patchSize) / s_sectorSizeInMeters);
 				uint8_t eastlod = nextSctorX < s_worldNumSectorsX ? sectorsLODMap[nextSctorX + sectorZ * s_worldNumSectorsX] : 0;
 				uint8_t southlod = sectorZ > 0 ? sectorsLODMap[sectorX + (sectorZ - 1) * s_worldNumSectorsX] : 0;
-				uint32_t nextSctorZ = ((uint32_t)(instanceData->worldPosY + patchSize) / 64);
+				uint32_t nextSctorZ = ((uint32_t)(instanceData->worldPosY + patchSize) / s_sectorSizeInMeters);
 				uint8_t northlod = nextSctorZ < s_worldNumSectorsY ? sectorsLODMap[sectorX + nextSctorZ * s_worldNumSectorsX] : 0;
 				/*uint16_t packedLOD = 0 |
 					MAX(westlod - mylod, 0) |
@@ -874,8 +922,8 @@ void traverseQuadTree(QuadTreeNode* node)
 	{
 		uint8_t* sectorsLODMap = s_sectorsLODMap;
 		// add note to sectors LOD map
-		uint32_t secotrStartX = (uint32_t)node->x / 64;
-		uint32_t secotrStartY = (uint32_t)node->z / 64;
+		uint32_t secotrStartX = (uint32_t)node->x / s_sectorSizeInMeters;
+		uint32_t secotrStartY = (uint32_t)node->z / s_sectorSizeInMeters;
 		uint32_t numSectorsInNode = 1 << node->lod;
 		for (uint32_t i = 0; i < numSectorsInNode; ++i)
 		{
@@ -898,13 +946,46 @@ void traverseQuadTree(QuadTreeNode* node)
 struct App
 {
 	void init(uint32_t windowWidth, uint32_t windowHeight);
+	void shutdown();
 	bool update();
 	void handleKey(KeyEvent* keyEvent);
+	void resize(uint32_t windowWidth, uint32_t windowHeight);
+
+	/// Records cursor position, every one since the last frame is used by sculpt strokes.
+	void addCursorPosition(int32_t _x, int32_t _y);
+
+	/// Renders poses of _posesPath into images of the window size in _outDir instead of showing
+	/// the camera. Every pose is drawn for _settleFrames frames before it's captured, so LOD,
+	/// streaming and budgeted work catch up with it. Returns false if the batch can't start.
+	bool beginBatch(const char* _posesPath, const char* _outDir, uint32_t _numInFlight, uint32_t _settleFrames);
+
+	/// Every pose of the batch was written or failed.
+	bool isBatchDone() const
+	{
+		return batchIsDone(m_batch);
+	}
+
+	/// Images that couldn't be written, final once the batch is done.
+	uint32_t getBatchNumFailed() const
+	{
+		return m_batch.m_numFailed;
+	}
 
 	MouseState s_mouseState;
 
 private:
 	void createTerrainMesh();
+	void dispatchNormals(bgfx::ViewId _view, const TileRect& _rect, bool _brushCentered);
+	void submitShadowCascades(uint32_t _cascadeMask);
+	void setLodMorphUniform();
+	void setupViews(uint32_t _width, uint32_t _height, bool _homogeneousDepth);
+	void submitTerrainView(uint32_t _viewIndex);
+	void applyLoadedHeights();
+	static void documentLoadedCb(const uint16_t* _heights, void* _userData);
+	bool isBoxVisible(float _x, float _z, float _size);
+	bool pickHeightfield(float _u, float _v, const float* _invViewProj, RayHit& _outHit);
+	uint32_t cullOccludedPatches(TerrainView& _view);
+	bool updateBatchPose();
 
 private:
 	uint32_t m_windowWidth;
@@ -913,11 +994,30 @@ private:
 	float	mousebuff[4];
 	float	m_brushSize = 1.0;
 	bool	m_renderGrid = false;
+	bool	m_useVirtualTexture = true;
+	float	m_virtualTextureDistance = 128.0f;
 
 	TerrainData m_terrain;
 	BrushData	m_brush;
 
-	bgfx::TextureHandle m_gbufferTex[3];
+	GBuffer m_gbuffer;
+	GBufferLayout::Enum m_gbufferLayout = GBufferLayout::Lit;
+	bool m_useBrushDecal = true;
+
+	// smoothed resolve GPU time per G-buffer size and layout
+	struct ResolveTiming
+	{
+		uint16_t m_width;
+		uint16_t m_height;
+		GBufferLayout::Enum m_layout;
+		float m_ms;
+	};
+	ResolveTiming m_resolveTimings[8];
+	uint32_t m_numResolveTimings;
+
+	// G-buffer resolution follows GPU frame time
+	bool  m_dynamicResolution = true;
+	float m_gpuTargetMs = 14.0f; // 60 FPS with headroom for the CPU side of the frame
 	bgfx::UniformHandle s_albedo;
 	bgfx::UniformHandle s_depth;
 	bgfx::UniformHandle u_params;
@@ -925,13 +1025,14 @@ private:
 	bgfx::UniformHandle u_invViewProj;
 	bgfx::UniformHandle u_heightMapParams;
 	bgfx::UniformHandle u_renderParams;
-
-	bgfx::FrameBufferHandle m_gbuffer;
+	bgfx::UniformHandle u_lodMorphParams;
 
 	bgfx::ProgramHandle m_program;
 	bgfx::ProgramHandle m_combinedProgram;
+	bgfx::ProgramHandle m_brushDecalProgram;
 	bgfx::ProgramHandle m_programComputeMousePos;
 	bgfx::ProgramHandle m_programComputeUpdateHeightMap;
+	bgfx::ProgramHandle m_programComputeHeightMip;
 
 	bgfx::DynamicVertexBufferHandle m_mouseBufferHandle;
 	bgfx::DynamicVertexBufferHandle m_mouseBufferHandle2;
@@ -941,16 +1042,104 @@ private:
 
 	bgfx::VertexBufferHandle m_terrainVbh;
 	bgfx::IndexBufferHandle m_terrainIbh;
+	// every 2nd and 4th vertex of the patch grid, for shadow cascades with LOD bias
+	bgfx::IndexBufferHandle m_terrainCoarseIbh[2];
 
 	
 	bgfx::ProgramHandle m_terrainHeightTextureProgram;
 	bgfx::UniformHandle s_heightTexture;
 	bgfx::TextureHandle m_heightTexture;
-
-	bgfx::UniformHandle m_albedoTextureSampler;
-	bgfx::TextureHandle m_albedoTexture;
-
-	
+	HeightMips m_heightMips;
+	bgfx::UniformHandle u_heightMipParams;
+
+	MaterialSet m_materials;
+	SplatMap m_splatMap;
+	VirtualTextureCache m_virtualTexture;
+	bgfx::UniformHandle s_materials;
+	bgfx::UniformHandle s_splatIndices;
+	bgfx::UniformHandle s_splatWeights;
+	bgfx::UniformHandle s_virtualAtlas;
+	bgfx::UniformHandle u_virtualParams;
+
+	bgfx::ProgramHandle m_programComputeUpdateNormals;
+	bgfx::UniformHandle s_normalTexture;
+	bgfx::UniformHandle u_normalParams;
+	bgfx::UniformHandle u_sunDirection;
+	bgfx::TextureHandle m_normalTexture;
+	NormalCache m_normalCache;
+
+	// GPU normals read back and compared with normalsComputeRG8 on request
+	bgfx::TextureHandle m_normalReadbackTexture;
+	uint8_t* m_normalReadback;
+	uint8_t* m_normalReference;    //!< CPU normals of the heights the readback was taken from.
+	uint32_t m_normalReadbackFrame;
+	int32_t  m_normalMaxError;     //!< Largest RG8 difference of the last check, -1 before one.
+	bool     m_normalCheckRequested;
+	float m_sunDirection[4];
+
+	// CPU copy of m_heightTexture for picking, synced by reading back the texture after edits
+	Heightfield m_heightfield;
+	bgfx::TextureHandle m_heightReadbackTexture;
+	uint16_t* m_heightReadback;
+	uint32_t m_heightReadbackFrame;
+	uint32_t m_heightReadbackRow;  //!< Rows of the arrived readback copied so far.
+	uint32_t m_frameNumber;
+	bool m_heightfieldDirty;
+	bool m_heightfieldReady;
+	bool m_mouseHit;
+	float m_pickTimeUs;
+
+	ScatterSystem m_scatter;
+
+	ShadowCascades m_shadows;
+	bgfx::ProgramHandle m_terrainShadowProgram;
+
+	// far terrain is shadowed by horizon maps instead of the last cascade
+	DiskCache m_diskCache;
+	HorizonCache m_horizon;
+	TileRect m_horizonDirty;        //!< Texels sculpted since the last readback was issued.
+	TileRect m_horizonReadbackRect; //!< Texels sculpted before the readback in flight.
+	bool m_useHorizonShadows;
+
+	// patches hidden behind nearer terrain are not drawn into the G-buffer
+	OcclusionBuffer m_occlusion;
+	uint32_t m_numFrustumPatches;
+	uint32_t m_numVisiblePatches;
+	bool m_useOcclusionCulling;
+
+	// spreads terrain CPU work over frames, so fast camera moves don't spike
+	FrameBudget m_budget;
+
+	// patches blend into their parent's grid before the quadtree merges them
+	QuadTree m_quadTree;
+	bx::Vec3 m_lodPositions[TerrainView::kMaxViews];
+	uint32_t m_numLodPositions;
+	bool m_useGeomorphing;
+
+	// cameras share one LOD selection, each culls and draws its own part of the window
+	TerrainView m_views[TerrainView::kMaxViews];
+	uint32_t m_numViews;
+	ViewLayout::Enum m_viewLayout;
+	float m_sharedLodMs;
+
+	// cursor positions since the last frame, turned into brush samples along the stroke
+	SculptStroke m_sculpt;
+	float m_cursorTrail[s_maxCursorTrail][2];
+	uint32_t m_numCursorTrail;
+
+	// sculpted heights on disk, saved from the CPU copy once it caught up with the edits
+	TerrainDocument m_document;
+	bool m_saveRequested;
+	bool m_loadPending;            //!< Loaded heights wait in m_terrain.m_heightMap for the readback in flight.
+
+	// windowless runs resolve poses into an offscreen target, images are read back and written
+	// while the next poses render
+	BatchRenderer m_batch;
+	const BatchPose* m_batchPose;  //!< Pose being rendered, NULL between poses.
+	uint32_t m_batchSettleFrames;
+	uint32_t m_batchFrame;         //!< Frames the current pose was drawn for.
+	bool m_batchMode;
+	bool m_batchReady;             //!< Shaders and heights are loaded, poses can start.
 };
 
 static App theApp;
@@ -991,48 +1180,47 @@ void App::init(uint32_t windowWidth, uint32_t windowHeight)
 	
 	
 
-	const uint64_t tsFlags = 0
-		| BGFX_SAMPLER_MIN_POINT
-		| BGFX_SAMPLER_MAG_POINT
-		| BGFX_SAMPLER_MIP_POINT
-		| BGFX_SAMPLER_U_CLAMP
-		| BGFX_SAMPLER_V_CLAMP
-		;
-
-	bgfx::Attachment gbufferAt[3];
-	
-
 	uint32_t width = windowWidth;
 	uint32_t height = windowHeight;
 
 	m_windowWidth = width;
 	m_windowHeight = height;
 
-	/*m_gbufferTex[0] = bgfx::createTexture2D(uint16_t(width), uint16_t(height), false, 1, bgfx::TextureFormat::BGRA8, 0 | tsFlags);
-	const bgfx::Memory* mem = bgfx::alloc(width * height * 4);
-	memset(mem->data, 0xFF, width * height * 4);
-	bgfx::updateTexture2D(m_gbufferTex[0], 0, 0, 0, 0, uint16_t(width), uint16_t(height), mem);*/
+	gbufferCreate(m_gbuffer, uint16_t(width), uint16_t(height), m_gbufferLayout);
+	m_numResolveTimings = 0;
 
+	for (uint32_t ii = 0; ii < TerrainView::kMaxViews; ++ii)
 	{
-		m_gbufferTex[0] = bgfx::createTexture2D(uint16_t(width), uint16_t(height), false, 1, bgfx::TextureFormat::BGRA8, BGFX_TEXTURE_RT | tsFlags);
-		m_gbufferTex[1] = bgfx::createTexture2D(uint16_t(width), uint16_t(height), false, 1, bgfx::TextureFormat::BGRA8, BGFX_TEXTURE_RT | tsFlags);
-		gbufferAt[0].init(m_gbufferTex[0]);
-		gbufferAt[1].init(m_gbufferTex[1]);
+		bgfx::setViewFrameBuffer(bgfx::ViewId(kGBufferView + ii), m_gbuffer.m_frameBuffer);
 	}
 
-	m_gbufferTex[2] = bgfx::createTexture2D(uint16_t(width), uint16_t(height), false, 1, bgfx::TextureFormat::D24S8, BGFX_TEXTURE_RT | tsFlags);
-	gbufferAt[2].init(m_gbufferTex[2]);
 
-	m_gbuffer = bgfx::createFrameBuffer(BX_COUNTOF(gbufferAt), gbufferAt, true);
 
-	bgfx::setViewFrameBuffer(0, m_gbuffer);
+	// Set G-buffer view to the same dimensions as the window and to clear the color buffer.
+	const bgfx::ViewId kClearView = kGBufferView;
+	//bgfx::setViewClear(kClearView, BGFX_CLEAR_COLOR);
+	bgfx::setViewRect(kClearView, 0, 0, bgfx::BackbufferRatio::Equal);
 
+	// height edits and normal updates must run in submission order
+	bgfx::setViewMode(kCombineView, bgfx::ViewMode::Sequential);
 
+	// brush decal blends over the resolved image
+	bgfx::setViewMode(kResolveView, bgfx::ViewMode::Sequential);
+	bgfx::setViewName(kResolveView, "Resolve");
 
-	// Set view 0 to the same dimensions as the window and to clear the color buffer.
-	const bgfx::ViewId kClearView = 0;
-	//bgfx::setViewClear(kClearView, BGFX_CLEAR_COLOR);
-	bgfx::setViewRect(kClearView, 0, 0, bgfx::BackbufferRatio::Equal);
+	// cull dispatch writes arguments read by the next one
+	bgfx::setViewMode(kScatterCullView, bgfx::ViewMode::Sequential);
+	bgfx::setViewName(kScatterCullView, "Scatter cull");
+
+	// per view GPU times for the settings window
+	bgfx::setDebug(BGFX_DEBUG_PROFILER);
+
+	m_sunDirection[0] = 0.4f;
+	m_sunDirection[1] = 0.8f;
+	m_sunDirection[2] = 0.3f;
+	m_sunDirection[3] = 0.25f; // ambient
+	const bx::Vec3 sunDir = bx::normalize(bx::load<bx::Vec3>(m_sunDirection));
+	bx::store(m_sunDirection, sunDir);
 
 
 	
@@ -1054,12 +1242,10 @@ void App::init(uint32_t windowWidth, uint32_t windowHeight)
 		| BGFX_SAMPLER_U_CLAMP
 		| BGFX_SAMPLER_V_CLAMP);
 	const bgfx::Memory* mem;
-	uint16_t* heightmap = (uint16_t*)malloc(heightMapWidth * heightMapHeigt * sizeof(uint16_t));
-	uint16_t* heightmap2 = (uint16_t*)malloc(heightMapWidth * heightMapHeigt * sizeof(uint16_t));
+	uint16_t* heightmap = (uint16_t*)BX_ALLOC(getAllocator(MemoryCategory::HeightMap), heightMapWidth * heightMapHeigt * sizeof(uint16_t));
 	memset(heightmap, 0xEE, heightMapWidth * heightMapHeigt * sizeof(uint16_t));
-	mem = bgfx::makeRef(&heightmap[0], sizeof(uint16_t) * heightMapWidth * heightMapHeigt);
+	mem = bgfx::makeRef(&heightmap[0], sizeof(uint16_t) * heightMapWidth * heightMapHeigt, releaseHeightMapCb);
 	bgfx::updateTexture2D(heightTexture, 0, 0, 0, 0, (uint16_t)heightMapWidth, (uint16_t)heightMapHeigt, mem);
-	memset(heightmap2, 0xAA, heightMapWidth * heightMapHeigt * sizeof(uint16_t));
 	bgfx::UniformHandle s_texColor = bgfx::createUniform("s_texColor", bgfx::UniformType::Sampler);
 	//bgfx::ProgramHandle programCompute = bgfx::createProgram(loadShader("cs_update"), true);
 	
@@ -1070,25 +1256,48 @@ void App::init(uint32_t windowWidth, uint32_t windowHeight)
 	s_depth = bgfx::createUniform("s_depth", bgfx::UniformType::Sampler);
 	u_params = bgfx::createUniform("u_params", bgfx::UniformType::Vec4);
 	m_heightTexture.idx = bgfx::kInvalidHandle;
+	m_normalTexture.idx = bgfx::kInvalidHandle;
 	s_heightTexture = bgfx::createUniform("s_heightTexture", bgfx::UniformType::Sampler);
-	m_albedoTextureSampler = bgfx::createUniform("albedoTexture", bgfx::UniformType::Sampler);
+	s_materials = bgfx::createUniform("s_materials", bgfx::UniformType::Sampler);
+	s_splatIndices = bgfx::createUniform("s_splatIndices", bgfx::UniformType::Sampler);
+	s_splatWeights = bgfx::createUniform("s_splatWeights", bgfx::UniformType::Sampler);
+	s_virtualAtlas = bgfx::createUniform("s_virtualAtlas", bgfx::UniformType::Sampler);
+	u_virtualParams = bgfx::createUniform("u_virtualParams", bgfx::UniformType::Vec4);
 	u_heightMapParams = bgfx::createUniform("u_heightMapParams", bgfx::UniformType::Vec4);
 	u_renderParams = bgfx::createUniform("u_renderParams", bgfx::UniformType::Vec4);
+	u_lodMorphParams = bgfx::createUniform("u_lodMorphParams", bgfx::UniformType::Vec4, 3);
+	s_normalTexture = bgfx::createUniform("s_normalTexture", bgfx::UniformType::Sampler);
+	u_normalParams = bgfx::createUniform("u_normalParams", bgfx::UniformType::Vec4, 2);
+	u_heightMipParams = bgfx::createUniform("u_heightMipParams", bgfx::UniformType::Vec4);
+	u_sunDirection = bgfx::createUniform("u_sunDirection", bgfx::UniformType::Vec4);
+
+	// Files are read and decoded on loader threads, handles are filled in by assetLoaderUpdate.
+	// Until then programs are invalid and their passes are skipped.
+	assetLoaderCreate(4);
+	assetLoadProgram(&m_program, "vs_cubes", "fs_cubes");
+	assetLoadProgram(&m_combinedProgram, "vs_deferred_combine", "fs_deferred_combine");
+	assetLoadProgram(&m_brushDecalProgram, "vs_deferred_combine", "fs_brush_decal");
+
+	assetLoadProgram(&m_terrainHeightTextureProgram, "vs_terrain_height_texture", "fs_terrain");
+	assetLoadProgram(&m_terrainShadowProgram, "vs_terrain_shadow", "fs_shadow");
+
+	// ground materials, one texture array layer each
+	static const char* s_materialPaths[] =
+	{
+		"textures/forest_ground_01_dif.dds",
+	};
+	materialSetCreate(m_materials, s_materialPaths, BX_COUNTOF(s_materialPaths));
+	virtualTextureCacheCreate(m_virtualTexture);
 
-	// Create program from shaders.
-	m_program = loadProgram("vs_cubes", "fs_cubes");
-	m_combinedProgram = loadProgram("vs_deferred_combine", "fs_deferred_combine");
-
-	m_terrainHeightTextureProgram = loadProgram("vs_terrain_height_texture", "fs_terrain");
-	m_albedoTexture = loadTexture("textures/forest_ground_01_dif.dds");
-
-	m_programComputeMousePos = bgfx::createProgram(loadShader("cs_updateMousePos"), true);
-	m_programComputeUpdateHeightMap = bgfx::createProgram(loadShader("cs_updateHeightMap"), true);
+	assetLoadProgram(&m_programComputeMousePos, "cs_updateMousePos");
+	assetLoadProgram(&m_programComputeUpdateHeightMap, "cs_updateHeightMap");
+	assetLoadProgram(&m_programComputeHeightMip, "cs_heightMip");
+	assetLoadProgram(&m_programComputeUpdateNormals, "cs_updateNormals");
 
 	uint32_t num = (s_terrainSize + 1) * (s_terrainSize + 1);
-	m_terrain.m_vertices = (PosColorVertex*)BX_ALLOC(getDefaultAllocator(), num * sizeof(PosColorVertex));
-	m_terrain.m_indices = (uint16_t*)BX_ALLOC(getDefaultAllocator(), num * sizeof(uint16_t) * 6);
-	m_terrain.m_heightMap = (uint16_t*)BX_ALLOC(getDefaultAllocator(), sizeof(uint16_t) * s_heightMapSize * s_heightMapSize);
+	m_terrain.m_vertices = (PosColorVertex*)BX_ALLOC(getAllocator(MemoryCategory::HeightMap), num * sizeof(PosColorVertex));
+	m_terrain.m_indices = (uint16_t*)BX_ALLOC(getAllocator(MemoryCategory::HeightMap), num * sizeof(uint16_t) * 6);
+	m_terrain.m_heightMap = (uint16_t*)BX_ALLOC(getAllocator(MemoryCategory::HeightMap), sizeof(uint16_t) * s_heightMapSize * s_heightMapSize);
 
 	bx::memSet(m_terrain.m_heightMap, 0, sizeof(uint16_t) * s_heightMapSize * s_heightMapSize);
 	for (int i = 0; i < 64; ++i)
@@ -1101,18 +1310,68 @@ void App::init(uint32_t windowWidth, uint32_t windowHeight)
 		m_terrain.m_heightMap[i + s_heightMapSize * 17] = 25;
 	}
 
+	heightMipsCreate(m_heightMips, s_heightMapSize, s_heightMapSize);
 	createTerrainMesh();
 
-	
+	// dmap() scales normalized heights by 65536
+	heightfieldCreate(m_heightfield, s_heightMapSize, s_heightMapSize, s_heightMapWorldSize / (float)s_heightMapSize, s_heightScale * 65536.0f / 65535.0f);
+	m_heightReadback = (uint16_t*)BX_ALLOC(getAllocator(MemoryCategory::HeightMap), sizeof(uint16_t) * s_heightMapSize * s_heightMapSize);
+	m_heightReadbackTexture.idx = bgfx::kInvalidHandle;
+	m_normalReadbackTexture.idx = bgfx::kInvalidHandle;
+	if (0 != (bgfx::getCaps()->supported & BGFX_CAPS_TEXTURE_READ_BACK)
+	&&  0 != (bgfx::getCaps()->supported & BGFX_CAPS_TEXTURE_BLIT) )
+	{
+		m_heightReadbackTexture = bgfx::createTexture2D((uint16_t)s_heightMapSize, (uint16_t)s_heightMapSize, false, 1, bgfx::TextureFormat::R16, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_BLIT_DST);
+		m_normalReadbackTexture = bgfx::createTexture2D((uint16_t)s_heightMapSize, (uint16_t)s_heightMapSize, false, 1, bgfx::TextureFormat::RG8, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_BLIT_DST);
+	}
+	m_normalReadback  = (uint8_t*)BX_ALLOC(getAllocator(MemoryCategory::General), s_heightMapSize * s_heightMapSize * 2);
+	m_normalReference = (uint8_t*)BX_ALLOC(getAllocator(MemoryCategory::General), s_heightMapSize * s_heightMapSize * 2);
+	m_normalReadbackFrame = 0;
+	m_normalMaxError = -1;
+	m_normalCheckRequested = false;
+	m_heightReadbackFrame = 0;
+	m_heightReadbackRow = 0;
+	m_frameNumber = 0;
+	m_heightfieldDirty = true;
+	m_heightfieldReady = false;
+	m_mouseHit = false;
+	m_pickTimeUs = 0.0f;
 
 	m_mouseBufferHandle = bgfx::createDynamicVertexBuffer(1, Pos4Vertex::ms_layout, BGFX_BUFFER_COMPUTE_READ_WRITE);
+
+	scatterCreate(m_scatter, s_heightMapSize, s_heightMapSize, s_heightMapWorldSize / (float)s_heightMapSize, s_scatterCellSize, 0x5ca77e12);
+	shadowCreate(m_shadows, s_heightMapWorldSize);
+	diskCacheCreate(m_diskCache, s_diskCacheDir);
+	horizonCacheCreate(m_horizon, s_heightMapSize, s_heightMapSize, s_heightTileSize, s_horizonRadius, &m_diskCache);
+	m_horizonDirty = { 0, 0, 0, 0 };
+	m_horizonReadbackRect = { 0, 0, 0, 0 };
+	m_useHorizonShadows = true;
+	occlusionCreate(m_occlusion, s_occluderCells, s_occlusionHelpers);
+	m_numFrustumPatches = 0;
+	m_numVisiblePatches = 0;
+	m_useOcclusionCulling = true;
+	frameBudgetCreate(m_budget, s_cpuBudgetUs);
+	quadTreeCreate(m_quadTree, s_rootLod, float(s_sectorSizeInMeters), s_lodRange, s_lodHysteresis, s_maxLodChanges);
+	m_lodPositions[0] = { 0.0f, 0.0f, 0.0f };
+	m_numLodPositions = 1;
+	m_useGeomorphing = true;
+	m_numViews = 0;
+	m_viewLayout = ViewLayout::Single;
+	m_sharedLodMs = 0.0f;
+	sculptCreate(m_sculpt);
+	m_numCursorTrail = 0;
+	documentCreate(m_document, s_documentPath, s_heightMapSize, s_heightMapSize, s_heightTileSize);
+	m_saveRequested = false;
+	m_loadPending = false;
+	m_batchPose = NULL;
+	m_batchSettleFrames = 1;
+	m_batchFrame = 0;
+	m_batchMode = false;
+	m_batchReady = false;
 	
 
-	s_sectorsLODMap = (uint8_t*)malloc(s_worldNumSectorsX * s_worldNumSectorsY);
-	memset(s_sectorsLODMap, 0, s_worldNumSectorsX * s_worldNumSectorsY);
-	s_quadTree = (QuadTreeNode*)malloc(sizeof(QuadTreeNode) * s_maxNodesInTree);
-	s_nodesToRender = (QuadTreeNode**)malloc(sizeof(QuadTreeNode*) * s_maxNodesInTree);
-	s_patches = (InstanceData*)malloc(sizeof(InstanceData) * s_maxNodesInTree * 64);
+	frameArenaCreate(s_frameArena, s_frameArenaSize, getAllocator(MemoryCategory::LodFrame));
+	memorySetBudget(MemoryCategory::LodFrame, s_frameArenaSize + 16);
 
 	cameraCreate();
 	cameraSetPosition({ s_terrainSize / 2.0f, 40.0f, 0.0f });
@@ -1120,6 +1379,163 @@ void App::init(uint32_t windowWidth, uint32_t windowHeight)
 	
 }
 
+void App::shutdown()
+{
+	virtualTextureCacheDestroy(m_virtualTexture);
+	materialSetDestroy(m_materials);
+	splatMapDestroy(m_splatMap);
+	normalCacheDestroy(m_normalCache);
+	cameraDestroy();
+
+	frameArenaDestroy(s_frameArena, getAllocator(MemoryCategory::LodFrame));
+	heightfieldDestroy(m_heightfield);
+	heightMipsDestroy(m_heightMips);
+	scatterDestroy(m_scatter);
+	shadowDestroy(m_shadows);
+	horizonCacheDestroy(m_horizon);
+	diskCacheDestroy(m_diskCache);
+	occlusionDestroy(m_occlusion);
+	sculptDestroy(m_sculpt);
+	documentDestroy(m_document);
+	gbufferDestroy(m_gbuffer);
+	if (m_batchMode)
+	{
+		batchDestroy(m_batch);
+	}
+
+	bgfx::destroy(m_terrainVbh);
+	bgfx::destroy(m_terrainIbh);
+	bgfx::destroy(m_terrainCoarseIbh[0]);
+	bgfx::destroy(m_terrainCoarseIbh[1]);
+	if (bgfx::isValid(m_heightReadbackTexture) )
+	{
+		bgfx::destroy(m_heightReadbackTexture);
+	}
+	if (bgfx::isValid(m_normalReadbackTexture) )
+	{
+		bgfx::destroy(m_normalReadbackTexture);
+	}
+	bgfx::frame(); // buffers reference terrain data until they are processed
+	BX_FREE(getAllocator(MemoryCategory::HeightMap), m_heightReadback);
+	BX_FREE(getAllocator(MemoryCategory::General), m_normalReadback);
+	BX_FREE(getAllocator(MemoryCategory::General), m_normalReference);
+	BX_FREE(getAllocator(MemoryCategory::HeightMap), m_terrain.m_vertices);
+	BX_FREE(getAllocator(MemoryCategory::HeightMap), m_terrain.m_indices);
+	BX_FREE(getAllocator(MemoryCategory::HeightMap), m_terrain.m_heightMap);
+}
+
+void App::resize(uint32_t windowWidth, uint32_t windowHeight)
+{
+	// minimized
+	if (0 == windowWidth
+	||  0 == windowHeight)
+	{
+		return;
+	}
+
+	m_windowWidth = windowWidth;
+	m_windowHeight = windowHeight;
+	gbufferResize(m_gbuffer, uint16_t(windowWidth), uint16_t(windowHeight) );
+	for (uint32_t ii = 0; ii < TerrainView::kMaxViews; ++ii)
+	{
+		bgfx::setViewFrameBuffer(bgfx::ViewId(kGBufferView + ii), m_gbuffer.m_frameBuffer);
+	}
+}
+
+void App::addCursorPosition(int32_t _x, int32_t _y)
+{
+	// a full trail keeps its start, the end always follows the cursor
+	if (m_numCursorTrail == s_maxCursorTrail)
+	{
+		--m_numCursorTrail;
+	}
+
+	m_cursorTrail[m_numCursorTrail][0] = float(_x);
+	m_cursorTrail[m_numCursorTrail][1] = float(_y);
+	++m_numCursorTrail;
+}
+
+bool App::beginBatch(const char* _posesPath, const char* _outDir, uint32_t _numInFlight, uint32_t _settleFrames)
+{
+	if (!batchCreate(m_batch, _posesPath, _outDir, m_windowWidth, m_windowHeight, _numInFlight) )
+	{
+		batchDestroy(m_batch);
+		return false;
+	}
+
+	// one full resolution camera without editor overlays
+	m_batchMode = true;
+	m_batchSettleFrames = bx::max(_settleFrames, 1u);
+	m_viewLayout = ViewLayout::Single;
+	m_dynamicResolution = false;
+	m_useBrushDecal = false;
+
+	// resolve writes color only, alpha of the images is cleared opaque
+	bgfx::setViewFrameBuffer(kResolveView, m_batch.m_target);
+	bgfx::setViewClear(kResolveView, BGFX_CLEAR_COLOR, 0x000000ff);
+	bgfx::setViewName(kBatchView, "Batch copy");
+	return true;
+}
+
+// Poses start once shaders and the first height readback are in. A pose is drawn for
+// m_batchSettleFrames frames and the last of them is captured.
+bool App::updateBatchPose()
+{
+	if (!m_batchReady)
+	{
+		m_batchReady = m_heightfieldReady
+			&& 0 == assetLoaderGetStats().m_numPending
+			;
+		if (!m_batchReady)
+		{
+			return false;
+		}
+	}
+
+	if (NULL == m_batchPose)
+	{
+		m_batchPose = batchBeginPose(m_batch);
+		if (NULL == m_batchPose)
+		{
+			return false;
+		}
+
+		if (0.0f == m_batchPose->m_extent)
+		{
+			cameraSetPosition(m_batchPose->m_position);
+			cameraSetHorizontalAngle(m_batchPose->m_yaw);
+			cameraSetVerticalAngle(m_batchPose->m_pitch);
+		}
+		else
+		{
+			// shadows and scatter follow the camera, it hovers over the middle of the tile
+			float minHeight;
+			float maxHeight;
+			heightfieldGetRange(m_heightfield, minHeight, maxHeight);
+			const float halfExtent = m_batchPose->m_extent * 0.5f;
+			cameraSetPosition({ m_batchPose->m_position.x + halfExtent, maxHeight, m_batchPose->m_position.z + halfExtent });
+			cameraSetVerticalAngle(-bx::kPiHalf);
+		}
+
+		// LOD of the previous pose would take frames to merge and split
+		quadTreeReset(m_quadTree);
+		m_batchFrame = 0;
+	}
+
+	return ++m_batchFrame == m_batchSettleFrames;
+}
+
+bool App::pickHeightfield(float _u, float _v, const float* _invViewProj, RayHit& _outHit)
+{
+	// picking ray through cursor from near to far plane
+	const float ndcX = 2.0f * _u - 1.0f;
+	const float ndcY = 1.0f - 2.0f * _v;
+	const bx::Vec3 rayStart = bx::mulH({ ndcX, ndcY, bgfx::getCaps()->homogeneousDepth ? -1.0f : 0.0f }, _invViewProj);
+	const bx::Vec3 rayEnd   = bx::mulH({ ndcX, ndcY, 1.0f }, _invViewProj);
+	const bx::Vec3 rayDir   = bx::sub(rayEnd, rayStart);
+	return terrainRaycast(m_heightfield, rayStart, bx::normalize(rayDir), bx::length(rayDir), _outHit);
+}
+
 void App::handleKey(KeyEvent* keyEvent)
 {
 
@@ -1232,82 +1648,720 @@ void App::createTerrainMesh()
 	mem = bgfx::makeRef(&m_terrain.m_indices[0], sizeof(uint16_t) * m_terrain.m_indexCount);
 	m_terrainIbh = bgfx::createIndexBuffer(mem);
 
+	// same vertices, so gl_VertexID based stitching still finds patch edges
+	for (uint32_t ii = 0; ii < BX_COUNTOF(m_terrainCoarseIbh); ++ii)
+	{
+		const uint16_t step = uint16_t(2 << ii);
+		const uint16_t numQuads = s_terrainSize / step;
+		mem = bgfx::alloc(sizeof(uint16_t) * numQuads * numQuads * 6);
+		uint16_t* indices = (uint16_t*)mem->data;
+		for (uint16_t y = 0; y < s_terrainSize; y += step)
+		{
+			for (uint16_t x = 0; x < s_terrainSize; x += step)
+			{
+				const uint16_t v00 = y * (s_terrainSize + 1) + x;
+				const uint16_t v10 = v00 + step;
+				const uint16_t v01 = v00 + step * (s_terrainSize + 1);
+				const uint16_t v11 = v01 + step;
+				*indices++ = v10;
+				*indices++ = v01;
+				*indices++ = v00;
+				*indices++ = v11;
+				*indices++ = v01;
+				*indices++ = v10;
+			}
+		}
+		m_terrainCoarseIbh[ii] = bgfx::createIndexBuffer(mem);
+	}
+
 
 	if (!bgfx::isValid(m_heightTexture))
 	{
-		m_heightTexture = bgfx::createTexture2D((uint16_t)s_heightMapSize, (uint16_t)s_heightMapSize, false, 1, bgfx::TextureFormat::TextureFormat::R16, 0 | BGFX_TEXTURE_COMPUTE_WRITE |  BGFX_SAMPLER_POINT | BGFX_SAMPLER_UVW_CLAMP);
+		m_heightTexture = bgfx::createTexture2D((uint16_t)s_heightMapSize, (uint16_t)s_heightMapSize, true, 1, bgfx::TextureFormat::TextureFormat::R16, 0 | BGFX_TEXTURE_COMPUTE_WRITE |  BGFX_SAMPLER_POINT | BGFX_SAMPLER_UVW_CLAMP);
 	}
 
-	//mem = bgfx::makeRef(&m_terrain.m_heightMap[0], sizeof(uint16_t) * s_heightMapSize * s_heightMapSize);
-	//bgfx::updateTexture2D(m_heightTexture, 0, 0, 0, 0, (uint16_t)s_heightMapSize, (uint16_t)s_heightMapSize, mem);
-	
+	// coarse patches sample filtered mips, built on the CPU once and kept up to date on the GPU
+	const TileRect full = { 0, 0, int32_t(s_heightMapSize), int32_t(s_heightMapSize) };
+	heightMipsUpdate(m_heightMips, m_terrain.m_heightMap, full);
+	heightMipsUpload(m_heightMips, m_heightTexture, m_terrain.m_heightMap, full);
+
+	// normals are derived from the height map once and cached, only tiles touched by edits are recomputed
+	if (!bgfx::isValid(m_normalTexture))
+	{
+		m_normalTexture = bgfx::createTexture2D((uint16_t)s_heightMapSize, (uint16_t)s_heightMapSize, false, 1, bgfx::TextureFormat::RG8, 0 | BGFX_TEXTURE_COMPUTE_WRITE | BGFX_SAMPLER_UVW_CLAMP);
+	}
+	normalCacheCreate(m_normalCache, s_heightMapSize, s_heightMapSize, s_heightTileSize);
+	splatMapCreate(m_splatMap, s_heightMapSize, s_heightMapSize, s_heightTileSize);
 }
 
-bool App::update()
+// Every node spreads the whole height map over its 8x8 patches, so patches of all LODs step
+// over the same number of texels between vertices. Mip follows that step, and the coarser
+// grid of shadow cascades drawn with _lodBias, never the LOD itself, so vertices shared with
+// a neighbour read the same height.
+static float getHeightMip(uint32_t _lodBias)
 {
-	int64_t now = bx::getHPCounter();
-	static int64_t last = now;
-	const int64_t frameTime = now - last;
-	last = now;
-	const double freq = double(bx::getHPFrequency());
-	const float deltaTime = float(frameTime / freq);
+	// one mip for all patches, vertices shared by patches of different LOD read the same heights
+	const float texelsPerCell = s_finestPatchSize / s_heightMapWorldSize * float(s_heightMapSize) / float(s_terrainSize);
+	return bx::max(0.0f, bx::log2(texelsPerCell) + float(_lodBias) );
+}
 
-	uint32_t width = m_windowWidth;
-	uint32_t height = m_windowHeight;
-	const bgfx::Caps* caps = bgfx::getCaps();
+static bool patchCastsShadow(const ShadowCascades& _shadows, const ShadowCascade& _cascade, const InstanceData& _patch)
+{
+	const bx::Vec3 patchMin = { _patch.worldPosX, _shadows.m_minHeight, _patch.worldPosY };
+	const bx::Vec3 patchMax = { _patch.worldPosX + _patch.worldSize, _shadows.m_maxHeight, _patch.worldPosY + _patch.worldSize };
+	return shadowCascadeOverlaps(_cascade, patchMin, patchMax);
+}
 
-	imguiBeginFrame(s_mouseState.m_mx
-		, s_mouseState.m_my
-		, (s_mouseState.m_buttons[0] ? IMGUI_MBUT_LEFT : 0)
-		| (s_mouseState.m_buttons[1] ? IMGUI_MBUT_RIGHT : 0)
-		| (s_mouseState.m_buttons[2] ? IMGUI_MBUT_MIDDLE : 0)
-		, s_mouseState.m_mz, width, height);
+void App::submitShadowCascades(uint32_t _cascadeMask)
+{
+	if (!bgfx::isValid(m_terrainShadowProgram) )
+	{
+		return;
+	}
 
-	ImGui::SetNextWindowPos(
-		ImVec2(width - width / 5.0f - 10.0f, 10.0f)
-		, ImGuiCond_FirstUseEver
-	);
-	ImGui::SetNextWindowSize(
-		ImVec2(width / 5.0f, height / 3.0f)
-		, ImGuiCond_FirstUseEver
-	);
-	ImGui::Begin("Settings"
-		, NULL
-		, 0
-	);
-	ImGui::Checkbox("Render grid", &m_renderGrid);
-	ImGui::SliderFloat("Brush size", &m_brushSize, 1, 20);
+	for (uint32_t ii = 0; ii < ShadowCascades::kNumCascades; ++ii)
+	{
+		if (0 == (_cascadeMask & (1 << ii) ) )
+		{
+			continue;
+		}
 
-	const bgfx::Stats* stats = bgfx::getStats();
-	const double toMsCpu = 1000.0 / stats->cpuTimerFreq;
-	const double toMsGpu = 1000.0 / stats->gpuTimerFreq;
-	const double frameMs = double(stats->cpuTimeFrame)*toMsCpu;
+		// patches come from this frame's quadtree, only the ones casting into the cascade are drawn
+		const ShadowCascade& cascade = m_shadows.m_cascades[ii];
+		uint32_t numPatches = 0;
+		for (uint32_t jj = 0; jj < s_numPatches; ++jj)
+		{
+			numPatches += patchCastsShadow(m_shadows, cascade, s_patches[jj]);
+		}
 
-	s_frameTime.pushSample(float(frameMs));
+		const uint16_t instanceStride = sizeof(InstanceData);
+		if (0 == numPatches
+		||  numPatches != bgfx::getAvailInstanceDataBuffer(numPatches, instanceStride) )
+		{
+			continue;
+		}
 
-	char frameTextOverlay[256];
-	bx::snprintf(frameTextOverlay, BX_COUNTOF(frameTextOverlay), "%s%.3fms, %s%.3fms\nAvg: %.3fms, %.1f FPS"
-		, ICON_FA_ARROW_DOWN
-		, s_frameTime.m_min
-		, ICON_FA_ARROW_UP
-		, s_frameTime.m_max
-		, s_frameTime.m_avg
-		, 1000.0f / s_frameTime.m_avg
-	);
+		bgfx::InstanceDataBuffer idb;
+		bgfx::allocInstanceDataBuffer(&idb, numPatches, instanceStride);
+		InstanceData* patches = (InstanceData*)idb.data;
+		for (uint32_t jj = 0; jj < s_numPatches; ++jj)
+		{
+			if (patchCastsShadow(m_shadows, cascade, s_patches[jj]) )
+			{
+				*patches++ = s_patches[jj];
+			}
+		}
 
-	ImGui::PushStyleColor(ImGuiCol_PlotHistogram, ImColor(0.0f, 0.5f, 0.15f, 1.0f).Value);
-	ImGui::PlotHistogram("Frame"
-		, s_frameTime.m_values
-		, SampleData::kNumSamples
-		, s_frameTime.m_offset
-		, frameTextOverlay
-		, 0.0f
-		, 60.0f
-		, ImVec2(0.0f, 45.0f)
-	);
-	ImGui::PopStyleColor();
+		float heightMapParams[4];
+		heightMapParams[0] = s_heightScale;
+		heightMapParams[1] = 0.0f;
+		heightMapParams[2] = 1.0f / s_heightMapWorldSize;
+		heightMapParams[3] = getHeightMip(cascade.m_lodBias);
 
-	ImGui::End();
+		bgfx::setInstanceDataBuffer(&idb);
+		bgfx::setVertexBuffer(0, m_terrainVbh);
+		bgfx::setIndexBuffer(0 == cascade.m_lodBias ? m_terrainIbh : m_terrainCoarseIbh[cascade.m_lodBias - 1]);
+		bgfx::setTexture(0, s_heightTexture, m_heightTexture, BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP);
+		bgfx::setUniform(u_heightMapParams, heightMapParams);
+		setLodMorphUniform();
+		bgfx::setState(0
+			| BGFX_STATE_WRITE_Z
+			| BGFX_STATE_DEPTH_TEST_LESS
+			);
+		bgfx::submit(bgfx::ViewId(kShadowView + ii), m_terrainShadowProgram);
+	}
+}
+
+void App::setLodMorphUniform()
+{
+	float lodMorphParams[12];
+	lodMorphParams[0] = s_lodMorphStart;
+	lodMorphParams[1] = m_useGeomorphing ? 1.0f : 0.0f;
+	lodMorphParams[2] = 0.0f;
+	lodMorphParams[3] = 0.0f;
+
+	// patches morph by the nearest camera, same as the quadtree split them
+	for (uint32_t ii = 0; ii < TerrainView::kMaxViews; ++ii)
+	{
+		const bx::Vec3& position = m_lodPositions[ii < m_numLodPositions ? ii : 0];
+		lodMorphParams[4 + ii * 2 + 0] = position.x;
+		lodMorphParams[4 + ii * 2 + 1] = position.z;
+	}
+	bgfx::setUniform(u_lodMorphParams, lodMorphParams, 3);
+}
+
+void App::setupViews(uint32_t _width, uint32_t _height, bool _homogeneousDepth)
+{
+	float rects[TerrainView::kMaxViews * 4];
+	m_numViews = viewLayoutGetRects(m_viewLayout, float(_width) / float(_height), rects);
+
+	float cameraView[16];
+	cameraGetViewMtx(cameraView);
+	const bx::Vec3 cameraPosition = cameraGetPosition();
+	const float center = s_heightMapWorldSize * 0.5f;
+
+	for (uint32_t ii = 0; ii < m_numViews; ++ii)
+	{
+		const float* rect = &rects[ii * 4];
+		const float aspect = (rect[2] * float(_width) ) / (rect[3] * float(_height) );
+		TerrainView& terrainView = m_views[ii];
+
+		float minHeight = 0.0f;
+		float maxHeight = s_heightScale * 65535.0f;
+		if (m_heightfieldReady)
+		{
+			heightfieldGetRange(m_heightfield, minHeight, maxHeight);
+		}
+
+		float view[16];
+		float proj[16];
+		if (ViewLayout::Overview == m_viewLayout
+		&&  1 == ii)
+		{
+			// whole map from above, too far to have a say in LOD
+			const float size = s_heightMapWorldSize * 1.05f;
+			viewSetupTopDown(terrainView, rect, center - size * 0.5f, center - size * 0.5f, size, aspect, minHeight, maxHeight, _homogeneousDepth, view, proj);
+			terrainView.m_selectsLod = false;
+		}
+		else if (NULL != m_batchPose
+		&&       0.0f != m_batchPose->m_extent)
+		{
+			// map tile, LOD refines around its middle
+			viewSetupTopDown(terrainView, rect, m_batchPose->m_position.x, m_batchPose->m_position.z, m_batchPose->m_extent, aspect, minHeight, maxHeight, _homogeneousDepth, view, proj);
+			terrainView.m_selectsLod = true;
+		}
+		else
+		{
+			// other players follow the camera a quarter turn apart around the middle of the map
+			float toCenter[16];
+			float rotation[16];
+			float fromCenter[16];
+			float turn[16];
+			float invTurn[16];
+			bx::mtxTranslate(toCenter, -center, 0.0f, -center);
+			bx::mtxRotateY(rotation, float(ii) * bx::kPiHalf);
+			bx::mtxTranslate(fromCenter, center, 0.0f, center);
+			bx::mtxMul(invTurn, toCenter, rotation);
+			bx::mtxMul(turn, invTurn, fromCenter);
+			bx::mtxInverse(invTurn, turn);
+			bx::mtxMul(view, invTurn, cameraView);
+
+			bx::mtxProj(proj, 60.0f, aspect, 0.1f, 2000.0f, _homogeneousDepth);
+			viewSetup(terrainView, rect, view, proj, bx::mul(cameraPosition, turn), _homogeneousDepth);
+			terrainView.m_selectsLod = true;
+		}
+
+		// scene covers the top left corner of the G-buffer at dynamic resolution, every view
+		// its own part of it
+		const uint16_t x0 = uint16_t(rect[0] * m_gbuffer.m_viewWidth + 0.5f);
+		const uint16_t y0 = uint16_t(rect[1] * m_gbuffer.m_viewHeight + 0.5f);
+		const uint16_t x1 = uint16_t( (rect[0] + rect[2]) * m_gbuffer.m_viewWidth + 0.5f);
+		const uint16_t y1 = uint16_t( (rect[1] + rect[3]) * m_gbuffer.m_viewHeight + 0.5f);
+		const bgfx::ViewId viewId = bgfx::ViewId(kGBufferView + ii);
+		bgfx::setViewTransform(viewId, view, proj);
+		bgfx::setViewRect(viewId, x0, y0, uint16_t(x1 - x0), uint16_t(y1 - y0) );
+		bgfx::setViewClear(viewId
+			, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH
+			, 0x303030ff
+			, 1.0f
+			, 0
+			);
+
+		// cleared even if nothing is drawn into it
+		bgfx::touch(viewId);
+	}
+}
+
+void App::submitTerrainView(uint32_t _viewIndex)
+{
+	const TerrainView& view = m_views[_viewIndex];
+	uint32_t numInstances = view.m_numPatches;
+	uint16_t instanceStride = sizeof(InstanceData);
+	if (0 != numInstances
+	&&  numInstances == bgfx::getAvailInstanceDataBuffer(numInstances, instanceStride))
+	{
+		bgfx::InstanceDataBuffer idb;
+		bgfx::allocInstanceDataBuffer(&idb, numInstances, instanceStride);
+
+		InstanceData* data = (InstanceData*)idb.data;
+		for (uint32_t ii = 0; ii < numInstances; ++ii)
+		{
+			data[ii] = s_patches[view.m_patches[ii] ];
+		}
+
+
+		float transform[16];
+		bx::mtxSRT(transform, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+		bgfx::setTransform(transform);
+
+		// Set instance data buffer.
+		bgfx::setInstanceDataBuffer(&idb);
+		bgfx::setVertexBuffer(0, m_terrainVbh);
+		bgfx::setIndexBuffer(m_terrainIbh);
+		bgfx::setTexture(0, s_heightTexture, m_heightTexture, BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP);
+		bgfx::setTexture(1, s_materials, m_materials.m_texture);
+		bgfx::setTexture(2, s_normalTexture, m_normalTexture);
+		bgfx::setTexture(3, s_splatIndices, m_splatMap.m_indexTexture);
+		bgfx::setTexture(4, s_splatWeights, m_splatMap.m_weightTexture);
+		bgfx::setTexture(5, s_virtualAtlas, m_virtualTexture.m_atlas);
+		bgfx::setUniform(u_sunDirection, m_sunDirection);
+		{
+			// horizon shadows take over where the last active cascade thins out
+			const ShadowCascade& lastCascade = m_shadows.m_cascades[ShadowCascades::kNumCascades - 2];
+			horizonSetUniforms(m_horizon, 6, m_sunDirection, view.m_position
+				, lastCascade.m_extent * 0.25f
+				, lastCascade.m_extent * 0.375f
+				, m_useHorizonShadows
+				);
+		}
+		float virtualParams[4];
+		virtualParams[0] = (float)VirtualTextureCache::kPagesPerRow;
+		virtualParams[1] = (float)VirtualTextureCache::kPageSize;
+		virtualParams[2] = (float)(VirtualTextureCache::kPageSize * VirtualTextureCache::kPagesPerRow);
+		virtualParams[3] = 0.0f;
+		bgfx::setUniform(u_virtualParams, virtualParams);
+		//bgfx::setState(BGFX_STATE_DEFAULT| BGFX_STATE_PT_LINES);
+		float val[4];
+		val[0] = 0.1f; // height map scale
+		val[1] = 0.0f; // sea level
+		val[2] = 1.0f / s_heightMapWorldSize; // height map uv per meter
+		val[3] = getHeightMip(0); // mip matching vertex spacing
+		bgfx::setUniform(u_heightMapParams, val);
+		setLodMorphUniform();
+		val[0] = (float)m_renderGrid;
+		val[1] = m_brush.m_worldPosition.x;
+		val[2] = m_brush.m_worldPosition.y;
+		val[3] = m_brush.m_worldPosition.z;
+
+		bgfx::setUniform(u_renderParams, val);
+		gbufferSetUniforms(m_gbuffer, false);
+
+		bgfx::submit(bgfx::ViewId(kGBufferView + _viewIndex), m_terrainHeightTextureProgram);
+	}
+}
+
+bool App::isBoxVisible(float _x, float _z, float _size)
+{
+	float minHeight;
+	float maxHeight;
+	heightfieldGetRectRange(m_heightfield, _x, _z, _x + _size, _z + _size, minHeight, maxHeight);
+
+	const bx::Vec3 boxMin = { _x, minHeight, _z };
+	const bx::Vec3 boxMax = { _x + _size, maxHeight, _z + _size };
+	return OcclusionResult::Visible == occlusionTest(m_occlusion, boxMin, boxMax);
+}
+
+uint32_t App::cullOccludedPatches(TerrainView& _view)
+{
+	m_occlusion.m_numTested = 0;
+	m_occlusion.m_numOutside = 0;
+	m_occlusion.m_numOccluded = 0;
+	m_occlusion.m_numTriangles = 0;
+	m_occlusion.m_setupMs = 0.0f;
+	m_occlusion.m_rasterMs = 0.0f;
+
+	// Occluders stand below the surface only while looking at it from above, and the CPU copy
+	// must match the heights drawn, not lag behind a stroke. Map tiles look straight down and
+	// have nothing behind the surface.
+	const bx::Vec3 eye = _view.m_position;
+	if (!m_useOcclusionCulling
+	||  (NULL != m_batchPose && 0.0f != m_batchPose->m_extent)
+	||  !m_heightfieldReady
+	||  m_heightfieldDirty
+	||  0 != m_heightReadbackFrame
+	||  eye.x < 0.0f || eye.x > s_heightMapWorldSize
+	||  eye.z < 0.0f || eye.z > s_heightMapWorldSize)
+	{
+		return _view.m_numPatches;
+	}
+
+	const float eyeXZ[2] = { eye.x, eye.z };
+	float groundHeight;
+	sampleHeights(m_heightfield, eyeXZ, &groundHeight, 1);
+	if (eye.y < groundHeight)
+	{
+		return _view.m_numPatches;
+	}
+
+	occlusionBegin(m_occlusion, _view.m_viewProj);
+	occlusionRasterizeHeightfield(m_occlusion, m_heightfield);
+	occlusionFlush(m_occlusion);
+
+	// Hidden patches drop out of the view's list, shadow cascades still draw all of them. The
+	// list keeps patches of a node together, a hidden node skips testing the rest of them.
+	const uint32_t patchesPerNode = s_maxPatchesPerSectorRow * s_maxPatchesPerSectorCol;
+	uint32_t numVisible = 0;
+	uint32_t nodeIndex = UINT32_MAX;
+	bool nodeVisible = false;
+	for (uint32_t ii = 0; ii < _view.m_numPatches; ++ii)
+	{
+		const uint32_t patchIndex = _view.m_patches[ii];
+		if (nodeIndex != patchIndex / patchesPerNode)
+		{
+			nodeIndex = patchIndex / patchesPerNode;
+			const QuadTreeNode* node = s_nodesToRender[nodeIndex];
+			nodeVisible = isBoxVisible(node->x, node->z, float(s_sectorSizeInMeters) * (1 << node->lod) );
+		}
+
+		const InstanceData& patch = s_patches[patchIndex];
+		if (nodeVisible
+		&&  isBoxVisible(patch.worldPosX, patch.worldPosY, patch.worldSize) )
+		{
+			_view.m_patches[numVisible++] = patchIndex;
+		}
+	}
+
+	_view.m_numPatches = numVisible;
+	return numVisible;
+}
+
+void App::dispatchNormals(bgfx::ViewId _view, const TileRect& _rect, bool _brushCentered)
+{
+	const float texelSize = s_heightMapWorldSize / (float)s_heightMapSize;
+	const uint32_t width = uint32_t(_rect.m_x1 - _rect.m_x0);
+	const uint32_t height = uint32_t(_rect.m_y1 - _rect.m_y0);
+
+	float params[8];
+	params[0] = (float)_rect.m_x0;
+	params[1] = (float)_rect.m_y0;
+	params[2] = _brushCentered ? 1.0f : 0.0f;
+	params[3] = (float)(width / 2);
+	// image loads return normalized height
+	params[4] = s_heightScale * 65536.0f / (2.0f * texelSize);
+	params[5] = s_heightMapWorldSize;
+	params[6] = 0.0f;
+	params[7] = 0.0f;
+	bgfx::setUniform(u_normalParams, params, 2);
+
+	bgfx::setImage(0, m_heightTexture, 0, bgfx::Access::Read, bgfx::TextureFormat::R16);
+	bgfx::setImage(1, m_normalTexture, 0, bgfx::Access::Write, bgfx::TextureFormat::RG8);
+	bgfx::setBuffer(2, m_mouseBufferHandle, bgfx::Access::Read);
+	bgfx::dispatch(_view, m_programComputeUpdateNormals, (width + 7) / 8, (height + 7) / 8);
+}
+
+void App::applyLoadedHeights()
+{
+	// everything derived from heights is rebuilt, edits not saved before the load are gone
+	const TileRect full = { 0, 0, int32_t(s_heightMapSize), int32_t(s_heightMapSize) };
+	heightMipsUpdate(m_heightMips, m_terrain.m_heightMap, full);
+	heightMipsUpload(m_heightMips, m_heightTexture, m_terrain.m_heightMap, full);
+	heightfieldUpdate(m_heightfield, m_terrain.m_heightMap, full);
+	scatterInvalidate(m_scatter, full);
+	normalCacheInvalidate(m_normalCache, full);
+	horizonCacheInvalidate(m_horizon, full);
+	shadowInvalidate(m_shadows, 0.0f, 0.0f, s_heightMapWorldSize, s_heightMapWorldSize);
+	m_horizonDirty = { 0, 0, 0, 0 };
+	m_heightfieldDirty = false;
+	m_heightfieldReady = true;
+	m_loadPending = false;
+}
+
+void App::documentLoadedCb(const uint16_t* _heights, void* _userData)
+{
+	App* app = (App*)_userData;
+	if (NULL != _heights)
+	{
+		bx::memCopy(app->m_terrain.m_heightMap, _heights, sizeof(uint16_t) * s_heightMapSize * s_heightMapSize);
+		app->m_loadPending = true;
+	}
+}
+
+bool App::update()
+{
+	int64_t now = bx::getHPCounter();
+	static int64_t last = now;
+	const int64_t frameTime = now - last;
+	last = now;
+	const double freq = double(bx::getHPFrequency());
+	const float deltaTime = float(frameTime / freq);
+
+	uint32_t width = m_windowWidth;
+	uint32_t height = m_windowHeight;
+	const bgfx::Caps* caps = bgfx::getCaps();
+
+	assetLoaderUpdate();
+	frameBudgetBeginFrame(m_budget);
+	const bool batchCapture = m_batchMode && updateBatchPose();
+
+	imguiBeginFrame(s_mouseState.m_mx
+		, s_mouseState.m_my
+		, (s_mouseState.m_buttons[0] ? IMGUI_MBUT_LEFT : 0)
+		| (s_mouseState.m_buttons[1] ? IMGUI_MBUT_RIGHT : 0)
+		| (s_mouseState.m_buttons[2] ? IMGUI_MBUT_MIDDLE : 0)
+		, s_mouseState.m_mz, width, height);
+
+	ImGui::SetNextWindowPos(
+		ImVec2(width - width / 5.0f - 10.0f, 10.0f)
+		, ImGuiCond_FirstUseEver
+	);
+	ImGui::SetNextWindowSize(
+		ImVec2(width / 5.0f, height / 3.0f)
+		, ImGuiCond_FirstUseEver
+	);
+	ImGui::Begin("Settings"
+		, NULL
+		, 0
+	);
+	ImGui::Checkbox("Render grid", &m_renderGrid);
+	ImGui::SliderFloat("Brush size", &m_brushSize, 1, 20);
+	ImGui::Checkbox("Virtual texture", &m_useVirtualTexture);
+	ImGui::SliderFloat("Virtual texture distance", &m_virtualTextureDistance, 0, 512);
+	ImGui::Text("Virtual pages: %u requests, %u misses", m_virtualTexture.m_numRequests, m_virtualTexture.m_numMisses);
+	ImGui::Text("Picking: %s, %.2fus", m_heightfieldReady ? (m_mouseHit ? "hit" : "miss") : "GPU", m_pickTimeUs);
+
+	const AssetLoaderStats& loaderStats = assetLoaderGetStats();
+	ImGui::Text("Assets: %u loaded, %u pending, %u failed", loaderStats.m_numLoaded, loaderStats.m_numPending, loaderStats.m_numFailed);
+	ImGui::Text("Load: io %.1fms, decode %.1fms, create %.1fms", loaderStats.m_ioMs, loaderStats.m_decodeMs, loaderStats.m_createMs);
+	ImGui::Text("Startup %.1fms, slowest %s %.1fms", loaderStats.m_startupMs, loaderStats.m_slowest, loaderStats.m_slowestMs);
+
+	if (ImGui::CollapsingHeader("Document") )
+	{
+		ImGui::Text("%s, %u saves, %u tiles edited", m_document.m_path, m_document.m_numSaves, m_document.m_numDirty);
+		if (ImGui::Button("Save") )
+		{
+			m_saveRequested = true;
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Load")
+		&&  documentLoad(m_document, documentLoadedCb, this) )
+		{
+			m_saveRequested = false;
+		}
+
+		if (documentIsBusy(m_document) || m_saveRequested || m_loadPending)
+		{
+			ImGui::Text("Busy");
+		}
+		else if (m_document.m_failed)
+		{
+			ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Last save or load failed");
+		}
+		else
+		{
+			ImGui::Text("Last: %u tiles, %.1fKB, copy %.2fms, io %.1fms"
+				, m_document.m_numTiles
+				, m_document.m_numBytes / 1024.0f
+				, m_document.m_copyMs
+				, m_document.m_ioMs
+				);
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Memory") )
+	{
+		MemoryStats memoryStats;
+		memoryGetStats(memoryStats);
+		for (uint32_t ii = 0; ii < MemoryCategory::Count; ++ii)
+		{
+			const bool overBudget = 0 != memoryStats.m_budget[ii] && memoryStats.m_allocated[ii] > memoryStats.m_budget[ii];
+			ImGui::TextColored(overBudget ? ImVec4(1.0f, 0.3f, 0.3f, 1.0f) : ImVec4(1.0f, 1.0f, 1.0f, 1.0f)
+				, "%-10s %8.1fKB, peak %8.1fKB, %u allocs"
+				, getName(MemoryCategory::Enum(ii) )
+				, double(memoryStats.m_allocated[ii]) / 1024.0
+				, double(memoryStats.m_peak[ii]) / 1024.0
+				, memoryStats.m_numAllocs[ii]
+				);
+		}
+		ImGui::Text("Frame arena %.1f of %.1fKB, peak %.1fKB"
+			, s_frameArena.m_offset / 1024.0f
+			, s_frameArena.m_size / 1024.0f
+			, s_frameArena.m_peak / 1024.0f
+			);
+	}
+
+	if (ImGui::CollapsingHeader("CPU budget") )
+	{
+		ImGui::SliderFloat("Budget us", &m_budget.m_budgetUs, 250.0f, 8000.0f);
+		float usedUs = 0.0f;
+		for (uint32_t ii = 0; ii < BudgetTask::Count; ++ii)
+		{
+			usedUs += m_budget.m_lastUs[ii];
+		}
+		ImGui::Text("Used %.0fus of %.0fus, peak %.0fus", usedUs, m_budget.m_budgetUs, frameBudgetGetPeakUs(m_budget) );
+		for (uint32_t ii = 0; ii < BudgetTask::Count; ++ii)
+		{
+			const bool deferred = 0 != m_budget.m_lastDeferred[ii];
+			ImGui::TextColored(deferred ? ImVec4(1.0f, 0.8f, 0.3f, 1.0f) : ImVec4(1.0f, 1.0f, 1.0f, 1.0f)
+				, "%-16s %7.0fus, %u items, %u deferred"
+				, getName(BudgetTask::Enum(ii) )
+				, m_budget.m_lastUs[ii]
+				, m_budget.m_lastItems[ii]
+				, m_budget.m_lastDeferred[ii]
+				);
+		}
+	}
+
+	const bgfx::Stats* stats = bgfx::getStats();
+	const double toMsCpu = 1000.0 / stats->cpuTimerFreq;
+	const double toMsGpu = 1000.0 / stats->gpuTimerFreq;
+	const double frameMs = double(stats->cpuTimeFrame)*toMsCpu;
+
+	s_frameTime.pushSample(float(frameMs));
+
+	char frameTextOverlay[256];
+	bx::snprintf(frameTextOverlay, BX_COUNTOF(frameTextOverlay), "%s%.3fms, %s%.3fms\nAvg: %.3fms, %.1f FPS"
+		, ICON_FA_ARROW_DOWN
+		, s_frameTime.m_min
+		, ICON_FA_ARROW_UP
+		, s_frameTime.m_max
+		, s_frameTime.m_avg
+		, 1000.0f / s_frameTime.m_avg
+	);
+
+	ImGui::PushStyleColor(ImGuiCol_PlotHistogram, ImColor(0.0f, 0.5f, 0.15f, 1.0f).Value);
+	ImGui::PlotHistogram("Frame"
+		, s_frameTime.m_values
+		, SampleData::kNumSamples
+		, s_frameTime.m_offset
+		, frameTextOverlay
+		, 0.0f
+		, 60.0f
+		, ImVec2(0.0f, 45.0f)
+	);
+	ImGui::PopStyleColor();
+
+	double scatterCullMs = 0.0;
+	double shadowMs = 0.0;
+	double gbufferMs = 0.0;
+	double resolveMs = 0.0;
+	for (uint16_t ii = 0; ii < stats->numViews; ++ii)
+	{
+		const bgfx::ViewStats& viewStats = stats->viewStats[ii];
+		const double viewMs = double(viewStats.gpuTimeEnd - viewStats.gpuTimeBegin) * toMsGpu;
+		if (kScatterCullView == viewStats.view)
+		{
+			scatterCullMs = viewMs;
+		}
+		else if (kShadowView <= viewStats.view && viewStats.view < kGBufferView)
+		{
+			shadowMs += viewMs;
+		}
+		else if (kGBufferView <= viewStats.view && viewStats.view < kMousePosView)
+		{
+			gbufferMs += viewMs;
+		}
+		else if (kResolveView == viewStats.view)
+		{
+			resolveMs = viewMs;
+		}
+	}
+	ImGui::Text("Scatter: %u instances, %u cells generated in %.2fms", m_scatter.m_numResident, m_scatter.m_numGenerated, m_scatter.m_generateMs);
+	ImGui::Text("Scatter cull: %.3fms GPU", scatterCullMs);
+	ImGui::Text("Shadows: %u cascades drawn, %.3fms GPU, G-buffer %.3fms", m_shadows.m_numRendered, shadowMs, gbufferMs);
+	if (ImGui::Button("Check normals") )
+	{
+		m_normalCheckRequested = true;
+	}
+	ImGui::SameLine();
+	if (m_normalCheckRequested || 0 != m_normalReadbackFrame)
+	{
+		ImGui::Text("Waiting for edits to settle");
+	}
+	else if (0 <= m_normalMaxError)
+	{
+		ImGui::Text("GPU normals %s CPU reference, max error %d", 1 >= m_normalMaxError ? "match" : "DON'T MATCH", m_normalMaxError);
+	}
+	ImGui::Checkbox("Horizon shadows", &m_useHorizonShadows);
+	ImGui::Text("Horizon: %u tiles computed, %u pending, last batch %.2fms", m_horizon.m_numComputed, m_horizon.m_numPending, m_horizon.m_computeMs);
+	ImGui::Text("Disk cache: %u of %u tiles read, %u written, %u replaced", m_horizon.m_numCached, m_horizon.m_numComputed, m_diskCache.m_numWrites, m_diskCache.m_numRemoved);
+	ImGui::Checkbox("Occlusion culling", &m_useOcclusionCulling);
+	ImGui::Checkbox("Geomorphing", &m_useGeomorphing);
+	ImGui::Text("LOD: %u nodes, %u split, %u merged, %u held back"
+		, m_quadTree.m_numNodes
+		, m_quadTree.m_numSplits
+		, m_quadTree.m_numMerges
+		, m_quadTree.m_numDeferred
+		);
+	int32_t viewLayout = m_viewLayout;
+	ImGui::Combo("Views", &viewLayout, "Single\0Overview\0Split two\0Split four\0\0");
+	m_viewLayout = ViewLayout::Enum(viewLayout);
+	ImGui::Text("Views: %u, %u patches selected in %.3fms", m_numViews, s_numPatches, m_sharedLodMs);
+	for (uint32_t ii = 0; ii < m_numViews; ++ii)
+	{
+		ImGui::Text("  %u: %u patches in view, culled in %.3fms", ii, m_views[ii].m_numPatches, m_views[ii].m_cullMs);
+	}
+	ImGui::Text("Occlusion: %u of %u patches in view culled, %u of %u boxes off screen, %u occluded"
+		, m_numFrustumPatches - m_numVisiblePatches
+		, m_numFrustumPatches
+		, m_occlusion.m_numOutside
+		, m_occlusion.m_numTested
+		, m_occlusion.m_numOccluded
+		);
+	ImGui::Text("Occluders: %u triangles, setup %.3fms, raster %.3fms, %.1f Mtri/s"
+		, m_occlusion.m_numTriangles
+		, m_occlusion.m_setupMs
+		, m_occlusion.m_rasterMs
+		, occlusionGetTrianglesPerSecond(m_occlusion) * 1e-6
+		);
+
+	int32_t layout = m_gbufferLayout;
+	ImGui::Combo("G-buffer layout", &layout, "Lit\0Packed\0\0");
+	m_gbufferLayout = GBufferLayout::Enum(layout);
+	ImGui::Checkbox("Brush decal", &m_useBrushDecal);
+
+	const double gpuFrameMs = double(stats->gpuTimeEnd - stats->gpuTimeBegin) * toMsGpu;
+	ImGui::Checkbox("Dynamic resolution", &m_dynamicResolution);
+	ImGui::SliderFloat("GPU target ms", &m_gpuTargetMs, 4.0f, 33.0f);
+	if (m_dynamicResolution)
+	{
+		gbufferUpdateScale(m_gbuffer, float(gpuFrameMs), m_gpuTargetMs, s_minResolutionScale);
+	}
+	else
+	{
+		gbufferSetScale(m_gbuffer, 1.0f);
+	}
+	ImGui::Text("G-buffer %ux%u of %ux%u, GPU frame %.2fms"
+		, m_gbuffer.m_viewWidth
+		, m_gbuffer.m_viewHeight
+		, m_gbuffer.m_width
+		, m_gbuffer.m_height
+		, gpuFrameMs
+		);
+
+	// resolve reads every G-buffer byte once, its cost scales with pixels times layout size
+	if (0.0 < resolveMs)
+	{
+		uint32_t index = 0;
+		while (index < m_numResolveTimings
+		&&  (m_resolveTimings[index].m_width  != m_gbuffer.m_viewWidth
+		||   m_resolveTimings[index].m_height != m_gbuffer.m_viewHeight
+		||   m_resolveTimings[index].m_layout != m_gbuffer.m_layout) )
+		{
+			++index;
+		}
+
+		if (index == m_numResolveTimings)
+		{
+			// oldest entry makes room
+			if (BX_COUNTOF(m_resolveTimings) == m_numResolveTimings)
+			{
+				bx::memMove(&m_resolveTimings[0], &m_resolveTimings[1], sizeof(ResolveTiming) * (m_numResolveTimings - 1) );
+				--m_numResolveTimings;
+			}
+
+			index = m_numResolveTimings++;
+			m_resolveTimings[index] = { m_gbuffer.m_viewWidth, m_gbuffer.m_viewHeight, m_gbuffer.m_layout, float(resolveMs) };
+		}
+
+		ResolveTiming& timing = m_resolveTimings[index];
+		timing.m_ms = bx::lerp(timing.m_ms, float(resolveMs), 0.05f);
+	}
+
+	for (uint32_t ii = 0; ii < m_numResolveTimings; ++ii)
+	{
+		const ResolveTiming& timing = m_resolveTimings[ii];
+		const uint32_t numPixels = uint32_t(timing.m_width) * timing.m_height;
+		ImGui::Text("Resolve %ux%u %s: %.3fms GPU, %.2fns/px, G-buffer %.1fMB"
+			, timing.m_width
+			, timing.m_height
+			, getName(timing.m_layout)
+			, timing.m_ms
+			, timing.m_ms * 1e6f / float(numPixels)
+			, float(numPixels * gbufferBytesPerPixel(timing.m_layout) ) / (1024.0f * 1024.0f)
+			);
+	}
+
+	ImGui::End();
 
 	bool imguiMouseCapture = true;
 
@@ -1344,44 +2398,19 @@ bool App::update()
 	//}
 
 
-	//// This dummy draw call is here to make sure that view 0 is cleared if no other draw calls are submitted to view 0.
-	bgfx::touch(0);
-	// Set view 0 clear state.
-	bgfx::setViewClear(0
-		, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH
-		, 0x303030ff
-		, 1.0f
-		, 0
-	);
-
-	
-
-	
-	
-
-	const bx::Vec3 at = { 0.0f, 0.0f,   0.0f };
-	const bx::Vec3 eye = { 0.0f, 0.0f, -35.0f };
-
-	float projView[16];
-	float invProjView[16];
-
-	// Set view and projection matrix for view 0.
+	if (m_gbufferLayout != m_gbuffer.m_layout)
 	{
-		float view[16];
-		bx::mtxLookAt(view, eye, at);
-
-		float proj[16];
-		bx::mtxProj(proj, 60.0f, float(width) / float(height), 0.1f, 2000.0f, caps->homogeneousDepth);
-		cameraGetViewMtx(view);
-		bgfx::setViewTransform(0, view, proj);
+		gbufferSetLayout(m_gbuffer, m_gbufferLayout);
+		for (uint32_t ii = 0; ii < TerrainView::kMaxViews; ++ii)
+		{
+			bgfx::setViewFrameBuffer(bgfx::ViewId(kGBufferView + ii), m_gbuffer.m_frameBuffer);
+		}
+	}
 
+	setupViews(width, height, caps->homogeneousDepth);
 
-		bx::mtxMul(projView, view, proj);
-		bx::mtxInverse(invProjView, projView);
-
-		// Set view 0 default viewport.
-		bgfx::setViewRect(0, 0, 0, uint16_t(width), uint16_t(height));
-	}
+	// picking, brush and shadows follow the interactive camera
+	const float* invProjView = m_views[0].m_invWindowViewProj;
 
 	//mousebuff[0] = (float)s_mouseState.m_mx;
 	//mousebuff[1] = (float)s_mouseState.m_my;
@@ -1392,60 +2421,134 @@ bool App::update()
 
 	///////////////////////////////////////////////////////////
 
-	static float ff = 0;
 	s_numPatches = 0;
+	frameArenaReset(s_frameArena);
+	s_sectorsLODMap = (uint8_t*)frameArenaAlloc(s_frameArena, s_worldNumSectorsX * s_worldNumSectorsY);
+	s_nodesToRender = (QuadTreeNode**)frameArenaAlloc(s_frameArena, sizeof(QuadTreeNode*) * s_maxNodesInTree);
+	s_patches = (InstanceData*)frameArenaAlloc(s_frameArena, sizeof(InstanceData) * s_maxNodesInTree * 64);
 	memset(s_sectorsLODMap, 0, s_worldNumSectorsX * s_worldNumSectorsY);
-	float playerPos[3];
-	playerPos[0] = 100 + ff;
-	playerPos[1] = 0;
-	playerPos[2] = 100 + ff;
-
-	buildQuadTree(playerPos);
+	// shadows drawn next frame morph from the same position the patches were selected from
+	// one item, the first of its task always runs, patches are never left half done
+	frameBudgetBeginItem(m_budget, BudgetTask::Lod, WorkPriority::Visible);
+	const int64_t lodStart = bx::getHPCounter();
+	m_numLodPositions = viewGetLodPositions(m_views, m_numViews, m_lodPositions);
+	quadTreeBuild(m_quadTree, s_frameArena, m_lodPositions, m_numLodPositions);
+	s_quadTree = m_quadTree.m_nodes;
 	s_numNodesToRender = 0;
 	traverseQuadTree(s_quadTree);
-	generatePatchesFromNodes(s_nodesToRender, s_numNodesToRender);
+	generatePatchesFromNodes(m_quadTree, s_nodesToRender, s_numNodesToRender);
+	m_sharedLodMs = float(double(bx::getHPCounter() - lodStart) * 1000.0 / freq);
 
+	// every view culls the shared patches
+	{
+		float minHeight = 0.0f;
+		float maxHeight = s_heightScale * 65535.0f;
+		if (m_heightfieldReady)
+		{
+			heightfieldGetRange(m_heightfield, minHeight, maxHeight);
+		}
 
+		for (uint32_t ii = 0; ii < m_numViews; ++ii)
+		{
+			TerrainView& view = m_views[ii];
+			view.m_patches = (uint32_t*)frameArenaAlloc(s_frameArena, sizeof(uint32_t) * s_maxNodesInTree * 64);
+			viewCullPatches(view, s_nodesToRender, s_numNodesToRender, float(s_sectorSizeInMeters), s_maxPatchesPerSectorRow, minHeight, maxHeight);
+		}
+	}
 
-	InstanceData* patches = s_patches;
+	// every view drops patches terrain hides from it, statistics add up over views
+	{
+		uint32_t numTested = 0;
+		uint32_t numOutside = 0;
+		uint32_t numOccluded = 0;
+		uint32_t numTriangles = 0;
+		float setupMs = 0.0f;
+		float rasterMs = 0.0f;
+		m_numFrustumPatches = 0;
+		m_numVisiblePatches = 0;
+		for (uint32_t ii = 0; ii < m_numViews; ++ii)
+		{
+			m_numFrustumPatches += m_views[ii].m_numPatches;
+			m_numVisiblePatches += cullOccludedPatches(m_views[ii]);
+			numTested    += m_occlusion.m_numTested;
+			numOutside   += m_occlusion.m_numOutside;
+			numOccluded  += m_occlusion.m_numOccluded;
+			numTriangles += m_occlusion.m_numTriangles;
+			setupMs      += m_occlusion.m_setupMs;
+			rasterMs     += m_occlusion.m_rasterMs;
+		}
 
+		m_occlusion.m_numTested    = numTested;
+		m_occlusion.m_numOutside   = numOutside;
+		m_occlusion.m_numOccluded  = numOccluded;
+		m_occlusion.m_numTriangles = numTriangles;
+		m_occlusion.m_setupMs      = setupMs;
+		m_occlusion.m_rasterMs     = rasterMs;
+	}
+	frameBudgetEndItem(m_budget, BudgetTask::Lod);
 
-	uint32_t numInstances = s_numPatches;
-	uint16_t instanceStride = sizeof(InstanceData);
-	if (numInstances == bgfx::getAvailInstanceDataBuffer(numInstances, instanceStride))
+	// distant patches sample one pre-composited page instead of blending splat layers, past the
+	// budget they blend layers until a later frame. Views share patches, a patch is distant only
+	// if it's far from all of them.
+	virtualTextureCacheBeginFrame(m_virtualTexture);
+	if (m_useVirtualTexture)
 	{
-		bgfx::InstanceDataBuffer idb;
-		bgfx::allocInstanceDataBuffer(&idb, numInstances, instanceStride);
-
-		uint8_t* data = idb.data;
-		memcpy(data, patches, sizeof(InstanceData)* numInstances);
+		const float minDistanceSq = m_virtualTextureDistance * m_virtualTextureDistance;
+		uint8_t* requested = (uint8_t*)frameArenaAlloc(s_frameArena, s_numPatches);
+		memset(requested, 0, s_numPatches);
+		for (uint32_t vv = 0; vv < m_numViews; ++vv)
+		{
+			const TerrainView& view = m_views[vv];
+			for (uint32_t ii = 0; ii < view.m_numPatches; ++ii)
+			{
+				const uint32_t patchIndex = view.m_patches[ii];
+				if (0 != requested[patchIndex])
+				{
+					continue;
+				}
+				requested[patchIndex] = 1;
+
+				InstanceData& patch = s_patches[patchIndex];
+				const float halfSize = patch.worldSize * 0.5f;
+				float distanceSq = bx::kFloatMax;
+				for (uint32_t jj = 0; jj < m_numViews; ++jj)
+				{
+					const float dx = patch.worldPosX + halfSize - m_views[jj].m_position.x;
+					const float dz = patch.worldPosY + halfSize - m_views[jj].m_position.z;
+					distanceSq = bx::min(distanceSq, dx * dx + dz * dz);
+				}
+
+				if (distanceSq > minDistanceSq
+				&&  frameBudgetBeginItem(m_budget, BudgetTask::VirtualTexture, WorkPriority::Visible) )
+				{
+					const uint8_t lod = (uint8_t)bx::uint32_cnttz(uint32_t(patch.worldSize / s_finestPatchSize) );
+					patch.virtualPage = (float)virtualTextureCacheRequest(m_virtualTexture, m_splatMap, lod, patch.worldPosX, patch.worldPosY, patch.worldSize, s_heightMapWorldSize);
+					frameBudgetEndItem(m_budget, BudgetTask::VirtualTexture);
+				}
+			}
+		}
+	}
 
 
-		float transform[16];
-		bx::mtxSRT(transform, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-		bgfx::setTransform(transform);
 
-		// Set instance data buffer.
-		bgfx::setInstanceDataBuffer(&idb);
-		bgfx::setVertexBuffer(0, m_terrainVbh);
-		bgfx::setIndexBuffer(m_terrainIbh);
-		bgfx::setTexture(0, s_heightTexture, m_heightTexture, BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP);
-		bgfx::setTexture(1, m_albedoTextureSampler, m_albedoTexture,0);
-		//bgfx::setState(BGFX_STATE_DEFAULT| BGFX_STATE_PT_LINES);
-		float val[4];
-		val[0] = 0.1f; // height map scale
-		val[1] = 0.0f; // sea level
-		val[2] = 0.125f; // size of patch inside height texture
-		bgfx::setUniform(u_heightMapParams, val);
-		val[0] = (float)m_renderGrid;
-		val[1] = m_brush.m_worldPosition.x;
-		val[2] = m_brush.m_worldPosition.y;
-		val[3] = m_brush.m_worldPosition.z;
+	for (uint32_t ii = 0; ii < m_numViews; ++ii)
+	{
+		submitTerrainView(ii);
+	}
 
-		bgfx::setUniform(u_renderParams, val);
+	// cascades are cached, only the ones that moved or lost content are drawn again
+	{
+		m_shadows.m_numActive = m_useHorizonShadows ? ShadowCascades::kNumCascades - 1 : ShadowCascades::kNumCascades;
 
-		bgfx::submit(0, m_terrainHeightTextureProgram);
+		float minHeight = 0.0f;
+		float maxHeight = 0.0f;
+		if (m_heightfieldReady)
+		{
+			heightfieldGetRange(m_heightfield, minHeight, maxHeight);
+		}
 
+		const uint32_t cascadeMask = shadowUpdate(m_shadows, kShadowView, cameraGetPosition(), m_sunDirection, minHeight, maxHeight);
+		submitShadowCascades(cascadeMask);
 	}
 
 	///////////////////////////////////////////////////////////
@@ -1457,47 +2560,283 @@ bool App::update()
 	params[3] = m_brushSize;
 	bgfx::setUniform(u_params, params, 1);
 	bgfx::setUniform(u_invViewProj, invProjView, 1);
-	
-	//bgfx::setImage(0, m_gbufferTex[2], 0, bgfx::Access::Read);
-	bgfx::setTexture(0, s_depth, m_gbufferTex[2]);
-	bgfx::setBuffer(1, m_mouseBufferHandle, bgfx::Access::Write);
-	bgfx::dispatch(1, m_programComputeMousePos, 1, 1);
-
-	if (!imguiMouseCapture && s_mouseState.m_buttons[0])
-	{
-		bgfx::setImage(0, m_heightTexture, 0, bgfx::Access::ReadWrite, bgfx::TextureFormat::R16);
-		bgfx::setBuffer(1, m_mouseBufferHandle, bgfx::Access::Read);
-		bgfx::dispatch(2, m_programComputeUpdateHeightMap, s_heightMapSize / 8, s_heightMapSize /8);
-		//bgfx::dispatch(2, m_programComputeUpdateHeightMap, 1, 1);
-		/*static float buff[129 * 129];
-		static float f = 0;
-		const bgfx::Memory* mem = bgfx::makeRef(buff, sizeof(buff));
-		f += 0.01f;
-		buff[0] = f;*/
-		//bgfx::updateTexture2D(m_heightTexture, 0, 0, 0, 0, (uint16_t)s_heightMapSize, (uint16_t)s_heightMapSize, mem);
+
+	// CPU copy catches up with edits once their readback arrives, a row of tiles at a time.
+	// Occlusion culling stays off and no new readback starts until all rows are in.
+	if (0 != m_heightReadbackFrame
+	&&  m_frameNumber >= m_heightReadbackFrame)
+	{
+		while (m_heightReadbackRow < s_heightMapSize
+		&&     frameBudgetBeginItem(m_budget, BudgetTask::HeightReadback, WorkPriority::Near) )
+		{
+			const TileRect rows =
+			{
+				0,
+				int32_t(m_heightReadbackRow),
+				int32_t(s_heightMapSize),
+				int32_t(bx::min(m_heightReadbackRow + s_heightTileSize, s_heightMapSize) ),
+			};
+			heightfieldUpdate(m_heightfield, m_heightReadback, rows);
+
+			// only cells under the edits regenerate, the rest of the band kept its heights
+			const TileRect edited = tileRectIntersect(rows, m_horizonReadbackRect);
+			if (!tileRectIsEmpty(edited) )
+			{
+				scatterInvalidate(m_scatter, edited);
+			}
+			m_heightReadbackRow = uint32_t(rows.m_y1);
+			frameBudgetEndItem(m_budget, BudgetTask::HeightReadback);
+		}
+
+		if (s_heightMapSize == m_heightReadbackRow)
+		{
+			horizonCacheInvalidate(m_horizon, m_horizonReadbackRect);
+			documentInvalidate(m_document, m_horizonReadbackRect);
+			m_horizonReadbackRect = { 0, 0, 0, 0 };
+			m_heightReadbackFrame = 0;
+			m_heightReadbackRow = 0;
+			m_heightfieldReady = true;
+		}
+	}
+
+	if (0 != m_normalReadbackFrame
+	&&  m_frameNumber >= m_normalReadbackFrame)
+	{
+		int32_t maxError = 0;
+		for (uint32_t ii = 0, num = s_heightMapSize * s_heightMapSize * 2; ii < num; ++ii)
+		{
+			const int32_t diff = int32_t(m_normalReadback[ii]) - int32_t(m_normalReference[ii]);
+			maxError = bx::max(maxError, diff < 0 ? -diff : diff);
+		}
+		m_normalMaxError = maxError;
+		m_normalReadbackFrame = 0;
 	}
-	
+
+	// a save takes the CPU copy, so it waits until no edit is missing from it. A loaded map
+	// replaces both copies, the readback in flight would overwrite it with older heights.
+	if (m_saveRequested
+	&&  m_heightfieldReady
+	&&  !m_heightfieldDirty
+	&&  0 == m_heightReadbackFrame
+	&&  documentSave(m_document, m_heightfield) )
+	{
+		m_saveRequested = false;
+	}
+
+	if (m_loadPending
+	&&  0 == m_heightReadbackFrame)
+	{
+		applyLoadedHeights();
+	}
+
+	if (m_heightfieldReady)
+	{
+		const int64_t pickStart = bx::getHPCounter();
+		RayHit hit;
+		m_mouseHit = pickHeightfield(params[0], params[1], invProjView, hit);
+		m_pickTimeUs = float(double(bx::getHPCounter() - pickStart) * 1e6 / freq);
+
+		if (m_mouseHit)
+		{
+			m_brush.m_worldPosition = hit.m_position;
+
+			const float mousePos[4] = { hit.m_position.x, hit.m_position.y, hit.m_position.z, 1.0f };
+			bgfx::update(m_mouseBufferHandle, 0, bgfx::copy(mousePos, sizeof(mousePos) ) );
+		}
+	}
+	else if (bgfx::isValid(m_programComputeMousePos) )
+	{
+		// until the first readback, pick from last frame's depth on the GPU
+		bgfx::setTexture(0, s_depth, m_gbuffer.m_depth);
+		bgfx::setBuffer(1, m_mouseBufferHandle, bgfx::Access::Write);
+		gbufferSetUniforms(m_gbuffer, false);
+		bgfx::dispatch(kMousePosView, m_programComputeMousePos, 1, 1);
+	}
+
+	// instances sit on the CPU height field, nothing is scattered before the first readback
+	if (m_heightfieldReady)
+	{
+		scatterUpdate(m_scatter, m_heightfield, m_views, m_numViews, m_budget);
+		horizonCacheUpdate(m_horizon, m_heightfield);
+	}
+	for (uint32_t ii = 0; ii < m_numViews; ++ii)
+	{
+		scatterSubmit(m_scatter, kScatterCullView, bgfx::ViewId(kGBufferView + ii), ii, m_gbuffer, m_views[ii].m_viewProj, m_views[ii].m_position, m_sunDirection, caps->homogeneousDepth);
+	}
+
+	// Stroke follows every cursor position since the last frame, picked on the CPU height
+	// field. Height added per second is the same at any frame rate.
+	if (!imguiMouseCapture && s_mouseState.m_buttons[0]
+	&&  m_heightfieldReady
+	&&  bgfx::isValid(m_programComputeUpdateHeightMap)
+	&&  bgfx::isValid(m_programComputeHeightMip)
+	&&  bgfx::isValid(m_programComputeUpdateNormals) )
+	{
+		for (uint32_t ii = 0; ii < m_numCursorTrail; ++ii)
+		{
+			RayHit hit;
+			if (pickHeightfield(m_cursorTrail[ii][0] / float(width), m_cursorTrail[ii][1] / float(height), invProjView, hit) )
+			{
+				sculptAddPoint(m_sculpt, hit.m_position);
+			}
+		}
+
+		if (0 == m_numCursorTrail
+		&&  m_mouseHit)
+		{
+			sculptAddPoint(m_sculpt, m_brush.m_worldPosition);
+		}
+
+		const float amount = s_sculptRate * bx::min(deltaTime, 0.1f);
+		if (0 != sculptBuildSamples(m_sculpt, m_brushSize, s_strokeSpacing * m_brushSize, amount) )
+		{
+			const float texelSize = s_heightMapWorldSize / (float)s_heightMapSize;
+			const TileRect rect = sculptGetRect(m_sculpt, texelSize, s_heightMapSize, s_heightMapSize);
+			sculptDispatch(m_sculpt, kCombineView, m_programComputeUpdateHeightMap, m_heightTexture, rect, s_heightMapWorldSize);
+			heightMipsDispatch(m_heightMips, kCombineView, m_programComputeHeightMip, u_heightMipParams, m_heightTexture, rect);
+
+			// tiles under the edit are recomputed below, with central differences one texel around it
+			normalCacheInvalidate(m_normalCache, rect);
+
+			shadowInvalidate(m_shadows
+				, rect.m_x0 * texelSize
+				, rect.m_y0 * texelSize
+				, (rect.m_x1 + 1) * texelSize
+				, (rect.m_y1 + 1) * texelSize
+				);
+			m_horizonDirty = tileRectUnion(m_horizonDirty, rect);
+			m_heightfieldDirty = true;
+		}
+	}
+	else
+	{
+		sculptEnd(m_sculpt);
+	}
+	m_numCursorTrail = 0;
+
+	// tiles stay dirty until the program is loaded
+	if (bgfx::isValid(m_programComputeUpdateNormals) )
+	{
+		TileRect dirtyRects[16];
+		const uint32_t numDirtyRects = normalCacheFlush(m_normalCache, dirtyRects, BX_COUNTOF(dirtyRects));
+		for (uint32_t ii = 0; ii < numDirtyRects; ++ii)
+		{
+			dispatchNormals(kCombineView, dirtyRects[ii], false);
+		}
+	}
+
+	// one readback in flight, edits made meanwhile are picked up by the next one
+	if (m_heightfieldDirty
+	&&  0 == m_heightReadbackFrame
+	&&  bgfx::isValid(m_heightReadbackTexture) )
+	{
+		bgfx::blit(kCombineView, m_heightReadbackTexture, 0, 0, m_heightTexture);
+		m_heightReadbackFrame = bgfx::readTexture(m_heightReadbackTexture, m_heightReadback);
+		m_heightfieldDirty = false;
+		m_horizonReadbackRect = m_horizonDirty;
+		m_horizonDirty = { 0, 0, 0, 0 };
+	}
+
+	// CPU reference needs the heights the GPU normals were computed from, so the check
+	// waits for the height readback and for the last dirty normal tiles
+	if (m_normalCheckRequested
+	&&  m_heightfieldReady
+	&&  !m_heightfieldDirty
+	&&  0 == m_heightReadbackFrame
+	&&  0 == m_normalCache.m_numDirty
+	&&  0 == m_normalReadbackFrame)
+	{
+		m_normalCheckRequested = false;
+		if (bgfx::isValid(m_normalReadbackTexture) )
+		{
+			const TileRect full = { 0, 0, int32_t(s_heightMapSize), int32_t(s_heightMapSize) };
+			normalsComputeRG8(m_normalReference, m_heightfield.m_heights, s_heightMapSize, s_heightMapSize, full, m_heightfield.m_heightScale, m_heightfield.m_texelSize);
+			bgfx::blit(kResolveView, m_normalReadbackTexture, 0, 0, m_normalTexture);
+			m_normalReadbackFrame = bgfx::readTexture(m_normalReadbackTexture, m_normalReadback);
+		}
+	}
+
+	// splat tiles are uploaded as they arrive, pages are baked after the upload
+	splatMapUpload(m_splatMap, 4);
+	virtualTextureCacheBake(m_virtualTexture, kCombineView, m_materials, m_splatMap, s_heightMapWorldSize);
 
 	// screen space quad
 
 	float proj[16];
 	bx::mtxOrtho(proj, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 100.0f, 0.0f, caps->homogeneousDepth);
-	bgfx::setViewTransform(2, NULL, proj);
+	bgfx::setViewTransform(kResolveView, NULL, proj);
+	bgfx::setViewRect(kResolveView, 0, 0, uint16_t(width), uint16_t(height));
+
+	// decal needs the brush position on the CPU, before the first readback it lives on the GPU.
+	// With several views the brush is drawn by the resolve of each of them.
+	const bool brushDecal = m_useBrushDecal
+		&& m_heightfieldReady
+		&& bgfx::isValid(m_brushDecalProgram)
+		&& 1 == m_numViews
+		;
 
-	bgfx::setState(0
-		| BGFX_STATE_WRITE_RGB
-		//| BGFX_STATE_WRITE_A
-	);
-	
+	// views resolve in reverse, the first one sets world position for the brush decal
+	for (uint32_t ii = m_numViews; ii-- > 0;)
+	{
+		const TerrainView& view = m_views[ii];
+		const uint16_t x0 = uint16_t(view.m_rect[0] * width + 0.5f);
+		const uint16_t y0 = uint16_t(view.m_rect[1] * height + 0.5f);
+		const uint16_t x1 = uint16_t( (view.m_rect[0] + view.m_rect[2]) * width + 0.5f);
+		const uint16_t y1 = uint16_t( (view.m_rect[1] + view.m_rect[3]) * height + 0.5f);
+		bgfx::setScissor(x0, y0, uint16_t(x1 - x0), uint16_t(y1 - y0) );
+		bgfx::setState(0
+			| BGFX_STATE_WRITE_RGB
+			//| BGFX_STATE_WRITE_A
+		);
+		bgfx::setTexture(0, s_albedo, m_gbuffer.m_color, BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP);
+		bgfx::setTexture(1, s_depth, m_gbuffer.m_depth);
+		gbufferSetMaterialTexture(m_gbuffer, 4);
+		screenSpaceQuad((float)width, (float)height, 0, caps->originBottomLeft);
+		bgfx::setBuffer(2, m_mouseBufferHandle, bgfx::Access::Read);
+		shadowSetUniforms(m_shadows, 3);
+		bgfx::setUniform(u_sunDirection, m_sunDirection);
+		bgfx::setUniform(u_invViewProj, view.m_invWindowViewProj, 1);
+		gbufferSetUniforms(m_gbuffer, !brushDecal && !m_batchMode);
+		bgfx::submit(kResolveView, m_combinedProgram);
+	}
 
-	bgfx::setViewRect(2, 0, 0, uint16_t(width), uint16_t(height));
-	bgfx::setTexture(0, s_albedo, m_gbufferTex[0]);
-	bgfx::setTexture(1, s_depth, m_gbufferTex[2]);
-	screenSpaceQuad((float)width, (float)height, 0, caps->originBottomLeft);
-	bgfx::setBuffer(2, m_mouseBufferHandle, bgfx::Access::Read);
-	bgfx::submit(2, m_combinedProgram);
+	if (brushDecal
+	&&  m_mouseHit)
+	{
+		float minHeight;
+		float maxHeight;
+		heightfieldGetRange(m_heightfield, minHeight, maxHeight);
+
+		uint16_t rect[4];
+		brushScreenRect(rect, m_views[0].m_windowViewProj, m_brush.m_worldPosition, 2.0f * m_brushSize, minHeight, maxHeight, width, height);
+		if (0 != rect[2]
+		&&  0 != rect[3])
+		{
+			bgfx::setScissor(rect[0], rect[1], rect[2], rect[3]);
+			bgfx::setState(0
+				| BGFX_STATE_WRITE_RGB
+				| BGFX_STATE_BLEND_ALPHA
+				);
+			bgfx::setTexture(1, s_depth, m_gbuffer.m_depth);
+			screenSpaceQuad((float)width, (float)height, 0, caps->originBottomLeft);
+			bgfx::setBuffer(2, m_mouseBufferHandle, bgfx::Access::Read);
+			gbufferSetUniforms(m_gbuffer, false);
+			bgfx::submit(kResolveView, m_brushDecalProgram);
+		}
+	}
 
-	uint32_t currFrame = bgfx::frame();
+	if (batchCapture)
+	{
+		batchEndPose(m_batch, kBatchView);
+		m_batchPose = NULL;
+	}
+
+	m_frameNumber = bgfx::frame();
+
+	if (m_batchMode)
+	{
+		batchUpdate(m_batch, m_frameNumber);
+	}
 
 	return true;
 }
@@ -1535,6 +2874,7 @@ static int32_t runApiThread(bx::Thread *self, void *userData)
 				auto mouseCursorEvent = (MouseCursorEvent *)ev;
 				theApp.s_mouseState.m_mx = (int32_t)mouseCursorEvent->x;
 				theApp.s_mouseState.m_my = (int32_t)mouseCursorEvent->y;
+				theApp.addCursorPosition(theApp.s_mouseState.m_mx, theApp.s_mouseState.m_my);
 			}
 			else if (*ev == EventType::MouseButton) {
 				auto mouseButtonEvent = (MouseButtonEvent *)ev;
@@ -1543,9 +2883,7 @@ static int32_t runApiThread(bx::Thread *self, void *userData)
 			else if (*ev == EventType::Resize) {
 				auto resizeEvent = (ResizeEvent *)ev;
 				bgfx::reset(resizeEvent->width, resizeEvent->height, BGFX_RESET_VSYNC);
-				/*bgfx::setViewRect(kClearView, 0, 0, bgfx::BackbufferRatio::Equal);
-				width = resizeEvent->width;
-				height = resizeEvent->height;*/
+				theApp.resize(resizeEvent->width, resizeEvent->height);
 			} else if (*ev == EventType::Exit) {
 				exit = true;
 			}
@@ -1557,14 +2895,136 @@ static int32_t runApiThread(bx::Thread *self, void *userData)
 		
 	}
 
+	assetLoaderDestroy();
+	theApp.shutdown();
 	imguiDestroy();
 	
 	bgfx::shutdown();
 	return 0;
 }
 
+static bool parseUint(const bx::CommandLine& _cmdLine, const char* _option, uint32_t& _value)
+{
+	const char* text = _cmdLine.findOption(_option, NULL);
+	if (NULL != text
+	&&  !bx::fromString(&_value, text) )
+	{
+		fprintf(stderr, "--%s expects a number, got %s.\n", _option, text);
+		return false;
+	}
+
+	return true;
+}
+
+// Renders poses to PNG files without a window. bgfx gets no native window handle and renders
+// into the batch target only, renderFrame isn't called so bgfx runs its own render thread.
+// --software picks the CPU rasterizer adapter, e.g. lavapipe with Vulkan or WARP with D3D.
+static int32_t runBatch(const bx::CommandLine& _cmdLine)
+{
+	static const struct { const char* m_name; bgfx::RendererType::Enum m_type; } s_renderers[] =
+	{
+		{ "d3d11",  bgfx::RendererType::Direct3D11 },
+		{ "d3d12",  bgfx::RendererType::Direct3D12 },
+		{ "gl",     bgfx::RendererType::OpenGL     },
+		{ "metal",  bgfx::RendererType::Metal      },
+		{ "vulkan", bgfx::RendererType::Vulkan     },
+	};
+
+	const char* posesPath = _cmdLine.findOption("batch", NULL);
+	const char* outDir    = _cmdLine.findOption("out", "batch");
+	uint32_t width    = 512;
+	uint32_t height   = 512;
+	uint32_t inFlight = 3;
+	uint32_t settle   = 8;
+	if (NULL == posesPath)
+	{
+		fprintf(stderr, "Usage: terrain --batch <poses> [--out <dir>] [--width <n>] [--height <n>] [--in-flight <n>]\n"
+			"       [--settle <frames>] [--renderer d3d11|d3d12|gl|metal|vulkan] [--software]\n"
+			);
+		return 1;
+	}
+
+	if (!parseUint(_cmdLine, "width", width)
+	||  !parseUint(_cmdLine, "height", height)
+	||  !parseUint(_cmdLine, "in-flight", inFlight)
+	||  !parseUint(_cmdLine, "settle", settle) )
+	{
+		return 1;
+	}
+
+	bgfx::Init init;
+	init.resolution.width  = width;
+	init.resolution.height = height;
+	init.resolution.reset  = BGFX_RESET_NONE;
+	if (_cmdLine.hasArg("software") )
+	{
+		init.vendorId = BGFX_PCI_ID_SOFTWARE_RASTERIZER;
+	}
+
+	const char* rendererName = _cmdLine.findOption("renderer", NULL);
+	if (NULL != rendererName)
+	{
+		uint32_t index = 0;
+		while (index < BX_COUNTOF(s_renderers)
+		&&     0 != bx::strCmp(s_renderers[index].m_name, rendererName) )
+		{
+			++index;
+		}
+
+		if (BX_COUNTOF(s_renderers) == index)
+		{
+			fprintf(stderr, "Unknown renderer %s.\n", rendererName);
+			return 1;
+		}
+
+		init.type = s_renderers[index].m_type;
+	}
+
+	if (!bgfx::init(init) )
+	{
+		fprintf(stderr, "Can't initialize renderer.\n");
+		return 1;
+	}
+
+	theApp.init(width, height);
+
+	int32_t exitCode = 0;
+	if (theApp.beginBatch(posesPath, outDir, inFlight, settle) )
+	{
+		while (!theApp.isBatchDone() )
+		{
+			theApp.update();
+		}
+
+		// scripts rendering many poses only look at the exit code
+		exitCode = 0 == theApp.getBatchNumFailed() ? 0 : 1;
+	}
+	else
+	{
+		exitCode = 1;
+	}
+
+	assetLoaderDestroy();
+	theApp.shutdown();
+	imguiDestroy();
+
+	bgfx::shutdown();
+	return exitCode;
+}
+
 int main(int argc, char **argv)
 {
+	bx::CommandLine cmdLine(argc, argv);
+	if (cmdLine.hasArg("bench"))
+	{
+		return runBenchmarks(cmdLine);
+	}
+
+	if (cmdLine.hasArg("batch"))
+	{
+		return runBatch(cmdLine);
+	}
+
 	// Create a GLFW window without an OpenGL context.
 	glfwSetErrorCallback(glfw_errorCallback);
 	if (!glfwInit())
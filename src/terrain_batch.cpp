@@ -0,0 +1,282 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <stdio.h>
+#include <bimg/bimg.h>
+#include <bx/file.h>
+#include <bx/string.h>
+#include <bx/timer.h>
+#include "asset_loader.h"
+#include "terrain_batch.h"
+#include "terrain_file.h"
+#include "terrain_memory.h"
+
+static bool loadPoses(BatchRenderer& _batch, const char* _path)
+{
+	FILE* file = fopen(_path, "r");
+	if (NULL == file)
+	{
+		fprintf(stderr, "Can't open poses %s.\n", _path);
+		return false;
+	}
+
+	// two passes, the first one counts
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::General);
+	bool valid = true;
+	for (uint32_t pass = 0; pass < 2 && valid; ++pass)
+	{
+		rewind(file);
+		uint32_t num  = 0;
+		uint32_t line = 0;
+		char text[512];
+		while (valid
+		&&     NULL != fgets(text, sizeof(text), file) )
+		{
+			++line;
+			char kind[8];
+			if (1 != sscanf(text, " %7s", kind)
+			||  '#' == kind[0])
+			{
+				continue;
+			}
+
+			BatchPose pose;
+			bx::memSet(&pose, 0, sizeof(pose) );
+			float yaw;
+			float pitch;
+			if (0 == bx::strCmp(kind, "view") )
+			{
+				valid = 6 == sscanf(text, " %*s %63s %f %f %f %f %f", pose.m_name, &pose.m_position.x, &pose.m_position.y, &pose.m_position.z, &yaw, &pitch);
+				pose.m_yaw   = bx::toRad(yaw);
+				pose.m_pitch = bx::toRad(pitch);
+			}
+			else if (0 == bx::strCmp(kind, "tile") )
+			{
+				valid = 4 == sscanf(text, " %*s %63s %f %f %f", pose.m_name, &pose.m_position.x, &pose.m_position.z, &pose.m_extent)
+					&& 0.0f < pose.m_extent
+					;
+			}
+			else
+			{
+				valid = false;
+			}
+
+			if (!valid)
+			{
+				fprintf(stderr, "%s:%u: expected 'view <name> <x> <y> <z> <yaw> <pitch>' or 'tile <name> <x> <z> <size>'.\n", _path, line);
+			}
+			else if (1 == pass)
+			{
+				_batch.m_poses[num] = pose;
+			}
+
+			num += valid ? 1 : 0;
+		}
+
+		if (0 == pass
+		&&  valid)
+		{
+			_batch.m_numPoses = num;
+			_batch.m_poses = (BatchPose*)BX_ALLOC(allocator, bx::max(num, 1u) * sizeof(BatchPose) );
+		}
+	}
+
+	fclose(file);
+	return valid;
+}
+
+bool batchCreate(BatchRenderer& _batch, const char* _posesPath, const char* _outDir, uint32_t _width, uint32_t _height, uint32_t _numInFlight)
+{
+	bx::memSet(&_batch, 0, sizeof(_batch) );
+	_batch.m_target.idx = bgfx::kInvalidHandle;
+	_batch.m_currentSlot = UINT32_MAX;
+	_batch.m_startTime = bx::getHPCounter();
+	bx::strCopy(_batch.m_outDir, BX_COUNTOF(_batch.m_outDir), _outDir);
+
+	const bgfx::Caps* caps = bgfx::getCaps();
+	if (0 == (caps->supported & BGFX_CAPS_TEXTURE_READ_BACK)
+	||  0 == (caps->supported & BGFX_CAPS_TEXTURE_BLIT) )
+	{
+		fprintf(stderr, "Renderer %s can't read textures back.\n", bgfx::getRendererName(caps->rendererType) );
+		return false;
+	}
+
+	if (!loadPoses(_batch, _posesPath) )
+	{
+		return false;
+	}
+
+	if (0 == _batch.m_numPoses)
+	{
+		fprintf(stderr, "No poses in %s.\n", _posesPath);
+		return false;
+	}
+
+	if (!fileMakeDir(_outDir) )
+	{
+		fprintf(stderr, "Can't create %s.\n", _outDir);
+		return false;
+	}
+
+	_batch.m_width  = _width;
+	_batch.m_height = _height;
+	_batch.m_yflip  = caps->originBottomLeft;
+	_batch.m_target = bgfx::createFrameBuffer(uint16_t(_width), uint16_t(_height), bgfx::TextureFormat::RGBA8
+		, BGFX_TEXTURE_RT | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP
+		);
+
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::General);
+	_batch.m_numSlots = bx::clamp(_numInFlight, 1u, BatchRenderer::kMaxInFlight);
+	for (uint32_t ii = 0; ii < _batch.m_numSlots; ++ii)
+	{
+		BatchRenderer::Slot& slot = _batch.m_slots[ii];
+		slot.m_readback = bgfx::createTexture2D(uint16_t(_width), uint16_t(_height), false, 1, bgfx::TextureFormat::RGBA8, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_BLIT_DST);
+		slot.m_pixels   = (uint8_t*)BX_ALLOC(allocator, _width * _height * 4);
+		slot.m_batch    = &_batch;
+	}
+
+	return true;
+}
+
+void batchDestroy(BatchRenderer& _batch)
+{
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::General);
+	for (uint32_t ii = 0; ii < _batch.m_numSlots; ++ii)
+	{
+		bgfx::destroy(_batch.m_slots[ii].m_readback);
+		BX_FREE(allocator, _batch.m_slots[ii].m_pixels);
+	}
+	_batch.m_numSlots = 0;
+
+	if (bgfx::isValid(_batch.m_target) )
+	{
+		bgfx::destroy(_batch.m_target);
+	}
+
+	BX_FREE(allocator, _batch.m_poses);
+	_batch.m_poses = NULL;
+	_batch.m_numPoses = 0;
+}
+
+const BatchPose* batchBeginPose(BatchRenderer& _batch)
+{
+	if (UINT32_MAX != _batch.m_currentSlot)
+	{
+		return &_batch.m_poses[_batch.m_slots[_batch.m_currentSlot].m_pose];
+	}
+
+	if (_batch.m_nextPose == _batch.m_numPoses)
+	{
+		return NULL;
+	}
+
+	for (uint32_t ii = 0; ii < _batch.m_numSlots; ++ii)
+	{
+		BatchRenderer::Slot& slot = _batch.m_slots[ii];
+		if (!slot.m_busy)
+		{
+			slot.m_busy   = true;
+			slot.m_failed = false;
+			slot.m_pose   = _batch.m_nextPose++;
+			_batch.m_currentSlot = ii;
+			if (0 == _batch.m_firstPoseTime)
+			{
+				_batch.m_firstPoseTime = bx::getHPCounter();
+			}
+			return &_batch.m_poses[slot.m_pose];
+		}
+	}
+
+	return NULL;
+}
+
+void batchEndPose(BatchRenderer& _batch, bgfx::ViewId _view)
+{
+	BX_CHECK(UINT32_MAX != _batch.m_currentSlot, "No pose is being rendered.");
+	BatchRenderer::Slot& slot = _batch.m_slots[_batch.m_currentSlot];
+	bgfx::blit(_view, slot.m_readback, 0, 0, bgfx::getTexture(_batch.m_target) );
+	slot.m_readyFrame = bgfx::readTexture(slot.m_readback, slot.m_pixels);
+	_batch.m_currentSlot = UINT32_MAX;
+}
+
+static void writeImageJob(void* _userData)
+{
+	BatchRenderer::Slot& slot = *(BatchRenderer::Slot*)_userData;
+	const BatchRenderer& batch = *slot.m_batch;
+	const BatchPose& pose = batch.m_poses[slot.m_pose];
+
+	// written next to the image and renamed, a stopped batch leaves no truncated images
+	char path[512];
+	char tempPath[512];
+	bx::snprintf(path, BX_COUNTOF(path), "%s/%s.png", batch.m_outDir, pose.m_name);
+	bx::snprintf(tempPath, BX_COUNTOF(tempPath), "%s/%s.png.tmp", batch.m_outDir, pose.m_name);
+
+	bx::Error err;
+	bx::FileWriter writer;
+	if (!writer.open(tempPath, false, &err) )
+	{
+		slot.m_failed = true;
+		remove(tempPath);
+		return;
+	}
+
+	bimg::imageWritePng(&writer, batch.m_width, batch.m_height, batch.m_width * 4, slot.m_pixels, bimg::TextureFormat::RGBA8, batch.m_yflip, &err);
+	writer.close();
+	slot.m_failed = !err.isOk()
+		|| !fileReplace(tempPath, path)
+		;
+
+	if (slot.m_failed)
+	{
+		remove(tempPath);
+	}
+}
+
+static void writeImageDone(void* _userData)
+{
+	BatchRenderer::Slot& slot = *(BatchRenderer::Slot*)_userData;
+	BatchRenderer& batch = *slot.m_batch;
+	const BatchPose& pose = batch.m_poses[slot.m_pose];
+
+	if (slot.m_failed)
+	{
+		fprintf(stderr, "Writing %s/%s.png failed.\n", batch.m_outDir, pose.m_name);
+		++batch.m_numFailed;
+	}
+	else
+	{
+		++batch.m_numWritten;
+	}
+	slot.m_busy = false;
+
+	if (batchIsDone(batch) )
+	{
+		const double freq = double(bx::getHPFrequency() );
+		const double setupSec  = double(batch.m_firstPoseTime - batch.m_startTime) / freq;
+		const double renderSec = double(bx::getHPCounter() - batch.m_firstPoseTime) / freq;
+		printf("%u images of %ux%u in %.2fs after %.2fs of loading, %.2f images/s, %u failed\n"
+			, batch.m_numWritten
+			, batch.m_width
+			, batch.m_height
+			, renderSec
+			, setupSec
+			, double(batch.m_numWritten) / bx::max(renderSec, 1e-6)
+			, batch.m_numFailed
+			);
+	}
+}
+
+void batchUpdate(BatchRenderer& _batch, uint32_t _frame)
+{
+	for (uint32_t ii = 0; ii < _batch.m_numSlots; ++ii)
+	{
+		BatchRenderer::Slot& slot = _batch.m_slots[ii];
+		if (0 != slot.m_readyFrame
+		&&  _frame >= slot.m_readyFrame)
+		{
+			slot.m_readyFrame = 0;
+			assetSubmitJob(writeImageJob, writeImageDone, &slot);
+		}
+	}
+}
@@ -0,0 +1,90 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_BATCH_H_HEADER_GUARD
+#define TERRAIN_BATCH_H_HEADER_GUARD
+
+#include <bgfx/bgfx.h>
+#include <bx/math.h>
+
+/// Camera of one image. A view is seen from m_position at m_yaw and m_pitch, a map tile looks
+/// straight down at the m_extent wide square from m_position.x, m_position.z, x to the right and
+/// z up the image.
+struct BatchPose
+{
+	char     m_name[64];   //!< File name of the image without extension.
+	bx::Vec3 m_position;
+	float    m_yaw;        //!< Radians, 0 looks along +z and quarter turn along +x.
+	float    m_pitch;      //!< Radians, positive looks up.
+	float    m_extent;     //!< World size of a map tile, 0 for a view.
+};
+
+/// Renders a list of poses into an offscreen target and writes every image to a PNG. The target
+/// is blitted into one of several readback textures, so rendering of the next poses goes on
+/// while earlier images travel back to the CPU. Arrived images are written on loader threads,
+/// a readback texture is reused once its image is on disk.
+struct BatchRenderer
+{
+	static constexpr uint32_t kMaxInFlight = 8;
+
+	struct Slot
+	{
+		bgfx::TextureHandle m_readback;
+		uint8_t*       m_pixels;
+		BatchRenderer* m_batch;
+		uint32_t       m_pose;
+		uint32_t       m_readyFrame;   //!< Frame m_pixels arrive in, 0 if no readback is in flight.
+		bool           m_busy;         //!< Image is read back or written.
+		bool           m_failed;       //!< Written by the loader thread.
+	};
+
+	bgfx::FrameBufferHandle m_target;  //!< RGBA8, the app resolves into it.
+	Slot       m_slots[kMaxInFlight];
+	uint32_t   m_numSlots;
+	uint32_t   m_width;
+	uint32_t   m_height;
+	bool       m_yflip;                //!< Rows arrive bottom up.
+	char       m_outDir[256];
+
+	BatchPose* m_poses;
+	uint32_t   m_numPoses;
+	uint32_t   m_nextPose;
+	uint32_t   m_currentSlot;          //!< Slot of the pose being rendered, UINT32_MAX if none.
+	uint32_t   m_numWritten;
+	uint32_t   m_numFailed;
+	int64_t    m_startTime;
+	int64_t    m_firstPoseTime;        //!< When the first pose started, 0 before.
+};
+
+/// Reads poses from _posesPath, one per line:
+///
+///     view <name> <x> <y> <z> <yaw degrees> <pitch degrees>
+///     tile <name> <x> <z> <size>
+///
+/// Empty lines and lines starting with # are skipped. Creates the _width x _height target and
+/// _numInFlight readback textures, images go to _outDir. Returns false and prints why if poses
+/// can't be read, there are none, or the renderer can't read textures back.
+bool batchCreate(BatchRenderer& _batch, const char* _posesPath, const char* _outDir, uint32_t _width, uint32_t _height, uint32_t _numInFlight);
+
+/// Call after assetLoaderDestroy, which finishes writes still using slot memory.
+void batchDestroy(BatchRenderer& _batch);
+
+/// Returns next pose to render, or NULL if every slot is busy or all poses were rendered. The
+/// pose stays current until batchEndPose.
+const BatchPose* batchBeginPose(BatchRenderer& _batch);
+
+/// Copies the target into the slot of the current pose in _view, after the view that resolves
+/// into the target, and starts its readback.
+void batchEndPose(BatchRenderer& _batch, bgfx::ViewId _view);
+
+/// Call after bgfx::frame with its return value. Hands arrived images to loader threads.
+void batchUpdate(BatchRenderer& _batch, uint32_t _frame);
+
+/// All images were written or failed.
+inline bool batchIsDone(const BatchRenderer& _batch)
+{
+	return _batch.m_numWritten + _batch.m_numFailed == _batch.m_numPoses;
+}
+
+#endif // TERRAIN_BATCH_H_HEADER_GUARD
@@ -0,0 +1,92 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <bx/math.h>
+#include <bx/timer.h>
+#include <string.h>
+#include "terrain_budget.h"
+
+// Part of the budget items of each priority may start in.
+static const float s_priorityShare[] =
+{
+	1.0f,
+	0.75f,
+	0.5f,
+};
+BX_STATIC_ASSERT(BX_COUNTOF(s_priorityShare) == WorkPriority::Count);
+
+static float toMicroseconds(int64_t _ticks)
+{
+	return float(double(_ticks) * 1e6 / double(bx::getHPFrequency() ) );
+}
+
+void frameBudgetCreate(FrameBudget& _budget, float _budgetUs)
+{
+	memset(&_budget, 0, sizeof(_budget) );
+	_budget.m_budgetUs = _budgetUs;
+}
+
+void frameBudgetBeginFrame(FrameBudget& _budget)
+{
+	for (uint32_t ii = 0; ii < BudgetTask::Count; ++ii)
+	{
+		_budget.m_lastUs[ii] = toMicroseconds(_budget.m_taskTicks[ii]);
+		_budget.m_lastItems[ii] = _budget.m_numItems[ii];
+		_budget.m_lastDeferred[ii] = _budget.m_numDeferred[ii];
+		_budget.m_taskTicks[ii] = 0;
+		_budget.m_numItems[ii] = 0;
+		_budget.m_numDeferred[ii] = 0;
+	}
+
+	_budget.m_totalUs[_budget.m_frame % FrameBudget::kHistory] = toMicroseconds(_budget.m_usedTicks);
+	_budget.m_usedTicks = 0;
+	++_budget.m_frame;
+}
+
+bool frameBudgetBeginItem(FrameBudget& _budget, BudgetTask::Enum _task, WorkPriority::Enum _priority)
+{
+	const float usedUs = toMicroseconds(_budget.m_usedTicks);
+	if (0 != _budget.m_numItems[_task]
+	&&  usedUs >= _budget.m_budgetUs * s_priorityShare[_priority])
+	{
+		++_budget.m_numDeferred[_task];
+		return false;
+	}
+
+	++_budget.m_numItems[_task];
+	_budget.m_itemStart = bx::getHPCounter();
+	return true;
+}
+
+void frameBudgetEndItem(FrameBudget& _budget, BudgetTask::Enum _task)
+{
+	const int64_t ticks = bx::getHPCounter() - _budget.m_itemStart;
+	_budget.m_taskTicks[_task] += ticks;
+	_budget.m_usedTicks += ticks;
+}
+
+float frameBudgetGetPeakUs(const FrameBudget& _budget)
+{
+	float peak = 0.0f;
+	for (uint32_t ii = 0; ii < FrameBudget::kHistory; ++ii)
+	{
+		peak = bx::max(peak, _budget.m_totalUs[ii]);
+	}
+
+	return peak;
+}
+
+const char* getName(BudgetTask::Enum _task)
+{
+	static const char* s_names[] =
+	{
+		"LOD",
+		"Height readback",
+		"Scatter",
+		"Virtual texture",
+	};
+	BX_STATIC_ASSERT(BX_COUNTOF(s_names) == BudgetTask::Count);
+
+	return s_names[_task];
+}
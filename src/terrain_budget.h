@@ -0,0 +1,81 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_BUDGET_H_HEADER_GUARD
+#define TERRAIN_BUDGET_H_HEADER_GUARD
+
+#include <stdint.h>
+
+/// Terrain CPU work sharing the frame budget.
+struct BudgetTask
+{
+	enum Enum
+	{
+		Lod,            //!< Quadtree and patches, one item that always runs.
+		HeightReadback, //!< GPU edits copied to the CPU height field.
+		Scatter,        //!< Cells of scattered instances generated.
+		VirtualTexture, //!< Pages requested for distant patches.
+
+		Count
+	};
+};
+
+/// Work of higher priority may use more of the budget.
+struct WorkPriority
+{
+	enum Enum
+	{
+		Visible, //!< On screen, may use all of it.
+		Near,
+		Far,
+
+		Count
+	};
+};
+
+/// Per frame CPU time budget for terrain work, so teleports and fast flights spread their
+/// work over several frames instead of spiking one. Work is split into items and each asks
+/// before it starts. Visible items may use the whole budget, near and far ones stop earlier
+/// and leave the rest to more important work that comes later in the frame. An item that
+/// doesn't get to run is deferred and its owner tries again next frame. Every task runs at
+/// least one item per frame, so nothing starves. Only time spent inside items counts.
+struct FrameBudget
+{
+	static constexpr uint32_t kHistory = 64;
+
+	float    m_budgetUs;
+	int64_t  m_usedTicks;                         //!< This frame, all tasks.
+	int64_t  m_itemStart;
+	int64_t  m_taskTicks[BudgetTask::Count];
+	uint32_t m_numItems[BudgetTask::Count];
+	uint32_t m_numDeferred[BudgetTask::Count];
+
+	// last finished frame
+	float    m_lastUs[BudgetTask::Count];
+	uint32_t m_lastItems[BudgetTask::Count];
+	uint32_t m_lastDeferred[BudgetTask::Count];
+	float    m_totalUs[kHistory];                 //!< Past frames, all tasks.
+	uint32_t m_frame;
+};
+
+///
+void frameBudgetCreate(FrameBudget& _budget, float _budgetUs);
+
+/// Closes stats of the previous frame and starts spending the budget again.
+void frameBudgetBeginFrame(FrameBudget& _budget);
+
+/// Returns true if an item of _task may run now and starts timing it, false if it has to wait
+/// for a later frame.
+bool frameBudgetBeginItem(FrameBudget& _budget, BudgetTask::Enum _task, WorkPriority::Enum _priority);
+
+/// Stops timing the item frameBudgetBeginItem started.
+void frameBudgetEndItem(FrameBudget& _budget, BudgetTask::Enum _task);
+
+/// Largest time spent by all tasks in a frame of the last kHistory.
+float frameBudgetGetPeakUs(const FrameBudget& _budget);
+
+///
+const char* getName(BudgetTask::Enum _task);
+
+#endif // TERRAIN_BUDGET_H_HEADER_GUARD
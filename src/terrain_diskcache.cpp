@@ -0,0 +1,186 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <stdio.h>
+#include <bx/cpu.h>
+#include <bx/hash.h>
+#include <bx/os.h>
+#include <bx/string.h>
+#include "terrain_diskcache.h"
+
+static const uint32_t s_diskCacheMagic = BX_MAKEFOURCC('T', 'D', 'C', '0');
+
+struct DiskCacheHeader
+{
+	uint32_t m_magic;
+	uint32_t m_generator;
+	uint32_t m_version;
+	uint32_t m_size;
+	uint64_t m_hash;
+};
+
+static void getEntryPath(const DiskCache& _cache, const DiskCacheKey& _key, char* _outPath, int32_t _max)
+{
+	const char* generator = (const char*)&_key.m_generator;
+	bx::snprintf(_outPath, _max, "%s/%c%c%c%c_%u_%016llx.bin"
+		, _cache.m_dir
+		, generator[0], generator[1], generator[2], generator[3]
+		, _key.m_version
+		, (unsigned long long)_key.m_hash
+		);
+}
+
+void diskCacheCreate(DiskCache& _cache, const char* _dir)
+{
+	bx::memSet(&_cache, 0, sizeof(_cache) );
+	bx::strCopy(_cache.m_dir, BX_COUNTOF(_cache.m_dir), _dir);
+
+	_cache.m_enabled = fileMakeDir(_dir);
+	if (!_cache.m_enabled)
+	{
+		BX_TRACE("Disk cache directory %s can't be created, cache is disabled.", _dir);
+	}
+}
+
+void diskCacheDestroy(DiskCache& _cache)
+{
+	_cache.m_enabled = false;
+}
+
+bool diskCacheMap(DiskCache& _cache, const DiskCacheKey& _key, DiskCacheView& _outView)
+{
+	_outView.m_data = NULL;
+	_outView.m_size = 0;
+	if (!_cache.m_enabled)
+	{
+		return false;
+	}
+
+	char path[512];
+	getEntryPath(_cache, _key, path, BX_COUNTOF(path) );
+	if (!fileMap(_outView.m_mapping, path) )
+	{
+		bx::atomicFetchAndAdd(&_cache.m_numMisses, 1u);
+		return false;
+	}
+
+	// name matches, header must too, anything else is a foreign or truncated file
+	const DiskCacheHeader* header = (const DiskCacheHeader*)_outView.m_mapping.m_data;
+	if (sizeof(DiskCacheHeader) > _outView.m_mapping.m_size
+	||  s_diskCacheMagic != header->m_magic
+	||  _key.m_generator != header->m_generator
+	||  _key.m_version   != header->m_version
+	||  _key.m_hash      != header->m_hash
+	||  sizeof(DiskCacheHeader) + header->m_size != _outView.m_mapping.m_size)
+	{
+		BX_TRACE("Disk cache entry %s is invalid.", path);
+		diskCacheUnmap(_outView);
+		bx::atomicFetchAndAdd(&_cache.m_numMisses, 1u);
+		return false;
+	}
+
+	_outView.m_data = header + 1;
+	_outView.m_size = header->m_size;
+	bx::atomicFetchAndAdd(&_cache.m_numHits, 1u);
+	bx::atomicFetchAndAdd(&_cache.m_bytesRead, uint64_t(header->m_size) );
+	return true;
+}
+
+void diskCacheUnmap(DiskCacheView& _view)
+{
+	fileUnmap(_view.m_mapping);
+	_view.m_data = NULL;
+	_view.m_size = 0;
+}
+
+void diskCacheWrite(DiskCache& _cache, const DiskCacheKey& _key, const void* _data, uint32_t _size)
+{
+	if (!_cache.m_enabled)
+	{
+		return;
+	}
+
+	char path[512];
+	getEntryPath(_cache, _key, path, BX_COUNTOF(path) );
+
+	// threads writing the same entry each use their own temporary file
+	char tempPath[512];
+	bx::snprintf(tempPath, BX_COUNTOF(tempPath), "%s.%u.tmp", path, bx::getTid() );
+
+	FILE* file = fopen(tempPath, "wb");
+	if (NULL == file)
+	{
+		BX_TRACE("Disk cache entry %s can't be written.", tempPath);
+		return;
+	}
+
+	DiskCacheHeader header;
+	header.m_magic     = s_diskCacheMagic;
+	header.m_generator = _key.m_generator;
+	header.m_version   = _key.m_version;
+	header.m_size      = _size;
+	header.m_hash      = _key.m_hash;
+	const bool written = 1 == fwrite(&header, sizeof(header), 1, file)
+		&& 1 == fwrite(_data, _size, 1, file)
+		;
+	const bool closed = 0 == fclose(file);
+	const bool renamed = written && closed && fileReplace(tempPath, path);
+
+	if (!renamed)
+	{
+		BX_TRACE("Disk cache entry %s can't be written.", path);
+		remove(tempPath);
+		return;
+	}
+
+	bx::atomicFetchAndAdd(&_cache.m_numWrites, 1u);
+	bx::atomicFetchAndAdd(&_cache.m_bytesWritten, uint64_t(_size) );
+}
+
+void diskCacheRemove(DiskCache& _cache, const DiskCacheKey& _key)
+{
+	if (!_cache.m_enabled)
+	{
+		return;
+	}
+
+	char path[512];
+	getEntryPath(_cache, _key, path, BX_COUNTOF(path) );
+	if (0 == remove(path) )
+	{
+		bx::atomicFetchAndAdd(&_cache.m_numRemoved, 1u);
+	}
+}
+
+uint64_t diskCacheHash(const void* _data, uint32_t _size, uint64_t _seed)
+{
+	bx::HashMurmur2A lo;
+	bx::HashMurmur2A hi;
+	lo.begin(uint32_t(_seed) );
+	hi.begin(uint32_t(_seed >> 32) ^ 0x9e3779b9);
+	lo.add(_data, int32_t(_size) );
+	hi.add(_data, int32_t(_size) );
+	return uint64_t(hi.end() ) << 32 | lo.end();
+}
+
+uint64_t diskCacheHashHeights(const uint16_t* _heights, uint32_t _width, const TileRect& _rect, const TileRect& _tile, uint64_t _seed)
+{
+	const int32_t placement[] =
+	{
+		_tile.m_x0 - _rect.m_x0,
+		_tile.m_y0 - _rect.m_y0,
+		_tile.m_x1 - _tile.m_x0,
+		_tile.m_y1 - _tile.m_y0,
+		_rect.m_x1 - _rect.m_x0,
+		_rect.m_y1 - _rect.m_y0,
+	};
+	uint64_t hash = diskCacheHash(placement, sizeof(placement), _seed);
+
+	for (int32_t yy = _rect.m_y0; yy < _rect.m_y1; ++yy)
+	{
+		hash = diskCacheHash(&_heights[_rect.m_x0 + yy * _width], uint32_t(_rect.m_x1 - _rect.m_x0) * sizeof(uint16_t), hash);
+	}
+
+	return hash;
+}
@@ -0,0 +1,73 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_DISKCACHE_H_HEADER_GUARD
+#define TERRAIN_DISKCACHE_H_HEADER_GUARD
+
+#include "terrain_file.h"
+#include "terrain_tiles.h"
+
+/// Entry of derived data. m_hash covers everything the generator read, so an entry is found
+/// again only for the same input, and m_version is bumped whenever the generator changes
+/// what it writes.
+struct DiskCacheKey
+{
+	uint32_t m_generator;  //!< FourCC.
+	uint32_t m_version;
+	uint64_t m_hash;
+};
+
+/// Entry mapped into memory, see diskCacheMap.
+struct DiskCacheView
+{
+	const void* m_data;
+	uint32_t    m_size;
+	FileMapping m_mapping;
+};
+
+/// Derived terrain data kept on disk between runs, one file per entry named after its key.
+/// Entries are written by loader threads right after they are computed and are mapped into
+/// memory when read, so a warm start costs a page in per tile instead of recomputing it.
+/// Files are written under a temporary name and renamed, so a crash never leaves a partial
+/// entry behind. Safe to use from any thread.
+struct DiskCache
+{
+	char     m_dir[256];
+	bool     m_enabled;
+
+	uint32_t m_numHits;
+	uint32_t m_numMisses;
+	uint32_t m_numWrites;
+	uint32_t m_numRemoved;
+	uint64_t m_bytesRead;
+	uint64_t m_bytesWritten;
+};
+
+/// Creates _dir if it doesn't exist yet. Cache is disabled if that fails.
+void diskCacheCreate(DiskCache& _cache, const char* _dir);
+
+///
+void diskCacheDestroy(DiskCache& _cache);
+
+/// Maps entry of _key and fills _outView. Returns false if there is no valid entry.
+bool diskCacheMap(DiskCache& _cache, const DiskCacheKey& _key, DiskCacheView& _outView);
+
+///
+void diskCacheUnmap(DiskCacheView& _view);
+
+/// Writes entry of _key, replacing any previous one. Blocks on file I/O, call it from a loader
+/// thread.
+void diskCacheWrite(DiskCache& _cache, const DiskCacheKey& _key, const void* _data, uint32_t _size);
+
+/// Deletes entry of _key, data it was derived from changed.
+void diskCacheRemove(DiskCache& _cache, const DiskCacheKey& _key);
+
+/// 64 bit hash of _data, continuing from _seed.
+uint64_t diskCacheHash(const void* _data, uint32_t _size, uint64_t _seed);
+
+/// Hashes heights in _rect of a _width texels wide map together with where _rect lies
+/// relative to _tile, so equal terrain hashes the same wherever it is on the map.
+uint64_t diskCacheHashHeights(const uint16_t* _heights, uint32_t _width, const TileRect& _rect, const TileRect& _tile, uint64_t _seed);
+
+#endif // TERRAIN_DISKCACHE_H_HEADER_GUARD
@@ -0,0 +1,431 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <stdio.h>
+#include <bx/hash.h>
+#include <bx/string.h>
+#include <bx/timer.h>
+#include "asset_loader.h"
+#include "height_codec.h"
+#include "terrain_document.h"
+#include "terrain_file.h"
+#include "terrain_memory.h"
+
+struct DocumentHeader
+{
+	static constexpr uint32_t kMagic   = BX_MAKEFOURCC('T', 'D', 'O', 'C');
+	static constexpr uint32_t kVersion = 1;
+
+	uint32_t m_magic;
+	uint32_t m_version;
+	uint32_t m_width;
+	uint32_t m_height;
+	uint32_t m_tileSize;
+	uint32_t m_numSaves;
+	uint32_t m_checksum;  //!< Of the tile table following the header.
+};
+
+struct DocumentJob
+{
+	TerrainDocument* m_doc;
+	uint32_t  m_save;          //!< Save being written, 0 when loading.
+	uint32_t* m_tileSaves;     //!< Table of the manifest written or read.
+	uint32_t* m_tiles;         //!< Tiles written.
+	uint32_t* m_prevSaves;     //!< Per tile written, save it replaces.
+	uint16_t* m_heights;       //!< Saving: written tiles, packed. Loading: whole map.
+	uint32_t  m_numTiles;
+	DocumentLoadedFn m_loaded;
+	void*     m_userData;
+	bool      m_failed;
+	uint32_t  m_numBytes;
+	float     m_copyMs;
+	float     m_ioMs;
+};
+
+static float toMilliseconds(int64_t _ticks)
+{
+	return float(double(_ticks) * 1000.0 / double(bx::getHPFrequency() ) );
+}
+
+static uint32_t getNumTiles(const TileGrid& _grid)
+{
+	return _grid.m_numTilesX * _grid.m_numTilesY;
+}
+
+static uint32_t getTableChecksum(const uint32_t* _tileSaves, uint32_t _num)
+{
+	bx::HashMurmur2A hash;
+	hash.begin();
+	hash.add(_tileSaves, int32_t(_num * sizeof(uint32_t) ) );
+	return hash.end();
+}
+
+void documentGetTilePath(const TerrainDocument& _doc, uint32_t _tile, uint32_t _save, char* _outPath, int32_t _max)
+{
+	bx::snprintf(_outPath, _max, "%s/tile_%u_%u_%u.htc"
+		, _doc.m_path
+		, _tile % _doc.m_grid.m_numTilesX
+		, _tile / _doc.m_grid.m_numTilesX
+		, _save
+		);
+}
+
+static DocumentJob* createJob(TerrainDocument& _doc, uint32_t _numTiles, uint32_t _numHeights)
+{
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::HeightMap);
+	const uint32_t numTiles = getNumTiles(_doc.m_grid);
+
+	DocumentJob* job = (DocumentJob*)BX_ALLOC(allocator, sizeof(DocumentJob) );
+	bx::memSet(job, 0, sizeof(DocumentJob) );
+	job->m_doc       = &_doc;
+	job->m_tileSaves = (uint32_t*)BX_ALLOC(allocator, numTiles * sizeof(uint32_t) );
+	job->m_tiles     = (uint32_t*)BX_ALLOC(allocator, bx::max(_numTiles, 1u) * sizeof(uint32_t) );
+	job->m_prevSaves = (uint32_t*)BX_ALLOC(allocator, bx::max(_numTiles, 1u) * sizeof(uint32_t) );
+	job->m_heights   = (uint16_t*)BX_ALLOC(allocator, bx::max(_numHeights, 1u) * sizeof(uint16_t) );
+	_doc.m_job = job;
+	return job;
+}
+
+static void destroyJob(DocumentJob* _job)
+{
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::HeightMap);
+	_job->m_doc->m_job = NULL;
+	BX_FREE(allocator, _job->m_heights);
+	BX_FREE(allocator, _job->m_prevSaves);
+	BX_FREE(allocator, _job->m_tiles);
+	BX_FREE(allocator, _job->m_tileSaves);
+	BX_FREE(allocator, _job);
+}
+
+static bool writeFile(const char* _path, const void* _header, uint32_t _headerSize, const void* _data, uint32_t _size)
+{
+	FILE* file = fopen(_path, "wb");
+	if (NULL == file)
+	{
+		return false;
+	}
+
+	const bool written = 1 == fwrite(_header, _headerSize, 1, file)
+		&& (0 == _size || 1 == fwrite(_data, _size, 1, file) )
+		&& fileSync(file)
+		;
+	return 0 == fclose(file) && written;
+}
+
+// Reads table of tile saves and number of saves from the manifest of _doc. Fails if there is no
+// manifest or it doesn't match the document.
+static bool readManifest(const TerrainDocument& _doc, uint32_t* _outTileSaves, uint32_t& _outNumSaves)
+{
+	const TileGrid& grid = _doc.m_grid;
+	const uint32_t numTiles = getNumTiles(grid);
+
+	char path[512];
+	bx::snprintf(path, BX_COUNTOF(path), "%s/manifest", _doc.m_path);
+
+	FileMapping manifest;
+	if (!fileMap(manifest, path) )
+	{
+		return false;
+	}
+
+	const DocumentHeader* header = (const DocumentHeader*)manifest.m_data;
+	const uint32_t* tileSaves = (const uint32_t*)(header + 1);
+	const bool valid = sizeof(DocumentHeader) + numTiles * sizeof(uint32_t) == manifest.m_size
+		&& DocumentHeader::kMagic   == header->m_magic
+		&& DocumentHeader::kVersion == header->m_version
+		&& grid.m_width    == header->m_width
+		&& grid.m_height   == header->m_height
+		&& grid.m_tileSize == header->m_tileSize
+		&& getTableChecksum(tileSaves, numTiles) == header->m_checksum
+		;
+
+	if (valid)
+	{
+		bx::memCopy(_outTileSaves, tileSaves, numTiles * sizeof(uint32_t) );
+		_outNumSaves = header->m_numSaves;
+	}
+	fileUnmap(manifest);
+	return valid;
+}
+
+static void saveJob(void* _userData)
+{
+	DocumentJob* job = (DocumentJob*)_userData;
+	const TerrainDocument& doc = *job->m_doc;
+	const TileGrid& grid = doc.m_grid;
+	const int64_t start = bx::getHPCounter();
+
+	job->m_failed = !fileMakeDir(doc.m_path);
+
+	// tiles first, nothing refers to them until the manifest is replaced
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::HeightMap);
+	const uint32_t bound = heightTileCompressBound(grid.m_tileSize, grid.m_tileSize);
+	uint8_t* compressed = (uint8_t*)BX_ALLOC(allocator, bound);
+	for (uint32_t ii = 0; ii < job->m_numTiles && !job->m_failed; ++ii)
+	{
+		const TileRect rect = tileGridTileRect(grid, job->m_tiles[ii] % grid.m_numTilesX, job->m_tiles[ii] / grid.m_numTilesX);
+		const uint32_t size = heightTileCompress(compressed, bound
+			, &job->m_heights[ii * grid.m_tileSize * grid.m_tileSize]
+			, uint32_t(rect.m_x1 - rect.m_x0)
+			, uint32_t(rect.m_y1 - rect.m_y0)
+			, grid.m_tileSize
+			, 0
+			);
+
+		char path[512];
+		documentGetTilePath(doc, job->m_tiles[ii], job->m_save, path, BX_COUNTOF(path) );
+		job->m_failed = 0 == size || !writeFile(path, compressed, size, NULL, 0);
+		job->m_numBytes += size;
+	}
+	BX_FREE(allocator, compressed);
+
+	if (!job->m_failed)
+	{
+		DocumentHeader header;
+		header.m_magic    = DocumentHeader::kMagic;
+		header.m_version  = DocumentHeader::kVersion;
+		header.m_width    = grid.m_width;
+		header.m_height   = grid.m_height;
+		header.m_tileSize = grid.m_tileSize;
+		header.m_numSaves = job->m_save;
+		header.m_checksum = getTableChecksum(job->m_tileSaves, getNumTiles(grid) );
+
+		char path[512];
+		char tempPath[512];
+		bx::snprintf(path, BX_COUNTOF(path), "%s/manifest", doc.m_path);
+		bx::snprintf(tempPath, BX_COUNTOF(tempPath), "%s/manifest.tmp", doc.m_path);
+		job->m_failed = !writeFile(tempPath, &header, sizeof(header), job->m_tileSaves, getNumTiles(grid) * sizeof(uint32_t) )
+			|| !fileReplace(tempPath, path)
+			;
+	}
+
+	// committed, files of replaced tiles aren't referenced any more
+	for (uint32_t ii = 0; ii < job->m_numTiles && !job->m_failed; ++ii)
+	{
+		if (0 != job->m_prevSaves[ii])
+		{
+			char path[512];
+			documentGetTilePath(doc, job->m_tiles[ii], job->m_prevSaves[ii], path, BX_COUNTOF(path) );
+			remove(path);
+		}
+	}
+
+	job->m_ioMs = toMilliseconds(bx::getHPCounter() - start);
+}
+
+static void saveDone(void* _userData)
+{
+	DocumentJob* job = (DocumentJob*)_userData;
+	TerrainDocument& doc = *job->m_doc;
+
+	if (job->m_failed)
+	{
+		BX_TRACE("Saving terrain to %s failed.", doc.m_path);
+		for (uint32_t ii = 0; ii < job->m_numTiles; ++ii)
+		{
+			doc.m_numDirty += 0 == doc.m_dirty[job->m_tiles[ii]] ? 1 : 0;
+			doc.m_dirty[job->m_tiles[ii]] = 1;
+		}
+	}
+	else
+	{
+		bx::memCopy(doc.m_tileSaves, job->m_tileSaves, getNumTiles(doc.m_grid) * sizeof(uint32_t) );
+		doc.m_numSaves = job->m_save;
+	}
+
+	doc.m_failed   = job->m_failed;
+	doc.m_numTiles = job->m_numTiles;
+	doc.m_numBytes = job->m_numBytes;
+	doc.m_copyMs   = job->m_copyMs;
+	doc.m_ioMs     = job->m_ioMs;
+	destroyJob(job);
+}
+
+static void loadJob(void* _userData)
+{
+	DocumentJob* job = (DocumentJob*)_userData;
+	const TerrainDocument& doc = *job->m_doc;
+	const TileGrid& grid = doc.m_grid;
+	const uint32_t numTiles = getNumTiles(grid);
+	const int64_t start = bx::getHPCounter();
+
+	job->m_failed = !readManifest(doc, job->m_tileSaves, job->m_save);
+
+	char path[512];
+	for (uint32_t ii = 0; ii < numTiles && !job->m_failed; ++ii)
+	{
+		documentGetTilePath(doc, ii, job->m_tileSaves[ii], path, BX_COUNTOF(path) );
+
+		FileMapping tile;
+		job->m_failed = !fileMap(tile, path);
+		if (!job->m_failed)
+		{
+			const TileRect rect = tileGridTileRect(grid, ii % grid.m_numTilesX, ii / grid.m_numTilesX);
+			job->m_failed = !heightTileDecompress(&job->m_heights[rect.m_x0 + rect.m_y0 * grid.m_width]
+				, uint32_t(rect.m_x1 - rect.m_x0)
+				, uint32_t(rect.m_y1 - rect.m_y0)
+				, grid.m_width
+				, tile.m_data
+				, tile.m_size
+				);
+			job->m_numBytes += tile.m_size;
+			fileUnmap(tile);
+		}
+	}
+
+	job->m_numTiles = numTiles;
+	job->m_ioMs = toMilliseconds(bx::getHPCounter() - start);
+}
+
+static void loadDone(void* _userData)
+{
+	DocumentJob* job = (DocumentJob*)_userData;
+	TerrainDocument& doc = *job->m_doc;
+
+	if (job->m_failed)
+	{
+		BX_TRACE("Loading terrain from %s failed.", doc.m_path);
+	}
+	else
+	{
+		bx::memCopy(doc.m_tileSaves, job->m_tileSaves, getNumTiles(doc.m_grid) * sizeof(uint32_t) );
+		bx::memSet(doc.m_dirty, 0, getNumTiles(doc.m_grid) );
+		doc.m_numDirty = 0;
+		doc.m_numSaves = job->m_save;
+	}
+
+	doc.m_failed   = job->m_failed;
+	doc.m_numTiles = job->m_numTiles;
+	doc.m_numBytes = job->m_numBytes;
+	doc.m_copyMs   = 0.0f;
+	doc.m_ioMs     = job->m_ioMs;
+
+	DocumentLoadedFn loaded = job->m_loaded;
+	void* userData = job->m_userData;
+	const uint16_t* heights = job->m_failed ? NULL : job->m_heights;
+	loaded(heights, userData);
+	destroyJob(job);
+}
+
+void documentCreate(TerrainDocument& _doc, const char* _path, uint32_t _width, uint32_t _height, uint32_t _tileSize)
+{
+	bx::strCopy(_doc.m_path, BX_COUNTOF(_doc.m_path), _path);
+	tileGridInit(_doc.m_grid, _width, _height, _tileSize);
+
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::HeightMap);
+	const uint32_t numTiles = getNumTiles(_doc.m_grid);
+	_doc.m_dirty     = (uint8_t*)BX_ALLOC(allocator, numTiles);
+	_doc.m_tileSaves = (uint32_t*)BX_ALLOC(allocator, numTiles * sizeof(uint32_t) );
+	bx::memSet(_doc.m_dirty, 1, numTiles);
+
+	// Saves of an earlier session continue its numbering. Their tile files stay referenced by
+	// the manifest until the next save commits, and are removed after that.
+	_doc.m_numDirty = numTiles;
+	if (!readManifest(_doc, _doc.m_tileSaves, _doc.m_numSaves) )
+	{
+		bx::memSet(_doc.m_tileSaves, 0, numTiles * sizeof(uint32_t) );
+		_doc.m_numSaves = 0;
+	}
+	_doc.m_job      = NULL;
+	_doc.m_failed   = false;
+	_doc.m_numTiles = 0;
+	_doc.m_numBytes = 0;
+	_doc.m_copyMs   = 0.0f;
+	_doc.m_ioMs     = 0.0f;
+}
+
+void documentDestroy(TerrainDocument& _doc)
+{
+	BX_CHECK(NULL == _doc.m_job, "Job is running, destroy asset loader first.");
+
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::HeightMap);
+	BX_FREE(allocator, _doc.m_tileSaves);
+	BX_FREE(allocator, _doc.m_dirty);
+	_doc.m_dirty = NULL;
+}
+
+void documentInvalidate(TerrainDocument& _doc, const TileRect& _rect)
+{
+	uint32_t x0, y0, x1, y1;
+	if (!tileGridRange(_doc.m_grid, _rect, x0, y0, x1, y1) )
+	{
+		return;
+	}
+
+	for (uint32_t yy = y0; yy < y1; ++yy)
+	{
+		for (uint32_t xx = x0; xx < x1; ++xx)
+		{
+			uint8_t& dirty = _doc.m_dirty[xx + yy * _doc.m_grid.m_numTilesX];
+			_doc.m_numDirty += 0 == dirty ? 1 : 0;
+			dirty = 1;
+		}
+	}
+}
+
+bool documentSave(TerrainDocument& _doc, const Heightfield& _field)
+{
+	const TileGrid& grid = _doc.m_grid;
+	BX_CHECK(_field.m_width == grid.m_width && _field.m_height == grid.m_height, "Height field doesn't match document.");
+	if (NULL != _doc.m_job)
+	{
+		return false;
+	}
+
+	if (0 == _doc.m_numDirty)
+	{
+		_doc.m_failed   = false;
+		_doc.m_numTiles = 0;
+		_doc.m_numBytes = 0;
+		_doc.m_copyMs   = 0.0f;
+		_doc.m_ioMs     = 0.0f;
+		return true;
+	}
+
+	const int64_t start = bx::getHPCounter();
+	const uint32_t tileTexels = grid.m_tileSize * grid.m_tileSize;
+	DocumentJob* job = createJob(_doc, _doc.m_numDirty, _doc.m_numDirty * tileTexels);
+	job->m_save = _doc.m_numSaves + 1;
+	bx::memCopy(job->m_tileSaves, _doc.m_tileSaves, getNumTiles(grid) * sizeof(uint32_t) );
+
+	for (uint32_t tile = 0; tile < getNumTiles(grid); ++tile)
+	{
+		if (0 == _doc.m_dirty[tile])
+		{
+			continue;
+		}
+
+		const TileRect rect = tileGridTileRect(grid, tile % grid.m_numTilesX, tile / grid.m_numTilesX);
+		uint16_t* dst = &job->m_heights[job->m_numTiles * tileTexels];
+		for (int32_t yy = rect.m_y0; yy < rect.m_y1; ++yy)
+		{
+			bx::memCopy(&dst[(yy - rect.m_y0) * grid.m_tileSize], &_field.m_heights[rect.m_x0 + yy * grid.m_width], (rect.m_x1 - rect.m_x0) * sizeof(uint16_t) );
+		}
+
+		job->m_tiles[job->m_numTiles] = tile;
+		job->m_prevSaves[job->m_numTiles] = _doc.m_tileSaves[tile];
+		job->m_tileSaves[tile] = job->m_save;
+		++job->m_numTiles;
+		_doc.m_dirty[tile] = 0;
+	}
+	_doc.m_numDirty = 0;
+
+	job->m_copyMs = toMilliseconds(bx::getHPCounter() - start);
+	assetSubmitJob(saveJob, saveDone, job);
+	return true;
+}
+
+bool documentLoad(TerrainDocument& _doc, DocumentLoadedFn _loaded, void* _userData)
+{
+	if (NULL != _doc.m_job)
+	{
+		return false;
+	}
+
+	DocumentJob* job = createJob(_doc, 0, _doc.m_grid.m_width * _doc.m_grid.m_height);
+	job->m_loaded   = _loaded;
+	job->m_userData = _userData;
+	assetSubmitJob(loadJob, loadDone, job);
+	return true;
+}
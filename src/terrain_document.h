@@ -0,0 +1,68 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_DOCUMENT_H_HEADER_GUARD
+#define TERRAIN_DOCUMENT_H_HEADER_GUARD
+
+#include "terrain_heightfield.h"
+
+struct DocumentJob;
+
+/// Runs on the API thread when a load finished. _heights holds the whole map, or is NULL if
+/// the document couldn't be read. Valid only during the call.
+typedef void (*DocumentLoadedFn)(const uint16_t* _heights, void* _userData);
+
+/// Sculpted height map saved to a directory. Every tile is a losslessly compressed file named
+/// after the save that wrote it, and a manifest lists the file of each tile. A save writes only
+/// tiles edited since the previous one, syncs them to disk and then commits them by replacing
+/// the manifest in one rename. Files of the previous save stay untouched until the new manifest
+/// is in place, so a crash at any point leaves the previous save intact.
+///
+/// Dirty tiles are copied on the API thread, compressing and writing happens on a loader
+/// thread. Edits made while a save runs go into the next one.
+struct TerrainDocument
+{
+	char      m_path[256];
+	TileGrid  m_grid;
+	uint8_t*  m_dirty;            //!< Per tile, edited since the last save started.
+	uint32_t* m_tileSaves;        //!< Per tile, save whose file the manifest on disk lists.
+	uint32_t  m_numDirty;
+	uint32_t  m_numSaves;         //!< Saves committed to m_path.
+	DocumentJob* m_job;           //!< Save or load running, NULL if none.
+
+	// last finished save or load
+	bool      m_failed;
+	uint32_t  m_numTiles;         //!< Tiles written or read.
+	uint32_t  m_numBytes;
+	float     m_copyMs;           //!< On the API thread.
+	float     m_ioMs;             //!< On the loader thread.
+};
+
+/// Document of a _width x _height map at _path, all tiles dirty. Continues numbering of saves
+/// already in _path, so no save of this session writes over files its manifest lists.
+void documentCreate(TerrainDocument& _doc, const char* _path, uint32_t _width, uint32_t _height, uint32_t _tileSize);
+
+/// Call after assetLoaderDestroy, which finishes a running save or load.
+void documentDestroy(TerrainDocument& _doc);
+
+/// Marks tiles of texels in _rect as edited.
+void documentInvalidate(TerrainDocument& _doc, const TileRect& _rect);
+
+/// Starts saving dirty tiles of _field. Returns false if a save or load is still running.
+bool documentSave(TerrainDocument& _doc, const Heightfield& _field);
+
+/// Starts reading the whole map, _loaded gets it from assetLoaderUpdate. All tiles are clean
+/// after a successful load. Returns false if a save or load is still running.
+bool documentLoad(TerrainDocument& _doc, DocumentLoadedFn _loaded, void* _userData);
+
+/// Writes path of the file of _tile written by save _save into _outPath.
+void documentGetTilePath(const TerrainDocument& _doc, uint32_t _tile, uint32_t _save, char* _outPath, int32_t _max);
+
+///
+inline bool documentIsBusy(const TerrainDocument& _doc)
+{
+	return NULL != _doc.m_job;
+}
+
+#endif // TERRAIN_DOCUMENT_H_HEADER_GUARD
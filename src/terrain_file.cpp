@@ -0,0 +1,211 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <string.h>
+#include <bx/bx.h>
+#include <bx/string.h>
+#include "terrain_file.h"
+
+#if BX_PLATFORM_WINDOWS
+#	include <direct.h>
+#	include <io.h>
+#	include <windows.h>
+#else
+#	include <dirent.h>
+#	include <fcntl.h>
+#	include <stdlib.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+bool fileMakeDir(const char* _path)
+{
+#if BX_PLATFORM_WINDOWS
+	_mkdir(_path);
+	const DWORD attributes = GetFileAttributesA(_path);
+	return INVALID_FILE_ATTRIBUTES != attributes && 0 != (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+	mkdir(_path, 0755);
+	struct stat st;
+	return 0 == stat(_path, &st) && S_ISDIR(st.st_mode);
+#endif
+}
+
+bool fileMakeTempDir(char* _outPath, int32_t _max, const char* _prefix)
+{
+#if BX_PLATFORM_WINDOWS
+	// unique name is reserved as a file, the directory takes its place
+	char dir[MAX_PATH];
+	char path[MAX_PATH];
+	if (0 == GetTempPathA(BX_COUNTOF(dir), dir)
+	||  0 == GetTempFileNameA(dir, _prefix, 0, path) )
+	{
+		return false;
+	}
+
+	DeleteFileA(path);
+	if (!CreateDirectoryA(path, NULL) )
+	{
+		return false;
+	}
+#else
+	const char* dir = getenv("TMPDIR");
+	char path[512];
+	bx::snprintf(path, BX_COUNTOF(path), "%s/%sXXXXXX", NULL != dir && '\0' != dir[0] ? dir : "/tmp", _prefix);
+	if (NULL == mkdtemp(path) )
+	{
+		return false;
+	}
+#endif
+
+	bx::strCopy(_outPath, _max, path);
+	return true;
+}
+
+void fileRemoveDir(const char* _path)
+{
+	char path[512];
+
+#if BX_PLATFORM_WINDOWS
+	bx::snprintf(path, BX_COUNTOF(path), "%s/*", _path);
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA(path, &data);
+	if (INVALID_HANDLE_VALUE != find)
+	{
+		do
+		{
+			if (0 == (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) )
+			{
+				bx::snprintf(path, BX_COUNTOF(path), "%s/%s", _path, data.cFileName);
+				DeleteFileA(path);
+			}
+		}
+		while (FindNextFileA(find, &data) );
+		FindClose(find);
+	}
+	RemoveDirectoryA(_path);
+#else
+	DIR* dir = opendir(_path);
+	if (NULL != dir)
+	{
+		for (struct dirent* entry = readdir(dir); NULL != entry; entry = readdir(dir) )
+		{
+			bx::snprintf(path, BX_COUNTOF(path), "%s/%s", _path, entry->d_name);
+			struct stat st;
+			if (0 == stat(path, &st)
+			&&  !S_ISDIR(st.st_mode) )
+			{
+				unlink(path);
+			}
+		}
+		closedir(dir);
+	}
+	rmdir(_path);
+#endif
+}
+
+bool fileSync(FILE* _file)
+{
+	if (0 != fflush(_file) )
+	{
+		return false;
+	}
+
+#if BX_PLATFORM_WINDOWS
+	return 0 == _commit(_fileno(_file) );
+#else
+	return 0 == fsync(fileno(_file) );
+#endif
+}
+
+bool fileReplace(const char* _from, const char* _to)
+{
+#if BX_PLATFORM_WINDOWS
+	return 0 != MoveFileExA(_from, _to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+	if (0 != rename(_from, _to) )
+	{
+		return false;
+	}
+
+	// rename itself is only durable once the directory holding it is
+	char dir[512];
+	bx::strCopy(dir, BX_COUNTOF(dir), _to);
+	char* slash = strrchr(dir, '/');
+	if (NULL != slash)
+	{
+		*slash = '\0';
+	}
+	else
+	{
+		bx::strCopy(dir, BX_COUNTOF(dir), ".");
+	}
+
+	const int fd = open(dir, O_RDONLY);
+	if (0 <= fd)
+	{
+		fsync(fd);
+		close(fd);
+	}
+
+	return true;
+#endif
+}
+
+bool fileMap(FileMapping& _outMapping, const char* _path)
+{
+	_outMapping.m_data = NULL;
+	_outMapping.m_size = 0;
+
+#if BX_PLATFORM_WINDOWS
+	HANDLE file = CreateFileA(_path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE != file)
+	{
+		const DWORD size = GetFileSize(file, NULL);
+		HANDLE mapping = 0 != size && INVALID_FILE_SIZE != size ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+		if (NULL != mapping)
+		{
+			_outMapping.m_data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			_outMapping.m_size = NULL != _outMapping.m_data ? uint32_t(size) : 0;
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+	}
+#else
+	const int fd = open(_path, O_RDONLY);
+	if (0 <= fd)
+	{
+		struct stat st;
+		if (0 == fstat(fd, &st)
+		&&  0 != st.st_size)
+		{
+			void* data = mmap(NULL, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if (MAP_FAILED != data)
+			{
+				_outMapping.m_data = data;
+				_outMapping.m_size = uint32_t(st.st_size);
+			}
+		}
+		close(fd);
+	}
+#endif
+
+	return NULL != _outMapping.m_data;
+}
+
+void fileUnmap(FileMapping& _mapping)
+{
+	if (NULL != _mapping.m_data)
+	{
+#if BX_PLATFORM_WINDOWS
+		UnmapViewOfFile(_mapping.m_data);
+#else
+		munmap(const_cast<void*>(_mapping.m_data), _mapping.m_size);
+#endif
+	}
+
+	_mapping.m_data = NULL;
+	_mapping.m_size = 0;
+}
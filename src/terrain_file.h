@@ -0,0 +1,41 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_FILE_H_HEADER_GUARD
+#define TERRAIN_FILE_H_HEADER_GUARD
+
+#include <stdint.h>
+#include <stdio.h>
+
+/// Read only view of a whole file.
+struct FileMapping
+{
+	const void* m_data;
+	uint32_t    m_size;
+};
+
+/// Creates directory _path, its parent must exist. Returns true if the directory exists.
+bool fileMakeDir(const char* _path);
+
+/// Creates new empty directory starting with _prefix in the temp directory of the system and
+/// writes its path to _outPath. Returns false if it can't be created.
+bool fileMakeTempDir(char* _outPath, int32_t _max, const char* _prefix);
+
+/// Removes files in directory _path and then the directory. Subdirectories aren't removed.
+void fileRemoveDir(const char* _path);
+
+/// Flushes _file all the way to the disk, not only to the OS.
+bool fileSync(FILE* _file);
+
+/// Renames _from to _to, replacing _to in one step. Readers see either the old or the new
+/// file, also after a crash.
+bool fileReplace(const char* _from, const char* _to);
+
+/// Maps file at _path into memory. Returns false if it can't be opened or is empty.
+bool fileMap(FileMapping& _outMapping, const char* _path);
+
+///
+void fileUnmap(FileMapping& _mapping);
+
+#endif // TERRAIN_FILE_H_HEADER_GUARD
@@ -0,0 +1,152 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <bx/math.h>
+#include "terrain_gbuffer.h"
+
+static const uint64_t s_targetFlags = 0
+	| BGFX_TEXTURE_RT
+	| BGFX_SAMPLER_MIN_POINT
+	| BGFX_SAMPLER_MAG_POINT
+	| BGFX_SAMPLER_MIP_POINT
+	| BGFX_SAMPLER_U_CLAMP
+	| BGFX_SAMPLER_V_CLAMP
+	;
+
+static void updateViewSize(GBuffer& _gbuffer)
+{
+	// whole steps keep the number of distinct sizes, and resolve timings, small
+	const float scale = bx::floor(_gbuffer.m_scale * 32.0f + 0.5f) / 32.0f;
+	_gbuffer.m_viewWidth  = uint16_t(bx::max(1.0f, bx::floor(_gbuffer.m_width  * scale) ) );
+	_gbuffer.m_viewHeight = uint16_t(bx::max(1.0f, bx::floor(_gbuffer.m_height * scale) ) );
+}
+
+static void createTargets(GBuffer& _gbuffer)
+{
+	bgfx::Attachment attachments[3];
+	uint8_t num = 0;
+
+	_gbuffer.m_color = bgfx::createTexture2D(_gbuffer.m_width, _gbuffer.m_height, false, 1, bgfx::TextureFormat::BGRA8, s_targetFlags);
+	attachments[num++].init(_gbuffer.m_color);
+
+	_gbuffer.m_material.idx = bgfx::kInvalidHandle;
+	if (GBufferLayout::Packed == _gbuffer.m_layout)
+	{
+		_gbuffer.m_material = bgfx::createTexture2D(_gbuffer.m_width, _gbuffer.m_height, false, 1, bgfx::TextureFormat::BGRA8, s_targetFlags);
+		attachments[num++].init(_gbuffer.m_material);
+	}
+
+	_gbuffer.m_depth = bgfx::createTexture2D(_gbuffer.m_width, _gbuffer.m_height, false, 1, bgfx::TextureFormat::D24S8, s_targetFlags);
+	attachments[num++].init(_gbuffer.m_depth);
+
+	_gbuffer.m_frameBuffer = bgfx::createFrameBuffer(num, attachments, true);
+}
+
+void gbufferCreate(GBuffer& _gbuffer, uint16_t _width, uint16_t _height, GBufferLayout::Enum _layout)
+{
+	_gbuffer.m_layout = _layout;
+	_gbuffer.m_width  = _width;
+	_gbuffer.m_height = _height;
+	_gbuffer.m_scale  = 1.0f;
+	updateViewSize(_gbuffer);
+	createTargets(_gbuffer);
+
+	_gbuffer.s_material      = bgfx::createUniform("s_gbufferMaterial", bgfx::UniformType::Sampler);
+	_gbuffer.u_gbufferParams = bgfx::createUniform("u_gbufferParams",   bgfx::UniformType::Vec4, 2);
+}
+
+void gbufferDestroy(GBuffer& _gbuffer)
+{
+	// destroys attached textures too
+	bgfx::destroy(_gbuffer.m_frameBuffer);
+	bgfx::destroy(_gbuffer.s_material);
+	bgfx::destroy(_gbuffer.u_gbufferParams);
+}
+
+void gbufferSetLayout(GBuffer& _gbuffer, GBufferLayout::Enum _layout)
+{
+	if (_layout == _gbuffer.m_layout)
+	{
+		return;
+	}
+
+	bgfx::destroy(_gbuffer.m_frameBuffer);
+	_gbuffer.m_layout = _layout;
+	createTargets(_gbuffer);
+}
+
+void gbufferResize(GBuffer& _gbuffer, uint16_t _width, uint16_t _height)
+{
+	if (_width  == _gbuffer.m_width
+	&&  _height == _gbuffer.m_height)
+	{
+		return;
+	}
+
+	bgfx::destroy(_gbuffer.m_frameBuffer);
+	_gbuffer.m_width  = _width;
+	_gbuffer.m_height = _height;
+	updateViewSize(_gbuffer);
+	createTargets(_gbuffer);
+}
+
+void gbufferSetScale(GBuffer& _gbuffer, float _scale)
+{
+	_gbuffer.m_scale = bx::clamp(_scale, 0.0f, 1.0f);
+	updateViewSize(_gbuffer);
+}
+
+void gbufferUpdateScale(GBuffer& _gbuffer, float _gpuMs, float _targetMs, float _minScale)
+{
+	if (0.0f >= _gpuMs)
+	{
+		return;
+	}
+
+	// GPU time mostly follows pixel count, sides scale with its square root. Measurements lag
+	// a few frames behind, small steps keep the scale from oscillating.
+	const float target = bx::clamp(_gbuffer.m_scale * bx::sqrt(_targetMs / _gpuMs), _minScale, 1.0f);
+	_gbuffer.m_scale = bx::lerp(_gbuffer.m_scale, target, 0.1f);
+	updateViewSize(_gbuffer);
+}
+
+uint32_t gbufferBytesPerPixel(GBufferLayout::Enum _layout)
+{
+	return GBufferLayout::Packed == _layout ? 12 : 8;
+}
+
+void gbufferSetUniforms(const GBuffer& _gbuffer, bool _brushInResolve)
+{
+	float params[8];
+	params[0] = GBufferLayout::Packed == _gbuffer.m_layout ? 1.0f : 0.0f;
+	params[1] = _brushInResolve ? 1.0f : 0.0f;
+	params[2] = 0.0f;
+	params[3] = 0.0f;
+	params[4] = float(_gbuffer.m_viewWidth)  / float(_gbuffer.m_width);
+	params[5] = float(_gbuffer.m_viewHeight) / float(_gbuffer.m_height);
+	params[6] = 1.0f / float(_gbuffer.m_width);
+	params[7] = 1.0f / float(_gbuffer.m_height);
+	bgfx::setUniform(_gbuffer.u_gbufferParams, params, 2);
+}
+
+void gbufferSetMaterialTexture(const GBuffer& _gbuffer, uint8_t _stage)
+{
+	bgfx::setTexture(_stage
+		, _gbuffer.s_material
+		, bgfx::isValid(_gbuffer.m_material) ? _gbuffer.m_material : _gbuffer.m_color
+		, BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP
+		);
+}
+
+const char* getName(GBufferLayout::Enum _layout)
+{
+	static const char* s_names[] =
+	{
+		"Lit",
+		"Packed",
+	};
+	BX_STATIC_ASSERT(BX_COUNTOF(s_names) == GBufferLayout::Count);
+
+	return s_names[_layout];
+}
@@ -0,0 +1,74 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_GBUFFER_H_HEADER_GUARD
+#define TERRAIN_GBUFFER_H_HEADER_GUARD
+
+#include <bgfx/bgfx.h>
+
+struct GBufferLayout
+{
+	enum Enum
+	{
+		Lit,    //!< Lit color with direct light fraction in alpha, depth.
+		Packed, //!< Albedo, octahedral normal with sun visibility and occlusion, depth. Lit in resolve.
+
+		Count
+	};
+};
+
+/// Targets the terrain and scatter passes draw into, read back by the resolve pass. Targets
+/// match the window, the scene is drawn into the m_viewWidth x m_viewHeight top left corner
+/// and upscaled by resolve.
+struct GBuffer
+{
+	GBufferLayout::Enum m_layout;
+	uint16_t m_width;
+	uint16_t m_height;
+	uint16_t m_viewWidth;
+	uint16_t m_viewHeight;
+	float    m_scale;      //!< Smoothed resolution scale, m_viewWidth follows it in 1/32 steps.
+
+	bgfx::TextureHandle m_color;     //!< BGRA8, lit color or albedo depending on layout.
+	bgfx::TextureHandle m_material;  //!< BGRA8, Packed layout only.
+	bgfx::TextureHandle m_depth;     //!< D24S8.
+	bgfx::FrameBufferHandle m_frameBuffer;
+
+	bgfx::UniformHandle s_material;
+	bgfx::UniformHandle u_gbufferParams;
+};
+
+///
+void gbufferCreate(GBuffer& _gbuffer, uint16_t _width, uint16_t _height, GBufferLayout::Enum _layout);
+
+///
+void gbufferDestroy(GBuffer& _gbuffer);
+
+/// Recreates targets, caller must attach m_frameBuffer to its views again.
+void gbufferSetLayout(GBuffer& _gbuffer, GBufferLayout::Enum _layout);
+
+/// Recreates targets for new window size, caller must attach m_frameBuffer to its views again.
+void gbufferResize(GBuffer& _gbuffer, uint16_t _width, uint16_t _height);
+
+/// Sets resolution scale directly, 1 renders at full resolution.
+void gbufferSetScale(GBuffer& _gbuffer, float _scale);
+
+/// Moves resolution scale towards GPU frame time _targetMs, _gpuMs is the last measured one.
+void gbufferUpdateScale(GBuffer& _gbuffer, float _gpuMs, float _targetMs, float _minScale);
+
+/// Bytes written and read per pixel by one frame, depth included.
+uint32_t gbufferBytesPerPixel(GBufferLayout::Enum _layout);
+
+/// Sets layout and rendered size for the next draw. Passes writing or reading the G-buffer must
+/// call this before every submit.
+void gbufferSetUniforms(const GBuffer& _gbuffer, bool _brushInResolve);
+
+/// Binds material target at _stage with bilinear filtering for upscaling, or color target if
+/// layout has none so the stage stays valid.
+void gbufferSetMaterialTexture(const GBuffer& _gbuffer, uint8_t _stage);
+
+///
+const char* getName(GBufferLayout::Enum _layout);
+
+#endif // TERRAIN_GBUFFER_H_HEADER_GUARD
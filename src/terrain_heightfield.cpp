@@ -0,0 +1,636 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <bx/allocator.h>
+#include <bx/simd_t.h>
+#include "terrain_heightfield.h"
+#include "terrain_memory.h"
+
+static inline uint16_t heightAt(const Heightfield& _field, int32_t _x, int32_t _y)
+{
+	const int32_t xx = bx::clamp(_x, 0, int32_t(_field.m_width)  - 1);
+	const int32_t yy = bx::clamp(_y, 0, int32_t(_field.m_height) - 1);
+	return _field.m_heights[xx + yy * _field.m_width];
+}
+
+void heightfieldCreate(Heightfield& _field, uint32_t _width, uint32_t _height, float _texelSize, float _heightScale)
+{
+	_field.m_width       = _width;
+	_field.m_height      = _height;
+	_field.m_texelSize   = _texelSize;
+	_field.m_heightScale = _heightScale;
+
+	uint32_t numCells = 0;
+	uint32_t levelWidth  = _width;
+	uint32_t levelHeight = _height;
+	_field.m_numLevels = 0;
+	for (;;)
+	{
+		BX_CHECK(_field.m_numLevels < Heightfield::kMaxLevels, "Height field %dx%d is too large.", _width, _height);
+		_field.m_levelOffset[_field.m_numLevels] = numCells;
+		_field.m_levelWidth[_field.m_numLevels]  = levelWidth;
+		_field.m_levelHeight[_field.m_numLevels] = levelHeight;
+		++_field.m_numLevels;
+		numCells += levelWidth * levelHeight;
+
+		if (1 == levelWidth && 1 == levelHeight)
+		{
+			break;
+		}
+
+		levelWidth  = (levelWidth  + 1) / 2;
+		levelHeight = (levelHeight + 1) / 2;
+	}
+
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::HeightMap);
+	_field.m_heights = (uint16_t*)BX_ALLOC(allocator, _width * _height * sizeof(uint16_t) );
+	_field.m_minMax  = (uint16_t*)BX_ALLOC(allocator, numCells * 2 * sizeof(uint16_t) );
+	bx::memSet(_field.m_heights, 0, _width * _height * sizeof(uint16_t) );
+	bx::memSet(_field.m_minMax, 0, numCells * 2 * sizeof(uint16_t) );
+}
+
+void heightfieldDestroy(Heightfield& _field)
+{
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::HeightMap);
+	BX_FREE(allocator, _field.m_heights);
+	BX_FREE(allocator, _field.m_minMax);
+	_field.m_heights = NULL;
+	_field.m_minMax  = NULL;
+	_field.m_numLevels = 0;
+}
+
+void heightfieldUpdate(Heightfield& _field, const uint16_t* _src, const TileRect& _rect)
+{
+	const TileRect full = { 0, 0, int32_t(_field.m_width), int32_t(_field.m_height) };
+	const TileRect rect = tileRectIntersect(_rect, full);
+	if (tileRectIsEmpty(rect) )
+	{
+		return;
+	}
+
+	for (int32_t yy = rect.m_y0; yy < rect.m_y1; ++yy)
+	{
+		const uint32_t offset = rect.m_x0 + yy * _field.m_width;
+		bx::memCopy(&_field.m_heights[offset], &_src[offset], (rect.m_x1 - rect.m_x0) * sizeof(uint16_t) );
+	}
+
+	heightfieldRebuild(_field, rect);
+}
+
+void heightfieldRebuild(Heightfield& _field, const TileRect& _rect)
+{
+	// cell (x, y) spans texels x..x+1, y..y+1, so texel x also bounds cell x-1
+	const TileRect full = { 0, 0, int32_t(_field.m_width), int32_t(_field.m_height) };
+	TileRect rect = { _rect.m_x0 - 1, _rect.m_y0 - 1, _rect.m_x1, _rect.m_y1 };
+	rect = tileRectIntersect(rect, full);
+	if (tileRectIsEmpty(rect) )
+	{
+		return;
+	}
+
+	uint16_t* cells = &_field.m_minMax[_field.m_levelOffset[0] * 2];
+	for (int32_t yy = rect.m_y0; yy < rect.m_y1; ++yy)
+	{
+		for (int32_t xx = rect.m_x0; xx < rect.m_x1; ++xx)
+		{
+			const uint16_t h00 = heightAt(_field, xx,     yy);
+			const uint16_t h10 = heightAt(_field, xx + 1, yy);
+			const uint16_t h01 = heightAt(_field, xx,     yy + 1);
+			const uint16_t h11 = heightAt(_field, xx + 1, yy + 1);
+
+			uint16_t* cell = &cells[(xx + yy * _field.m_width) * 2];
+			cell[0] = bx::min(bx::min(h00, h10), bx::min(h01, h11) );
+			cell[1] = bx::max(bx::max(h00, h10), bx::max(h01, h11) );
+		}
+	}
+
+	for (uint32_t level = 1; level < _field.m_numLevels; ++level)
+	{
+		const uint32_t childWidth  = _field.m_levelWidth[level - 1];
+		const uint32_t childHeight = _field.m_levelHeight[level - 1];
+		const uint16_t* children = &_field.m_minMax[_field.m_levelOffset[level - 1] * 2];
+		uint16_t* parents = &_field.m_minMax[_field.m_levelOffset[level] * 2];
+
+		rect.m_x0 = rect.m_x0 / 2;
+		rect.m_y0 = rect.m_y0 / 2;
+		rect.m_x1 = (rect.m_x1 + 1) / 2;
+		rect.m_y1 = (rect.m_y1 + 1) / 2;
+
+		for (int32_t yy = rect.m_y0; yy < rect.m_y1; ++yy)
+		{
+			for (int32_t xx = rect.m_x0; xx < rect.m_x1; ++xx)
+			{
+				uint16_t minHeight = UINT16_MAX;
+				uint16_t maxHeight = 0;
+
+				const uint32_t x1 = bx::min<uint32_t>(xx * 2 + 2, childWidth);
+				const uint32_t y1 = bx::min<uint32_t>(yy * 2 + 2, childHeight);
+				for (uint32_t cy = yy * 2; cy < y1; ++cy)
+				{
+					for (uint32_t cx = xx * 2; cx < x1; ++cx)
+					{
+						const uint16_t* child = &children[(cx + cy * childWidth) * 2];
+						minHeight = bx::min(minHeight, child[0]);
+						maxHeight = bx::max(maxHeight, child[1]);
+					}
+				}
+
+				uint16_t* parent = &parents[(xx + yy * _field.m_levelWidth[level]) * 2];
+				parent[0] = minHeight;
+				parent[1] = maxHeight;
+			}
+		}
+	}
+}
+
+void heightfieldGetRange(const Heightfield& _field, float& _outMin, float& _outMax)
+{
+	const uint16_t* root = &_field.m_minMax[_field.m_levelOffset[_field.m_numLevels - 1] * 2];
+	_outMin = root[0] * _field.m_heightScale;
+	_outMax = root[1] * _field.m_heightScale;
+}
+
+void heightfieldGetRectRange(const Heightfield& _field, float _minX, float _minZ, float _maxX, float _maxZ, float& _outMin, float& _outMax)
+{
+	// level 0 cell x spans world (x + 0.5) * texelSize to (x + 1.5) * texelSize, outside of
+	// texel centres heights are clamped, so border cells bound those areas too
+	const float invTexelSize = 1.0f / _field.m_texelSize;
+	int32_t x0 = bx::clamp(int32_t(bx::ceil(_minX * invTexelSize - 1.5f) ), 0, int32_t(_field.m_width)  - 1);
+	int32_t y0 = bx::clamp(int32_t(bx::ceil(_minZ * invTexelSize - 1.5f) ), 0, int32_t(_field.m_height) - 1);
+	int32_t x1 = bx::clamp(int32_t(bx::floor(_maxX * invTexelSize - 0.5f) ), x0, int32_t(_field.m_width)  - 1);
+	int32_t y1 = bx::clamp(int32_t(bx::floor(_maxZ * invTexelSize - 0.5f) ), y0, int32_t(_field.m_height) - 1);
+
+	uint32_t level = 0;
+	while (level + 1 < _field.m_numLevels
+	&&    (x1 - x0 > 1 || y1 - y0 > 1) )
+	{
+		x0 >>= 1;
+		y0 >>= 1;
+		x1 >>= 1;
+		y1 >>= 1;
+		++level;
+	}
+
+	uint16_t minHeight = UINT16_MAX;
+	uint16_t maxHeight = 0;
+	const uint16_t* cells = &_field.m_minMax[_field.m_levelOffset[level] * 2];
+	for (int32_t yy = y0; yy <= y1; ++yy)
+	{
+		for (int32_t xx = x0; xx <= x1; ++xx)
+		{
+			const uint16_t* cell = &cells[(xx + yy * _field.m_levelWidth[level]) * 2];
+			minHeight = bx::min(minHeight, cell[0]);
+			maxHeight = bx::max(maxHeight, cell[1]);
+		}
+	}
+
+	_outMin = minHeight * _field.m_heightScale;
+	_outMax = maxHeight * _field.m_heightScale;
+}
+
+// Ray is traced in texel space: x and z in texels relative to texel centres, y in height map
+// units, t in world units.
+struct TexelRay
+{
+	float m_origin[3];
+	float m_dir[3];
+};
+
+static bool clipSlab(float _origin, float _dir, float _min, float _max, float& _tMin, float& _tMax)
+{
+	if (0.0f == _dir)
+	{
+		return _origin >= _min && _origin <= _max;
+	}
+
+	const float invDir = 1.0f / _dir;
+	float t0 = (_min - _origin) * invDir;
+	float t1 = (_max - _origin) * invDir;
+	if (t0 > t1)
+	{
+		bx::swap(t0, t1);
+	}
+
+	_tMin = bx::max(_tMin, t0);
+	_tMax = bx::min(_tMax, t1);
+	return _tMin <= _tMax;
+}
+
+// Height along the ray inside a bilinear cell is quadratic in t, so the first crossing is
+// the smallest root of ray height - surface height in [_t0, _t1].
+static bool intersectCell(const Heightfield& _field, const TexelRay& _ray, int32_t _x, int32_t _y, float _t0, float _t1, float& _outT)
+{
+	const float h00 = float(heightAt(_field, _x,     _y) );
+	const float h10 = float(heightAt(_field, _x + 1, _y) );
+	const float h01 = float(heightAt(_field, _x,     _y + 1) );
+	const float h11 = float(heightAt(_field, _x + 1, _y + 1) );
+	const float aa = h10 - h00;
+	const float bb = h01 - h00;
+	const float cc = h00 - h10 - h01 + h11;
+
+	const float u0 = _ray.m_origin[0] + _ray.m_dir[0] * _t0 - float(_x);
+	const float v0 = _ray.m_origin[2] + _ray.m_dir[2] * _t0 - float(_y);
+	const float y0 = _ray.m_origin[1] + _ray.m_dir[1] * _t0;
+	const float du = _ray.m_dir[0];
+	const float dv = _ray.m_dir[2];
+
+	const float c = y0 - (h00 + aa * u0 + bb * v0 + cc * u0 * v0);
+	if (0.0f >= c)
+	{
+		_outT = _t0;
+		return true;
+	}
+
+	const float b = _ray.m_dir[1] - (aa * du + bb * dv + cc * (u0 * dv + v0 * du) );
+	const float a = -cc * du * dv;
+	const float sMax = _t1 - _t0;
+
+	float s = sMax + 1.0f;
+	if (bx::abs(a) * sMax < 1e-6f * bx::abs(b) || 0.0f == a)
+	{
+		if (0.0f > b)
+		{
+			s = -c / b;
+		}
+	}
+	else
+	{
+		const float disc = b * b - 4.0f * a * c;
+		if (0.0f <= disc)
+		{
+			// numerically stable roots, see Numerical Recipes 5.6
+			const float q = -0.5f * (b + (0.0f > b ? -bx::sqrt(disc) : bx::sqrt(disc) ) );
+			const float r0 = q / a;
+			const float r1 = 0.0f != q ? c / q : r0;
+			if (0.0f <= r0)
+			{
+				s = r0;
+			}
+
+			if (0.0f <= r1)
+			{
+				s = bx::min(s, r1);
+			}
+		}
+	}
+
+	if (s > sMax)
+	{
+		// rounding can miss a grazing root, catch rays that still end below the surface
+		if (c + (b + a * sMax) * sMax > 0.0f)
+		{
+			return false;
+		}
+
+		s = sMax;
+	}
+
+	_outT = _t0 + s;
+	return true;
+}
+
+bool terrainRaycast(const Heightfield& _field, const bx::Vec3& _origin, const bx::Vec3& _dir, float _maxDistance, RayHit& _outHit)
+{
+	_outHit.m_distance = -1.0f;
+
+	const float invTexelSize = 1.0f / _field.m_texelSize;
+	const float invHeightScale = 1.0f / _field.m_heightScale;
+
+	TexelRay ray;
+	ray.m_origin[0] = _origin.x * invTexelSize - 0.5f;
+	ray.m_origin[1] = _origin.y * invHeightScale;
+	ray.m_origin[2] = _origin.z * invTexelSize - 0.5f;
+	ray.m_dir[0] = _dir.x * invTexelSize;
+	ray.m_dir[1] = _dir.y * invHeightScale;
+	ray.m_dir[2] = _dir.z * invTexelSize;
+
+	const uint32_t topLevel = _field.m_numLevels - 1;
+	const uint16_t* root = &_field.m_minMax[_field.m_levelOffset[topLevel] * 2];
+
+	float tStart = 0.0f;
+	float tEnd = _maxDistance;
+	if (!clipSlab(ray.m_origin[0], ray.m_dir[0], 0.0f, float(_field.m_width  - 1), tStart, tEnd)
+	||  !clipSlab(ray.m_origin[2], ray.m_dir[2], 0.0f, float(_field.m_height - 1), tStart, tEnd)
+	||  !clipSlab(ray.m_origin[1], ray.m_dir[1], -bx::kFloatMax, float(root[1]) + 1.0f, tStart, tEnd) )
+	{
+		return false;
+	}
+
+	const float invDirX = 0.0f != ray.m_dir[0] ? 1.0f / ray.m_dir[0] : 0.0f;
+	const float invDirZ = 0.0f != ray.m_dir[2] ? 1.0f / ray.m_dir[2] : 0.0f;
+
+	uint32_t level = topLevel;
+	float tt = tStart;
+	while (tt <= tEnd)
+	{
+		const int32_t cellSize = 1 << level;
+		const float px = ray.m_origin[0] + ray.m_dir[0] * tt;
+		const float pz = ray.m_origin[2] + ray.m_dir[2] * tt;
+		const int32_t cx = bx::clamp(int32_t(bx::floor(px / float(cellSize) ) ), 0, int32_t(_field.m_levelWidth[level])  - 1);
+		const int32_t cz = bx::clamp(int32_t(bx::floor(pz / float(cellSize) ) ), 0, int32_t(_field.m_levelHeight[level]) - 1);
+
+		float tExit = tEnd;
+		if (0.0f != ray.m_dir[0])
+		{
+			const float edge = float( (0.0f < ray.m_dir[0] ? cx + 1 : cx) * cellSize);
+			tExit = bx::min(tExit, (edge - ray.m_origin[0]) * invDirX);
+		}
+
+		if (0.0f != ray.m_dir[2])
+		{
+			const float edge = float( (0.0f < ray.m_dir[2] ? cz + 1 : cz) * cellSize);
+			tExit = bx::min(tExit, (edge - ray.m_origin[2]) * invDirZ);
+		}
+
+		tExit = bx::max(tExit, tt);
+
+		const uint16_t* cell = &_field.m_minMax[(_field.m_levelOffset[level] + cx + cz * _field.m_levelWidth[level]) * 2];
+		const float yEnter = ray.m_origin[1] + ray.m_dir[1] * tt;
+		const float yExit  = ray.m_origin[1] + ray.m_dir[1] * tExit;
+
+		bool skip = bx::min(yEnter, yExit) > float(cell[1]);
+		if (!skip)
+		{
+			if (0 != level)
+			{
+				--level;
+				continue;
+			}
+
+			float tHit;
+			if (intersectCell(_field, ray, cx, cz, tt, tExit, tHit) )
+			{
+				const float u = ray.m_origin[0] + ray.m_dir[0] * tHit - float(cx);
+				const float v = ray.m_origin[2] + ray.m_dir[2] * tHit - float(cz);
+				const float h00 = float(heightAt(_field, cx,     cz) );
+				const float h10 = float(heightAt(_field, cx + 1, cz) );
+				const float h01 = float(heightAt(_field, cx,     cz + 1) );
+				const float h11 = float(heightAt(_field, cx + 1, cz + 1) );
+				const float cc = h00 - h10 - h01 + h11;
+
+				const float gradScale = _field.m_heightScale * invTexelSize;
+				const float dhdx = (h10 - h00 + cc * bx::clamp(v, 0.0f, 1.0f) ) * gradScale;
+				const float dhdz = (h01 - h00 + cc * bx::clamp(u, 0.0f, 1.0f) ) * gradScale;
+
+				_outHit.m_position = bx::add(_origin, bx::mul(_dir, tHit) );
+				_outHit.m_normal   = bx::normalize(bx::Vec3{ -dhdx, 1.0f, -dhdz });
+				_outHit.m_distance = tHit;
+				return true;
+			}
+		}
+
+		// step just past the exit so the next lookup lands in the neighbour cell, and retry
+		// one level up since the ray may have left the parent too
+		tt = bx::max(tExit * (1.0f + 1e-6f), tExit + 1e-5f);
+		level = bx::min(level + 1, topLevel);
+	}
+
+	return false;
+}
+
+uint32_t terrainRaycastBatch(
+	  const Heightfield& _field
+	, const bx::Vec3* _origins
+	, const bx::Vec3* _dirs
+	, uint32_t _num
+	, float _maxDistance
+	, RayHit* _outHits
+	)
+{
+	uint32_t numHits = 0;
+	for (uint32_t ii = 0; ii < _num; ++ii)
+	{
+		numHits += terrainRaycast(_field, _origins[ii], _dirs[ii], _maxDistance, _outHits[ii]) ? 1 : 0;
+	}
+
+	return numHits;
+}
+
+namespace
+{
+	// Texel space constants shared by the samplers.
+	struct SampleParams
+	{
+		SampleParams(const Heightfield& _field)
+			: m_heights(_field.m_heights)
+			, m_invTexelSize(bx::simd_splat(1.0f / _field.m_texelSize) )
+			, m_half(bx::simd_splat(0.5f) )
+			, m_one(bx::simd_splat(1.0f) )
+			, m_maxX(bx::simd_splat(float(_field.m_width  - 1) ) )
+			, m_maxZ(bx::simd_splat(float(_field.m_height - 1) ) )
+			, m_width(_field.m_width)
+		{
+		}
+
+		const uint16_t* m_heights;
+		bx::simd128_t m_invTexelSize;
+		bx::simd128_t m_half;
+		bx::simd128_t m_one;
+		bx::simd128_t m_maxX;
+		bx::simd128_t m_maxZ;
+		uint32_t m_width;
+	};
+}
+
+// Deinterleaves up to 4 positions, missing ones repeat the last.
+static void loadPositions(const float* _xz, uint32_t _num, bx::simd128_t& _outX, bx::simd128_t& _outZ)
+{
+	BX_ALIGN_DECL_16(float) xx[4];
+	BX_ALIGN_DECL_16(float) zz[4];
+	for (uint32_t ii = 0; ii < 4; ++ii)
+	{
+		const uint32_t index = bx::min(ii, _num - 1);
+		xx[ii] = _xz[index * 2 + 0];
+		zz[ii] = _xz[index * 2 + 1];
+	}
+
+	_outX = bx::simd_ld(xx);
+	_outZ = bx::simd_ld(zz);
+}
+
+// SSE2 and NEON have no gather, lanes are fetched one by one and the math stays vectorized.
+// Texel coordinates are exact in float, their index past 2^24 texels isn't, it's computed in
+// integers.
+static inline bx::simd128_t gather(const SampleParams& _params, bx::simd128_t _x, bx::simd128_t _z)
+{
+	BX_ALIGN_DECL_16(int32_t) xx[4];
+	BX_ALIGN_DECL_16(int32_t) zz[4];
+	BX_ALIGN_DECL_16(float) value[4];
+	bx::simd_st(xx, bx::simd_ftoi(_x) );
+	bx::simd_st(zz, bx::simd_ftoi(_z) );
+	for (uint32_t ii = 0; ii < 4; ++ii)
+	{
+		value[ii] = float(_params.m_heights[uint32_t(zz[ii]) * _params.m_width + uint32_t(xx[ii])]);
+	}
+	return bx::simd_ld(value);
+}
+
+static inline bx::simd128_t clampX(const SampleParams& _params, bx::simd128_t _x)
+{
+	return bx::simd_clamp(_x, bx::simd_zero(), _params.m_maxX);
+}
+
+static inline bx::simd128_t clampZ(const SampleParams& _params, bx::simd128_t _z)
+{
+	return bx::simd_clamp(_z, bx::simd_zero(), _params.m_maxZ);
+}
+
+static bx::simd128_t sampleBilinear(const SampleParams& _params, bx::simd128_t _x, bx::simd128_t _z)
+{
+	const bx::simd128_t tx = clampX(_params, bx::simd_sub(bx::simd_mul(_x, _params.m_invTexelSize), _params.m_half) );
+	const bx::simd128_t tz = clampZ(_params, bx::simd_sub(bx::simd_mul(_z, _params.m_invTexelSize), _params.m_half) );
+	const bx::simd128_t x0 = bx::simd_floor(tx);
+	const bx::simd128_t z0 = bx::simd_floor(tz);
+	const bx::simd128_t x1 = bx::simd_min(bx::simd_add(x0, _params.m_one), _params.m_maxX);
+	const bx::simd128_t z1 = bx::simd_min(bx::simd_add(z0, _params.m_one), _params.m_maxZ);
+	const bx::simd128_t fx = bx::simd_sub(tx, x0);
+	const bx::simd128_t fz = bx::simd_sub(tz, z0);
+
+	const bx::simd128_t top    = bx::simd_lerp(gather(_params, x0, z0), gather(_params, x1, z0), fx);
+	const bx::simd128_t bottom = bx::simd_lerp(gather(_params, x0, z1), gather(_params, x1, z1), fx);
+	return bx::simd_lerp(top, bottom, fz);
+}
+
+// Catmull-Rom weights of taps at -1, 0, 1 and 2 for fraction _t.
+static void catmullRomWeights(bx::simd128_t _t, bx::simd128_t* _outWeights)
+{
+	const bx::simd128_t half      = bx::simd_splat(0.5f);
+	const bx::simd128_t oneHalf   = bx::simd_splat(1.5f);
+	const bx::simd128_t two       = bx::simd_splat(2.0f);
+	const bx::simd128_t twoHalf   = bx::simd_splat(2.5f);
+	const bx::simd128_t one       = bx::simd_splat(1.0f);
+	const bx::simd128_t tt        = bx::simd_mul(_t, _t);
+
+	// w0 = t (-0.5 + t (1 - 0.5 t)), w1 = 1 + t^2 (-2.5 + 1.5 t)
+	// w2 = t (0.5 + t (2 - 1.5 t)),   w3 = t^2 (-0.5 + 0.5 t)
+	_outWeights[0] = bx::simd_mul(_t, bx::simd_sub(bx::simd_mul(_t, bx::simd_nmsub(half, _t, one) ), half) );
+	_outWeights[1] = bx::simd_madd(tt, bx::simd_sub(bx::simd_mul(oneHalf, _t), twoHalf), one);
+	_outWeights[2] = bx::simd_mul(_t, bx::simd_madd(_t, bx::simd_nmsub(oneHalf, _t, two), half) );
+	_outWeights[3] = bx::simd_mul(tt, bx::simd_mul(half, bx::simd_sub(_t, one) ) );
+}
+
+static bx::simd128_t sampleBicubic(const SampleParams& _params, bx::simd128_t _x, bx::simd128_t _z)
+{
+	const bx::simd128_t tx = clampX(_params, bx::simd_sub(bx::simd_mul(_x, _params.m_invTexelSize), _params.m_half) );
+	const bx::simd128_t tz = clampZ(_params, bx::simd_sub(bx::simd_mul(_z, _params.m_invTexelSize), _params.m_half) );
+	const bx::simd128_t x0 = bx::simd_floor(tx);
+	const bx::simd128_t z0 = bx::simd_floor(tz);
+
+	bx::simd128_t weightsX[4];
+	bx::simd128_t weightsZ[4];
+	catmullRomWeights(bx::simd_sub(tx, x0), weightsX);
+	catmullRomWeights(bx::simd_sub(tz, z0), weightsZ);
+
+	bx::simd128_t columns[4];
+	for (int32_t ii = 0; ii < 4; ++ii)
+	{
+		columns[ii] = clampX(_params, bx::simd_add(x0, bx::simd_splat(float(ii - 1) ) ) );
+	}
+
+	bx::simd128_t result = bx::simd_zero();
+	for (int32_t jj = 0; jj < 4; ++jj)
+	{
+		const bx::simd128_t row = clampZ(_params, bx::simd_add(z0, bx::simd_splat(float(jj - 1) ) ) );
+
+		bx::simd128_t sum = bx::simd_mul(gather(_params, columns[0], row), weightsX[0]);
+		sum = bx::simd_madd(gather(_params, columns[1], row), weightsX[1], sum);
+		sum = bx::simd_madd(gather(_params, columns[2], row), weightsX[2], sum);
+		sum = bx::simd_madd(gather(_params, columns[3], row), weightsX[3], sum);
+		result = bx::simd_madd(sum, weightsZ[jj], result);
+	}
+
+	return result;
+}
+
+void sampleHeights(
+	  const Heightfield& _field
+	, const float* _xz
+	, float* _outHeights
+	, uint32_t _num
+	, HeightFilter::Enum _filter
+	)
+{
+	const SampleParams params(_field);
+	const bx::simd128_t heightScale = bx::simd_splat(_field.m_heightScale);
+
+	BX_ALIGN_DECL_16(float) heights[4];
+	for (uint32_t ii = 0; ii < _num; ii += 4)
+	{
+		const uint32_t num = bx::min(4u, _num - ii);
+
+		bx::simd128_t xx, zz;
+		loadPositions(&_xz[ii * 2], num, xx, zz);
+
+		const bx::simd128_t height = HeightFilter::Bicubic == _filter
+			? sampleBicubic(params, xx, zz)
+			: sampleBilinear(params, xx, zz)
+			;
+		bx::simd_st(heights, bx::simd_mul(height, heightScale) );
+
+		for (uint32_t jj = 0; jj < num; ++jj)
+		{
+			_outHeights[ii + jj] = heights[jj];
+		}
+	}
+}
+
+// Central difference gradient at texel (_x, _z), in height units per texel times two.
+static void gradient(const SampleParams& _params, bx::simd128_t _x, bx::simd128_t _z, bx::simd128_t& _outDx, bx::simd128_t& _outDz)
+{
+	const bx::simd128_t left  = clampX(_params, bx::simd_sub(_x, _params.m_one) );
+	const bx::simd128_t right = clampX(_params, bx::simd_add(_x, _params.m_one) );
+	const bx::simd128_t down  = clampZ(_params, bx::simd_sub(_z, _params.m_one) );
+	const bx::simd128_t up    = clampZ(_params, bx::simd_add(_z, _params.m_one) );
+	_outDx = bx::simd_sub(gather(_params, right, _z), gather(_params, left, _z) );
+	_outDz = bx::simd_sub(gather(_params, _x, up), gather(_params, _x, down) );
+}
+
+void sampleNormals(const Heightfield& _field, const float* _xz, float* _outNormals, uint32_t _num)
+{
+	const SampleParams params(_field);
+	const bx::simd128_t gradScale = bx::simd_splat(_field.m_heightScale / (2.0f * _field.m_texelSize) );
+
+	BX_ALIGN_DECL_16(float) normalX[4];
+	BX_ALIGN_DECL_16(float) normalY[4];
+	BX_ALIGN_DECL_16(float) normalZ[4];
+	for (uint32_t ii = 0; ii < _num; ii += 4)
+	{
+		const uint32_t num = bx::min(4u, _num - ii);
+
+		bx::simd128_t xx, zz;
+		loadPositions(&_xz[ii * 2], num, xx, zz);
+
+		const bx::simd128_t tx = clampX(params, bx::simd_sub(bx::simd_mul(xx, params.m_invTexelSize), params.m_half) );
+		const bx::simd128_t tz = clampZ(params, bx::simd_sub(bx::simd_mul(zz, params.m_invTexelSize), params.m_half) );
+		const bx::simd128_t x0 = bx::simd_floor(tx);
+		const bx::simd128_t z0 = bx::simd_floor(tz);
+		const bx::simd128_t x1 = bx::simd_min(bx::simd_add(x0, params.m_one), params.m_maxX);
+		const bx::simd128_t z1 = bx::simd_min(bx::simd_add(z0, params.m_one), params.m_maxZ);
+		const bx::simd128_t fx = bx::simd_sub(tx, x0);
+		const bx::simd128_t fz = bx::simd_sub(tz, z0);
+
+		bx::simd128_t dx00, dz00, dx10, dz10, dx01, dz01, dx11, dz11;
+		gradient(params, x0, z0, dx00, dz00);
+		gradient(params, x1, z0, dx10, dz10);
+		gradient(params, x0, z1, dx01, dz01);
+		gradient(params, x1, z1, dx11, dz11);
+
+		const bx::simd128_t dx = bx::simd_mul(bx::simd_lerp(bx::simd_lerp(dx00, dx10, fx), bx::simd_lerp(dx01, dx11, fx), fz), gradScale);
+		const bx::simd128_t dz = bx::simd_mul(bx::simd_lerp(bx::simd_lerp(dz00, dz10, fx), bx::simd_lerp(dz01, dz11, fx), fz), gradScale);
+
+		// normal = normalize(-dx, 1, -dz)
+		const bx::simd128_t invLen = bx::simd_rsqrt(bx::simd_madd(dx, dx, bx::simd_madd(dz, dz, params.m_one) ) );
+		bx::simd_st(normalX, bx::simd_neg(bx::simd_mul(dx, invLen) ) );
+		bx::simd_st(normalY, invLen);
+		bx::simd_st(normalZ, bx::simd_neg(bx::simd_mul(dz, invLen) ) );
+
+		for (uint32_t jj = 0; jj < num; ++jj)
+		{
+			float* normal = &_outNormals[(ii + jj) * 3];
+			normal[0] = normalX[jj];
+			normal[1] = normalY[jj];
+			normal[2] = normalZ[jj];
+		}
+	}
+}
@@ -0,0 +1,106 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_HEIGHTFIELD_H_HEADER_GUARD
+#define TERRAIN_HEIGHTFIELD_H_HEADER_GUARD
+
+#include <bx/math.h>
+#include "terrain_tiles.h"
+
+/// CPU copy of the height map with a min/max pyramid on top, used for queries that must not
+/// wait for the GPU. Like the linearly filtered height texture covering the map, texel (x, y)
+/// sits at world (x, z) = (x + 0.5, y + 0.5) * m_texelSize, the surface between texel centres
+/// is bilinear and border texels are clamped.
+///
+/// Pyramid level 0 has one cell per texel holding min and max of the four texels spanning it,
+/// every next level halves the resolution until a single cell covers the whole map.
+struct Heightfield
+{
+	static constexpr uint32_t kMaxLevels = 16;
+
+	uint16_t* m_heights;
+	uint16_t* m_minMax;                   //!< Min and max pairs of all levels.
+	uint32_t  m_levelOffset[kMaxLevels];  //!< First pair of level in m_minMax.
+	uint32_t  m_levelWidth[kMaxLevels];
+	uint32_t  m_levelHeight[kMaxLevels];
+	uint32_t  m_numLevels;
+	uint32_t  m_width;
+	uint32_t  m_height;
+	float     m_texelSize;                //!< World units between two texels.
+	float     m_heightScale;              //!< World units per height map unit.
+};
+
+/// Ray hit on the height field.
+struct RayHit
+{
+	bx::Vec3 m_position;
+	bx::Vec3 m_normal;
+	float    m_distance;  //!< Distance from origin along direction, negative if ray missed.
+};
+
+/// Filter used by height queries.
+struct HeightFilter
+{
+	enum Enum
+	{
+		Bilinear, //!< Same heights as dmap() at mip 0 in vs_terrain_height_texture.sc.
+		Bicubic,  //!< Catmull-Rom over 4x4 texels, passes through texels with smooth slopes.
+
+		Count
+	};
+};
+
+/// Creates flat height field of _width x _height texels.
+void heightfieldCreate(Heightfield& _field, uint32_t _width, uint32_t _height, float _texelSize, float _heightScale);
+
+///
+void heightfieldDestroy(Heightfield& _field);
+
+/// Copies texels in _rect from _src, which has the height field's dimensions, and rebuilds
+/// pyramid cells over them. Not safe while other threads query the height field.
+void heightfieldUpdate(Heightfield& _field, const uint16_t* _src, const TileRect& _rect);
+
+/// Rebuilds pyramid cells depending on texels in _rect, after m_heights was written directly.
+void heightfieldRebuild(Heightfield& _field, const TileRect& _rect);
+
+/// Returns lowest and highest world height of the whole field.
+void heightfieldGetRange(const Heightfield& _field, float& _outMin, float& _outMax);
+
+/// Returns conservative lowest and highest world height over world rectangle, from the
+/// coarsest pyramid level that covers it with at most 2x2 cells.
+void heightfieldGetRectRange(const Heightfield& _field, float _minX, float _minZ, float _maxX, float _maxZ, float& _outMin, float& _outMax);
+
+/// Casts ray against height field by walking the max pyramid: cells the ray passes above are
+/// skipped whole, only level 0 cells it can touch are intersected exactly. _dir must be
+/// normalized. Rays are traced over the area between texel centres. Ground is solid below the
+/// surface, rays entering the area below it or starting underground hit where they enter. Returns false if nothing was hit within _maxDistance.
+/// Read only, rays can be cast from any number of threads at once.
+bool terrainRaycast(const Heightfield& _field, const bx::Vec3& _origin, const bx::Vec3& _dir, float _maxDistance, RayHit& _outHit);
+
+/// Casts _num rays, misses have negative m_distance. Returns number of hits.
+uint32_t terrainRaycastBatch(
+	  const Heightfield& _field
+	, const bx::Vec3* _origins
+	, const bx::Vec3* _dirs
+	, uint32_t _num
+	, float _maxDistance
+	, RayHit* _outHits
+	);
+
+/// Samples world heights at _num positions, _xz holds x and z of every position. Positions
+/// are processed 4 at a time. Read only, any number of threads can sample at once.
+void sampleHeights(
+	  const Heightfield& _field
+	, const float* _xz
+	, float* _outHeights
+	, uint32_t _num
+	, HeightFilter::Enum _filter = HeightFilter::Bilinear
+	);
+
+/// Samples surface normals at _num positions into _outNormals, x, y and z of every normal.
+/// Normals are central differences like cs_updateNormals, filtered bilinearly like the normal
+/// texture. Read only, any number of threads can sample at once.
+void sampleNormals(const Heightfield& _field, const float* _xz, float* _outNormals, uint32_t _num);
+
+#endif // TERRAIN_HEIGHTFIELD_H_HEADER_GUARD
@@ -0,0 +1,223 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <string.h>
+#include <bx/allocator.h>
+#include <bx/simd_t.h>
+#include "terrain_heightmips.h"
+#include "terrain_memory.h"
+
+void heightMipsCreate(HeightMips& _mips, uint32_t _width, uint32_t _height)
+{
+	uint32_t numTexels = 0;
+	uint32_t levelWidth  = _width;
+	uint32_t levelHeight = _height;
+	_mips.m_numLevels = 0;
+	for (;;)
+	{
+		BX_CHECK(_mips.m_numLevels < HeightMips::kMaxLevels, "Height map %dx%d is too large.", _width, _height);
+		_mips.m_levelOffset[_mips.m_numLevels] = numTexels;
+		_mips.m_levelWidth[_mips.m_numLevels]  = levelWidth;
+		_mips.m_levelHeight[_mips.m_numLevels] = levelHeight;
+		if (0 != _mips.m_numLevels)
+		{
+			numTexels += levelWidth * levelHeight;
+		}
+		++_mips.m_numLevels;
+
+		if (1 == levelWidth && 1 == levelHeight)
+		{
+			break;
+		}
+
+		// same as bgfx, odd sizes round down
+		levelWidth  = bx::max(1u, levelWidth  / 2);
+		levelHeight = bx::max(1u, levelHeight / 2);
+	}
+
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::HeightMap);
+	_mips.m_data = (uint16_t*)BX_ALLOC(allocator, bx::max(1u, numTexels) * sizeof(uint16_t) );
+	bx::memSet(_mips.m_data, 0, numTexels * sizeof(uint16_t) );
+}
+
+void heightMipsDestroy(HeightMips& _mips)
+{
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::HeightMap);
+	BX_FREE(allocator, _mips.m_data);
+	_mips.m_data = NULL;
+	_mips.m_numLevels = 0;
+}
+
+TileRect heightMipsGetRect(const HeightMips& _mips, const TileRect& _rect, uint32_t _level)
+{
+	// texel x of a level is read by texel x / 2 of the next one
+	TileRect rect = _rect;
+	for (uint32_t level = 1; level <= _level; ++level)
+	{
+		rect.m_x0 = rect.m_x0 / 2;
+		rect.m_y0 = rect.m_y0 / 2;
+		rect.m_x1 = (rect.m_x1 + 1) / 2;
+		rect.m_y1 = (rect.m_y1 + 1) / 2;
+	}
+
+	const TileRect full = { 0, 0, int32_t(_mips.m_levelWidth[_level]), int32_t(_mips.m_levelHeight[_level]) };
+	return tileRectIntersect(rect, full);
+}
+
+static inline uint16_t downsampleTexel(const uint16_t* _row0, const uint16_t* _row1, int32_t _x, uint32_t _srcWidth)
+{
+	const uint32_t x0 = bx::min(uint32_t(_x) * 2,     _srcWidth - 1);
+	const uint32_t x1 = bx::min(uint32_t(_x) * 2 + 1, _srcWidth - 1);
+	return uint16_t( (uint32_t(_row0[x0]) + _row0[x1] + _row1[x0] + _row1[x1] + 2) >> 2);
+}
+
+void heightMipDownsampleRef(
+	  uint16_t* _dst
+	, uint32_t _dstWidth
+	, const uint16_t* _src
+	, uint32_t _srcWidth
+	, uint32_t _srcHeight
+	, const TileRect& _dstRect
+	)
+{
+	for (int32_t yy = _dstRect.m_y0; yy < _dstRect.m_y1; ++yy)
+	{
+		const uint16_t* row0 = &_src[bx::min(uint32_t(yy) * 2,     _srcHeight - 1) * _srcWidth];
+		const uint16_t* row1 = &_src[bx::min(uint32_t(yy) * 2 + 1, _srcHeight - 1) * _srcWidth];
+		uint16_t* dst = &_dst[yy * _dstWidth];
+		for (int32_t xx = _dstRect.m_x0; xx < _dstRect.m_x1; ++xx)
+		{
+			dst[xx] = downsampleTexel(row0, row1, xx, _srcWidth);
+		}
+	}
+}
+
+// sums of horizontal texel pairs of 8 heights packed in 4 lanes, (h0 + h1, h2 + h3, ...)
+static inline bx::simd128_t sumPairs(bx::simd128_t _packed, bx::simd128_t _mask)
+{
+	return bx::simd_iadd(bx::simd_and(_packed, _mask), bx::simd_srl(_packed, 16) );
+}
+
+void heightMipDownsample(
+	  uint16_t* _dst
+	, uint32_t _dstWidth
+	, const uint16_t* _src
+	, uint32_t _srcWidth
+	, uint32_t _srcHeight
+	, const TileRect& _dstRect
+	)
+{
+	const bx::simd128_t mask  = bx::simd_isplat(0xffff);
+	const bx::simd128_t round = bx::simd_isplat(2);
+
+	// 16 source texels a row make 8 texels, those that would read past the row edge are
+	// clamped in the scalar tail
+	const int32_t simdEnd = bx::min(_dstRect.m_x1, int32_t(_srcWidth / 2) );
+
+	for (int32_t yy = _dstRect.m_y0; yy < _dstRect.m_y1; ++yy)
+	{
+		const uint16_t* row0 = &_src[bx::min(uint32_t(yy) * 2,     _srcHeight - 1) * _srcWidth];
+		const uint16_t* row1 = &_src[bx::min(uint32_t(yy) * 2 + 1, _srcHeight - 1) * _srcWidth];
+		uint16_t* dst = &_dst[yy * _dstWidth];
+
+		int32_t xx = _dstRect.m_x0;
+		for (; xx + 8 <= simdEnd; xx += 8)
+		{
+			bx::simd128_t a0, b0, a1, b1;
+			memcpy(&a0, &row0[xx * 2],     16);
+			memcpy(&b0, &row0[xx * 2 + 8], 16);
+			memcpy(&a1, &row1[xx * 2],     16);
+			memcpy(&b1, &row1[xx * 2 + 8], 16);
+
+			// texels 0..3 and 4..7 in 32 bit lanes
+			bx::simd128_t sa = bx::simd_iadd(sumPairs(a0, mask), sumPairs(a1, mask) );
+			bx::simd128_t sb = bx::simd_iadd(sumPairs(b0, mask), sumPairs(b1, mask) );
+			sa = bx::simd_srl(bx::simd_iadd(sa, round), 2);
+			sb = bx::simd_srl(bx::simd_iadd(sb, round), 2);
+
+			// pack back to 16 bit, (0, 4, 1, 5), (2, 6, 3, 7) -> (0, 2, 4, 6), (1, 3, 5, 7)
+			const bx::simd128_t lo   = bx::simd_shuf_xAyB(sa, sb);
+			const bx::simd128_t hi   = bx::simd_shuf_zCwD(sa, sb);
+			const bx::simd128_t even = bx::simd_shuf_xAyB(lo, hi);
+			const bx::simd128_t odd  = bx::simd_shuf_zCwD(lo, hi);
+			const bx::simd128_t packed = bx::simd_or(even, bx::simd_sll(odd, 16) );
+			memcpy(&dst[xx], &packed, 16);
+		}
+
+		for (; xx < _dstRect.m_x1; ++xx)
+		{
+			dst[xx] = downsampleTexel(row0, row1, xx, _srcWidth);
+		}
+	}
+}
+
+void heightMipsUpdate(HeightMips& _mips, const uint16_t* _heights, const TileRect& _rect)
+{
+	const uint16_t* src = _heights;
+	for (uint32_t level = 1; level < _mips.m_numLevels; ++level)
+	{
+		const TileRect rect = heightMipsGetRect(_mips, _rect, level);
+		if (tileRectIsEmpty(rect) )
+		{
+			return;
+		}
+
+		uint16_t* dst = &_mips.m_data[_mips.m_levelOffset[level] ];
+		heightMipDownsample(dst, _mips.m_levelWidth[level], src, _mips.m_levelWidth[level - 1], _mips.m_levelHeight[level - 1], rect);
+		src = dst;
+	}
+}
+
+void heightMipsUpload(const HeightMips& _mips, bgfx::TextureHandle _texture, const uint16_t* _heights, const TileRect& _rect)
+{
+	for (uint32_t level = 0; level < _mips.m_numLevels; ++level)
+	{
+		const TileRect rect = heightMipsGetRect(_mips, _rect, level);
+		if (tileRectIsEmpty(rect) )
+		{
+			return;
+		}
+
+		const uint16_t* texels = 0 == level ? _heights : &_mips.m_data[_mips.m_levelOffset[level] ];
+		const uint32_t pitch  = _mips.m_levelWidth[level];
+		const uint16_t width  = uint16_t(rect.m_x1 - rect.m_x0);
+		const uint16_t height = uint16_t(rect.m_y1 - rect.m_y0);
+		const uint32_t offset = rect.m_x0 + rect.m_y0 * pitch;
+		bgfx::updateTexture2D(_texture, 0, uint8_t(level), uint16_t(rect.m_x0), uint16_t(rect.m_y0), width, height
+			, bgfx::copy(&texels[offset], (pitch * (height - 1) + width) * sizeof(uint16_t) ), uint16_t(pitch * sizeof(uint16_t) ) );
+	}
+}
+
+void heightMipsDispatch(
+	  const HeightMips& _mips
+	, bgfx::ViewId _view
+	, bgfx::ProgramHandle _program
+	, bgfx::UniformHandle _params
+	, bgfx::TextureHandle _texture
+	, const TileRect& _rect
+	)
+{
+	// dispatches of a view run in submit order, each level reads the one written before it
+	for (uint32_t level = 1; level < _mips.m_numLevels; ++level)
+	{
+		const TileRect rect = heightMipsGetRect(_mips, _rect, level);
+		if (tileRectIsEmpty(rect) )
+		{
+			return;
+		}
+
+		float params[4];
+		params[0] = float(rect.m_x0);
+		params[1] = float(rect.m_y0);
+		params[2] = float(rect.m_x1);
+		params[3] = float(rect.m_y1);
+		bgfx::setUniform(_params, params);
+
+		const uint32_t width  = uint32_t(rect.m_x1 - rect.m_x0);
+		const uint32_t height = uint32_t(rect.m_y1 - rect.m_y0);
+		bgfx::setImage(0, _texture, uint8_t(level - 1), bgfx::Access::Read,  bgfx::TextureFormat::R16);
+		bgfx::setImage(1, _texture, uint8_t(level),     bgfx::Access::Write, bgfx::TextureFormat::R16);
+		bgfx::dispatch(_view, _program, (width + 7) / 8, (height + 7) / 8);
+	}
+}
@@ -0,0 +1,79 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_HEIGHTMIPS_H_HEADER_GUARD
+#define TERRAIN_HEIGHTMIPS_H_HEADER_GUARD
+
+#include <bgfx/bgfx.h>
+#include "terrain_tiles.h"
+
+/// Mip chain of the height texture. Level l is max(1, size >> l) texels wide like bgfx mips,
+/// every texel is the rounded average of the 2x2 texels below it, so coarse patches read
+/// a filtered height instead of skipping over full resolution texels.
+///
+/// Levels are rebuilt only over texels an edit touched, either on the CPU from the height
+/// map (loads, initial upload) or by cs_heightMip right after a sculpt dispatch. Both paths
+/// produce the same texels. Levels kept here aren't read back, after GPU edits they are stale
+/// until the next heightMipsUpdate.
+struct HeightMips
+{
+	static constexpr uint32_t kMaxLevels = 16;
+
+	uint16_t* m_data;                     //!< Levels 1 and up, level 0 is the height map.
+	uint32_t  m_levelOffset[kMaxLevels];  //!< First texel of level in m_data.
+	uint32_t  m_levelWidth[kMaxLevels];
+	uint32_t  m_levelHeight[kMaxLevels];
+	uint32_t  m_numLevels;
+};
+
+/// Creates full mip chain of _width x _height height map.
+void heightMipsCreate(HeightMips& _mips, uint32_t _width, uint32_t _height);
+
+///
+void heightMipsDestroy(HeightMips& _mips);
+
+/// Rebuilds texels of every level depending on level 0 texels in _rect of _heights.
+void heightMipsUpdate(HeightMips& _mips, const uint16_t* _heights, const TileRect& _rect);
+
+/// Uploads texels depending on level 0 texels in _rect to all mips of _texture, level 0
+/// from _heights. Call after heightMipsUpdate with the same rect.
+void heightMipsUpload(const HeightMips& _mips, bgfx::TextureHandle _texture, const uint16_t* _heights, const TileRect& _rect);
+
+/// Rebuilds texels of every mip of _texture depending on level 0 texels in _rect with one
+/// cs_heightMip dispatch per level, after level 0 was written on the GPU. _params is the
+/// program's u_heightMipParams.
+void heightMipsDispatch(
+	  const HeightMips& _mips
+	, bgfx::ViewId _view
+	, bgfx::ProgramHandle _program
+	, bgfx::UniformHandle _params
+	, bgfx::TextureHandle _texture
+	, const TileRect& _rect
+	);
+
+/// Returns level 0 texels _rect grows to at _level, clamped to the level.
+TileRect heightMipsGetRect(const HeightMips& _mips, const TileRect& _rect, uint32_t _level);
+
+/// Writes texels in _dstRect of the next level of _srcWidth x _srcHeight _src into _dst,
+/// which is _dstWidth texels wide. 8 texels at a time with SIMD.
+void heightMipDownsample(
+	  uint16_t* _dst
+	, uint32_t _dstWidth
+	, const uint16_t* _src
+	, uint32_t _srcWidth
+	, uint32_t _srcHeight
+	, const TileRect& _dstRect
+	);
+
+/// CPU reference for heightMipDownsample and cs_heightMip.
+void heightMipDownsampleRef(
+	  uint16_t* _dst
+	, uint32_t _dstWidth
+	, const uint16_t* _src
+	, uint32_t _srcWidth
+	, uint32_t _srcHeight
+	, const TileRect& _dstRect
+	);
+
+#endif // TERRAIN_HEIGHTMIPS_H_HEADER_GUARD
@@ -0,0 +1,372 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <bx/allocator.h>
+#include <bx/timer.h>
+#include "asset_loader.h"
+#include "terrain_horizon.h"
+#include "terrain_memory.h"
+
+struct HorizonTileState
+{
+	enum Enum
+	{
+		Clean,
+		Dirty,
+		Computing, //!< Job running, goes back to Dirty if invalidated meanwhile.
+	};
+};
+
+struct HorizonJob
+{
+	HorizonCache* m_cache;
+	uint32_t m_tileX;
+	uint32_t m_tileY;
+	uint64_t m_hash;
+	float    m_ms;
+	bool     m_cached;
+};
+
+// Bump when horizonCompute or the stored layout changes, old disk cache entries are ignored.
+static const uint32_t s_horizonGenerator = BX_MAKEFOURCC('H', 'R', 'Z', 'N');
+static const uint32_t s_horizonVersion   = 1;
+
+// Azimuth d * 45 degrees, texel y runs along world z.
+static const int32_t s_directions[HorizonCache::kNumDirections][2] =
+{
+	{  1,  0 }, {  1,  1 }, {  0,  1 }, { -1,  1 },
+	{ -1,  0 }, { -1, -1 }, {  0, -1 }, {  1, -1 },
+};
+
+void horizonCompute(
+	  const uint16_t* _heights
+	, uint32_t _width
+	, uint32_t _height
+	, uint32_t _x
+	, uint32_t _y
+	, uint32_t _radius
+	, float _texelSize
+	, float _heightScale
+	, float* _outSin
+	)
+{
+	const float height = _heights[_x + _y * _width] * _heightScale;
+
+	for (uint32_t dir = 0; dir < HorizonCache::kNumDirections; ++dir)
+	{
+		const int32_t dx = s_directions[dir][0];
+		const int32_t dy = s_directions[dir][1];
+		const float stepLength = (0 != dx && 0 != dy ? bx::kSqrt2 : 1.0f) * _texelSize;
+
+		// directions are axis aligned or diagonal, every step lands on a texel. Steps grow with
+		// distance, far occluders only matter when they are large.
+		float maxTan = 0.0f;
+		for (uint32_t step = 1; step <= _radius; step += 1 + step / 8)
+		{
+			const int32_t xx = int32_t(_x) + dx * int32_t(step);
+			const int32_t yy = int32_t(_y) + dy * int32_t(step);
+			if (xx < 0 || yy < 0 || xx >= int32_t(_width) || yy >= int32_t(_height) )
+			{
+				break;
+			}
+
+			const float rise = _heights[xx + yy * _width] * _heightScale - height;
+			maxTan = bx::max(maxTan, rise / (step * stepLength) );
+		}
+
+		_outSin[dir] = maxTan / bx::sqrt(1.0f + maxTan * maxTan);
+	}
+}
+
+// RGBA8 bytes of one of the two textures.
+static uint32_t getTileSize(const TileRect& _rect)
+{
+	return uint32_t(_rect.m_x1 - _rect.m_x0) * uint32_t(_rect.m_y1 - _rect.m_y0) * 4;
+}
+
+// Disk cache entry holds the tile of m_data[0] followed by the tile of m_data[1].
+static void packTile(const HorizonCache& _cache, const TileRect& _rect, uint8_t* _dst)
+{
+	const uint32_t pitch = uint32_t(_rect.m_x1 - _rect.m_x0) * 4;
+	for (uint32_t ii = 0; ii < BX_COUNTOF(_cache.m_data); ++ii)
+	{
+		for (int32_t yy = _rect.m_y0; yy < _rect.m_y1; ++yy)
+		{
+			bx::memCopy(_dst, &_cache.m_data[ii][(_rect.m_x0 + yy * _cache.m_grid.m_width) * 4], pitch);
+			_dst += pitch;
+		}
+	}
+}
+
+static void unpackTile(HorizonCache& _cache, const TileRect& _rect, const uint8_t* _src)
+{
+	const uint32_t pitch = uint32_t(_rect.m_x1 - _rect.m_x0) * 4;
+	for (uint32_t ii = 0; ii < BX_COUNTOF(_cache.m_data); ++ii)
+	{
+		for (int32_t yy = _rect.m_y0; yy < _rect.m_y1; ++yy)
+		{
+			bx::memCopy(&_cache.m_data[ii][(_rect.m_x0 + yy * _cache.m_grid.m_width) * 4], _src, pitch);
+			_src += pitch;
+		}
+	}
+}
+
+static void horizonTileJob(void* _userData)
+{
+	HorizonJob* job = (HorizonJob*)_userData;
+	HorizonCache& cache = *job->m_cache;
+	const TileGrid& grid = cache.m_grid;
+	const TileRect rect = tileGridTileRect(grid, job->m_tileX, job->m_tileY);
+	const int64_t start = bx::getHPCounter();
+	job->m_cached = false;
+
+	if (NULL != cache.m_diskCache)
+	{
+		// horizon depends on everything within reach of the tile and on how it's measured
+		const float params[] = { float(cache.m_radius), cache.m_texelSize, cache.m_heightScale };
+		const TileRect reach = tileRectIntersect(tileRectExpand(rect, int32_t(cache.m_radius) ), tileGridFull(grid) );
+		job->m_hash = diskCacheHashHeights(cache.m_heights, grid.m_width, reach, rect, diskCacheHash(params, sizeof(params), 0) );
+
+		const uint64_t prevHash = cache.m_hashes[job->m_tileX + job->m_tileY * grid.m_numTilesX];
+		if (0 != prevHash
+		&&  job->m_hash != prevHash)
+		{
+			diskCacheRemove(*cache.m_diskCache, { s_horizonGenerator, s_horizonVersion, prevHash });
+		}
+
+		DiskCacheView view;
+		if (diskCacheMap(*cache.m_diskCache, { s_horizonGenerator, s_horizonVersion, job->m_hash }, view) )
+		{
+			job->m_cached = getTileSize(rect) * 2 == view.m_size;
+			if (job->m_cached)
+			{
+				unpackTile(cache, rect, (const uint8_t*)view.m_data);
+			}
+			diskCacheUnmap(view);
+		}
+
+		if (job->m_cached)
+		{
+			job->m_ms = float(double(bx::getHPCounter() - start) * 1000.0 / double(bx::getHPFrequency() ) );
+			return;
+		}
+	}
+
+	for (int32_t yy = rect.m_y0; yy < rect.m_y1; ++yy)
+	{
+		for (int32_t xx = rect.m_x0; xx < rect.m_x1; ++xx)
+		{
+			float horizon[HorizonCache::kNumDirections];
+			horizonCompute(cache.m_heights, grid.m_width, grid.m_height, xx, yy, cache.m_radius, cache.m_texelSize, cache.m_heightScale, horizon);
+
+			const uint32_t offset = (xx + yy * grid.m_width) * 4;
+			for (uint32_t ii = 0; ii < 4; ++ii)
+			{
+				cache.m_data[0][offset + ii] = uint8_t(horizon[ii    ] * 255.0f + 0.5f);
+				cache.m_data[1][offset + ii] = uint8_t(horizon[ii + 4] * 255.0f + 0.5f);
+			}
+		}
+	}
+
+	// written here, the tile isn't uploaded before the job is done anyway
+	if (NULL != cache.m_diskCache)
+	{
+		const uint32_t size = getTileSize(rect) * 2;
+		bx::AllocatorI* allocator = getAllocator(MemoryCategory::Horizon);
+		uint8_t* data = (uint8_t*)BX_ALLOC(allocator, size);
+		packTile(cache, rect, data);
+		diskCacheWrite(*cache.m_diskCache, { s_horizonGenerator, s_horizonVersion, job->m_hash }, data, size);
+		BX_FREE(allocator, data);
+	}
+
+	job->m_ms = float(double(bx::getHPCounter() - start) * 1000.0 / double(bx::getHPFrequency() ) );
+}
+
+static void horizonTileDone(void* _userData)
+{
+	HorizonJob* job = (HorizonJob*)_userData;
+	HorizonCache& cache = *job->m_cache;
+	const TileGrid& grid = cache.m_grid;
+	const TileRect rect = tileGridTileRect(grid, job->m_tileX, job->m_tileY);
+	const uint16_t width  = uint16_t(rect.m_x1 - rect.m_x0);
+	const uint16_t height = uint16_t(rect.m_y1 - rect.m_y0);
+
+	for (uint32_t ii = 0; ii < BX_COUNTOF(cache.m_texture); ++ii)
+	{
+		const bgfx::Memory* mem = bgfx::alloc(width * height * 4);
+		for (uint16_t yy = 0; yy < height; ++yy)
+		{
+			bx::memCopy(&mem->data[yy * width * 4], &cache.m_data[ii][(rect.m_x0 + (rect.m_y0 + yy) * grid.m_width) * 4], width * 4);
+		}
+		bgfx::updateTexture2D(cache.m_texture[ii], 0, 0, uint16_t(rect.m_x0), uint16_t(rect.m_y0), width, height, mem);
+	}
+
+	uint8_t& state = cache.m_state[job->m_tileX + job->m_tileY * grid.m_numTilesX];
+	if (HorizonTileState::Computing == state)
+	{
+		state = HorizonTileState::Clean;
+	}
+
+	cache.m_hashes[job->m_tileX + job->m_tileY * grid.m_numTilesX] = job->m_hash;
+	cache.m_computeMs += job->m_ms;
+	cache.m_numCached += job->m_cached ? 1 : 0;
+	++cache.m_numComputed;
+	--cache.m_numPending;
+}
+
+void horizonCacheCreate(HorizonCache& _cache, uint32_t _width, uint32_t _height, uint32_t _tileSize, uint32_t _radius, DiskCache* _diskCache)
+{
+	tileGridInit(_cache.m_grid, _width, _height, _tileSize);
+
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::Horizon);
+	const uint32_t numTiles = _cache.m_grid.m_numTilesX * _cache.m_grid.m_numTilesY;
+	_cache.m_state   = (uint8_t*)BX_ALLOC(allocator, numTiles);
+	_cache.m_data[0] = (uint8_t*)BX_ALLOC(allocator, _width * _height * 4);
+	_cache.m_data[1] = (uint8_t*)BX_ALLOC(allocator, _width * _height * 4);
+	_cache.m_heights = (uint16_t*)BX_ALLOC(allocator, _width * _height * sizeof(uint16_t) );
+	_cache.m_jobs    = (HorizonJob*)BX_ALLOC(allocator, numTiles * sizeof(HorizonJob) );
+	_cache.m_hashes  = (uint64_t*)BX_ALLOC(allocator, numTiles * sizeof(uint64_t) );
+	bx::memSet(_cache.m_state, HorizonTileState::Dirty, numTiles);
+	bx::memSet(_cache.m_hashes, 0, numTiles * sizeof(uint64_t) );
+	bx::memSet(_cache.m_data[0], 0, _width * _height * 4);
+	bx::memSet(_cache.m_data[1], 0, _width * _height * 4);
+
+	_cache.m_radius = _radius;
+	_cache.m_diskCache = _diskCache;
+	_cache.m_texelSize = 1.0f;
+	_cache.m_heightScale = 0.0f;
+	_cache.m_numDirty = numTiles;
+	_cache.m_numPending = 0;
+	_cache.m_numComputed = 0;
+	_cache.m_numCached = 0;
+	_cache.m_computeMs = 0.0f;
+
+	// open sky until the first tiles arrive
+	for (uint32_t ii = 0; ii < BX_COUNTOF(_cache.m_texture); ++ii)
+	{
+		_cache.m_texture[ii] = bgfx::createTexture2D(uint16_t(_width), uint16_t(_height), false, 1, bgfx::TextureFormat::RGBA8, BGFX_SAMPLER_UVW_CLAMP
+			, bgfx::copy(_cache.m_data[ii], _width * _height * 4)
+			);
+	}
+
+	_cache.s_horizon[0] = bgfx::createUniform("s_horizon0", bgfx::UniformType::Sampler);
+	_cache.s_horizon[1] = bgfx::createUniform("s_horizon1", bgfx::UniformType::Sampler);
+	_cache.u_horizonParams = bgfx::createUniform("u_horizonParams", bgfx::UniformType::Vec4, 4);
+}
+
+void horizonCacheDestroy(HorizonCache& _cache)
+{
+	bgfx::destroy(_cache.m_texture[0]);
+	bgfx::destroy(_cache.m_texture[1]);
+	bgfx::destroy(_cache.s_horizon[0]);
+	bgfx::destroy(_cache.s_horizon[1]);
+	bgfx::destroy(_cache.u_horizonParams);
+
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::Horizon);
+	BX_FREE(allocator, _cache.m_hashes);
+	BX_FREE(allocator, _cache.m_jobs);
+	BX_FREE(allocator, _cache.m_heights);
+	BX_FREE(allocator, _cache.m_data[1]);
+	BX_FREE(allocator, _cache.m_data[0]);
+	BX_FREE(allocator, _cache.m_state);
+	_cache.m_state = NULL;
+}
+
+void horizonCacheInvalidate(HorizonCache& _cache, const TileRect& _rect)
+{
+	uint32_t x0, y0, x1, y1;
+	if (!tileGridRange(_cache.m_grid, tileRectExpand(_rect, int32_t(_cache.m_radius) ), x0, y0, x1, y1) )
+	{
+		return;
+	}
+
+	for (uint32_t yy = y0; yy < y1; ++yy)
+	{
+		for (uint32_t xx = x0; xx < x1; ++xx)
+		{
+			uint8_t& state = _cache.m_state[xx + yy * _cache.m_grid.m_numTilesX];
+			if (HorizonTileState::Dirty != state)
+			{
+				state = HorizonTileState::Dirty;
+				++_cache.m_numDirty;
+			}
+		}
+	}
+}
+
+void horizonCacheUpdate(HorizonCache& _cache, const Heightfield& _field)
+{
+	// snapshot can only be replaced when no job reads it
+	if (0 != _cache.m_numPending
+	||  0 == _cache.m_numDirty)
+	{
+		return;
+	}
+
+	const TileGrid& grid = _cache.m_grid;
+	BX_CHECK(_field.m_width == grid.m_width && _field.m_height == grid.m_height, "Height field doesn't match horizon cache.");
+	bx::memCopy(_cache.m_heights, _field.m_heights, grid.m_width * grid.m_height * sizeof(uint16_t) );
+	_cache.m_texelSize   = _field.m_texelSize;
+	_cache.m_heightScale = _field.m_heightScale;
+	_cache.m_computeMs   = 0.0f;
+
+	for (uint32_t yy = 0; yy < grid.m_numTilesY; ++yy)
+	{
+		for (uint32_t xx = 0; xx < grid.m_numTilesX; ++xx)
+		{
+			const uint32_t tile = xx + yy * grid.m_numTilesX;
+			if (HorizonTileState::Dirty != _cache.m_state[tile])
+			{
+				continue;
+			}
+
+			HorizonJob& job = _cache.m_jobs[tile];
+			job.m_cache = &_cache;
+			job.m_tileX = xx;
+			job.m_tileY = yy;
+			job.m_hash = 0;
+			job.m_ms = 0.0f;
+			job.m_cached = false;
+			_cache.m_state[tile] = HorizonTileState::Computing;
+			++_cache.m_numPending;
+			assetSubmitJob(horizonTileJob, horizonTileDone, &job);
+		}
+	}
+
+	_cache.m_numDirty = 0;
+}
+
+void horizonSetUniforms(
+	  const HorizonCache& _cache
+	, uint8_t _stage
+	, const float* _sunDirection
+	, const bx::Vec3& _cameraPos
+	, float _shadowStart
+	, float _shadowEnd
+	, bool _enabled
+	)
+{
+	// sun azimuth falls between two stored directions, blend them linearly
+	float params[16] = {};
+	const float azimuth = bx::atan2(_sunDirection[2], _sunDirection[0]);
+	const float dir = (azimuth < 0.0f ? azimuth + bx::kPi2 : azimuth) / (bx::kPi2 / HorizonCache::kNumDirections);
+	const uint32_t dir0 = uint32_t(dir) % HorizonCache::kNumDirections;
+	const uint32_t dir1 = (dir0 + 1) % HorizonCache::kNumDirections;
+	const float blend = dir - bx::floor(dir);
+	params[dir0] += 1.0f - blend;
+	params[dir1] += blend;
+
+	params[ 8] = _sunDirection[1];
+	params[ 9] = 0.05f; // softness, in sine of elevation
+	params[10] = 1.0f;  // occlusion strength
+	params[11] = _enabled ? 1.0f : 0.0f;
+	params[12] = _cameraPos.x;
+	params[13] = _cameraPos.z;
+	params[14] = _shadowStart;
+	params[15] = _shadowEnd;
+
+	bgfx::setTexture(_stage,     _cache.s_horizon[0], _cache.m_texture[0]);
+	bgfx::setTexture(_stage + 1, _cache.s_horizon[1], _cache.m_texture[1]);
+	bgfx::setUniform(_cache.u_horizonParams, params, 4);
+}
@@ -0,0 +1,89 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_HORIZON_H_HEADER_GUARD
+#define TERRAIN_HORIZON_H_HEADER_GUARD
+
+#include <bgfx/bgfx.h>
+#include "terrain_diskcache.h"
+#include "terrain_heightfield.h"
+
+struct HorizonJob;
+
+/// Per texel horizon elevation in 8 directions, used by fs_terrain for soft sun shadows and
+/// ambient occlusion with a single fetch per texture. Direction d points at azimuth d * 45
+/// degrees from +x towards +z, its sine of horizon elevation is stored as unorm, directions
+/// 0-3 in m_texture[0] and 4-7 in m_texture[1].
+///
+/// Tiles are computed on loader threads from a snapshot of the height field and uploaded as
+/// they finish. An edit only changes horizons within m_radius texels, so only tiles in reach
+/// of a sculpted rectangle are recomputed. With a disk cache, tiles whose heights were seen in
+/// an earlier run are read from it instead, and entries of sculpted tiles are replaced.
+struct HorizonCache
+{
+	static constexpr uint32_t kNumDirections = 8;
+
+	TileGrid m_grid;
+	uint8_t*  m_state;       //!< Per tile, see HorizonTileState in terrain_horizon.cpp.
+	uint8_t*  m_data[2];     //!< RGBA8 images mirroring m_texture.
+	uint16_t* m_heights;     //!< Snapshot read by running jobs.
+	HorizonJob* m_jobs;      //!< One per tile.
+	uint64_t* m_hashes;      //!< Per tile, disk cache entry of the last computed horizon.
+	DiskCache* m_diskCache;  //!< NULL if tiles are always computed.
+	uint32_t m_radius;       //!< Texels searched for the horizon.
+	float    m_texelSize;
+	float    m_heightScale;
+	uint32_t m_numDirty;
+	uint32_t m_numPending;
+
+	uint32_t m_numComputed;  //!< Tiles finished since creation.
+	uint32_t m_numCached;    //!< Of those read from the disk cache.
+	float    m_computeMs;    //!< Thread time of last finished batch.
+
+	bgfx::TextureHandle m_texture[2];
+	bgfx::UniformHandle s_horizon[2];
+	bgfx::UniformHandle u_horizonParams;
+};
+
+/// Creates cache for a _width x _height texel height map, all tiles dirty. _diskCache can be
+/// NULL.
+void horizonCacheCreate(HorizonCache& _cache, uint32_t _width, uint32_t _height, uint32_t _tileSize, uint32_t _radius, DiskCache* _diskCache);
+
+/// Call after assetLoaderDestroy, running jobs use cache memory.
+void horizonCacheDestroy(HorizonCache& _cache);
+
+/// Marks tiles whose horizon may see texels in _rect as dirty.
+void horizonCacheInvalidate(HorizonCache& _cache, const TileRect& _rect);
+
+/// Starts jobs for dirty tiles once the previous batch finished. Finished tiles are uploaded
+/// from assetLoaderUpdate.
+void horizonCacheUpdate(HorizonCache& _cache, const Heightfield& _field);
+
+/// CPU reference for one texel, _outSin receives sine of horizon elevation per direction.
+void horizonCompute(
+	  const uint16_t* _heights
+	, uint32_t _width
+	, uint32_t _height
+	, uint32_t _x
+	, uint32_t _y
+	, uint32_t _radius
+	, float _texelSize
+	, float _heightScale
+	, float* _outSin
+	);
+
+/// Binds horizon textures at _stage and _stage + 1. Horizon shadows fade in from
+/// _shadowStart to _shadowEnd distance from _cameraPos, closer terrain is left to shadow
+/// cascades. Ambient occlusion applies everywhere.
+void horizonSetUniforms(
+	  const HorizonCache& _cache
+	, uint8_t _stage
+	, const float* _sunDirection
+	, const bx::Vec3& _cameraPos
+	, float _shadowStart
+	, float _shadowEnd
+	, bool _enabled
+	);
+
+#endif // TERRAIN_HORIZON_H_HEADER_GUARD
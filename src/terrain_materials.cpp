@@ -0,0 +1,460 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <bx/allocator.h>
+#include <bx/math.h>
+#include <bimg/bimg.h>
+#include "asset_loader.h"
+#include "terrain_materials.h"
+#include "terrain_memory.h"
+
+static void createMaterialArray(MaterialSet& _set)
+{
+	bimg::ImageContainer* layers[MaterialSet::kMaxLayers];
+	uint32_t numLayers = 0;
+	uint32_t totalSize = 0;
+
+	for (uint32_t ii = 0; ii < _set.m_numRequests; ++ii)
+	{
+		bimg::ImageContainer* image = _set.m_requests[ii].m_image;
+		_set.m_requests[ii].m_image = NULL;
+
+		if (NULL == image)
+		{
+			continue;
+		}
+
+		// every layer of an array shares the layout of the first one
+		if (0 != numLayers
+		&& (image->m_width     != layers[0]->m_width
+		||  image->m_height    != layers[0]->m_height
+		||  image->m_format    != layers[0]->m_format
+		||  image->m_numMips   != layers[0]->m_numMips
+		||  image->m_numLayers != 1
+		||  image->m_cubeMap) )
+		{
+			BX_TRACE("Material layer %d doesn't match layout of first layer, skipped.", ii);
+			bimg::imageFree(image);
+			continue;
+		}
+
+		layers[numLayers++] = image;
+		totalSize += image->m_size;
+	}
+
+	if (0 == numLayers)
+	{
+		BX_TRACE("No material could be loaded, keeping placeholder.");
+		return;
+	}
+
+	// renderers only create an array view for more than one layer, repeat the only one
+	const uint32_t numTextureLayers = bx::max(numLayers, 2u);
+	totalSize += (numTextureLayers - numLayers) * layers[0]->m_size;
+
+	// bgfx expects layers one after another, each with its full mip chain
+	const bgfx::Memory* mem = bgfx::alloc(totalSize);
+	uint32_t offset = 0;
+	for (uint32_t ii = 0; ii < numTextureLayers; ++ii)
+	{
+		const bimg::ImageContainer* layer = layers[bx::min(ii, numLayers - 1)];
+		bx::memCopy(&mem->data[offset], layer->m_data, layer->m_size);
+		offset += layer->m_size;
+	}
+
+	bgfx::TextureHandle texture = bgfx::createTexture2D(
+		  uint16_t(layers[0]->m_width)
+		, uint16_t(layers[0]->m_height)
+		, 1 < layers[0]->m_numMips
+		, uint16_t(numTextureLayers)
+		, bgfx::TextureFormat::Enum(layers[0]->m_format)
+		, BGFX_TEXTURE_NONE | BGFX_SAMPLER_MIN_ANISOTROPIC | BGFX_SAMPLER_MAG_ANISOTROPIC
+		, mem
+		);
+
+	for (uint32_t ii = 0; ii < numLayers; ++ii)
+	{
+		bimg::imageFree(layers[ii]);
+	}
+
+	if (bgfx::isValid(texture) )
+	{
+		bgfx::setName(texture, "Materials");
+		bgfx::destroy(_set.m_texture);
+		_set.m_texture = texture;
+		_set.m_numLayers = numLayers;
+	}
+}
+
+static void materialLayerLoaded(bimg::ImageContainer* _image, void* _userData)
+{
+	MaterialSet::Request* request = (MaterialSet::Request*)_userData;
+	MaterialSet& set = *request->m_set;
+	request->m_image = _image;
+
+	// array is created once, when the last layer arrives
+	--set.m_numPending;
+	if (0 == set.m_numPending)
+	{
+		createMaterialArray(set);
+	}
+}
+
+void materialSetCreate(MaterialSet& _set, const char* const* _paths, uint32_t _num)
+{
+	static const uint32_t s_placeholder[2] = { UINT32_C(0xff808080), UINT32_C(0xff808080) };
+	_set.m_texture = bgfx::createTexture2D(1, 1, false, 2, bgfx::TextureFormat::RGBA8, BGFX_TEXTURE_NONE, bgfx::copy(s_placeholder, sizeof(s_placeholder) ) );
+	_set.m_numLayers = 1;
+
+	_num = bx::min(_num, MaterialSet::kMaxLayers);
+	_set.m_numRequests = _num;
+	_set.m_numPending  = _num;
+	for (uint32_t ii = 0; ii < _num; ++ii)
+	{
+		_set.m_requests[ii].m_set   = &_set;
+		_set.m_requests[ii].m_image = NULL;
+		assetLoadImage(_paths[ii], materialLayerLoaded, &_set.m_requests[ii]);
+	}
+}
+
+void materialSetDestroy(MaterialSet& _set)
+{
+	if (bgfx::isValid(_set.m_texture) )
+	{
+		bgfx::destroy(_set.m_texture);
+	}
+
+	for (uint32_t ii = 0; ii < _set.m_numRequests; ++ii)
+	{
+		if (NULL != _set.m_requests[ii].m_image)
+		{
+			bimg::imageFree(_set.m_requests[ii].m_image);
+		}
+	}
+
+	_set.m_texture.idx = bgfx::kInvalidHandle;
+	_set.m_numLayers = 0;
+	_set.m_numRequests = 0;
+}
+
+void splatMapCreate(SplatMap& _map, uint32_t _width, uint32_t _height, uint32_t _tileSize)
+{
+	tileGridInit(_map.m_grid, _width, _height, _tileSize);
+
+	const uint32_t numTexels = _width * _height;
+	const uint32_t numTiles  = _map.m_grid.m_numTilesX * _map.m_grid.m_numTilesY;
+	_map.m_indices = (uint8_t*)BX_ALLOC(getAllocator(MemoryCategory::Materials), numTexels * 4);
+	_map.m_weights = (uint8_t*)BX_ALLOC(getAllocator(MemoryCategory::Materials), numTexels * 4);
+	_map.m_dirty   = (uint8_t*)BX_ALLOC(getAllocator(MemoryCategory::Materials), numTiles);
+	_map.m_tileGenerations = (uint32_t*)BX_ALLOC(getAllocator(MemoryCategory::Materials), numTiles * sizeof(uint32_t) );
+
+	bx::memSet(_map.m_indices, 0, numTexels * 4);
+	for (uint32_t ii = 0; ii < numTexels; ++ii)
+	{
+		_map.m_weights[ii * 4 + 0] = 255;
+		_map.m_weights[ii * 4 + 1] = 0;
+		_map.m_weights[ii * 4 + 2] = 0;
+		_map.m_weights[ii * 4 + 3] = 0;
+	}
+
+	bx::memSet(_map.m_dirty, 1, numTiles);
+	bx::memSet(_map.m_tileGenerations, 0, numTiles * sizeof(uint32_t) );
+	_map.m_numDirty = numTiles;
+	_map.m_generation = 0;
+
+	// indices must never be filtered
+	_map.m_indexTexture  = bgfx::createTexture2D(uint16_t(_width), uint16_t(_height), false, 1, bgfx::TextureFormat::RGBA8, BGFX_SAMPLER_POINT | BGFX_SAMPLER_UVW_CLAMP);
+	_map.m_weightTexture = bgfx::createTexture2D(uint16_t(_width), uint16_t(_height), false, 1, bgfx::TextureFormat::RGBA8, BGFX_SAMPLER_UVW_CLAMP);
+}
+
+void splatMapDestroy(SplatMap& _map)
+{
+	bgfx::destroy(_map.m_indexTexture);
+	bgfx::destroy(_map.m_weightTexture);
+	BX_FREE(getAllocator(MemoryCategory::Materials), _map.m_indices);
+	BX_FREE(getAllocator(MemoryCategory::Materials), _map.m_weights);
+	BX_FREE(getAllocator(MemoryCategory::Materials), _map.m_dirty);
+	BX_FREE(getAllocator(MemoryCategory::Materials), _map.m_tileGenerations);
+	_map.m_indices = NULL;
+	_map.m_weights = NULL;
+	_map.m_dirty = NULL;
+	_map.m_tileGenerations = NULL;
+}
+
+uint32_t splatMapUpload(SplatMap& _map, uint32_t _maxTiles)
+{
+	const TileGrid& grid = _map.m_grid;
+
+	uint32_t num = 0;
+	for (uint32_t ii = 0, numTiles = grid.m_numTilesX * grid.m_numTilesY; ii < numTiles && num < _maxTiles && 0 != _map.m_numDirty; ++ii)
+	{
+		if (0 == _map.m_dirty[ii])
+		{
+			continue;
+		}
+
+		const TileRect rect = tileGridTileRect(grid, ii % grid.m_numTilesX, ii / grid.m_numTilesX);
+		const uint16_t width  = uint16_t(rect.m_x1 - rect.m_x0);
+		const uint16_t height = uint16_t(rect.m_y1 - rect.m_y0);
+		const uint32_t pitch  = uint32_t(width) * 4;
+
+		// tile is packed into memory owned by bgfx, the CPU copy may change before the render
+		// thread consumes the update
+		const bgfx::Memory* indices = bgfx::alloc(pitch * height);
+		const bgfx::Memory* weights = bgfx::alloc(pitch * height);
+		for (uint32_t yy = 0; yy < height; ++yy)
+		{
+			const uint32_t offset = (uint32_t(rect.m_x0) + (uint32_t(rect.m_y0) + yy) * grid.m_width) * 4;
+			bx::memCopy(&indices->data[yy * pitch], &_map.m_indices[offset], pitch);
+			bx::memCopy(&weights->data[yy * pitch], &_map.m_weights[offset], pitch);
+		}
+		bgfx::updateTexture2D(_map.m_indexTexture,  0, 0, uint16_t(rect.m_x0), uint16_t(rect.m_y0), width, height, indices);
+		bgfx::updateTexture2D(_map.m_weightTexture, 0, 0, uint16_t(rect.m_x0), uint16_t(rect.m_y0), width, height, weights);
+
+		_map.m_dirty[ii] = 0;
+		_map.m_tileGenerations[ii] = ++_map.m_generation;
+		--_map.m_numDirty;
+		++num;
+	}
+
+	return num;
+}
+
+void virtualTextureCacheCreate(VirtualTextureCache& _cache)
+{
+	for (uint32_t ii = 0; ii < VirtualTextureCache::kNumPages; ++ii)
+	{
+		VirtualPage& page = _cache.m_pages[ii];
+		page.m_key = UINT32_MAX;
+		page.m_lastUsed = 0;
+		page.m_generation = 0;
+		page.m_next = -1;
+		page.m_baked = false;
+	}
+
+	for (uint32_t ii = 0; ii < VirtualTextureCache::kNumBuckets; ++ii)
+	{
+		_cache.m_buckets[ii] = -1;
+	}
+
+	_cache.m_numPendingBakes = 0;
+	_cache.m_frame = 1;
+	_cache.m_numRequests = 0;
+	_cache.m_numMisses = 0;
+
+	const uint16_t atlasSize = uint16_t(VirtualTextureCache::kPageSize * VirtualTextureCache::kPagesPerRow);
+	_cache.m_atlas = bgfx::createTexture2D(atlasSize, atlasSize, false, 1, bgfx::TextureFormat::RGBA8, BGFX_TEXTURE_COMPUTE_WRITE | BGFX_SAMPLER_UVW_CLAMP);
+	bgfx::setName(_cache.m_atlas, "Virtual texture atlas");
+
+	assetLoadProgram(&_cache.m_bakeProgram, "cs_bakeVirtualPage");
+	_cache.u_virtualPageParams = bgfx::createUniform("u_virtualPageParams", bgfx::UniformType::Vec4, 2);
+	_cache.s_materials    = bgfx::createUniform("s_materials",    bgfx::UniformType::Sampler);
+	_cache.s_splatIndices = bgfx::createUniform("s_splatIndices", bgfx::UniformType::Sampler);
+	_cache.s_splatWeights = bgfx::createUniform("s_splatWeights", bgfx::UniformType::Sampler);
+}
+
+void virtualTextureCacheDestroy(VirtualTextureCache& _cache)
+{
+	bgfx::destroy(_cache.m_atlas);
+	if (bgfx::isValid(_cache.m_bakeProgram) )
+	{
+		bgfx::destroy(_cache.m_bakeProgram);
+	}
+	bgfx::destroy(_cache.u_virtualPageParams);
+	bgfx::destroy(_cache.s_materials);
+	bgfx::destroy(_cache.s_splatIndices);
+	bgfx::destroy(_cache.s_splatWeights);
+}
+
+void virtualTextureCacheBeginFrame(VirtualTextureCache& _cache)
+{
+	++_cache.m_frame;
+	_cache.m_numPendingBakes = 0;
+	_cache.m_numRequests = 0;
+	_cache.m_numMisses = 0;
+}
+
+static uint32_t pageKey(uint8_t _lod, float _worldX, float _worldZ, float _worldSize)
+{
+	const uint32_t xx = uint32_t(_worldX / _worldSize) & 0xfff;
+	const uint32_t zz = uint32_t(_worldZ / _worldSize) & 0xfff;
+	return uint32_t(_lod) << 24 | xx << 12 | zz;
+}
+
+// Newest generation of the splat tiles under a page, false if one of them isn't uploaded yet.
+// Bilinear weights reach one texel past the page.
+static bool splatPageGeneration(const SplatMap& _splat, float _worldX, float _worldZ, float _worldSize, float _heightMapWorldSize, uint32_t& _outGeneration)
+{
+	const TileGrid& grid = _splat.m_grid;
+	const float texelsX = float(grid.m_width)  / _heightMapWorldSize;
+	const float texelsZ = float(grid.m_height) / _heightMapWorldSize;
+	TileRect rect;
+	rect.m_x0 = int32_t(bx::floor(_worldX * texelsX) );
+	rect.m_y0 = int32_t(bx::floor(_worldZ * texelsZ) );
+	rect.m_x1 = int32_t(bx::ceil( (_worldX + _worldSize) * texelsX) );
+	rect.m_y1 = int32_t(bx::ceil( (_worldZ + _worldSize) * texelsZ) );
+
+	_outGeneration = 0;
+	uint32_t x0, y0, x1, y1;
+	if (!tileGridRange(grid, tileRectExpand(rect, 1), x0, y0, x1, y1) )
+	{
+		return true;
+	}
+
+	for (uint32_t yy = y0; yy < y1; ++yy)
+	{
+		for (uint32_t xx = x0; xx < x1; ++xx)
+		{
+			const uint32_t tile = xx + yy * grid.m_numTilesX;
+			if (0 != _splat.m_dirty[tile])
+			{
+				return false;
+			}
+
+			_outGeneration = bx::max(_outGeneration, _splat.m_tileGenerations[tile]);
+		}
+	}
+
+	return true;
+}
+
+static void unlinkPage(VirtualTextureCache& _cache, uint16_t _slot)
+{
+	VirtualPage& page = _cache.m_pages[_slot];
+	int16_t* link = &_cache.m_buckets[page.m_key % VirtualTextureCache::kNumBuckets];
+	while (*link != -1)
+	{
+		if (*link == int16_t(_slot) )
+		{
+			*link = page.m_next;
+			break;
+		}
+
+		link = &_cache.m_pages[*link].m_next;
+	}
+
+	page.m_key = UINT32_MAX;
+	page.m_next = -1;
+	page.m_baked = false;
+}
+
+uint32_t virtualTextureCacheRequest(VirtualTextureCache& _cache, const SplatMap& _splat, uint8_t _lod, float _worldX, float _worldZ, float _worldSize, float _heightMapWorldSize)
+{
+	++_cache.m_numRequests;
+
+	uint32_t generation;
+	const bool uploaded = splatPageGeneration(_splat, _worldX, _worldZ, _worldSize, _heightMapWorldSize, generation);
+
+	const uint32_t key = pageKey(_lod, _worldX, _worldZ, _worldSize);
+	int16_t* bucket = &_cache.m_buckets[key % VirtualTextureCache::kNumBuckets];
+
+	for (int16_t slot = *bucket; slot != -1; slot = _cache.m_pages[slot].m_next)
+	{
+		VirtualPage& page = _cache.m_pages[slot];
+		if (page.m_key != key)
+		{
+			continue;
+		}
+
+		page.m_lastUsed = _cache.m_frame;
+		if (page.m_baked
+		&&  page.m_generation == generation)
+		{
+			return uint32_t(slot) + 1;
+		}
+
+		// stale or not baked yet, bake again once its tiles are uploaded and if there's budget
+		// left this frame
+		++_cache.m_numMisses;
+		if (uploaded
+		&&  _cache.m_numPendingBakes < VirtualTextureCache::kMaxBakes)
+		{
+			page.m_generation = generation;
+			_cache.m_pendingBakes[_cache.m_numPendingBakes++] = uint16_t(slot);
+		}
+
+		return 0;
+	}
+
+	++_cache.m_numMisses;
+	if (!uploaded
+	||  _cache.m_numPendingBakes == VirtualTextureCache::kMaxBakes)
+	{
+		return 0;
+	}
+
+	// evict least recently used page that wasn't used this frame
+	uint16_t victim = UINT16_MAX;
+	uint32_t oldest = _cache.m_frame;
+	for (uint32_t ii = 0; ii < VirtualTextureCache::kNumPages; ++ii)
+	{
+		if (_cache.m_pages[ii].m_lastUsed < oldest)
+		{
+			oldest = _cache.m_pages[ii].m_lastUsed;
+			victim = uint16_t(ii);
+		}
+	}
+
+	if (UINT16_MAX == victim)
+	{
+		return 0;
+	}
+
+	if (UINT32_MAX != _cache.m_pages[victim].m_key)
+	{
+		unlinkPage(_cache, victim);
+	}
+
+	VirtualPage& page = _cache.m_pages[victim];
+	page.m_key = key;
+	page.m_lastUsed = _cache.m_frame;
+	page.m_generation = generation;
+	page.m_worldX = _worldX;
+	page.m_worldZ = _worldZ;
+	page.m_worldSize = _worldSize;
+	page.m_baked = false;
+	page.m_next = *bucket;
+	*bucket = int16_t(victim);
+
+	_cache.m_pendingBakes[_cache.m_numPendingBakes++] = victim;
+	return 0;
+}
+
+void virtualTextureCacheBake(VirtualTextureCache& _cache, bgfx::ViewId _view, const MaterialSet& _materials, const SplatMap& _splat, float _heightMapWorldSize)
+{
+	// nothing is baked from placeholders, so no page has to be dropped once loading is done
+	if (!bgfx::isValid(_cache.m_bakeProgram)
+	||  0 != _materials.m_numPending)
+	{
+		_cache.m_numPendingBakes = 0;
+		return;
+	}
+
+	for (uint32_t ii = 0; ii < _cache.m_numPendingBakes; ++ii)
+	{
+		const uint16_t slot = _cache.m_pendingBakes[ii];
+		VirtualPage& page = _cache.m_pages[slot];
+
+		float params[8];
+		params[0] = page.m_worldX;
+		params[1] = page.m_worldZ;
+		params[2] = page.m_worldSize;
+		params[3] = _heightMapWorldSize;
+		params[4] = float( (slot % VirtualTextureCache::kPagesPerRow) * VirtualTextureCache::kPageSize);
+		params[5] = float( (slot / VirtualTextureCache::kPagesPerRow) * VirtualTextureCache::kPageSize);
+		params[6] = float(VirtualTextureCache::kPageSize);
+		params[7] = 0.0f;
+		bgfx::setUniform(_cache.u_virtualPageParams, params, 2);
+
+		bgfx::setImage(0, _cache.m_atlas, 0, bgfx::Access::Write, bgfx::TextureFormat::RGBA8);
+		bgfx::setTexture(1, _cache.s_materials, _materials.m_texture);
+		bgfx::setTexture(3, _cache.s_splatIndices, _splat.m_indexTexture);
+		bgfx::setTexture(4, _cache.s_splatWeights, _splat.m_weightTexture);
+		bgfx::dispatch(_view, _cache.m_bakeProgram, VirtualTextureCache::kPageSize / 8, VirtualTextureCache::kPageSize / 8);
+
+		page.m_baked = true;
+	}
+
+	_cache.m_numPendingBakes = 0;
+}
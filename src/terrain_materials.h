@@ -0,0 +1,122 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_MATERIALS_H_HEADER_GUARD
+#define TERRAIN_MATERIALS_H_HEADER_GUARD
+
+#include <bgfx/bgfx.h>
+#include "terrain_tiles.h"
+
+namespace bimg { struct ImageContainer; }
+
+/// Ground materials packed as layers of one Texture2DArray. All layers must share size,
+/// format and mip count.
+struct MaterialSet
+{
+	static constexpr uint32_t kMaxLayers = 32;
+
+	struct Request
+	{
+		MaterialSet* m_set;
+		bimg::ImageContainer* m_image;
+	};
+
+	bgfx::TextureHandle m_texture;
+	uint32_t m_numLayers;
+
+	Request  m_requests[kMaxLayers];
+	uint32_t m_numRequests;
+	uint32_t m_numPending; //!< Layers still loading, array is created when it reaches 0.
+};
+
+/// Splat map, per texel the 4 strongest materials and their weights. Shading cost stays at
+/// two splat fetches and 4 layer fetches no matter how many materials the set has.
+struct SplatMap
+{
+	TileGrid m_grid;
+	uint8_t* m_indices;  //!< RGBA8, material layer per channel.
+	uint8_t* m_weights;  //!< RGBA8, weight per channel, sums to 255.
+	uint8_t* m_dirty;    //!< Per tile, 1 if tile needs to be uploaded.
+	uint32_t* m_tileGenerations; //!< Per tile, m_generation of its last upload.
+	uint32_t m_numDirty;
+	uint32_t m_generation; //!< Bumped on every tile upload.
+
+	bgfx::TextureHandle m_indexTexture;
+	bgfx::TextureHandle m_weightTexture;
+};
+
+struct VirtualPage
+{
+	uint32_t m_key;
+	uint32_t m_lastUsed;
+	uint32_t m_generation; //!< Newest generation of the splat tiles under the page when it was baked.
+	float    m_worldX;
+	float    m_worldZ;
+	float    m_worldSize;
+	int16_t  m_next;
+	bool     m_baked;
+};
+
+/// Cache of pre-composited albedo pages for distant patches. Far patches sample one atlas
+/// page instead of blending splat layers.
+struct VirtualTextureCache
+{
+	static constexpr uint32_t kPageSize     = 128;
+	static constexpr uint32_t kPagesPerRow  = 16;
+	static constexpr uint32_t kNumPages     = kPagesPerRow * kPagesPerRow;
+	static constexpr uint32_t kNumBuckets   = 512;
+	static constexpr uint32_t kMaxBakes     = 4; //!< Pages composited per frame.
+
+	VirtualPage m_pages[kNumPages];
+	int16_t  m_buckets[kNumBuckets];
+	uint16_t m_pendingBakes[kMaxBakes];
+	uint32_t m_numPendingBakes;
+	uint32_t m_frame;
+	uint32_t m_numRequests;
+	uint32_t m_numMisses;
+
+	bgfx::TextureHandle m_atlas;
+	bgfx::ProgramHandle m_bakeProgram;
+	bgfx::UniformHandle u_virtualPageParams;
+	bgfx::UniformHandle s_materials;
+	bgfx::UniformHandle s_splatIndices;
+	bgfx::UniformHandle s_splatWeights;
+};
+
+/// Starts loading _num images with the asset loader. Set holds a 1x1 placeholder until all
+/// layers are loaded, then the texture array. Set must not move while loading.
+void materialSetCreate(MaterialSet& _set, const char* const* _paths, uint32_t _num);
+
+/// Asset loader must be destroyed first if layers are still loading.
+void materialSetDestroy(MaterialSet& _set);
+
+/// Creates splat map with every texel fully on material 0.
+void splatMapCreate(SplatMap& _map, uint32_t _width, uint32_t _height, uint32_t _tileSize);
+
+///
+void splatMapDestroy(SplatMap& _map);
+
+/// Uploads at most _maxTiles dirty tiles, returns number of uploaded tiles. Tile data is
+/// copied, m_indices and m_weights can change right after the call.
+uint32_t splatMapUpload(SplatMap& _map, uint32_t _maxTiles);
+
+/// Bake program is loaded with the asset loader, pages are baked once it and the
+/// materials are loaded.
+void virtualTextureCacheCreate(VirtualTextureCache& _cache);
+
+///
+void virtualTextureCacheDestroy(VirtualTextureCache& _cache);
+
+///
+void virtualTextureCacheBeginFrame(VirtualTextureCache& _cache);
+
+/// Returns page slot + 1 for the patch, or 0 if page isn't baked yet and the patch has to
+/// blend splat layers this frame. Missing pages are queued for baking, a page is baked only
+/// once every splat tile under it is uploaded and is stale only if one of them changed.
+uint32_t virtualTextureCacheRequest(VirtualTextureCache& _cache, const SplatMap& _splat, uint8_t _lod, float _worldX, float _worldZ, float _worldSize, float _heightMapWorldSize);
+
+/// Composites queued pages into the atlas.
+void virtualTextureCacheBake(VirtualTextureCache& _cache, bgfx::ViewId _view, const MaterialSet& _materials, const SplatMap& _splat, float _heightMapWorldSize);
+
+#endif // TERRAIN_MATERIALS_H_HEADER_GUARD
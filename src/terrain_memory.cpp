@@ -0,0 +1,284 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <bx/mutex.h>
+#include "terrain_memory.h"
+
+namespace
+{
+	// Prefix of every tracked allocation. Raw pointer is kept for over-aligned blocks, which
+	// don't start at the header.
+	struct AllocHeader
+	{
+		size_t m_size;
+		void*  m_raw;
+	};
+
+	static constexpr size_t kHeaderSize = 16;
+	static constexpr size_t kNaturalAlignment = 8;
+	BX_STATIC_ASSERT(sizeof(AllocHeader) <= kHeaderSize);
+
+	struct MemoryTracker;
+
+	class TrackingAllocator : public bx::AllocatorI
+	{
+	public:
+		virtual ~TrackingAllocator()
+		{
+		}
+
+		virtual void* realloc(void* _ptr, size_t _size, size_t _align, const char* _file, uint32_t _line) override;
+
+		MemoryTracker* m_tracker;
+		MemoryCategory::Enum m_category;
+	};
+
+	struct MemoryTracker
+	{
+		MemoryTracker()
+		{
+			bx::memSet(&m_stats, 0, sizeof(m_stats) );
+			for (uint32_t ii = 0; ii < MemoryCategory::Count; ++ii)
+			{
+				m_allocators[ii].m_tracker  = this;
+				m_allocators[ii].m_category = MemoryCategory::Enum(ii);
+			}
+		}
+
+		void add(MemoryCategory::Enum _category, int64_t _bytes, int32_t _numAllocs)
+		{
+			bx::MutexScope lock(m_mutex);
+
+			int64_t& allocated = m_stats.m_allocated[_category];
+			const int64_t budget = m_stats.m_budget[_category];
+			const bool wasOver = 0 != budget && allocated > budget;
+
+			allocated += _bytes;
+			m_stats.m_peak[_category] = bx::max(m_stats.m_peak[_category], allocated);
+			m_stats.m_numAllocs[_category] += _numAllocs;
+
+			if (!wasOver && 0 != budget && allocated > budget)
+			{
+				BX_TRACE("Memory category %s is over budget, %lld of %lld bytes.", getName(_category), allocated, budget);
+			}
+		}
+
+		bx::DefaultAllocator m_system;
+		TrackingAllocator m_allocators[MemoryCategory::Count];
+		bx::Mutex m_mutex;
+		MemoryStats m_stats;
+	};
+
+	static MemoryTracker& getTracker()
+	{
+		static MemoryTracker s_tracker;
+		return s_tracker;
+	}
+
+	static AllocHeader* getHeader(void* _ptr)
+	{
+		return (AllocHeader*)( (uint8_t*)_ptr - kHeaderSize);
+	}
+
+	void* TrackingAllocator::realloc(void* _ptr, size_t _size, size_t _align, const char* _file, uint32_t _line)
+	{
+		bx::AllocatorI* system = &m_tracker->m_system;
+
+		if (0 == _size)
+		{
+			if (NULL != _ptr)
+			{
+				AllocHeader* header = getHeader(_ptr);
+				m_tracker->add(m_category, -int64_t(header->m_size), -1);
+				system->realloc(header->m_raw, 0, 0, _file, _line);
+			}
+
+			return NULL;
+		}
+
+		const size_t oldSize = NULL != _ptr ? getHeader(_ptr)->m_size : 0;
+
+		uint8_t* ptr;
+		if (kNaturalAlignment >= _align)
+		{
+			void* raw = NULL != _ptr ? getHeader(_ptr)->m_raw : NULL;
+			raw = system->realloc(raw, _size + kHeaderSize, 0, _file, _line);
+			if (NULL == raw)
+			{
+				return NULL;
+			}
+
+			ptr = (uint8_t*)raw + kHeaderSize;
+			getHeader(ptr)->m_raw = raw;
+		}
+		else
+		{
+			void* raw = system->realloc(NULL, _size + _align + kHeaderSize, 0, _file, _line);
+			if (NULL == raw)
+			{
+				return NULL;
+			}
+
+			const uintptr_t addr = uintptr_t(raw) + kHeaderSize;
+			ptr = (uint8_t*)( (addr + _align - 1) & ~uintptr_t(_align - 1) );
+			getHeader(ptr)->m_raw = raw;
+
+			if (NULL != _ptr)
+			{
+				bx::memCopy(ptr, _ptr, bx::min(oldSize, _size) );
+				system->realloc(getHeader(_ptr)->m_raw, 0, 0, _file, _line);
+			}
+		}
+
+		getHeader(ptr)->m_size = _size;
+		m_tracker->add(m_category, int64_t(_size) - int64_t(oldSize), NULL == _ptr ? 1 : 0);
+		return ptr;
+	}
+}
+
+bx::AllocatorI* getAllocator(MemoryCategory::Enum _category)
+{
+	return &getTracker().m_allocators[_category];
+}
+
+const char* getName(MemoryCategory::Enum _category)
+{
+	static const char* s_names[] =
+	{
+		"General",
+		"Height map",
+		"LOD frame",
+		"Materials",
+		"Normals",
+		"Assets",
+		"Scatter",
+		"Horizon",
+		"Occlusion",
+		"Streaming",
+	};
+	BX_STATIC_ASSERT(BX_COUNTOF(s_names) == MemoryCategory::Count);
+
+	return s_names[_category];
+}
+
+void memorySetBudget(MemoryCategory::Enum _category, int64_t _bytes)
+{
+	MemoryTracker& tracker = getTracker();
+	bx::MutexScope lock(tracker.m_mutex);
+	tracker.m_stats.m_budget[_category] = _bytes;
+}
+
+void memoryGetStats(MemoryStats& _outStats)
+{
+	MemoryTracker& tracker = getTracker();
+	bx::MutexScope lock(tracker.m_mutex);
+	_outStats = tracker.m_stats;
+}
+
+void frameArenaCreate(FrameArena& _arena, uint32_t _size, bx::AllocatorI* _allocator)
+{
+	_arena.m_data   = (uint8_t*)BX_ALIGNED_ALLOC(_allocator, _size, 16);
+	_arena.m_size   = _size;
+	_arena.m_offset = 0;
+	_arena.m_peak   = 0;
+}
+
+void frameArenaDestroy(FrameArena& _arena, bx::AllocatorI* _allocator)
+{
+	BX_ALIGNED_FREE(_allocator, _arena.m_data, 16);
+	_arena.m_data = NULL;
+	_arena.m_size = 0;
+	_arena.m_offset = 0;
+}
+
+void* frameArenaAlloc(FrameArena& _arena, uint32_t _size, uint32_t _align)
+{
+	const uint32_t offset = (_arena.m_offset + _align - 1) & ~(_align - 1);
+	if (offset + _size > _arena.m_size)
+	{
+		BX_TRACE("Frame arena out of space, %d of %d bytes used, %d requested.", _arena.m_offset, _arena.m_size, _size);
+		return NULL;
+	}
+
+	_arena.m_offset = offset + _size;
+	_arena.m_peak = bx::max(_arena.m_peak, _arena.m_offset);
+	return &_arena.m_data[offset];
+}
+
+void frameArenaReset(FrameArena& _arena)
+{
+	_arena.m_offset = 0;
+}
+
+void poolCreate(Pool& _pool, uint32_t _itemSize, uint32_t _itemsPerBlock, uint32_t _maxItems, bx::AllocatorI* _allocator)
+{
+	// free list link is stored in the item itself
+	_pool.m_allocator = _allocator;
+	_pool.m_blocks    = NULL;
+	_pool.m_freeList  = NULL;
+	_pool.m_itemSize  = (bx::max<uint32_t>(_itemSize, sizeof(void*) ) + 15) & ~15u;
+	_pool.m_itemsPerBlock = _itemsPerBlock;
+	_pool.m_maxItems  = _maxItems;
+	_pool.m_numItems  = 0;
+	_pool.m_numUsed   = 0;
+}
+
+void poolDestroy(Pool& _pool)
+{
+	BX_CHECK(0 == _pool.m_numUsed, "%d pool items are still in use.", _pool.m_numUsed);
+
+	void* block = _pool.m_blocks;
+	while (NULL != block)
+	{
+		void* next = *(void**)block;
+		BX_ALIGNED_FREE(_pool.m_allocator, block, 16);
+		block = next;
+	}
+
+	_pool.m_blocks   = NULL;
+	_pool.m_freeList = NULL;
+	_pool.m_numItems = 0;
+}
+
+void* poolAlloc(Pool& _pool)
+{
+	if (NULL == _pool.m_freeList)
+	{
+		uint32_t num = _pool.m_itemsPerBlock;
+		if (0 != _pool.m_maxItems)
+		{
+			num = bx::min(num, _pool.m_maxItems - _pool.m_numItems);
+			if (0 == num)
+			{
+				return NULL;
+			}
+		}
+
+		// first 16 bytes link the blocks
+		uint8_t* block = (uint8_t*)BX_ALIGNED_ALLOC(_pool.m_allocator, 16 + num * _pool.m_itemSize, 16);
+		*(void**)block = _pool.m_blocks;
+		_pool.m_blocks = block;
+
+		for (uint32_t ii = num; ii > 0; --ii)
+		{
+			void* item = &block[16 + (ii - 1) * _pool.m_itemSize];
+			*(void**)item = _pool.m_freeList;
+			_pool.m_freeList = item;
+		}
+
+		_pool.m_numItems += num;
+	}
+
+	void* item = _pool.m_freeList;
+	_pool.m_freeList = *(void**)item;
+	++_pool.m_numUsed;
+	return item;
+}
+
+void poolFree(Pool& _pool, void* _ptr)
+{
+	*(void**)_ptr = _pool.m_freeList;
+	_pool.m_freeList = _ptr;
+	--_pool.m_numUsed;
+}
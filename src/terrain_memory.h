@@ -0,0 +1,99 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_MEMORY_H_HEADER_GUARD
+#define TERRAIN_MEMORY_H_HEADER_GUARD
+
+#include <bx/allocator.h>
+
+struct MemoryCategory
+{
+	enum Enum
+	{
+		General,
+		HeightMap,
+		LodFrame,
+		Materials,
+		Normals,
+		Assets,
+		Scatter,
+		Horizon,
+		Occlusion,
+		Streaming,
+
+		Count
+	};
+};
+
+struct MemoryStats
+{
+	int64_t  m_allocated[MemoryCategory::Count];
+	int64_t  m_peak[MemoryCategory::Count];
+	int64_t  m_budget[MemoryCategory::Count]; //!< 0 if category isn't bounded.
+	uint32_t m_numAllocs[MemoryCategory::Count];
+};
+
+/// Allocator that counts live bytes of its category. getDefaultAllocator returns the General
+/// one. Safe to use from any thread.
+bx::AllocatorI* getAllocator(MemoryCategory::Enum _category);
+
+///
+const char* getName(MemoryCategory::Enum _category);
+
+/// Caps what a map may keep in _category. Going over is reported, not refused, so allocation
+/// sites don't need to handle failure.
+void memorySetBudget(MemoryCategory::Enum _category, int64_t _bytes);
+
+///
+void memoryGetStats(MemoryStats& _outStats);
+
+/// Linear allocator for data that lives one frame. Memory is reserved once and reset every
+/// update, so per frame LOD data costs no heap traffic.
+struct FrameArena
+{
+	uint8_t* m_data;
+	uint32_t m_size;
+	uint32_t m_offset;
+	uint32_t m_peak;  //!< Highest offset reached since creation.
+};
+
+///
+void frameArenaCreate(FrameArena& _arena, uint32_t _size, bx::AllocatorI* _allocator);
+
+///
+void frameArenaDestroy(FrameArena& _arena, bx::AllocatorI* _allocator);
+
+/// Returns NULL if arena is out of space.
+void* frameArenaAlloc(FrameArena& _arena, uint32_t _size, uint32_t _align = 16);
+
+///
+void frameArenaReset(FrameArena& _arena);
+
+/// Fixed size item pool. Items are carved out of blocks of _itemsPerBlock and recycled
+/// through a free list, blocks are only released on destroy.
+struct Pool
+{
+	bx::AllocatorI* m_allocator;
+	void*    m_blocks;    //!< Singly linked list of blocks.
+	void*    m_freeList;
+	uint32_t m_itemSize;
+	uint32_t m_itemsPerBlock;
+	uint32_t m_maxItems;  //!< 0 for unbounded.
+	uint32_t m_numItems;  //!< Items in all blocks.
+	uint32_t m_numUsed;
+};
+
+///
+void poolCreate(Pool& _pool, uint32_t _itemSize, uint32_t _itemsPerBlock, uint32_t _maxItems, bx::AllocatorI* _allocator);
+
+///
+void poolDestroy(Pool& _pool);
+
+/// Returns NULL if pool is bounded and full.
+void* poolAlloc(Pool& _pool);
+
+///
+void poolFree(Pool& _pool, void* _ptr);
+
+#endif // TERRAIN_MEMORY_H_HEADER_GUARD
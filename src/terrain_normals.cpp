@@ -0,0 +1,167 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <bx/allocator.h>
+#include <bx/simd_t.h>
+#include "terrain_memory.h"
+#include "terrain_normals.h"
+
+void normalCacheCreate(NormalCache& _cache, uint32_t _width, uint32_t _height, uint32_t _tileSize)
+{
+	tileGridInit(_cache.m_grid, _width, _height, _tileSize);
+
+	const uint32_t numTiles = _cache.m_grid.m_numTilesX * _cache.m_grid.m_numTilesY;
+	_cache.m_dirty = (uint8_t*)BX_ALLOC(getAllocator(MemoryCategory::Normals), numTiles);
+	bx::memSet(_cache.m_dirty, 1, numTiles);
+	_cache.m_numDirty = numTiles;
+}
+
+void normalCacheDestroy(NormalCache& _cache)
+{
+	BX_FREE(getAllocator(MemoryCategory::Normals), _cache.m_dirty);
+	_cache.m_dirty = NULL;
+	_cache.m_numDirty = 0;
+}
+
+void normalCacheInvalidate(NormalCache& _cache, const TileRect& _rect)
+{
+	uint32_t x0, y0, x1, y1;
+	if (!tileGridRange(_cache.m_grid, tileRectExpand(_rect, 1), x0, y0, x1, y1) )
+	{
+		return;
+	}
+
+	for (uint32_t yy = y0; yy < y1; ++yy)
+	{
+		for (uint32_t xx = x0; xx < x1; ++xx)
+		{
+			uint8_t& dirty = _cache.m_dirty[xx + yy * _cache.m_grid.m_numTilesX];
+			_cache.m_numDirty += 1 - dirty;
+			dirty = 1;
+		}
+	}
+}
+
+uint32_t normalCacheFlush(NormalCache& _cache, TileRect* _outRects, uint32_t _max)
+{
+	const TileGrid& grid = _cache.m_grid;
+
+	uint32_t num = 0;
+	for (uint32_t yy = 0; yy < grid.m_numTilesY && 0 != _cache.m_numDirty; ++yy)
+	{
+		uint8_t* row = &_cache.m_dirty[yy * grid.m_numTilesX];
+
+		uint32_t xx = 0;
+		while (xx < grid.m_numTilesX)
+		{
+			if (0 == row[xx])
+			{
+				++xx;
+				continue;
+			}
+
+			if (num == _max)
+			{
+				return num;
+			}
+
+			const uint32_t start = xx;
+			for (; xx < grid.m_numTilesX && 0 != row[xx]; ++xx)
+			{
+				row[xx] = 0;
+				--_cache.m_numDirty;
+			}
+
+			const TileRect first = tileGridTileRect(grid, start, yy);
+			const TileRect last  = tileGridTileRect(grid, xx - 1, yy);
+			_outRects[num++] = tileRectUnion(first, last);
+		}
+	}
+
+	return num;
+}
+
+static inline float heightAt(const uint16_t* _heights, uint32_t _width, uint32_t _height, int32_t _x, int32_t _y)
+{
+	const int32_t xx = bx::clamp(_x, 0, int32_t(_width)  - 1);
+	const int32_t yy = bx::clamp(_y, 0, int32_t(_height) - 1);
+	return float(_heights[xx + yy * _width]);
+}
+
+void normalsComputeRG8(
+	  uint8_t* _dst
+	, const uint16_t* _heights
+	, uint32_t _width
+	, uint32_t _height
+	, const TileRect& _rect
+	, float _heightScale
+	, float _texelSize
+	)
+{
+	TileRect full = { 0, 0, int32_t(_width), int32_t(_height) };
+	const TileRect rect = tileRectIntersect(_rect, full);
+	if (tileRectIsEmpty(rect) )
+	{
+		return;
+	}
+
+	// Gradient of central difference in world units.
+	const bx::simd128_t gradScale = bx::simd_splat(_heightScale / (2.0f * _texelSize) );
+	const bx::simd128_t one       = bx::simd_splat(1.0f);
+	const bx::simd128_t half      = bx::simd_splat(127.5f);
+	const bx::simd128_t zero      = bx::simd_zero();
+	const bx::simd128_t maxByte   = bx::simd_splat(255.0f);
+
+	BX_ALIGN_DECL_16(float) left[4];
+	BX_ALIGN_DECL_16(float) right[4];
+	BX_ALIGN_DECL_16(float) down[4];
+	BX_ALIGN_DECL_16(float) up[4];
+	BX_ALIGN_DECL_16(float) outX[4];
+	BX_ALIGN_DECL_16(float) outZ[4];
+
+	for (int32_t yy = rect.m_y0; yy < rect.m_y1; ++yy)
+	{
+		for (int32_t xx = rect.m_x0; xx < rect.m_x1; xx += 4)
+		{
+			for (int32_t ii = 0; ii < 4; ++ii)
+			{
+				const int32_t x = xx + ii;
+				left[ii]  = heightAt(_heights, _width, _height, x - 1, yy);
+				right[ii] = heightAt(_heights, _width, _height, x + 1, yy);
+				down[ii]  = heightAt(_heights, _width, _height, x, yy - 1);
+				up[ii]    = heightAt(_heights, _width, _height, x, yy + 1);
+			}
+
+			const bx::simd128_t dx = bx::simd_mul(bx::simd_sub(bx::simd_ld(right), bx::simd_ld(left) ), gradScale);
+			const bx::simd128_t dz = bx::simd_mul(bx::simd_sub(bx::simd_ld(up),    bx::simd_ld(down) ), gradScale);
+
+			// normal = normalize(-dx, 1, -dz)
+			const bx::simd128_t lenSq  = bx::simd_madd(dx, dx, bx::simd_madd(dz, dz, one) );
+			const bx::simd128_t invLen = bx::simd_rsqrt(lenSq);
+			const bx::simd128_t nx     = bx::simd_neg(bx::simd_mul(dx, invLen) );
+			const bx::simd128_t nz     = bx::simd_neg(bx::simd_mul(dz, invLen) );
+
+			const bx::simd128_t ex = bx::simd_clamp(bx::simd_round(bx::simd_madd(nx, half, half) ), zero, maxByte);
+			const bx::simd128_t ez = bx::simd_clamp(bx::simd_round(bx::simd_madd(nz, half, half) ), zero, maxByte);
+			bx::simd_st(outX, ex);
+			bx::simd_st(outZ, ez);
+
+			const int32_t num = bx::min(4, rect.m_x1 - xx);
+			uint8_t* dst = &_dst[(xx + yy * _width) * 2];
+			for (int32_t ii = 0; ii < num; ++ii)
+			{
+				dst[ii * 2 + 0] = uint8_t(outX[ii]);
+				dst[ii * 2 + 1] = uint8_t(outZ[ii]);
+			}
+		}
+	}
+}
+
+bx::Vec3 normalsDecodeRG8(const uint8_t* _texel)
+{
+	const float nx = float(_texel[0]) / 127.5f - 1.0f;
+	const float nz = float(_texel[1]) / 127.5f - 1.0f;
+	const float ny = bx::sqrt(bx::max(0.0f, 1.0f - nx * nx - nz * nz) );
+	return { nx, ny, nz };
+}
@@ -0,0 +1,54 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_NORMALS_H_HEADER_GUARD
+#define TERRAIN_NORMALS_H_HEADER_GUARD
+
+#include <bx/math.h>
+#include "terrain_tiles.h"
+
+/// Tracks which normal map tiles are out of date with the height map. Tiles start dirty and
+/// are only invalidated again by edits touching them.
+struct NormalCache
+{
+	TileGrid m_grid;
+	uint8_t* m_dirty;
+	uint32_t m_numDirty;
+};
+
+///
+void normalCacheCreate(NormalCache& _cache, uint32_t _width, uint32_t _height, uint32_t _tileSize);
+
+///
+void normalCacheDestroy(NormalCache& _cache);
+
+/// Marks tiles touched by height edit in _rect as dirty. Rectangle is grown by one texel
+/// because central differences read neighbours.
+void normalCacheInvalidate(NormalCache& _cache, const TileRect& _rect);
+
+/// Returns up to _max rectangles that need normals recomputed and marks them clean. Dirty
+/// tiles in one row are merged into one rectangle.
+uint32_t normalCacheFlush(NormalCache& _cache, TileRect* _outRects, uint32_t _max);
+
+/// CPU reference for cs_updateNormals. Writes RG8 normals for texels in _rect into _dst, a
+/// _width x _height RG8 image. X and Z are stored in [0, 255], Y is reconstructed as
+/// sqrt(1 - x^2 - z^2) since height field normals always point up.
+///
+/// @param[in] _heightScale World units per height map unit.
+/// @param[in] _texelSize World units between two height map texels.
+///
+void normalsComputeRG8(
+	  uint8_t* _dst
+	, const uint16_t* _heights
+	, uint32_t _width
+	, uint32_t _height
+	, const TileRect& _rect
+	, float _heightScale
+	, float _texelSize
+	);
+
+///
+bx::Vec3 normalsDecodeRG8(const uint8_t* _texel);
+
+#endif // TERRAIN_NORMALS_H_HEADER_GUARD
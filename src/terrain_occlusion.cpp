@@ -0,0 +1,556 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <bx/allocator.h>
+#include <bx/cpu.h>
+#include <bx/simd_t.h>
+#include <bx/timer.h>
+#include "asset_loader.h"
+#include "terrain_memory.h"
+#include "terrain_occlusion.h"
+
+// Triangles are clipped at w = s_nearW, depth z / w stays ordered for any positive w.
+static const float s_nearW = 1e-3f;
+
+static inline void transformClip(float* _out, const float* _viewProj, float _x, float _y, float _z)
+{
+	_out[0] = _x * _viewProj[0] + _y * _viewProj[4] + _z * _viewProj[ 8] + _viewProj[12];
+	_out[1] = _x * _viewProj[1] + _y * _viewProj[5] + _z * _viewProj[ 9] + _viewProj[13];
+	_out[2] = _x * _viewProj[2] + _y * _viewProj[6] + _z * _viewProj[10] + _viewProj[14];
+	_out[3] = _x * _viewProj[3] + _y * _viewProj[7] + _z * _viewProj[11] + _viewProj[15];
+}
+
+// Clip space to pixels, x right and y down, and depth.
+static inline void projectScreen(float* _out, const float* _clip)
+{
+	const float invW = 1.0f / _clip[3];
+	_out[0] = ( _clip[0] * invW * 0.5f + 0.5f) * float(OcclusionBuffer::kWidth);
+	_out[1] = (-_clip[1] * invW * 0.5f + 0.5f) * float(OcclusionBuffer::kHeight);
+	_out[2] = _clip[2] * invW;
+}
+
+static void setupTriangle(OcclusionBuffer& _buffer, const float* _v0, const float* _v1, const float* _v2)
+{
+	const float* v0 = _v0;
+	const float* v1 = _v1;
+	const float* v2 = _v2;
+
+	float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v1[1] - v0[1]) * (v2[0] - v0[0]);
+	if (area < 0.0f)
+	{
+		bx::swap(v1, v2);
+		area = -area;
+	}
+
+	if (area < 1e-6f)
+	{
+		return;
+	}
+
+	const int32_t x0 = bx::max(int32_t(bx::floor(bx::min(v0[0], v1[0], v2[0]) ) ), 0);
+	const int32_t y0 = bx::max(int32_t(bx::floor(bx::min(v0[1], v1[1], v2[1]) ) ), 0);
+	const int32_t x1 = bx::min(int32_t(bx::ceil(bx::max(v0[0], v1[0], v2[0]) ) ), int32_t(OcclusionBuffer::kWidth) );
+	const int32_t y1 = bx::min(int32_t(bx::ceil(bx::max(v0[1], v1[1], v2[1]) ) ), int32_t(OcclusionBuffer::kHeight) );
+	if (x0 >= x1
+	||  y0 >= y1
+	||  _buffer.m_numTriangles == _buffer.m_maxTriangles)
+	{
+		return;
+	}
+
+	const uint16_t index = uint16_t(_buffer.m_numTriangles++);
+	OcclusionTriangle& triangle = _buffer.m_triangles[index];
+	triangle.m_minX = int16_t(x0);
+	triangle.m_minY = int16_t(y0);
+	triangle.m_maxX = int16_t(x1);
+	triangle.m_maxY = int16_t(y1);
+
+	// edge opposite vertex n, evaluated at pixel centres, is its barycentric weight times area
+	const float* vertices[3] = { v0, v1, v2 };
+	const float invArea = 1.0f / area;
+	float depth[3] = { 0.0f, 0.0f, 0.0f };
+	for (uint32_t ii = 0; ii < 3; ++ii)
+	{
+		const float* pp = vertices[(ii + 1) % 3];
+		const float* qq = vertices[(ii + 2) % 3];
+		const float aa = pp[1] - qq[1];
+		const float bb = qq[0] - pp[0];
+		const float cc = -(aa * pp[0] + bb * pp[1]) + 0.5f * (aa + bb);
+		triangle.m_edgeA[ii] = aa;
+		triangle.m_edgeB[ii] = bb;
+		triangle.m_edgeC[ii] = cc;
+
+		// depth is linear in screen space
+		const float zz = vertices[ii][2] * invArea;
+		depth[0] += aa * zz;
+		depth[1] += bb * zz;
+		depth[2] += cc * zz;
+	}
+	triangle.m_depth[0] = depth[0];
+	triangle.m_depth[1] = depth[1];
+	triangle.m_depth[2] = depth[2];
+
+	const uint32_t tileX0 = uint32_t(x0) / OcclusionBuffer::kTileSize;
+	const uint32_t tileY0 = uint32_t(y0) / OcclusionBuffer::kTileSize;
+	const uint32_t tileX1 = uint32_t(x1 - 1) / OcclusionBuffer::kTileSize;
+	const uint32_t tileY1 = uint32_t(y1 - 1) / OcclusionBuffer::kTileSize;
+	for (uint32_t yy = tileY0; yy <= tileY1; ++yy)
+	{
+		for (uint32_t xx = tileX0; xx <= tileX1; ++xx)
+		{
+			const uint32_t tile = xx + yy * OcclusionBuffer::kNumTilesX;
+			_buffer.m_bins[tile * _buffer.m_maxTriangles + _buffer.m_binSize[tile]++] = index;
+		}
+	}
+}
+
+static void rasterizeTile(OcclusionBuffer& _buffer, uint32_t _tile)
+{
+	const int32_t tileX0 = int32_t(_tile % OcclusionBuffer::kNumTilesX * OcclusionBuffer::kTileSize);
+	const int32_t tileY0 = int32_t(_tile / OcclusionBuffer::kNumTilesX * OcclusionBuffer::kTileSize);
+	const int32_t tileX1 = tileX0 + int32_t(OcclusionBuffer::kTileSize);
+	const int32_t tileY1 = tileY0 + int32_t(OcclusionBuffer::kTileSize);
+
+	// nothing drawn is infinitely far, boxes over empty texels stay visible
+	const bx::simd128_t farDepth = bx::simd_splat(bx::kFloatMax);
+	for (int32_t yy = tileY0; yy < tileY1; ++yy)
+	{
+		float* row = &_buffer.m_depth[yy * OcclusionBuffer::kWidth];
+		for (int32_t xx = tileX0; xx < tileX1; xx += 4)
+		{
+			bx::simd_st(&row[xx], farDepth);
+		}
+	}
+
+	const bx::simd128_t offsets = bx::simd_ld(0.0f, 1.0f, 2.0f, 3.0f);
+	const uint16_t* bin = &_buffer.m_bins[_tile * _buffer.m_maxTriangles];
+	for (uint32_t ii = 0, num = _buffer.m_binSize[_tile]; ii < num; ++ii)
+	{
+		const OcclusionTriangle& triangle = _buffer.m_triangles[bin[ii] ];
+
+		// rows start at a multiple of 4 pixels, tiles are too
+		const int32_t x0 = bx::max(int32_t(triangle.m_minX), tileX0) & ~3;
+		const int32_t y0 = bx::max(int32_t(triangle.m_minY), tileY0);
+		const int32_t x1 = bx::min(int32_t(triangle.m_maxX), tileX1);
+		const int32_t y1 = bx::min(int32_t(triangle.m_maxY), tileY1);
+
+		const bx::simd128_t a0 = bx::simd_splat(triangle.m_edgeA[0]);
+		const bx::simd128_t a1 = bx::simd_splat(triangle.m_edgeA[1]);
+		const bx::simd128_t a2 = bx::simd_splat(triangle.m_edgeA[2]);
+		const bx::simd128_t az = bx::simd_splat(triangle.m_depth[0]);
+		const bx::simd128_t step0 = bx::simd_splat(triangle.m_edgeA[0] * 4.0f);
+		const bx::simd128_t step1 = bx::simd_splat(triangle.m_edgeA[1] * 4.0f);
+		const bx::simd128_t step2 = bx::simd_splat(triangle.m_edgeA[2] * 4.0f);
+		const bx::simd128_t stepZ = bx::simd_splat(triangle.m_depth[0] * 4.0f);
+		const bx::simd128_t px = bx::simd_add(bx::simd_splat(float(x0) ), offsets);
+
+		for (int32_t yy = y0; yy < y1; ++yy)
+		{
+			const float fy = float(yy);
+			bx::simd128_t e0 = bx::simd_madd(a0, px, bx::simd_splat(triangle.m_edgeB[0] * fy + triangle.m_edgeC[0]) );
+			bx::simd128_t e1 = bx::simd_madd(a1, px, bx::simd_splat(triangle.m_edgeB[1] * fy + triangle.m_edgeC[1]) );
+			bx::simd128_t e2 = bx::simd_madd(a2, px, bx::simd_splat(triangle.m_edgeB[2] * fy + triangle.m_edgeC[2]) );
+			bx::simd128_t zz = bx::simd_madd(az, px, bx::simd_splat(triangle.m_depth[1] * fy + triangle.m_depth[2]) );
+
+			float* row = &_buffer.m_depth[yy * OcclusionBuffer::kWidth];
+			for (int32_t xx = x0; xx < x1; xx += 4)
+			{
+				// any negative edge sets the sign bit, the pixel is outside
+				const bx::simd128_t outside = bx::simd_sra(bx::simd_or(bx::simd_or(e0, e1), e2), 31);
+				const bx::simd128_t depth = bx::simd_ld(&row[xx]);
+				bx::simd_st(&row[xx], bx::simd_selb(outside, depth, bx::simd_min(depth, zz) ) );
+
+				e0 = bx::simd_add(e0, step0);
+				e1 = bx::simd_add(e1, step1);
+				e2 = bx::simd_add(e2, step2);
+				zz = bx::simd_add(zz, stepZ);
+			}
+		}
+	}
+
+	// pyramid levels below one texel per tile need other tiles
+	for (uint32_t level = 1; level < OcclusionBuffer::kTileLevels; ++level)
+	{
+		const uint32_t childWidth = OcclusionBuffer::kWidth >> (level - 1);
+		const uint32_t width = OcclusionBuffer::kWidth >> level;
+		const uint32_t size  = OcclusionBuffer::kTileSize >> level;
+		const uint32_t originX = uint32_t(tileX0) >> level;
+		const uint32_t originY = uint32_t(tileY0) >> level;
+		const float* children = &_buffer.m_depth[_buffer.m_levelOffset[level - 1] ];
+		float* parents = &_buffer.m_depth[_buffer.m_levelOffset[level] ];
+
+		for (uint32_t yy = originY; yy < originY + size; ++yy)
+		{
+			const float* row0 = &children[(yy * 2    ) * childWidth];
+			const float* row1 = &children[(yy * 2 + 1) * childWidth];
+			for (uint32_t xx = originX; xx < originX + size; ++xx)
+			{
+				parents[xx + yy * width] = bx::max(
+					  bx::max(row0[xx * 2], row0[xx * 2 + 1])
+					, bx::max(row1[xx * 2], row1[xx * 2 + 1])
+					);
+			}
+		}
+	}
+}
+
+static void rasterizeTiles(OcclusionBuffer& _buffer)
+{
+	for (;;)
+	{
+		const uint32_t tile = bx::atomicFetchAndAdd(&_buffer.m_nextTile, 1u);
+		if (tile >= OcclusionBuffer::kNumTiles)
+		{
+			return;
+		}
+
+		rasterizeTile(_buffer, tile);
+		if (OcclusionBuffer::kNumTiles == bx::atomicFetchAndAdd(&_buffer.m_numTilesDone, 1u) + 1)
+		{
+			_buffer.m_tilesDone.post();
+		}
+	}
+}
+
+// Helpers that start late find no tiles left and return, until the next flush resets
+// m_nextTile after all occluders are set up.
+static void occlusionHelperJob(void* _userData)
+{
+	OcclusionBuffer& buffer = *(OcclusionBuffer*)_userData;
+	rasterizeTiles(buffer);
+	bx::atomicFetchAndSub(&buffer.m_numHelpersQueued, 1);
+}
+
+static void clipTriangle(OcclusionBuffer& _buffer, const float* _c0, const float* _c1, const float* _c2)
+{
+	const float* clip[3] = { _c0, _c1, _c2 };
+
+	// trivially outside one of the side planes
+	for (uint32_t axis = 0; axis < 2; ++axis)
+	{
+		if ( (_c0[axis] >  _c0[3] && _c1[axis] >  _c1[3] && _c2[axis] >  _c2[3])
+		||   (_c0[axis] < -_c0[3] && _c1[axis] < -_c1[3] && _c2[axis] < -_c2[3]) )
+		{
+			return;
+		}
+	}
+
+	uint32_t numBehind = 0;
+	for (uint32_t ii = 0; ii < 3; ++ii)
+	{
+		numBehind += clip[ii][3] < s_nearW ? 1 : 0;
+	}
+
+	if (3 == numBehind)
+	{
+		return;
+	}
+
+	if (0 == numBehind)
+	{
+		float screen[3][3];
+		for (uint32_t ii = 0; ii < 3; ++ii)
+		{
+			projectScreen(screen[ii], clip[ii]);
+		}
+		setupTriangle(_buffer, screen[0], screen[1], screen[2]);
+		return;
+	}
+
+	// clip polygon at near w, a triangle becomes at most a quad
+	float polygon[4][3];
+	uint32_t numPolygon = 0;
+	for (uint32_t ii = 0; ii < 3; ++ii)
+	{
+		const float* aa = clip[ii];
+		const float* bb = clip[(ii + 1) % 3];
+		if (aa[3] >= s_nearW)
+		{
+			projectScreen(polygon[numPolygon++], aa);
+		}
+
+		if ( (aa[3] >= s_nearW) != (bb[3] >= s_nearW) )
+		{
+			const float tt = (s_nearW - aa[3]) / (bb[3] - aa[3]);
+			float point[4];
+			for (uint32_t jj = 0; jj < 4; ++jj)
+			{
+				point[jj] = bx::lerp(aa[jj], bb[jj], tt);
+			}
+			projectScreen(polygon[numPolygon++], point);
+		}
+	}
+
+	for (uint32_t ii = 2; ii < numPolygon; ++ii)
+	{
+		setupTriangle(_buffer, polygon[0], polygon[ii - 1], polygon[ii]);
+	}
+}
+
+void occlusionCreate(OcclusionBuffer& _buffer, uint32_t _maxOccluderCells, uint32_t _numHelpers)
+{
+	uint32_t numTexels = 0;
+	for (uint32_t level = 0; level < OcclusionBuffer::kNumLevels; ++level)
+	{
+		_buffer.m_levelOffset[level] = numTexels;
+		numTexels += (OcclusionBuffer::kWidth >> level) * (OcclusionBuffer::kHeight >> level);
+	}
+
+	// every height field cell may be clipped into 2 triangles at the near plane
+	_buffer.m_maxOccluderCells = _maxOccluderCells;
+	_buffer.m_maxTriangles = bx::min(_maxOccluderCells * _maxOccluderCells * 4, uint32_t(UINT16_MAX) );
+
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::Occlusion);
+	_buffer.m_depth     = (float*)BX_ALIGNED_ALLOC(allocator, numTexels * sizeof(float), 16);
+	_buffer.m_vertices  = (float*)BX_ALLOC(allocator, (_maxOccluderCells + 1) * (_maxOccluderCells + 1) * 4 * sizeof(float) );
+	_buffer.m_triangles = (OcclusionTriangle*)BX_ALLOC(allocator, _buffer.m_maxTriangles * sizeof(OcclusionTriangle) );
+	_buffer.m_bins      = (uint16_t*)BX_ALLOC(allocator, OcclusionBuffer::kNumTiles * _buffer.m_maxTriangles * sizeof(uint16_t) );
+
+	_buffer.m_numHelpers = _numHelpers;
+	_buffer.m_numHelpersQueued = 0;
+	_buffer.m_nextTile = OcclusionBuffer::kNumTiles;
+	_buffer.m_numTilesDone = 0;
+
+	bx::mtxIdentity(_buffer.m_viewProj);
+	occlusionBegin(_buffer, _buffer.m_viewProj);
+}
+
+void occlusionDestroy(OcclusionBuffer& _buffer)
+{
+	BX_CHECK(0 == _buffer.m_numHelpersQueued, "Loader threads must be stopped first.");
+
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::Occlusion);
+	BX_FREE(allocator, _buffer.m_bins);
+	BX_FREE(allocator, _buffer.m_triangles);
+	BX_FREE(allocator, _buffer.m_vertices);
+	BX_ALIGNED_FREE(allocator, _buffer.m_depth, 16);
+	_buffer.m_bins = NULL;
+	_buffer.m_triangles = NULL;
+	_buffer.m_vertices = NULL;
+	_buffer.m_depth = NULL;
+}
+
+void occlusionBegin(OcclusionBuffer& _buffer, const float* _viewProj)
+{
+	bx::memCopy(_buffer.m_viewProj, _viewProj, sizeof(_buffer.m_viewProj) );
+	bx::memSet(_buffer.m_binSize, 0, sizeof(_buffer.m_binSize) );
+
+	_buffer.m_numTriangles = 0;
+	_buffer.m_numTested = 0;
+	_buffer.m_numOutside = 0;
+	_buffer.m_numOccluded = 0;
+	_buffer.m_setupMs = 0.0f;
+	_buffer.m_rasterMs = 0.0f;
+}
+
+void occlusionRasterize(OcclusionBuffer& _buffer, const float* _positions, uint32_t _numVertices, const uint16_t* _indices, uint32_t _numIndices)
+{
+	BX_UNUSED(_numVertices);
+	const int64_t start = bx::getHPCounter();
+
+	for (uint32_t ii = 0; ii + 2 < _numIndices; ii += 3)
+	{
+		float clip[3][4];
+		for (uint32_t jj = 0; jj < 3; ++jj)
+		{
+			const uint16_t index = _indices[ii + jj];
+			BX_CHECK(index < _numVertices, "Index %d out of range.", index);
+			const float* pos = &_positions[index * 3];
+			transformClip(clip[jj], _buffer.m_viewProj, pos[0], pos[1], pos[2]);
+		}
+		clipTriangle(_buffer, clip[0], clip[1], clip[2]);
+	}
+
+	_buffer.m_setupMs += float(double(bx::getHPCounter() - start) * 1000.0 / double(bx::getHPFrequency() ) );
+}
+
+void occlusionRasterizeHeightfield(OcclusionBuffer& _buffer, const Heightfield& _field)
+{
+	const int64_t start = bx::getHPCounter();
+
+	uint32_t level = 0;
+	while (level + 1 < _field.m_numLevels
+	&&    (_field.m_levelWidth[level]  > _buffer.m_maxOccluderCells
+	||     _field.m_levelHeight[level] > _buffer.m_maxOccluderCells) )
+	{
+		++level;
+	}
+
+	const uint32_t width  = _field.m_levelWidth[level];
+	const uint32_t height = _field.m_levelHeight[level];
+	const uint16_t* cells = &_field.m_minMax[_field.m_levelOffset[level] * 2];
+	const float cellSize  = float(1 << level) * _field.m_texelSize;
+	const float maxX = (float(_field.m_width)  - 0.5f) * _field.m_texelSize;
+	const float maxZ = (float(_field.m_height) - 0.5f) * _field.m_texelSize;
+
+	// Surface drawn with coarse LOD dips below a cell's min where it interpolates heights of
+	// neighbour cells, so vertices take min of the cells around their 4 cells. Vertices stay
+	// within texel centres, the rendered surface ends there too.
+	for (uint32_t yy = 0; yy <= height; ++yy)
+	{
+		for (uint32_t xx = 0; xx <= width; ++xx)
+		{
+			const uint32_t cx0 = uint32_t(bx::max(int32_t(xx) - 2, 0) );
+			const uint32_t cy0 = uint32_t(bx::max(int32_t(yy) - 2, 0) );
+			const uint32_t cx1 = bx::min(xx + 2, width);
+			const uint32_t cy1 = bx::min(yy + 2, height);
+
+			uint16_t minHeight = UINT16_MAX;
+			for (uint32_t cy = cy0; cy < cy1; ++cy)
+			{
+				for (uint32_t cx = cx0; cx < cx1; ++cx)
+				{
+					minHeight = bx::min(minHeight, cells[(cx + cy * width) * 2]);
+				}
+			}
+
+			const float worldX = bx::min(float(xx) * cellSize + 0.5f * _field.m_texelSize, maxX);
+			const float worldZ = bx::min(float(yy) * cellSize + 0.5f * _field.m_texelSize, maxZ);
+			transformClip(&_buffer.m_vertices[(xx + yy * (width + 1) ) * 4], _buffer.m_viewProj, worldX, minHeight * _field.m_heightScale, worldZ);
+		}
+	}
+
+	for (uint32_t yy = 0; yy < height; ++yy)
+	{
+		for (uint32_t xx = 0; xx < width; ++xx)
+		{
+			const float* v00 = &_buffer.m_vertices[(xx     +  yy      * (width + 1) ) * 4];
+			const float* v10 = &_buffer.m_vertices[(xx + 1 +  yy      * (width + 1) ) * 4];
+			const float* v01 = &_buffer.m_vertices[(xx     + (yy + 1) * (width + 1) ) * 4];
+			const float* v11 = &_buffer.m_vertices[(xx + 1 + (yy + 1) * (width + 1) ) * 4];
+			clipTriangle(_buffer, v00, v10, v11);
+			clipTriangle(_buffer, v00, v11, v01);
+		}
+	}
+
+	_buffer.m_setupMs += float(double(bx::getHPCounter() - start) * 1000.0 / double(bx::getHPFrequency() ) );
+}
+
+void occlusionFlush(OcclusionBuffer& _buffer)
+{
+	const int64_t start = bx::getHPCounter();
+
+	// no tile is claimed while m_nextTile is past the last one, stale helpers can't be inside
+	_buffer.m_numTilesDone = 0;
+	uint32_t nextTile;
+	do
+	{
+		nextTile = _buffer.m_nextTile;
+	}
+	while (nextTile != bx::atomicCompareAndSwap(&_buffer.m_nextTile, nextTile, 0u) );
+
+	// helpers still queued from earlier flushes help with this one
+	for (int32_t ii = bx::atomicFetchAndAdd(&_buffer.m_numHelpersQueued, 0); ii < int32_t(_buffer.m_numHelpers); ++ii)
+	{
+		bx::atomicFetchAndAdd(&_buffer.m_numHelpersQueued, 1);
+		assetSubmitJob(occlusionHelperJob, NULL, &_buffer);
+	}
+
+	// loader threads may be busy with other jobs, this thread never waits on them to start,
+	// only on tiles helpers already claimed
+	rasterizeTiles(_buffer);
+	_buffer.m_tilesDone.wait();
+
+	for (uint32_t level = OcclusionBuffer::kTileLevels; level < OcclusionBuffer::kNumLevels; ++level)
+	{
+		const uint32_t childWidth = OcclusionBuffer::kWidth >> (level - 1);
+		const uint32_t width  = OcclusionBuffer::kWidth  >> level;
+		const uint32_t height = OcclusionBuffer::kHeight >> level;
+		const float* children = &_buffer.m_depth[_buffer.m_levelOffset[level - 1] ];
+		float* parents = &_buffer.m_depth[_buffer.m_levelOffset[level] ];
+
+		for (uint32_t yy = 0; yy < height; ++yy)
+		{
+			const float* row0 = &children[(yy * 2    ) * childWidth];
+			const float* row1 = &children[(yy * 2 + 1) * childWidth];
+			for (uint32_t xx = 0; xx < width; ++xx)
+			{
+				parents[xx + yy * width] = bx::max(
+					  bx::max(row0[xx * 2], row0[xx * 2 + 1])
+					, bx::max(row1[xx * 2], row1[xx * 2 + 1])
+					);
+			}
+		}
+	}
+
+	_buffer.m_rasterMs = float(double(bx::getHPCounter() - start) * 1000.0 / double(bx::getHPFrequency() ) );
+}
+
+OcclusionResult::Enum occlusionTest(OcclusionBuffer& _buffer, const bx::Vec3& _min, const bx::Vec3& _max)
+{
+	++_buffer.m_numTested;
+
+	float minX =  bx::kFloatMax;
+	float minY =  bx::kFloatMax;
+	float maxX = -bx::kFloatMax;
+	float maxY = -bx::kFloatMax;
+	float minZ =  bx::kFloatMax;
+	for (uint32_t ii = 0; ii < 8; ++ii)
+	{
+		float clip[4];
+		transformClip(clip, _buffer.m_viewProj
+			, 0 != (ii & 1) ? _max.x : _min.x
+			, 0 != (ii & 2) ? _max.y : _min.y
+			, 0 != (ii & 4) ? _max.z : _min.z
+			);
+		if (clip[3] < s_nearW)
+		{
+			return OcclusionResult::Visible;
+		}
+
+		float screen[3];
+		projectScreen(screen, clip);
+		minX = bx::min(minX, screen[0]);
+		minY = bx::min(minY, screen[1]);
+		maxX = bx::max(maxX, screen[0]);
+		maxY = bx::max(maxY, screen[1]);
+		minZ = bx::min(minZ, screen[2]);
+	}
+
+	if (maxX < 0.0f || minX > float(OcclusionBuffer::kWidth)
+	||  maxY < 0.0f || minY > float(OcclusionBuffer::kHeight) )
+	{
+		++_buffer.m_numOutside;
+		return OcclusionResult::Outside;
+	}
+
+	// every pixel the box may touch, on the level where they fit in a few texels
+	int32_t x0 = bx::max(int32_t(bx::floor(minX) ), 0);
+	int32_t y0 = bx::max(int32_t(bx::floor(minY) ), 0);
+	int32_t x1 = bx::min(int32_t(bx::floor(maxX) ), int32_t(OcclusionBuffer::kWidth)  - 1);
+	int32_t y1 = bx::min(int32_t(bx::floor(maxY) ), int32_t(OcclusionBuffer::kHeight) - 1);
+
+	uint32_t level = 0;
+	while (level + 1 < OcclusionBuffer::kNumLevels
+	&&    (x1 - x0 > 3 || y1 - y0 > 3) )
+	{
+		x0 >>= 1;
+		y0 >>= 1;
+		x1 >>= 1;
+		y1 >>= 1;
+		++level;
+	}
+
+	const uint32_t width = OcclusionBuffer::kWidth >> level;
+	const float* depth = &_buffer.m_depth[_buffer.m_levelOffset[level] ];
+	for (int32_t yy = y0; yy <= y1; ++yy)
+	{
+		for (int32_t xx = x0; xx <= x1; ++xx)
+		{
+			if (minZ <= depth[xx + yy * width])
+			{
+				return OcclusionResult::Visible;
+			}
+		}
+	}
+
+	++_buffer.m_numOccluded;
+	return OcclusionResult::Occluded;
+}
+
+double occlusionGetTrianglesPerSecond(const OcclusionBuffer& _buffer)
+{
+	const double ms = double(_buffer.m_setupMs) + double(_buffer.m_rasterMs);
+	return 0.0 < ms ? double(_buffer.m_numTriangles) * 1000.0 / ms : 0.0;
+}
@@ -0,0 +1,115 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_OCCLUSION_H_HEADER_GUARD
+#define TERRAIN_OCCLUSION_H_HEADER_GUARD
+
+#include <bx/math.h>
+#include <bx/semaphore.h>
+#include "terrain_heightfield.h"
+
+/// Result of an occlusion query.
+struct OcclusionResult
+{
+	enum Enum
+	{
+		Visible,
+		Outside,  //!< Off screen.
+		Occluded, //!< Behind occluders everywhere it covers.
+
+		Count
+	};
+};
+
+/// Screen space triangle ready for rasterisation, edge functions a * x + b * y + c are
+/// positive inside and depth is a plane over the screen.
+struct OcclusionTriangle
+{
+	float   m_edgeA[3];
+	float   m_edgeB[3];
+	float   m_edgeC[3];
+	float   m_depth[3];
+	int16_t m_minX;
+	int16_t m_minY;
+	int16_t m_maxX;  //!< Exclusive.
+	int16_t m_maxY;  //!< Exclusive.
+};
+
+/// Coarse depth buffer rasterised on the CPU, with a pyramid of farthest depth on top for
+/// testing bounding boxes against it. Depth is post projection z / w of the view projection
+/// matrix passed to occlusionBegin, nearer is smaller. No GPU involved, works headless.
+///
+/// Occluders are set up and binned into screen tiles on the calling thread. occlusionFlush
+/// rasterises tiles 4 pixels at a time, on the calling thread and on up to m_numHelpers
+/// loader jobs, and each tile builds its part of the pyramid.
+///
+/// Occluders must never stand in front of what they stand for, or visible objects get culled.
+/// Terrain is drawn from the min pyramid of the height field, below the real surface, which
+/// only holds while the camera is above the surface.
+struct OcclusionBuffer
+{
+	static constexpr uint32_t kWidth      = 256;
+	static constexpr uint32_t kHeight     = 128;
+	static constexpr uint32_t kNumLevels  = 8;   //!< Down to 2x1.
+	static constexpr uint32_t kTileSize   = 32;  //!< Tiles own pyramid levels down to one texel.
+	static constexpr uint32_t kNumTilesX  = kWidth  / kTileSize;
+	static constexpr uint32_t kNumTilesY  = kHeight / kTileSize;
+	static constexpr uint32_t kNumTiles   = kNumTilesX * kNumTilesY;
+	static constexpr uint32_t kTileLevels = 6;   //!< Levels 0 to 5 are built per tile.
+
+	float    m_viewProj[16];
+	float*   m_depth;                    //!< All levels, level 0 is the rasterised depth.
+	uint32_t m_levelOffset[kNumLevels];
+
+	float*   m_vertices;                 //!< Clip space scratch for height field occluders.
+	uint32_t m_maxOccluderCells;
+
+	OcclusionTriangle* m_triangles;
+	uint32_t  m_maxTriangles;            //!< Occluders past this are dropped, losing only occlusion.
+	uint16_t* m_bins;                    //!< m_maxTriangles triangle indices per tile.
+	uint32_t  m_binSize[kNumTiles];
+
+	// tiles are claimed by the calling thread and helpers alike
+	uint32_t m_numHelpers;
+	int32_t  m_numHelpersQueued;
+	uint32_t m_nextTile;
+	uint32_t m_numTilesDone;
+	bx::Semaphore m_tilesDone;           //!< Posted by whoever finishes the last tile of a flush.
+
+	// stats since occlusionBegin
+	uint32_t m_numTriangles;             //!< Triangles binned after clipping.
+	uint32_t m_numTested;
+	uint32_t m_numOutside;
+	uint32_t m_numOccluded;
+	float    m_setupMs;
+	float    m_rasterMs;                 //!< Wall time of occlusionFlush.
+};
+
+/// Height field occluders use a pyramid level at most _maxOccluderCells wide and high. Tiles
+/// are shared with up to _numHelpers asset loader jobs, 0 rasterises on the calling thread
+/// only. Loader threads must be stopped before the buffer is destroyed.
+void occlusionCreate(OcclusionBuffer& _buffer, uint32_t _maxOccluderCells, uint32_t _numHelpers);
+
+///
+void occlusionDestroy(OcclusionBuffer& _buffer);
+
+/// Starts a new view, drops occluders and stats.
+void occlusionBegin(OcclusionBuffer& _buffer, const float* _viewProj);
+
+/// Adds triangle list, _positions are world space xyz triples. Both windings are drawn.
+void occlusionRasterize(OcclusionBuffer& _buffer, const float* _positions, uint32_t _numVertices, const uint16_t* _indices, uint32_t _numIndices);
+
+/// Adds height field as occluder, conservatively below its surface.
+void occlusionRasterizeHeightfield(OcclusionBuffer& _buffer, const Heightfield& _field);
+
+/// Rasterises all occluders and builds depth pyramid, call before testing.
+void occlusionFlush(OcclusionBuffer& _buffer);
+
+/// Tests world space box. Boxes crossing the near plane are visible.
+OcclusionResult::Enum occlusionTest(OcclusionBuffer& _buffer, const bx::Vec3& _min, const bx::Vec3& _max);
+
+/// Triangles rasterised per second by the last flush, setup included.
+double occlusionGetTrianglesPerSecond(const OcclusionBuffer& _buffer);
+
+#endif // TERRAIN_OCCLUSION_H_HEADER_GUARD
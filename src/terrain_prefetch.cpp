@@ -0,0 +1,151 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <string.h>
+#include "terrain_prefetch.h"
+
+static const uint32_t s_maxNeeded = 256;
+
+// Turns about the up axis, forward (0, 0, 1) turns to (sin(yaw), 0, cos(yaw) ) like cameraGetAt.
+static bx::Vec3 rotateYaw(const bx::Vec3& _v, float _yaw)
+{
+	const float ss = bx::sin(_yaw);
+	const float cc = bx::cos(_yaw);
+	return { _v.x * cc + _v.z * ss, _v.y, _v.z * cc - _v.x * ss };
+}
+
+static float wrapAngle(float _angle)
+{
+	while (_angle >  bx::kPi) { _angle -= bx::kPi2; }
+	while (_angle < -bx::kPi) { _angle += bx::kPi2; }
+	return _angle;
+}
+
+void tilePrefetcherCreate(TilePrefetcher& _prefetcher, float _tileSize, uint32_t _numTiles, uint8_t _numLods, float _range, float _lookahead, uint32_t _numSteps)
+{
+	BX_CHECK(_numSteps <= TilePrefetcher::kMaxSteps, "Too many prefetch steps %d.", _numSteps);
+
+	memset(&_prefetcher, 0, sizeof(_prefetcher) );
+	_prefetcher.m_tileSize  = _tileSize;
+	_prefetcher.m_numTiles  = _numTiles;
+	_prefetcher.m_numLods   = _numLods;
+	_prefetcher.m_range     = _range;
+	_prefetcher.m_lookahead = _lookahead;
+	_prefetcher.m_numSteps  = bx::min(_numSteps, TilePrefetcher::kMaxSteps);
+}
+
+void tilePrefetcherAddSample(TilePrefetcher& _prefetcher, const bx::Vec3& _position, const bx::Vec3& _at, float _time)
+{
+	const uint32_t index = _prefetcher.m_numSamples % TilePrefetcher::kHistory;
+	_prefetcher.m_positions[index] = _position;
+	_prefetcher.m_yaws[index]      = bx::atan2(_at.x - _position.x, _at.z - _position.z);
+	_prefetcher.m_times[index]     = _time;
+	++_prefetcher.m_numSamples;
+}
+
+void tilePrefetcherUpdate(TilePrefetcher& _prefetcher, TileStreamer& _streamer)
+{
+	_prefetcher.m_velocity = { 0.0f, 0.0f, 0.0f };
+	_prefetcher.m_yawRate  = 0.0f;
+	_prefetcher.m_numRequests = 0;
+	if (2 > _prefetcher.m_numSamples
+	||  0 == _prefetcher.m_numSteps)
+	{
+		return;
+	}
+
+	const uint32_t numSamples = bx::min(_prefetcher.m_numSamples, TilePrefetcher::kHistory);
+	const uint32_t newest = (_prefetcher.m_numSamples - 1) % TilePrefetcher::kHistory;
+	const uint32_t oldest = (_prefetcher.m_numSamples - numSamples) % TilePrefetcher::kHistory;
+	const float dt = _prefetcher.m_times[newest] - _prefetcher.m_times[oldest];
+	if (0.0f >= dt)
+	{
+		return;
+	}
+
+	// heading wraps around, sum turns between samples instead
+	float turned = 0.0f;
+	for (uint32_t ii = 1; ii < numSamples; ++ii)
+	{
+		const uint32_t prev = (oldest + ii - 1) % TilePrefetcher::kHistory;
+		const uint32_t curr = (oldest + ii) % TilePrefetcher::kHistory;
+		turned += wrapAngle(_prefetcher.m_yaws[curr] - _prefetcher.m_yaws[prev]);
+	}
+
+	const bx::Vec3 position = _prefetcher.m_positions[newest];
+	const float yaw = _prefetcher.m_yaws[newest];
+	_prefetcher.m_velocity = bx::mul(bx::sub(position, _prefetcher.m_positions[oldest]), 1.0f / dt);
+	_prefetcher.m_yawRate  = turned / dt;
+
+	// velocity relative to the heading stays the same while the camera turns, at most half
+	// a turn though, a camera spinning in place isn't going anywhere
+	const bx::Vec3 localVelocity = rotateYaw(_prefetcher.m_velocity, -yaw);
+	const float maxTurn = bx::kPi / bx::max(bx::abs(_prefetcher.m_yawRate), 1e-3f);
+	const uint32_t kSubSteps = 4;
+	const float stepTime = _prefetcher.m_lookahead / float(_prefetcher.m_numSteps);
+	const float subStepTime = stepTime / float(kSubSteps);
+
+	bx::Vec3 predicted = position;
+	float time = 0.0f;
+	for (uint32_t step = 0; step < _prefetcher.m_numSteps; ++step)
+	{
+		for (uint32_t ii = 0; ii < kSubSteps; ++ii)
+		{
+			const float turnTime = bx::min(time + subStepTime * 0.5f, maxTurn);
+			const bx::Vec3 velocity = rotateYaw(localVelocity, yaw + _prefetcher.m_yawRate * turnTime);
+			predicted = bx::add(predicted, bx::mul(velocity, subStepTime) );
+			time += subStepTime;
+		}
+		_prefetcher.m_path[step] = predicted;
+
+		for (uint32_t layer = 0; layer < TileLayer::Count; ++layer)
+		{
+			TileKey keys[s_maxNeeded];
+			const uint32_t numKeys = tilePrefetcherGetNeeded(_prefetcher, predicted, TileLayer::Enum(layer), keys, s_maxNeeded);
+			for (uint32_t ii = 0; ii < numKeys; ++ii)
+			{
+				tileStreamerRequest(_streamer, keys[ii], time);
+			}
+			_prefetcher.m_numRequests += numKeys;
+		}
+	}
+}
+
+uint32_t tilePrefetcherGetNeeded(const TilePrefetcher& _prefetcher, const bx::Vec3& _position, TileLayer::Enum _layer, TileKey* _keys, uint32_t _max)
+{
+	uint32_t num = 0;
+	for (uint8_t lod = 0; lod < _prefetcher.m_numLods; ++lod)
+	{
+		const float tileSize = _prefetcher.m_tileSize * float(1 << lod);
+		const float range = _prefetcher.m_range * tileSize;
+		const int32_t numTiles = int32_t( (_prefetcher.m_numTiles + (1 << lod) - 1) >> lod);
+		const int32_t x0 = bx::max(int32_t(bx::floor( (_position.x - range) / tileSize) ), 0);
+		const int32_t z0 = bx::max(int32_t(bx::floor( (_position.z - range) / tileSize) ), 0);
+		const int32_t x1 = bx::min(int32_t(bx::floor( (_position.x + range) / tileSize) ), numTiles - 1);
+		const int32_t z1 = bx::min(int32_t(bx::floor( (_position.z + range) / tileSize) ), numTiles - 1);
+
+		for (int32_t zz = z0; zz <= z1; ++zz)
+		{
+			for (int32_t xx = x0; xx <= x1; ++xx)
+			{
+				// distance to the nearest point of the tile, like quadtree nodes
+				const float dx = bx::max(bx::abs( (float(xx) + 0.5f) * tileSize - _position.x) - tileSize * 0.5f, 0.0f);
+				const float dz = bx::max(bx::abs( (float(zz) + 0.5f) * tileSize - _position.z) - tileSize * 0.5f, 0.0f);
+				if (dx * dx + dz * dz >= range * range
+				||  num == _max)
+				{
+					continue;
+				}
+
+				TileKey& key = _keys[num++];
+				key.m_layer = uint8_t(_layer);
+				key.m_lod   = lod;
+				key.m_x     = uint16_t(xx);
+				key.m_z     = uint16_t(zz);
+			}
+		}
+	}
+
+	return num;
+}
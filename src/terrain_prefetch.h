@@ -0,0 +1,55 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_PREFETCH_H_HEADER_GUARD
+#define TERRAIN_PREFETCH_H_HEADER_GUARD
+
+#include <bx/math.h>
+#include "terrain_streaming.h"
+
+/// Requests tiles along the path the camera is predicted to take, so they are loaded before
+/// it gets there. Velocity and turn rate come from the last kHistory camera samples, and the
+/// velocity turns along with the heading while the path is followed for m_lookahead seconds,
+/// so circling and strafing cameras are predicted as well as straight flights. At each of
+/// m_numSteps points along the path the tiles needed there are requested, at the LOD needed
+/// there, with the time until the camera arrives so nearer ones load first.
+struct TilePrefetcher
+{
+	static constexpr uint32_t kHistory  = 8;
+	static constexpr uint32_t kMaxSteps = 8;
+
+	bx::Vec3 m_positions[kHistory];
+	float    m_yaws[kHistory];
+	float    m_times[kHistory];
+	uint32_t m_numSamples;
+
+	float    m_tileSize;          //!< World size of a tile of LOD 0.
+	uint32_t m_numTiles;          //!< Tiles of LOD 0 per side of the world.
+	uint8_t  m_numLods;
+	float    m_range;             //!< Tiles of LOD l are needed within m_range of their size.
+	float    m_lookahead;         //!< In seconds.
+	uint32_t m_numSteps;          //!< 0 disables prefetching.
+
+	// last update
+	bx::Vec3 m_velocity;
+	float    m_yawRate;           //!< Radians per second.
+	bx::Vec3 m_path[kMaxSteps];
+	uint32_t m_numRequests;
+};
+
+///
+void tilePrefetcherCreate(TilePrefetcher& _prefetcher, float _tileSize, uint32_t _numTiles, uint8_t _numLods, float _range, float _lookahead, uint32_t _numSteps);
+
+/// Adds camera position and look at point, see cameraGetPosition and cameraGetAt. _time is in
+/// seconds.
+void tilePrefetcherAddSample(TilePrefetcher& _prefetcher, const bx::Vec3& _position, const bx::Vec3& _at, float _time);
+
+/// Predicts the path from the samples and requests its tiles of all layers.
+void tilePrefetcherUpdate(TilePrefetcher& _prefetcher, TileStreamer& _streamer);
+
+/// Writes keys of tiles of _layer needed to draw from _position, finest LOD first. Returns
+/// number of keys.
+uint32_t tilePrefetcherGetNeeded(const TilePrefetcher& _prefetcher, const bx::Vec3& _position, TileLayer::Enum _layer, TileKey* _keys, uint32_t _max);
+
+#endif // TERRAIN_PREFETCH_H_HEADER_GUARD
@@ -0,0 +1,56 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_PYRAMID_H_HEADER_GUARD
+#define TERRAIN_PYRAMID_H_HEADER_GUARD
+
+#include <bx/string.h>
+
+/// Height tile pyramid written by terrainc, laid out for TileStreamer. A directory holds one
+/// subdirectory per LOD with a losslessly compressed height tile file per tile, and a
+/// manifest with this header. Every LOD halves the resolution of the previous one, so tile
+/// (x, z) of LOD l covers tiles 2x..2x+1, 2z..2z+1 of LOD l-1. Tiles at the right and bottom
+/// edges are smaller when the size isn't a multiple of the tile size.
+///
+/// Manifest is written last, a directory without one holds an unfinished import.
+struct PyramidHeader
+{
+	static constexpr uint32_t kMagic   = BX_MAKEFOURCC('T', 'P', 'Y', 'R');
+	static constexpr uint32_t kVersion = 1;
+
+	uint32_t m_magic;
+	uint32_t m_version;
+	uint32_t m_width;         //!< Of LOD 0, in texels.
+	uint32_t m_height;
+	uint32_t m_tileSize;
+	uint32_t m_numLods;
+	float    m_minElevation;  //!< Source elevation stored as height 0.
+	float    m_maxElevation;  //!< Source elevation stored as height 65535.
+};
+
+///
+inline void pyramidGetManifestPath(const char* _dir, char* _outPath, int32_t _max)
+{
+	bx::snprintf(_outPath, _max, "%s/manifest", _dir);
+}
+
+///
+inline void pyramidGetLodPath(const char* _dir, uint32_t _lod, char* _outPath, int32_t _max)
+{
+	bx::snprintf(_outPath, _max, "%s/%u", _dir, _lod);
+}
+
+///
+inline void pyramidGetTilePath(const char* _dir, uint32_t _lod, uint32_t _x, uint32_t _z, char* _outPath, int32_t _max)
+{
+	bx::snprintf(_outPath, _max, "%s/%u/tile_%u_%u.htc", _dir, _lod, _x, _z);
+}
+
+/// Size of LOD _lod of a _size texels wide level 0.
+inline uint32_t pyramidGetLodSize(uint32_t _size, uint32_t _lod)
+{
+	return bx::max(1u, (_size + (1u << _lod) - 1) >> _lod);
+}
+
+#endif // TERRAIN_PYRAMID_H_HEADER_GUARD
@@ -0,0 +1,174 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <string.h>
+#include "terrain_quadtree.h"
+
+static uint32_t nodesPerSide(uint8_t _lod)
+{
+	return 1u << (QuadTree::kNumLods - 1 - _lod);
+}
+
+// Nodes of LOD 0 first, row by row.
+static uint32_t nodeId(uint8_t _lod, uint32_t _x, uint32_t _z)
+{
+	uint32_t offset = 0;
+	for (uint8_t lod = 0; lod < _lod; ++lod)
+	{
+		offset += nodesPerSide(lod) * nodesPerSide(lod);
+	}
+
+	return offset + _z * nodesPerSide(_lod) + _x;
+}
+
+// Merged node forgets the split state below it, so it refines from scratch when split again.
+static void clearChildren(QuadTree& _tree, uint8_t _lod, uint32_t _x, uint32_t _z)
+{
+	if (0 == _lod)
+	{
+		return;
+	}
+
+	for (uint32_t ii = 0; ii < 4; ++ii)
+	{
+		const uint32_t x = _x * 2 + (ii & 1);
+		const uint32_t z = _z * 2 + (ii >> 1);
+		uint8_t& split = _tree.m_split[nodeId(_lod - 1, x, z)];
+		if (0 != split)
+		{
+			split = 0;
+			clearChildren(_tree, _lod - 1, x, z);
+		}
+	}
+}
+
+void quadTreeCreate(QuadTree& _tree, uint8_t _rootLod, float _sectorSize, float _range, float _hysteresis, uint32_t _maxChanges)
+{
+	BX_CHECK(_rootLod < QuadTree::kNumLods, "Root LOD %d is out of range.", _rootLod);
+
+	_tree.m_rootLod    = _rootLod;
+	_tree.m_sectorSize = _sectorSize;
+	_tree.m_range      = _range;
+	_tree.m_hysteresis = _hysteresis;
+	_tree.m_maxChanges = _maxChanges;
+	_tree.m_nodes      = NULL;
+	_tree.m_numNodes   = 0;
+	_tree.m_numSplits  = 0;
+	_tree.m_numMerges  = 0;
+	_tree.m_numDeferred = 0;
+	quadTreeReset(_tree);
+}
+
+void quadTreeReset(QuadTree& _tree)
+{
+	memset(_tree.m_split, 0, sizeof(_tree.m_split) );
+	_tree.m_unbudgeted = true;
+}
+
+void quadTreeBuild(QuadTree& _tree, FrameArena& _arena, const bx::Vec3* _positions, uint32_t _numPositions)
+{
+	BX_CHECK(0 < _numPositions, "Quadtree needs at least one camera.");
+
+	_tree.m_nodes = (QuadTreeNode*)frameArenaAlloc(_arena, sizeof(QuadTreeNode) * QuadTree::kMaxNodes);
+	uint16_t* nodesQueue = (uint16_t*)frameArenaAlloc(_arena, sizeof(uint16_t) * QuadTree::kMaxNodes);
+	_tree.m_numSplits = 0;
+	_tree.m_numMerges = 0;
+	_tree.m_numDeferred = 0;
+
+	const uint32_t maxChanges = _tree.m_unbudgeted ? UINT32_MAX : _tree.m_maxChanges;
+	_tree.m_unbudgeted = false;
+
+	uint16_t nodeIndex = 0;
+	QuadTreeNode* node = &_tree.m_nodes[nodeIndex];
+	node->lod = _tree.m_rootLod;
+	node->firstChildIndex = -1;
+	node->x = 0;
+	node->z = 0;
+	++nodeIndex;
+
+	uint16_t queueHead = 0;
+	uint16_t queueSize = 0;
+	// add head to queue
+	queueSize++;
+	nodesQueue[queueHead] = 0;
+
+	while (queueSize > 0)
+	{
+		// pop from queue
+		node = &_tree.m_nodes[nodesQueue[queueHead]];
+		++queueHead;
+		--queueSize;
+
+		if (0 == node->lod)
+		{
+			continue;
+		}
+
+		float nodeSize = _tree.m_sectorSize * (1 << node->lod);
+		float halfNodeSize = nodeSize * 0.5f;
+		float nodeCenterX = node->x + halfNodeSize;
+		float nodeCenterZ = node->z + halfNodeSize;
+		// distance to the nearest point of the node from the nearest camera, patches morph by
+		// the same measure
+		float distance = bx::kFloatMax;
+		for (uint32_t ii = 0; ii < _numPositions; ++ii)
+		{
+			const float dx = bx::max(bx::abs(nodeCenterX - _positions[ii].x) - halfNodeSize, 0.0f);
+			const float dz = bx::max(bx::abs(nodeCenterZ - _positions[ii].z) - halfNodeSize, 0.0f);
+			distance = bx::min(distance, dx * dx + dz * dz);
+		}
+
+		// between split and merge distance the node stays what it was
+		const uint32_t x = uint32_t(node->x / nodeSize);
+		const uint32_t z = uint32_t(node->z / nodeSize);
+		uint8_t& split = _tree.m_split[nodeId(node->lod, x, z)];
+		float range = _tree.m_range * nodeSize * (0 != split ? 1.0f + _tree.m_hysteresis : 1.0f - _tree.m_hysteresis);
+		const uint8_t wantSplit = distance < range * range ? 1 : 0;
+		if (wantSplit != split)
+		{
+			if (_tree.m_numSplits + _tree.m_numMerges < maxChanges)
+			{
+				if (0 != wantSplit)
+				{
+					++_tree.m_numSplits;
+				}
+				else
+				{
+					++_tree.m_numMerges;
+					clearChildren(_tree, node->lod, x, z);
+				}
+				split = wantSplit;
+			}
+			else
+			{
+				++_tree.m_numDeferred;
+			}
+		}
+
+		if (0 != split)
+		{
+			// split node to 4 child nodes, point parent node to first child
+			node->firstChildIndex = nodeIndex;
+			for (uint32_t ii = 0; ii < 4; ++ii)
+			{
+				QuadTreeNode* childNode = &_tree.m_nodes[nodeIndex];
+				childNode->lod = node->lod - 1;
+				childNode->firstChildIndex = -1;
+				childNode->x = node->x + (ii & 1) * halfNodeSize;
+				childNode->z = node->z + (ii >> 1) * halfNodeSize;
+				nodesQueue[queueHead + queueSize] = nodeIndex;
+				++queueSize;
+				++nodeIndex;
+			}
+		}
+	}
+
+	_tree.m_numNodes = nodeIndex;
+}
+
+float quadTreeGetMorphEnd(const QuadTree& _tree, uint8_t _lod)
+{
+	const float parentSize = _tree.m_sectorSize * float(2 << _lod);
+	return _tree.m_range * parentSize * (1.0f - _tree.m_hysteresis);
+}
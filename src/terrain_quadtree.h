@@ -0,0 +1,69 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_QUADTREE_H_HEADER_GUARD
+#define TERRAIN_QUADTREE_H_HEADER_GUARD
+
+#include <bx/math.h>
+#include "terrain_memory.h"
+
+///
+struct QuadTreeNode
+{
+	float x;
+	float z;
+	int32_t	firstChildIndex; //!< Four children follow each other, -1 on leaves.
+	uint8_t lod;
+};
+
+/// LOD quadtree over a square of sectors, node of LOD l is 2^l sectors wide and splits in four
+/// of LOD l - 1 while the camera is within m_range node sizes of it. With several cameras the
+/// nearest one counts, one tree holds the union of nodes every camera needs.
+///
+/// Nodes are rebuilt every frame but whether they are split is kept. A split node merges only
+/// once the camera is m_hysteresis past the range and a merged one splits only m_hysteresis
+/// inside it, so a camera hovering at the range doesn't flip the node every frame. At most
+/// m_maxChanges nodes split or merge per build, the rest keep their LOD until a later one.
+struct QuadTree
+{
+	static constexpr uint32_t kNumLods  = 6; //!< Root of LOD 5 covers 32x32 sectors.
+	static constexpr uint32_t kMaxNodes = 1 + 4 + 16 + 64 + 256 + 1024;
+
+	uint8_t  m_split[kMaxNodes];   //!< Per node position and LOD, 1 if split.
+	uint8_t  m_rootLod;
+	float    m_sectorSize;
+	float    m_range;              //!< In node sizes, measured to the nearest point of the node.
+	float    m_hysteresis;         //!< Fraction of the range.
+	uint32_t m_maxChanges;
+	bool     m_unbudgeted;         //!< Next build may change any number of nodes.
+
+	QuadTreeNode* m_nodes;         //!< Last build, root first. Lives in the frame arena.
+	uint32_t m_numNodes;
+
+	// last build
+	uint32_t m_numSplits;
+	uint32_t m_numMerges;
+	uint32_t m_numDeferred;        //!< Nodes past a threshold held back by the budget.
+};
+
+///
+void quadTreeCreate(QuadTree& _tree, uint8_t _rootLod, float _sectorSize, float _range, float _hysteresis, uint32_t _maxChanges);
+
+/// Forgets split state, the next build refines from the root at once, without budget.
+void quadTreeReset(QuadTree& _tree);
+
+/// Builds nodes in _arena for _numPositions cameras at _positions, height is ignored.
+void quadTreeBuild(QuadTree& _tree, FrameArena& _arena, const bx::Vec3* _positions, uint32_t _numPositions);
+
+/// Builds nodes in _arena for camera at _position, height is ignored.
+inline void quadTreeBuild(QuadTree& _tree, FrameArena& _arena, const bx::Vec3& _position)
+{
+	quadTreeBuild(_tree, _arena, &_position, 1);
+}
+
+/// Distance from which patches of a node of _lod look exactly like their parent's, the parent
+/// splits only closer than that and merges only farther.
+float quadTreeGetMorphEnd(const QuadTree& _tree, uint8_t _lod);
+
+#endif // TERRAIN_QUADTREE_H_HEADER_GUARD
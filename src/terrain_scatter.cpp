@@ -0,0 +1,590 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <bx/allocator.h>
+#include <bx/timer.h>
+#include "asset_loader.h"
+#include "terrain_memory.h"
+#include "terrain_scatter.h"
+#include "terrain_views.h"
+
+namespace
+{
+	struct ScatterVertex
+	{
+		float m_x;
+		float m_y;
+		float m_z;
+		float m_nx;
+		float m_ny;
+		float m_nz;
+		uint32_t m_abgr;
+	};
+
+	// Floats per instance in the instance buffer: position and type * 16 + scale.
+	static constexpr uint32_t kInstanceStride = 4;
+
+	// Floats per candidate while generating: x, z, height, normal xyz, random.
+	static constexpr uint32_t kScratchStride = 7;
+}
+
+static bgfx::VertexLayout s_scatterVertexLayout;
+static bgfx::VertexLayout s_scatterInstanceLayout;
+
+// Grass tuft, three blades crossing at 60 degrees. Normals point up so blades are lit like the
+// ground below them.
+static const ScatterVertex s_grassVertices[] =
+{
+	{ -0.30f, 0.0f,  0.00f, 0.0f, 1.0f, 0.0f, 0xff1a4d1a },
+	{  0.30f, 0.0f,  0.00f, 0.0f, 1.0f, 0.0f, 0xff1a4d1a },
+	{ -0.10f, 0.6f,  0.00f, 0.0f, 1.0f, 0.0f, 0xff4dcc66 },
+	{  0.10f, 0.6f,  0.00f, 0.0f, 1.0f, 0.0f, 0xff4dcc66 },
+	{ -0.15f, 0.0f, -0.26f, 0.0f, 1.0f, 0.0f, 0xff1a4d1a },
+	{  0.15f, 0.0f,  0.26f, 0.0f, 1.0f, 0.0f, 0xff1a4d1a },
+	{ -0.05f, 0.5f, -0.09f, 0.0f, 1.0f, 0.0f, 0xff4dcc66 },
+	{  0.05f, 0.5f,  0.09f, 0.0f, 1.0f, 0.0f, 0xff4dcc66 },
+	{ -0.15f, 0.0f,  0.26f, 0.0f, 1.0f, 0.0f, 0xff1a4d1a },
+	{  0.15f, 0.0f, -0.26f, 0.0f, 1.0f, 0.0f, 0xff1a4d1a },
+	{ -0.05f, 0.7f,  0.09f, 0.0f, 1.0f, 0.0f, 0xff4dcc66 },
+	{  0.05f, 0.7f, -0.09f, 0.0f, 1.0f, 0.0f, 0xff4dcc66 },
+};
+
+static const uint16_t s_grassIndices[] =
+{
+	0, 2, 1,  1, 2, 3,
+	4, 6, 5,  5, 6, 7,
+	8, 10, 9, 9, 10, 11,
+};
+
+// Rock, octahedron squashed and sunk into the ground.
+static const ScatterVertex s_rockVertices[] =
+{
+	{  0.00f,  0.35f,  0.00f,  0.00f,  1.00f,  0.00f, 0xff8a9aa5 },
+	{  0.40f,  0.00f,  0.00f,  1.00f,  0.00f,  0.00f, 0xff6a7a85 },
+	{  0.00f,  0.00f,  0.40f,  0.00f,  0.00f,  1.00f, 0xff707070 },
+	{ -0.40f,  0.00f,  0.00f, -1.00f,  0.00f,  0.00f, 0xff6a7a85 },
+	{  0.00f,  0.00f, -0.40f,  0.00f,  0.00f, -1.00f, 0xff707070 },
+	{  0.00f, -0.15f,  0.00f,  0.00f, -1.00f,  0.00f, 0xff505050 },
+};
+
+static const uint16_t s_rockIndices[] =
+{
+	0, 2, 1,  0, 3, 2,  0, 4, 3,  0, 1, 4,
+	5, 1, 2,  5, 2, 3,  5, 3, 4,  5, 4, 1,
+};
+
+static uint32_t hashCell(uint32_t _x, uint32_t _z, uint32_t _index, uint32_t _seed)
+{
+	uint32_t hash = _x * 0x8da6b343u ^ _z * 0xd8163841u ^ _index * 0xcb1ab31fu ^ _seed * 0x165667b1u;
+	hash ^= hash >> 16;
+	hash *= 0x7feb352du;
+	hash ^= hash >> 15;
+	hash *= 0x846ca68bu;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+void scatterCreate(ScatterSystem& _system, uint32_t _width, uint32_t _height, float _texelSize, float _cellSize, uint32_t _seed)
+{
+	static const ScatterLayer s_defaultLayers[ScatterType::Count] =
+	{
+		{ 24.0f, 0.6f, 1.4f, 0.4f, 40.0f }, // Grass
+		{  0.3f, 0.5f, 2.0f, 1.0f, 60.0f }, // Rock
+	};
+	bx::memCopy(_system.m_layers, s_defaultLayers, sizeof(s_defaultLayers) );
+
+	_system.m_densityWidth  = _width;
+	_system.m_densityHeight = _height;
+	_system.m_texelSize = _texelSize;
+	_system.m_cellSize  = _cellSize;
+	_system.m_numCellsX = uint32_t(bx::ceil(_width  * _texelSize / _cellSize) );
+	_system.m_numCellsZ = uint32_t(bx::ceil(_height * _texelSize / _cellSize) );
+	_system.m_seed  = _seed;
+	_system.m_frame = 0;
+	_system.m_numSlotsUsed = 0;
+	_system.m_numResident  = 0;
+	_system.m_numGenerated = 0;
+	_system.m_generateMs   = 0.0f;
+
+	for (uint32_t ii = 0; ii < ScatterSystem::kMaxSlots; ++ii)
+	{
+		ScatterSlot& slot = _system.m_slots[ii];
+		slot.m_cell = -1;
+		slot.m_lastUsed = 0;
+		slot.m_numInstances = 0;
+		slot.m_dirty = false;
+	}
+
+	const uint32_t numCells = _system.m_numCellsX * _system.m_numCellsZ;
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::Scatter);
+	_system.m_cellSlots = (int16_t*)BX_ALLOC(allocator, numCells * sizeof(int16_t) );
+	_system.m_density   = (uint8_t*)BX_ALLOC(allocator, _width * _height * ScatterType::Count);
+	_system.m_scratch   = (float*)BX_ALLOC(allocator, ScatterSystem::kMaxInstancesPerCell * kScratchStride * sizeof(float) );
+	_system.m_instances = (float*)BX_ALLOC(allocator, ScatterSystem::kMaxInstancesPerCell * kInstanceStride * sizeof(float) );
+	bx::memSet(_system.m_cellSlots, 0xff, numCells * sizeof(int16_t) );
+	bx::memSet(_system.m_density, 0xff, _width * _height * ScatterType::Count);
+
+	s_scatterVertexLayout
+		.begin()
+		.add(bgfx::Attrib::Position,  3, bgfx::AttribType::Float)
+		.add(bgfx::Attrib::Normal,    3, bgfx::AttribType::Float)
+		.add(bgfx::Attrib::Color0,    4, bgfx::AttribType::Uint8, true)
+		.end();
+
+	s_scatterInstanceLayout
+		.begin()
+		.add(bgfx::Attrib::TexCoord7, 4, bgfx::AttribType::Float)
+		.end();
+
+	// both meshes share one vertex and index buffer, indices of rocks are rebased
+	const uint32_t numVertices = BX_COUNTOF(s_grassVertices) + BX_COUNTOF(s_rockVertices);
+	const uint32_t numIndices  = BX_COUNTOF(s_grassIndices)  + BX_COUNTOF(s_rockIndices);
+	const bgfx::Memory* vertices = bgfx::alloc(numVertices * sizeof(ScatterVertex) );
+	const bgfx::Memory* indices  = bgfx::alloc(numIndices * sizeof(uint16_t) );
+	bx::memCopy(vertices->data, s_grassVertices, sizeof(s_grassVertices) );
+	bx::memCopy(vertices->data + sizeof(s_grassVertices), s_rockVertices, sizeof(s_rockVertices) );
+
+	uint16_t* index = (uint16_t*)indices->data;
+	for (uint32_t ii = 0; ii < BX_COUNTOF(s_grassIndices); ++ii)
+	{
+		*index++ = s_grassIndices[ii];
+	}
+	for (uint32_t ii = 0; ii < BX_COUNTOF(s_rockIndices); ++ii)
+	{
+		*index++ = uint16_t(s_rockIndices[ii] + BX_COUNTOF(s_grassVertices) );
+	}
+
+	_system.m_startIndex[ScatterType::Grass] = 0;
+	_system.m_numIndices[ScatterType::Grass] = BX_COUNTOF(s_grassIndices);
+	_system.m_startIndex[ScatterType::Rock]  = BX_COUNTOF(s_grassIndices);
+	_system.m_numIndices[ScatterType::Rock]  = BX_COUNTOF(s_rockIndices);
+
+	_system.m_vbh = bgfx::createVertexBuffer(vertices, s_scatterVertexLayout);
+	_system.m_ibh = bgfx::createIndexBuffer(indices);
+
+	_system.m_instanceBuffer = bgfx::createDynamicVertexBuffer(ScatterSystem::kMaxInstances, s_scatterInstanceLayout, BGFX_BUFFER_COMPUTE_READ);
+	// counters, indirect draws and visible instances are per view and type
+	const uint32_t numLists = ScatterSystem::kMaxViews * ScatterType::Count;
+	_system.m_visibleBuffer  = bgfx::createDynamicVertexBuffer(ScatterSystem::kMaxVisible * numLists, s_scatterInstanceLayout, BGFX_BUFFER_COMPUTE_WRITE);
+	_system.m_counters = bgfx::createDynamicIndexBuffer(numLists, BGFX_BUFFER_COMPUTE_READ_WRITE | BGFX_BUFFER_INDEX32);
+	_system.m_indirect = bgfx::createIndirectBuffer(numLists);
+
+	_system.u_frustumPlanes = bgfx::createUniform("u_frustumPlanes", bgfx::UniformType::Vec4, 6);
+	_system.u_scatterParams = bgfx::createUniform("u_scatterParams", bgfx::UniformType::Vec4, 2);
+	_system.u_scatterMeshes = bgfx::createUniform("u_scatterMeshes", bgfx::UniformType::Vec4, ScatterType::Count);
+	_system.u_sunDirection  = bgfx::createUniform("u_sunDirection",  bgfx::UniformType::Vec4);
+
+	_system.m_cullProgram.idx = bgfx::kInvalidHandle;
+	_system.m_argsProgram.idx = bgfx::kInvalidHandle;
+	_system.m_drawProgram.idx = bgfx::kInvalidHandle;
+	assetLoadProgram(&_system.m_cullProgram, "cs_scatterCull");
+	assetLoadProgram(&_system.m_argsProgram, "cs_scatterArgs");
+	assetLoadProgram(&_system.m_drawProgram, "vs_scatter", "fs_scatter");
+}
+
+void scatterDestroy(ScatterSystem& _system)
+{
+	bgfx::ProgramHandle* programs[] = { &_system.m_cullProgram, &_system.m_argsProgram, &_system.m_drawProgram };
+	for (uint32_t ii = 0; ii < BX_COUNTOF(programs); ++ii)
+	{
+		if (bgfx::isValid(*programs[ii]) )
+		{
+			bgfx::destroy(*programs[ii]);
+		}
+	}
+
+	bgfx::destroy(_system.u_frustumPlanes);
+	bgfx::destroy(_system.u_scatterParams);
+	bgfx::destroy(_system.u_scatterMeshes);
+	bgfx::destroy(_system.u_sunDirection);
+	bgfx::destroy(_system.m_indirect);
+	bgfx::destroy(_system.m_counters);
+	bgfx::destroy(_system.m_visibleBuffer);
+	bgfx::destroy(_system.m_instanceBuffer);
+	bgfx::destroy(_system.m_ibh);
+	bgfx::destroy(_system.m_vbh);
+
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::Scatter);
+	BX_FREE(allocator, _system.m_instances);
+	BX_FREE(allocator, _system.m_scratch);
+	BX_FREE(allocator, _system.m_density);
+	BX_FREE(allocator, _system.m_cellSlots);
+	_system.m_cellSlots = NULL;
+	_system.m_density   = NULL;
+	_system.m_scratch   = NULL;
+	_system.m_instances = NULL;
+}
+
+void scatterInvalidate(ScatterSystem& _system, const TileRect& _rect)
+{
+	const float cellsPerTexel = _system.m_texelSize / _system.m_cellSize;
+	const int32_t x0 = bx::max(int32_t(bx::floor(_rect.m_x0 * cellsPerTexel) ), 0);
+	const int32_t z0 = bx::max(int32_t(bx::floor(_rect.m_y0 * cellsPerTexel) ), 0);
+	const int32_t x1 = bx::min(int32_t(bx::ceil(_rect.m_x1 * cellsPerTexel) ), int32_t(_system.m_numCellsX) );
+	const int32_t z1 = bx::min(int32_t(bx::ceil(_rect.m_y1 * cellsPerTexel) ), int32_t(_system.m_numCellsZ) );
+
+	for (int32_t zz = z0; zz < z1; ++zz)
+	{
+		for (int32_t xx = x0; xx < x1; ++xx)
+		{
+			const int16_t slot = _system.m_cellSlots[xx + zz * _system.m_numCellsX];
+			if (0 <= slot)
+			{
+				_system.m_slots[slot].m_dirty = true;
+			}
+		}
+	}
+}
+
+void scatterSetDensity(ScatterSystem& _system, ScatterType::Enum _type, const TileRect& _rect, const uint8_t* _data)
+{
+	const TileRect full = { 0, 0, int32_t(_system.m_densityWidth), int32_t(_system.m_densityHeight) };
+	const TileRect rect = tileRectIntersect(_rect, full);
+	const int32_t pitch = _rect.m_x1 - _rect.m_x0;
+
+	for (int32_t yy = rect.m_y0; yy < rect.m_y1; ++yy)
+	{
+		for (int32_t xx = rect.m_x0; xx < rect.m_x1; ++xx)
+		{
+			const uint8_t density = _data[(xx - _rect.m_x0) + (yy - _rect.m_y0) * pitch];
+			_system.m_density[(xx + yy * _system.m_densityWidth) * ScatterType::Count + _type] = density;
+		}
+	}
+
+	scatterInvalidate(_system, rect);
+}
+
+uint32_t scatterGenerateCell(ScatterSystem& _system, const Heightfield& _field, uint32_t _cellX, uint32_t _cellZ, float* _outInstances, uint32_t _max)
+{
+	const float cellSize = _system.m_cellSize;
+	const float cellX = _cellX * cellSize;
+	const float cellZ = _cellZ * cellSize;
+	const float invTexelSize = 1.0f / _system.m_texelSize;
+	const int32_t maxTexelX = int32_t(_system.m_densityWidth)  - 1;
+	const int32_t maxTexelZ = int32_t(_system.m_densityHeight) - 1;
+
+	float* scratch = _system.m_scratch;
+	float* xz = scratch;
+	float* heights = &scratch[ScatterSystem::kMaxInstancesPerCell * 2];
+	float* normals = &scratch[ScatterSystem::kMaxInstancesPerCell * 3];
+	float* random  = &scratch[ScatterSystem::kMaxInstancesPerCell * 6];
+
+	uint32_t num = 0;
+	for (uint32_t type = 0; type < ScatterType::Count; ++type)
+	{
+		const ScatterLayer& layer = _system.m_layers[type];
+		const uint32_t numCandidates = bx::min(uint32_t(layer.m_density * cellSize * cellSize), _max - num);
+
+		// candidates are a function of cell and index only, density map thins them out
+		uint32_t numAccepted = 0;
+		for (uint32_t ii = 0; ii < numCandidates; ++ii)
+		{
+			const uint32_t hash0 = hashCell(_cellX, _cellZ, type * ScatterSystem::kMaxInstancesPerCell + ii, _system.m_seed);
+			const uint32_t hash1 = hashCell(hash0, _cellZ, ii, _system.m_seed + 1);
+			const float xx = cellX + float(hash0 & 0xffff) / 65536.0f * cellSize;
+			const float zz = cellZ + float(hash0 >> 16)    / 65536.0f * cellSize;
+
+			const int32_t texelX = bx::clamp(int32_t(xx * invTexelSize), 0, maxTexelX);
+			const int32_t texelZ = bx::clamp(int32_t(zz * invTexelSize), 0, maxTexelZ);
+			const uint32_t density = _system.m_density[(texelX + texelZ * _system.m_densityWidth) * ScatterType::Count + type];
+			if ( (hash1 & 0xffff) * 255 >= density * 65536)
+			{
+				continue;
+			}
+
+			xz[numAccepted * 2 + 0] = xx;
+			xz[numAccepted * 2 + 1] = zz;
+			random[numAccepted] = float(hash1 >> 16) / 65536.0f;
+			++numAccepted;
+		}
+
+		sampleHeights(_field, xz, heights, numAccepted);
+		sampleNormals(_field, xz, normals, numAccepted);
+
+		const float minNormalY = 1.0f - layer.m_maxSlope;
+		for (uint32_t ii = 0; ii < numAccepted; ++ii)
+		{
+			if (normals[ii * 3 + 1] < minNormalY)
+			{
+				continue;
+			}
+
+			float* instance = &_outInstances[num * kInstanceStride];
+			instance[0] = xz[ii * 2 + 0];
+			instance[1] = heights[ii];
+			instance[2] = xz[ii * 2 + 1];
+			instance[3] = float(type) * 16.0f + bx::lerp(layer.m_minScale, layer.m_maxScale, random[ii]);
+			++num;
+		}
+	}
+
+	return num;
+}
+
+static int16_t allocSlot(ScatterSystem& _system)
+{
+	// free slot first, else least recently used one not needed this frame
+	int16_t victim = -1;
+	uint32_t oldest = _system.m_frame;
+	for (uint32_t ii = 0; ii < ScatterSystem::kMaxSlots; ++ii)
+	{
+		const ScatterSlot& slot = _system.m_slots[ii];
+		if (-1 == slot.m_cell)
+		{
+			return int16_t(ii);
+		}
+
+		if (slot.m_lastUsed < oldest)
+		{
+			oldest = slot.m_lastUsed;
+			victim = int16_t(ii);
+		}
+	}
+
+	if (-1 != victim)
+	{
+		ScatterSlot& slot = _system.m_slots[victim];
+		_system.m_cellSlots[slot.m_cell] = -1;
+		_system.m_numResident -= slot.m_numInstances;
+		slot.m_cell = -1;
+		slot.m_numInstances = 0;
+	}
+
+	return victim;
+}
+
+void scatterUpdate(ScatterSystem& _system, const Heightfield& _field, const TerrainView* _views, uint32_t _numViews, FrameBudget& _budget)
+{
+	const int64_t start = bx::getHPCounter();
+	++_system.m_frame;
+	_system.m_numGenerated = 0;
+
+	float maxDistance = 0.0f;
+	for (uint32_t ii = 0; ii < ScatterType::Count; ++ii)
+	{
+		maxDistance = bx::max(maxDistance, _system.m_layers[ii].m_maxDistance);
+	}
+
+	// missing or dirty cells in view first, then nearest first, kept sorted by priority and
+	// distance folded into one key
+	const float cellSize = _system.m_cellSize;
+	const float nearDistance = maxDistance * 0.5f;
+	const float priorityStride = maxDistance * maxDistance * 4.0f;
+	uint32_t requests[ScatterSystem::kMaxGeneratePerFrame];
+	float requestKeys[ScatterSystem::kMaxGeneratePerFrame];
+	uint32_t numRequests = 0;
+
+	for (uint32_t view = 0; view < _numViews; ++view)
+	{
+		const bx::Vec3 cameraPos = _views[view].m_position;
+		const int32_t x0 = bx::max(int32_t(bx::floor( (cameraPos.x - maxDistance) / cellSize) ), 0);
+		const int32_t z0 = bx::max(int32_t(bx::floor( (cameraPos.z - maxDistance) / cellSize) ), 0);
+		const int32_t x1 = bx::min(int32_t(bx::floor( (cameraPos.x + maxDistance) / cellSize) ) + 1, int32_t(_system.m_numCellsX) );
+		const int32_t z1 = bx::min(int32_t(bx::floor( (cameraPos.z + maxDistance) / cellSize) ) + 1, int32_t(_system.m_numCellsZ) );
+
+		for (int32_t zz = z0; zz < z1; ++zz)
+		{
+			for (int32_t xx = x0; xx < x1; ++xx)
+			{
+				const float dx = bx::clamp(cameraPos.x, xx * cellSize, (xx + 1) * cellSize) - cameraPos.x;
+				const float dz = bx::clamp(cameraPos.z, zz * cellSize, (zz + 1) * cellSize) - cameraPos.z;
+				const float cellDistanceSq = dx * dx + dz * dz;
+				if (cellDistanceSq > maxDistance * maxDistance)
+				{
+					continue;
+				}
+
+				const uint32_t cell = xx + zz * _system.m_numCellsX;
+				const int16_t slot = _system.m_cellSlots[cell];
+				if (0 <= slot)
+				{
+					_system.m_slots[slot].m_lastUsed = _system.m_frame;
+					if (!_system.m_slots[slot].m_dirty)
+					{
+						continue;
+					}
+				}
+
+				float minHeight;
+				float maxHeight;
+				heightfieldGetRectRange(_field, xx * cellSize, zz * cellSize, (xx + 1) * cellSize, (zz + 1) * cellSize, minHeight, maxHeight);
+				const bx::Vec3 boxMin = { xx * cellSize, minHeight, zz * cellSize };
+				const bx::Vec3 boxMax = { (xx + 1) * cellSize, maxHeight, (zz + 1) * cellSize };
+				const WorkPriority::Enum priority = viewIsBoxInFrustum(_views[view].m_planes, boxMin, boxMax) ? WorkPriority::Visible
+					: cellDistanceSq < nearDistance * nearDistance ? WorkPriority::Near
+					: WorkPriority::Far
+					;
+				const float key = cellDistanceSq + float(priority) * priorityStride;
+
+				// cell seen by an earlier view keeps the better of both keys
+				uint32_t existing = 0;
+				for (; existing < numRequests && requests[existing] != cell; ++existing)
+				{
+				}
+
+				if (existing < numRequests)
+				{
+					if (key >= requestKeys[existing])
+					{
+						continue;
+					}
+
+					for (--numRequests; existing < numRequests; ++existing)
+					{
+						requests[existing] = requests[existing + 1];
+						requestKeys[existing] = requestKeys[existing + 1];
+					}
+				}
+
+				if (numRequests == ScatterSystem::kMaxGeneratePerFrame
+				&&  key >= requestKeys[numRequests - 1])
+				{
+					continue;
+				}
+
+				uint32_t pos = bx::min(numRequests, ScatterSystem::kMaxGeneratePerFrame - 1);
+				for (; 0 < pos && requestKeys[pos - 1] > key; --pos)
+				{
+					requests[pos] = requests[pos - 1];
+					requestKeys[pos] = requestKeys[pos - 1];
+				}
+
+				requests[pos] = cell;
+				requestKeys[pos] = key;
+				numRequests = bx::min(numRequests + 1, ScatterSystem::kMaxGeneratePerFrame);
+			}
+		}
+	}
+
+	for (uint32_t ii = 0; ii < numRequests; ++ii)
+	{
+		const WorkPriority::Enum priority = WorkPriority::Enum(uint32_t(requestKeys[ii] / priorityStride) );
+		if (!frameBudgetBeginItem(_budget, BudgetTask::Scatter, priority) )
+		{
+			continue;
+		}
+
+		const uint32_t cell = requests[ii];
+		int16_t slotIndex = _system.m_cellSlots[cell];
+		if (0 > slotIndex)
+		{
+			slotIndex = allocSlot(_system);
+			if (0 > slotIndex)
+			{
+				frameBudgetEndItem(_budget, BudgetTask::Scatter);
+				break;
+			}
+		}
+
+		ScatterSlot& slot = _system.m_slots[slotIndex];
+		const uint32_t num = scatterGenerateCell(_system, _field, cell % _system.m_numCellsX, cell / _system.m_numCellsX, _system.m_instances, ScatterSystem::kMaxInstancesPerCell);
+
+		// unused tail of the slot is marked empty for the cull pass
+		for (uint32_t jj = num; jj < ScatterSystem::kMaxInstancesPerCell; ++jj)
+		{
+			float* instance = &_system.m_instances[jj * kInstanceStride];
+			instance[0] = 0.0f;
+			instance[1] = 0.0f;
+			instance[2] = 0.0f;
+			instance[3] = -1.0f;
+		}
+
+		const uint32_t size = ScatterSystem::kMaxInstancesPerCell * kInstanceStride * sizeof(float);
+		bgfx::update(_system.m_instanceBuffer, slotIndex * ScatterSystem::kMaxInstancesPerCell, bgfx::copy(_system.m_instances, size) );
+
+		_system.m_numResident += num - slot.m_numInstances;
+		_system.m_cellSlots[cell] = slotIndex;
+		slot.m_cell = int32_t(cell);
+		slot.m_lastUsed = _system.m_frame;
+		slot.m_numInstances = num;
+		slot.m_dirty = false;
+		_system.m_numSlotsUsed = bx::max(_system.m_numSlotsUsed, uint32_t(slotIndex) + 1);
+		++_system.m_numGenerated;
+		frameBudgetEndItem(_budget, BudgetTask::Scatter);
+	}
+
+	_system.m_generateMs = float(double(bx::getHPCounter() - start) * 1000.0 / double(bx::getHPFrequency() ) );
+}
+
+void scatterSubmit(
+	  ScatterSystem& _system
+	, bgfx::ViewId _cullView
+	, bgfx::ViewId _drawView
+	, uint32_t _viewIndex
+	, const GBuffer& _gbuffer
+	, const float* _viewProj
+	, const bx::Vec3& _cameraPos
+	, const float* _sunDirection
+	, bool _homogeneousDepth
+	)
+{
+	if (!bgfx::isValid(_system.m_cullProgram)
+	||  !bgfx::isValid(_system.m_argsProgram)
+	||  !bgfx::isValid(_system.m_drawProgram) )
+	{
+		return;
+	}
+
+	BX_CHECK(_viewIndex < ScatterSystem::kMaxViews, "Scatter view %u out of range.", _viewIndex);
+	const uint32_t firstList = _viewIndex * ScatterType::Count;
+
+	float planes[6 * 4];
+	viewComputeFrustumPlanes(planes, _viewProj, _homogeneousDepth);
+	bgfx::setUniform(_system.u_frustumPlanes, planes, 6);
+
+	const uint32_t numInstances = _system.m_numSlotsUsed * ScatterSystem::kMaxInstancesPerCell;
+	float params[8];
+	params[0] = float(numInstances);
+	params[1] = float(ScatterSystem::kMaxVisible);
+	params[2] = _system.m_layers[ScatterType::Grass].m_maxDistance;
+	params[3] = _system.m_layers[ScatterType::Rock].m_maxDistance;
+	params[4] = _cameraPos.x;
+	params[5] = _cameraPos.y;
+	params[6] = _cameraPos.z;
+	params[7] = float(firstList);
+	bgfx::setUniform(_system.u_scatterParams, params, 2);
+
+	// counters are reset before any view runs
+	static const uint32_t s_zero[ScatterType::Count] = {};
+	bgfx::update(_system.m_counters, firstList, bgfx::copy(s_zero, sizeof(s_zero) ) );
+
+	if (0 != numInstances)
+	{
+		bgfx::setBuffer(0, _system.m_instanceBuffer, bgfx::Access::Read);
+		bgfx::setBuffer(1, _system.m_visibleBuffer, bgfx::Access::Write);
+		bgfx::setBuffer(2, _system.m_counters, bgfx::Access::ReadWrite);
+		bgfx::dispatch(_cullView, _system.m_cullProgram, (numInstances + 63) / 64);
+	}
+
+	float meshes[ScatterType::Count * 4];
+	for (uint32_t ii = 0; ii < ScatterType::Count; ++ii)
+	{
+		meshes[ii * 4 + 0] = float(_system.m_numIndices[ii]);
+		meshes[ii * 4 + 1] = float(_system.m_startIndex[ii]);
+		meshes[ii * 4 + 2] = 0.0f;
+		meshes[ii * 4 + 3] = 0.0f;
+	}
+	bgfx::setUniform(_system.u_scatterMeshes, meshes, ScatterType::Count);
+	bgfx::setUniform(_system.u_scatterParams, params, 2);
+	bgfx::setBuffer(0, _system.m_counters, bgfx::Access::Read);
+	bgfx::setBuffer(1, _system.m_indirect, bgfx::Access::Write);
+	bgfx::dispatch(_cullView, _system.m_argsProgram, 1);
+
+	for (uint32_t ii = 0; ii < ScatterType::Count; ++ii)
+	{
+		bgfx::setVertexBuffer(0, _system.m_vbh);
+		bgfx::setIndexBuffer(_system.m_ibh);
+		bgfx::setInstanceDataBuffer(_system.m_visibleBuffer, (firstList + ii) * ScatterSystem::kMaxVisible, ScatterSystem::kMaxVisible);
+		bgfx::setUniform(_system.u_sunDirection, _sunDirection);
+		gbufferSetUniforms(_gbuffer, false);
+		bgfx::setState(0
+			| BGFX_STATE_WRITE_RGB
+			| BGFX_STATE_WRITE_A
+			| BGFX_STATE_WRITE_Z
+			| BGFX_STATE_DEPTH_TEST_LESS
+			| BGFX_STATE_MSAA
+			);
+		bgfx::submit(_drawView, _system.m_drawProgram, _system.m_indirect, uint16_t(firstList + ii) );
+	}
+}
@@ -0,0 +1,141 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_SCATTER_H_HEADER_GUARD
+#define TERRAIN_SCATTER_H_HEADER_GUARD
+
+#include <bgfx/bgfx.h>
+#include "terrain_budget.h"
+#include "terrain_gbuffer.h"
+#include "terrain_heightfield.h"
+
+struct TerrainView;
+
+/// Kind of detail instance, each has its own mesh and indirect draw.
+struct ScatterType
+{
+	enum Enum
+	{
+		Grass,
+		Rock,
+
+		Count
+	};
+};
+
+/// Placement rules of one instance type.
+struct ScatterLayer
+{
+	float m_density;     //!< Instances per square meter where density map is 255.
+	float m_minScale;
+	float m_maxScale;
+	float m_maxSlope;    //!< Instances are rejected where normal y is below 1 - m_maxSlope.
+	float m_maxDistance; //!< Culled on the GPU beyond this distance from camera.
+};
+
+/// Resident cell, one slot of the instance buffer.
+struct ScatterSlot
+{
+	int32_t  m_cell;         //!< Cell index, -1 if slot is free.
+	uint32_t m_lastUsed;
+	uint32_t m_numInstances;
+	bool     m_dirty;        //!< Heights changed under the cell, instances are regenerated.
+};
+
+/// Grass and rocks scattered over the terrain. The map is split into square cells, instances
+/// of a cell are generated on the CPU when the camera gets close and kept in a fixed slot of
+/// one GPU instance buffer, so memory is bounded no matter how large the map is. Placement
+/// is a pure function of cell coordinates, evicted cells come back identical.
+///
+/// Every frame a compute pass per view culls all resident instances against frustum and
+/// distance and appends survivors per type into the view's part of the visible buffer, a
+/// second pass writes indirect draw arguments from the counts.
+struct ScatterSystem
+{
+	static constexpr uint32_t kMaxSlots            = 1024;
+	static constexpr uint32_t kMaxInstancesPerCell = 1024;
+	static constexpr uint32_t kMaxInstances        = kMaxSlots * kMaxInstancesPerCell;
+	static constexpr uint32_t kMaxViews            = 4;
+	static constexpr uint32_t kMaxVisible          = 64 * 1024;  //!< Per type and view.
+	static constexpr uint32_t kMaxGeneratePerFrame = 32;         //!< Cells, fewer once the frame budget is spent.
+
+	ScatterLayer m_layers[ScatterType::Count];
+	ScatterSlot m_slots[kMaxSlots];
+	int16_t* m_cellSlots;   //!< Per cell, slot index or -1.
+	uint8_t* m_density;     //!< Per height map texel, one channel per type.
+	float*   m_scratch;     //!< Positions, heights and normals while generating a cell.
+	float*   m_instances;   //!< One cell of instances being uploaded.
+	uint32_t m_densityWidth;
+	uint32_t m_densityHeight;
+	uint32_t m_numCellsX;
+	uint32_t m_numCellsZ;
+	float    m_cellSize;
+	float    m_texelSize;
+	uint32_t m_seed;
+	uint32_t m_frame;
+	uint32_t m_numSlotsUsed; //!< Highest used slot + 1, limits cull dispatch.
+
+	uint32_t m_numResident;   //!< Instances in resident cells.
+	uint32_t m_numGenerated;  //!< Cells generated last update.
+	float    m_generateMs;    //!< CPU time spent generating last update.
+
+	bgfx::VertexBufferHandle m_vbh;
+	bgfx::IndexBufferHandle m_ibh;
+	uint32_t m_startIndex[ScatterType::Count];
+	uint32_t m_numIndices[ScatterType::Count];
+
+	bgfx::DynamicVertexBufferHandle m_instanceBuffer;
+	bgfx::DynamicVertexBufferHandle m_visibleBuffer;
+	bgfx::DynamicIndexBufferHandle m_counters;
+	bgfx::IndirectBufferHandle m_indirect;
+
+	bgfx::ProgramHandle m_cullProgram;
+	bgfx::ProgramHandle m_argsProgram;
+	bgfx::ProgramHandle m_drawProgram;
+	bgfx::UniformHandle u_frustumPlanes;
+	bgfx::UniformHandle u_scatterParams;
+	bgfx::UniformHandle u_scatterMeshes;
+	bgfx::UniformHandle u_sunDirection;
+};
+
+/// Creates scatter system for a _width x _height texel height map. Density starts full for
+/// every type. Programs are loaded with the asset loader, nothing is drawn until they are.
+void scatterCreate(ScatterSystem& _system, uint32_t _width, uint32_t _height, float _texelSize, float _cellSize, uint32_t _seed);
+
+///
+void scatterDestroy(ScatterSystem& _system);
+
+/// Sets density of _type in texel rectangle from _data, one byte per texel with _rect width
+/// as pitch. Cells under the rectangle are regenerated.
+void scatterSetDensity(ScatterSystem& _system, ScatterType::Enum _type, const TileRect& _rect, const uint8_t* _data);
+
+/// Regenerates cells over texel rectangle, e.g. after height edits.
+void scatterInvalidate(ScatterSystem& _system, const TileRect& _rect);
+
+/// Makes cells within draw distance of any of _views resident, generating at most
+/// kMaxGeneratePerFrame of them while _budget lasts. Cells in view of one of them go first,
+/// then nearest first, the rest are left for later frames.
+void scatterUpdate(ScatterSystem& _system, const Heightfield& _field, const TerrainView* _views, uint32_t _numViews, FrameBudget& _budget);
+
+/// Generates instances of one cell into _outInstances, x, y, z and type * 16 + scale each.
+/// Returns number of instances. Exposed for tools and benchmarks.
+uint32_t scatterGenerateCell(ScatterSystem& _system, const Heightfield& _field, uint32_t _cellX, uint32_t _cellZ, float* _outInstances, uint32_t _max);
+
+/// Culls resident instances in _cullView and draws survivors in _drawView. _cullView must be
+/// sequential and run before _drawView. _viewProj is the draw view's view projection matrix.
+/// Every camera drawn in a frame has its own _viewIndex, below kMaxViews. Instances are
+/// written in _gbuffer's layout.
+void scatterSubmit(
+	  ScatterSystem& _system
+	, bgfx::ViewId _cullView
+	, bgfx::ViewId _drawView
+	, uint32_t _viewIndex
+	, const GBuffer& _gbuffer
+	, const float* _viewProj
+	, const bx::Vec3& _cameraPos
+	, const float* _sunDirection
+	, bool _homogeneousDepth
+	);
+
+#endif // TERRAIN_SCATTER_H_HEADER_GUARD
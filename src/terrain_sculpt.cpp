@@ -0,0 +1,182 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include "terrain_sculpt.h"
+
+static bgfx::VertexLayout s_sampleLayout;
+
+static float distanceXZ(const bx::Vec3& _a, const bx::Vec3& _b)
+{
+	const float dx = _b.x - _a.x;
+	const float dz = _b.z - _a.z;
+	return bx::sqrt(dx * dx + dz * dz);
+}
+
+static void addSample(SculptStroke& _stroke, const bx::Vec3& _position, float _size)
+{
+	if (_stroke.m_numSamples < SculptStroke::kMaxSamples)
+	{
+		BrushSample& sample = _stroke.m_samples[_stroke.m_numSamples++];
+		sample.m_x = _position.x;
+		sample.m_z = _position.z;
+		sample.m_size = _size;
+		sample.m_amount = 0.0f;
+	}
+}
+
+void sculptCreate(SculptStroke& _stroke)
+{
+	s_sampleLayout
+		.begin()
+		.add(bgfx::Attrib::Position, 4, bgfx::AttribType::Float)
+		.end();
+	BX_STATIC_ASSERT(sizeof(BrushSample) == 16);
+
+	_stroke.m_numPoints = 0;
+	_stroke.m_last = { 0.0f, 0.0f, 0.0f };
+	_stroke.m_carry = 0.0f;
+	_stroke.m_active = false;
+	_stroke.m_numSamples = 0;
+
+	_stroke.m_sampleBuffer  = bgfx::createDynamicVertexBuffer(SculptStroke::kMaxSamples, s_sampleLayout, BGFX_BUFFER_COMPUTE_READ);
+	_stroke.u_sculptParams  = bgfx::createUniform("u_sculptParams", bgfx::UniformType::Vec4);
+}
+
+void sculptDestroy(SculptStroke& _stroke)
+{
+	bgfx::destroy(_stroke.m_sampleBuffer);
+	bgfx::destroy(_stroke.u_sculptParams);
+}
+
+void sculptAddPoint(SculptStroke& _stroke, const bx::Vec3& _position)
+{
+	if (_stroke.m_numPoints == SculptStroke::kMaxPoints)
+	{
+		--_stroke.m_numPoints;
+	}
+
+	_stroke.m_points[_stroke.m_numPoints++] = _position;
+}
+
+void sculptEnd(SculptStroke& _stroke)
+{
+	_stroke.m_numPoints = 0;
+	_stroke.m_active = false;
+}
+
+uint32_t sculptBuildSamples(SculptStroke& _stroke, float _size, float _spacing, float _amount)
+{
+	_stroke.m_numSamples = 0;
+
+	uint32_t first = 0;
+	if (!_stroke.m_active
+	&&  0 != _stroke.m_numPoints)
+	{
+		_stroke.m_last = _stroke.m_points[0];
+		_stroke.m_carry = 0.0f;
+		_stroke.m_active = true;
+		addSample(_stroke, _stroke.m_last, _size);
+		first = 1;
+	}
+
+	if (!_stroke.m_active)
+	{
+		return 0;
+	}
+
+	// strokes too long for one batch get samples further apart instead of being cut short
+	float length = 0.0f;
+	bx::Vec3 prev = _stroke.m_last;
+	for (uint32_t ii = first; ii < _stroke.m_numPoints; ++ii)
+	{
+		length += distanceXZ(prev, _stroke.m_points[ii]);
+		prev = _stroke.m_points[ii];
+	}
+	const float spacing = bx::max(_spacing, length / float(SculptStroke::kMaxSamples - 1) );
+
+	for (uint32_t ii = first; ii < _stroke.m_numPoints; ++ii)
+	{
+		const bx::Vec3 point = _stroke.m_points[ii];
+		const float segment = distanceXZ(_stroke.m_last, point);
+		if (0.0f < segment)
+		{
+			float distance = spacing - _stroke.m_carry;
+			for (; distance <= segment; distance += spacing)
+			{
+				addSample(_stroke, bx::lerp(_stroke.m_last, point, distance / segment), _size);
+			}
+			_stroke.m_carry = segment - (distance - spacing);
+		}
+
+		_stroke.m_last = point;
+	}
+	_stroke.m_numPoints = 0;
+
+	// resting or slow brush keeps building up where it is
+	if (0 == _stroke.m_numSamples)
+	{
+		addSample(_stroke, _stroke.m_last, _size);
+	}
+
+	const float amount = _amount / float(_stroke.m_numSamples);
+	for (uint32_t ii = 0; ii < _stroke.m_numSamples; ++ii)
+	{
+		_stroke.m_samples[ii].m_amount = amount;
+	}
+
+	return _stroke.m_numSamples;
+}
+
+TileRect sculptGetRect(const SculptStroke& _stroke, float _texelSize, uint32_t _width, uint32_t _height)
+{
+	TileRect rect = { 0, 0, 0, 0 };
+	for (uint32_t ii = 0; ii < _stroke.m_numSamples; ++ii)
+	{
+		// texel x sits at (x + 0.5) * _texelSize
+		const BrushSample& sample = _stroke.m_samples[ii];
+		const float extent = 2.0f * sample.m_size;
+		const TileRect sampleRect =
+		{
+			int32_t(bx::floor( (sample.m_x - extent) / _texelSize - 0.5f) ),
+			int32_t(bx::floor( (sample.m_z - extent) / _texelSize - 0.5f) ),
+			int32_t(bx::ceil( (sample.m_x + extent) / _texelSize - 0.5f) ) + 1,
+			int32_t(bx::ceil( (sample.m_z + extent) / _texelSize - 0.5f) ) + 1,
+		};
+		rect = tileRectUnion(rect, sampleRect);
+	}
+
+	const TileRect full = { 0, 0, int32_t(_width), int32_t(_height) };
+	return tileRectIntersect(rect, full);
+}
+
+void sculptDispatch(
+	  SculptStroke& _stroke
+	, bgfx::ViewId _view
+	, bgfx::ProgramHandle _program
+	, bgfx::TextureHandle _heightTexture
+	, const TileRect& _rect
+	, float _worldSize
+	)
+{
+	if (0 == _stroke.m_numSamples
+	||  tileRectIsEmpty(_rect) )
+	{
+		return;
+	}
+
+	bgfx::update(_stroke.m_sampleBuffer, 0, bgfx::copy(_stroke.m_samples, _stroke.m_numSamples * sizeof(BrushSample) ) );
+
+	float params[4];
+	params[0] = float(_stroke.m_numSamples);
+	params[1] = float(_rect.m_x0);
+	params[2] = float(_rect.m_y0);
+	params[3] = _worldSize;
+	bgfx::setUniform(_stroke.u_sculptParams, params);
+
+	const uint32_t width  = uint32_t(_rect.m_x1 - _rect.m_x0);
+	const uint32_t height = uint32_t(_rect.m_y1 - _rect.m_y0);
+	bgfx::setImage(0, _heightTexture, 0, bgfx::Access::ReadWrite, bgfx::TextureFormat::R16);
+	bgfx::setBuffer(1, _stroke.m_sampleBuffer, bgfx::Access::Read);
+	bgfx::dispatch(_view, _program, (width + 7) / 8, (height + 7) / 8);
+}
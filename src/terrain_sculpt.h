@@ -0,0 +1,71 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_SCULPT_H_HEADER_GUARD
+#define TERRAIN_SCULPT_H_HEADER_GUARD
+
+#include <bgfx/bgfx.h>
+#include <bx/math.h>
+#include "terrain_tiles.h"
+
+/// One brush application, matches u_brushSamples in cs_updateHeightMap.
+struct BrushSample
+{
+	float m_x;
+	float m_z;
+	float m_size;    //!< Brush falls off to zero at twice the size.
+	float m_amount;  //!< Normalized height added at the centre.
+};
+
+/// Turns cursor positions on the terrain into brush samples spaced evenly along the stroke,
+/// so fast strokes leave no gaps. Samples of a frame are applied by one dispatch.
+struct SculptStroke
+{
+	static constexpr uint32_t kMaxPoints  = 64;
+	static constexpr uint32_t kMaxSamples = 64;
+
+	bx::Vec3 m_points[kMaxPoints];     //!< Cursor hits since the last batch.
+	uint32_t m_numPoints;
+	bx::Vec3 m_last;                   //!< Stroke position the next segment starts from.
+	float    m_carry;                  //!< Stroke length since the last sample.
+	bool     m_active;
+
+	BrushSample m_samples[kMaxSamples];
+	uint32_t m_numSamples;
+
+	bgfx::DynamicVertexBufferHandle m_sampleBuffer;
+	bgfx::UniformHandle u_sculptParams;
+};
+
+///
+void sculptCreate(SculptStroke& _stroke);
+
+///
+void sculptDestroy(SculptStroke& _stroke);
+
+/// Adds cursor hit, in the order the cursor moved. Past kMaxPoints the last one is replaced.
+void sculptAddPoint(SculptStroke& _stroke, const bx::Vec3& _position);
+
+/// Ends the stroke, the next point starts a new one.
+void sculptEnd(SculptStroke& _stroke);
+
+/// Places samples _spacing apart along points added since the last batch, a stroke that
+/// didn't move gets one sample where it rests. _amount is split over the samples, so the
+/// height added per batch doesn't depend on how far the cursor moved. Returns number of samples.
+uint32_t sculptBuildSamples(SculptStroke& _stroke, float _size, float _spacing, float _amount);
+
+/// Texels of a _width x _height height map with _texelSize spacing touched by the last batch.
+TileRect sculptGetRect(const SculptStroke& _stroke, float _texelSize, uint32_t _width, uint32_t _height);
+
+/// Applies the last batch to texels in _rect of _heightTexture with one dispatch.
+void sculptDispatch(
+	  SculptStroke& _stroke
+	, bgfx::ViewId _view
+	, bgfx::ProgramHandle _program
+	, bgfx::TextureHandle _heightTexture
+	, const TileRect& _rect
+	, float _worldSize
+	);
+
+#endif // TERRAIN_SCULPT_H_HEADER_GUARD
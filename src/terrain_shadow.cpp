@@ -0,0 +1,265 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include "terrain_shadow.h"
+
+// Height margin kept around the terrain's height range, so small edits don't move the depth
+// range and invalidate every cascade.
+static const float s_heightMargin = 4.0f;
+
+// Depth bias in world units along the sun direction.
+static const float s_depthBiasWorld = 0.05f;
+
+void shadowCreate(ShadowCascades& _shadows, float _worldSize)
+{
+	static const float s_extents[ShadowCascades::kNumCascades] = { 0.25f, 0.625f, 1.5f };
+	for (uint32_t ii = 0; ii < ShadowCascades::kNumCascades; ++ii)
+	{
+		ShadowCascade& cascade = _shadows.m_cascades[ii];
+		cascade.m_extent  = s_extents[ii] * _worldSize;
+		cascade.m_lodBias = uint8_t(ii);
+		cascade.m_center[0] = 0.0f;
+		cascade.m_center[1] = 0.0f;
+		cascade.m_valid = false;
+		bx::mtxIdentity(cascade.m_view);
+		bx::mtxIdentity(cascade.m_proj);
+		bx::mtxIdentity(cascade.m_shadowMtx);
+	}
+
+	_shadows.m_sunDirection[0] = 0.0f;
+	_shadows.m_sunDirection[1] = 0.0f;
+	_shadows.m_sunDirection[2] = 0.0f;
+	_shadows.m_minHeight =  bx::kFloatMax;
+	_shadows.m_maxHeight = -bx::kFloatMax;
+	_shadows.m_worldSize = _worldSize;
+	_shadows.m_depthBias = 0.0f;
+	_shadows.m_numActive = ShadowCascades::kNumCascades;
+	_shadows.m_numRendered = 0;
+
+	_shadows.m_atlas.idx = bgfx::kInvalidHandle;
+	_shadows.m_frameBuffer.idx = bgfx::kInvalidHandle;
+	if (0 != (bgfx::getCaps()->supported & BGFX_CAPS_TEXTURE_COMPARE_LEQUAL) )
+	{
+		_shadows.m_atlas = bgfx::createTexture2D(
+			  ShadowCascades::kResolution * ShadowCascades::kNumCascades
+			, ShadowCascades::kResolution
+			, false
+			, 1
+			, bgfx::TextureFormat::D16
+			, BGFX_TEXTURE_RT | BGFX_SAMPLER_COMPARE_LEQUAL | BGFX_SAMPLER_UVW_CLAMP
+			);
+		_shadows.m_frameBuffer = bgfx::createFrameBuffer(1, &_shadows.m_atlas, true);
+	}
+
+	_shadows.s_shadowMap     = bgfx::createUniform("s_shadowMap",    bgfx::UniformType::Sampler);
+	_shadows.u_shadowMtx     = bgfx::createUniform("u_shadowMtx",    bgfx::UniformType::Mat4, ShadowCascades::kNumCascades);
+	_shadows.u_shadowParams  = bgfx::createUniform("u_shadowParams", bgfx::UniformType::Vec4);
+}
+
+void shadowDestroy(ShadowCascades& _shadows)
+{
+	if (bgfx::isValid(_shadows.m_frameBuffer) )
+	{
+		// destroys atlas too
+		bgfx::destroy(_shadows.m_frameBuffer);
+	}
+
+	bgfx::destroy(_shadows.s_shadowMap);
+	bgfx::destroy(_shadows.u_shadowMtx);
+	bgfx::destroy(_shadows.u_shadowParams);
+}
+
+bool shadowCascadeOverlaps(const ShadowCascade& _cascade, const bx::Vec3& _min, const bx::Vec3& _max)
+{
+	float viewProj[16];
+	bx::mtxMul(viewProj, _cascade.m_view, _cascade.m_proj);
+
+	float minX =  bx::kFloatMax;
+	float minY =  bx::kFloatMax;
+	float maxX = -bx::kFloatMax;
+	float maxY = -bx::kFloatMax;
+	for (uint32_t ii = 0; ii < 8; ++ii)
+	{
+		const bx::Vec3 corner =
+		{
+			0 != (ii & 1) ? _max.x : _min.x,
+			0 != (ii & 2) ? _max.y : _min.y,
+			0 != (ii & 4) ? _max.z : _min.z,
+		};
+
+		// orthographic, no divide
+		const bx::Vec3 clip = bx::mul(corner, viewProj);
+		minX = bx::min(minX, clip.x);
+		minY = bx::min(minY, clip.y);
+		maxX = bx::max(maxX, clip.x);
+		maxY = bx::max(maxY, clip.y);
+	}
+
+	return minX <= 1.0f && maxX >= -1.0f
+		&& minY <= 1.0f && maxY >= -1.0f
+		;
+}
+
+void shadowInvalidate(ShadowCascades& _shadows, float _minX, float _minZ, float _maxX, float _maxZ)
+{
+	const bx::Vec3 boxMin = { _minX, _shadows.m_minHeight, _minZ };
+	const bx::Vec3 boxMax = { _maxX, _shadows.m_maxHeight, _maxZ };
+
+	for (uint32_t ii = 0; ii < ShadowCascades::kNumCascades; ++ii)
+	{
+		ShadowCascade& cascade = _shadows.m_cascades[ii];
+		if (cascade.m_valid
+		&&  shadowCascadeOverlaps(cascade, boxMin, boxMax) )
+		{
+			cascade.m_valid = false;
+		}
+	}
+}
+
+uint32_t shadowUpdate(
+	  ShadowCascades& _shadows
+	, bgfx::ViewId _firstView
+	, const bx::Vec3& _cameraPos
+	, const float* _sunDirection
+	, float _minHeight
+	, float _maxHeight
+	)
+{
+	_shadows.m_numRendered = 0;
+	if (!bgfx::isValid(_shadows.m_frameBuffer) )
+	{
+		return 0;
+	}
+
+	bool invalidateAll = false;
+	if (0 != bx::memCmp(_shadows.m_sunDirection, _sunDirection, sizeof(_shadows.m_sunDirection) ) )
+	{
+		bx::memCopy(_shadows.m_sunDirection, _sunDirection, sizeof(_shadows.m_sunDirection) );
+		invalidateAll = true;
+	}
+
+	// depth range only grows, cascades are re-rendered when it does
+	if (_minHeight < _shadows.m_minHeight
+	||  _maxHeight > _shadows.m_maxHeight)
+	{
+		_shadows.m_minHeight = bx::min(_shadows.m_minHeight, _minHeight - s_heightMargin);
+		_shadows.m_maxHeight = bx::max(_shadows.m_maxHeight, _maxHeight + s_heightMargin);
+		invalidateAll = true;
+	}
+
+	const bgfx::Caps* caps = bgfx::getCaps();
+	const bx::Vec3 sunDir = bx::load<bx::Vec3>(_sunDirection);
+	const bx::Vec3 up = bx::abs(sunDir.z) < 0.99f ? bx::Vec3{ 0.0f, 0.0f, 1.0f } : bx::Vec3{ 1.0f, 0.0f, 0.0f };
+
+	float view[16];
+	bx::mtxLookAt(view, { 0.0f, 0.0f, 0.0f }, bx::neg(sunDir), up);
+
+	// depth range covers the whole map, every cascade has the same one
+	float minDepth =  bx::kFloatMax;
+	float maxDepth = -bx::kFloatMax;
+	for (uint32_t ii = 0; ii < 8; ++ii)
+	{
+		const bx::Vec3 corner =
+		{
+			0 != (ii & 1) ? _shadows.m_worldSize : 0.0f,
+			0 != (ii & 2) ? _shadows.m_maxHeight : _shadows.m_minHeight,
+			0 != (ii & 4) ? _shadows.m_worldSize : 0.0f,
+		};
+		const float depth = bx::mul(corner, view).z;
+		minDepth = bx::min(minDepth, depth);
+		maxDepth = bx::max(maxDepth, depth);
+	}
+	_shadows.m_depthBias = s_depthBiasWorld / (maxDepth - minDepth);
+
+	const float sy = caps->originBottomLeft ? 0.5f : -0.5f;
+	const float sz = caps->homogeneousDepth ? 0.5f :  1.0f;
+	const float tz = caps->homogeneousDepth ? 0.5f :  0.0f;
+	const float crop[16] =
+	{
+		0.5f, 0.0f, 0.0f, 0.0f,
+		0.0f,   sy, 0.0f, 0.0f,
+		0.0f, 0.0f,   sz, 0.0f,
+		0.5f, 0.5f,   tz, 1.0f,
+	};
+
+	// cascades are centered on the ground below the camera, not on the camera itself
+	const bx::Vec3 ground = { _cameraPos.x, bx::clamp(_cameraPos.y, _shadows.m_minHeight, _shadows.m_maxHeight), _cameraPos.z };
+	const bx::Vec3 camera = bx::mul(ground, view);
+
+	// unused cascades miss sun and range changes, redraw them once they are back in use
+	for (uint32_t ii = _shadows.m_numActive; ii < ShadowCascades::kNumCascades; ++ii)
+	{
+		_shadows.m_cascades[ii].m_valid = false;
+	}
+
+	uint32_t mask = 0;
+	for (uint32_t ii = 0; ii < _shadows.m_numActive; ++ii)
+	{
+		ShadowCascade& cascade = _shadows.m_cascades[ii];
+
+		// a quarter of extent is a whole number of texels, snapping also keeps texels stable
+		const float step = cascade.m_extent * 0.25f;
+		const float centerX = bx::floor(camera.x / step + 0.5f) * step;
+		const float centerY = bx::floor(camera.y / step + 0.5f) * step;
+		if (cascade.m_valid
+		&&  !invalidateAll
+		&&  centerX == cascade.m_center[0]
+		&&  centerY == cascade.m_center[1])
+		{
+			continue;
+		}
+
+		const float halfExtent = cascade.m_extent * 0.5f;
+		cascade.m_center[0] = centerX;
+		cascade.m_center[1] = centerY;
+		bx::memCopy(cascade.m_view, view, sizeof(view) );
+		bx::mtxOrtho(cascade.m_proj
+			, centerX - halfExtent
+			, centerX + halfExtent
+			, centerY - halfExtent
+			, centerY + halfExtent
+			, minDepth
+			, maxDepth
+			, 0.0f
+			, caps->homogeneousDepth
+			);
+
+		float viewProj[16];
+		bx::mtxMul(viewProj, cascade.m_view, cascade.m_proj);
+		bx::mtxMul(cascade.m_shadowMtx, viewProj, crop);
+		cascade.m_valid = true;
+
+		const bgfx::ViewId viewId = bgfx::ViewId(_firstView + ii);
+		bgfx::setViewName(viewId, "Shadow cascade");
+		bgfx::setViewFrameBuffer(viewId, _shadows.m_frameBuffer);
+		bgfx::setViewRect(viewId, uint16_t(ii * ShadowCascades::kResolution), 0, ShadowCascades::kResolution, ShadowCascades::kResolution);
+		bgfx::setViewClear(viewId, BGFX_CLEAR_DEPTH, 0, 1.0f, 0);
+		bgfx::setViewTransform(viewId, cascade.m_view, cascade.m_proj);
+		bgfx::touch(viewId);
+
+		mask |= 1 << ii;
+		++_shadows.m_numRendered;
+	}
+
+	return mask;
+}
+
+void shadowSetUniforms(const ShadowCascades& _shadows, uint8_t _stage)
+{
+	float shadowMtx[16 * ShadowCascades::kNumCascades];
+	for (uint32_t ii = 0; ii < ShadowCascades::kNumCascades; ++ii)
+	{
+		bx::memCopy(&shadowMtx[ii * 16], _shadows.m_cascades[ii].m_shadowMtx, sizeof(float) * 16);
+	}
+
+	float params[4];
+	params[0] = _shadows.m_depthBias;
+	params[1] = bgfx::isValid(_shadows.m_atlas) ? 1.0f : 0.0f;
+	params[2] = 1.0f / float(ShadowCascades::kResolution);
+	params[3] = float(_shadows.m_numActive);
+
+	bgfx::setTexture(_stage, _shadows.s_shadowMap, _shadows.m_atlas);
+	bgfx::setUniform(_shadows.u_shadowMtx, shadowMtx, ShadowCascades::kNumCascades);
+	bgfx::setUniform(_shadows.u_shadowParams, params);
+}
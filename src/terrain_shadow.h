@@ -0,0 +1,77 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_SHADOW_H_HEADER_GUARD
+#define TERRAIN_SHADOW_H_HEADER_GUARD
+
+#include <bgfx/bgfx.h>
+#include <bx/math.h>
+
+/// One cascade, an orthographic sun view over a square around the camera.
+struct ShadowCascade
+{
+	float    m_extent;        //!< World units covered by the cascade.
+	uint8_t  m_lodBias;       //!< Terrain patches are drawn with every 2^m_lodBias-th vertex.
+	float    m_center[2];     //!< Light space center, snapped to a quarter of m_extent.
+	float    m_view[16];
+	float    m_proj[16];
+	float    m_shadowMtx[16]; //!< World to cascade uv and depth.
+	bool     m_valid;         //!< Shadow map holds current content.
+};
+
+/// Cascaded shadow maps of the sun. Cascades are placed in light space and only move in steps
+/// of a quarter of their size, so their content stays valid while the camera moves within a
+/// step. A cascade is re-rendered only when it moves, the sun turns or terrain under it changes.
+/// All cascades share one depth atlas, side by side.
+struct ShadowCascades
+{
+	static constexpr uint32_t kNumCascades = 3;
+	static constexpr uint16_t kResolution  = 1024;
+
+	ShadowCascade m_cascades[kNumCascades];
+	float m_sunDirection[3];
+	float m_minHeight;
+	float m_maxHeight;
+	float m_worldSize;
+	float m_depthBias;
+
+	bgfx::TextureHandle m_atlas;
+	bgfx::FrameBufferHandle m_frameBuffer;
+	bgfx::UniformHandle s_shadowMap;
+	bgfx::UniformHandle u_shadowMtx;
+	bgfx::UniformHandle u_shadowParams;
+
+	uint32_t m_numActive;   //!< Cascades in use, nearest first.
+	uint32_t m_numRendered; //!< Cascades rendered last frame.
+};
+
+/// Creates cascades over a square map of _worldSize. Nothing is rendered if depth compare
+/// sampling isn't supported, combine pass then skips the lookup.
+void shadowCreate(ShadowCascades& _shadows, float _worldSize);
+
+///
+void shadowDestroy(ShadowCascades& _shadows);
+
+/// Marks cascades overlapping world rectangle as stale, e.g. after sculpting.
+void shadowInvalidate(ShadowCascades& _shadows, float _minX, float _minZ, float _maxX, float _maxZ);
+
+/// Places cascades around _cameraPos for sun direction _sunDirection (towards the sun) and
+/// terrain heights in [_minHeight, _maxHeight]. Sets up views _firstView + cascade index of
+/// stale cascades and returns bit mask of cascades that must be drawn this frame.
+uint32_t shadowUpdate(
+	  ShadowCascades& _shadows
+	, bgfx::ViewId _firstView
+	, const bx::Vec3& _cameraPos
+	, const float* _sunDirection
+	, float _minHeight
+	, float _maxHeight
+	);
+
+/// Returns true if world box may cast shadow into _cascade.
+bool shadowCascadeOverlaps(const ShadowCascade& _cascade, const bx::Vec3& _min, const bx::Vec3& _max);
+
+/// Binds shadow atlas at _stage and cascade matrices for the combine pass.
+void shadowSetUniforms(const ShadowCascades& _shadows, uint8_t _stage);
+
+#endif // TERRAIN_SHADOW_H_HEADER_GUARD
@@ -0,0 +1,282 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <bx/math.h>
+#include <string.h>
+#include "asset_loader.h"
+#include "terrain_memory.h"
+#include "terrain_streaming.h"
+
+struct TileState
+{
+	enum Enum
+	{
+		Empty,
+		Queued,
+		Loading,
+		Resident,
+		Missing,  //!< Load failed, kept so the tile isn't requested again right away.
+	};
+};
+
+struct TileSlot
+{
+	TileStreamer* m_streamer;
+	void*    m_data;
+	TileKey  m_key;
+	uint8_t  m_state;
+	bool     m_prefetched;   //!< Requested ahead and not acquired since it loaded.
+	bool     m_loaded;       //!< Set by the loader thread.
+	int16_t  m_next;         //!< Next slot in the bucket, -1 at the end.
+	uint32_t m_lastUsed;     //!< Frame it was last requested or acquired.
+	float    m_urgency;      //!< Seconds until needed, while queued.
+};
+
+static uint32_t hashKey(const TileKey& _key)
+{
+	uint32_t hash = uint32_t(_key.m_x) * 0x8da6b343u ^ uint32_t(_key.m_z) * 0xd8163841u ^ (uint32_t(_key.m_lod) << 2 | _key.m_layer) * 0xcb1ab31fu;
+	return (hash ^ hash >> 16) % TileStreamer::kNumBuckets;
+}
+
+static bool isEqual(const TileKey& _a, const TileKey& _b)
+{
+	return _a.m_layer == _b.m_layer
+		&& _a.m_lod   == _b.m_lod
+		&& _a.m_x     == _b.m_x
+		&& _a.m_z     == _b.m_z
+		;
+}
+
+static TileSlot* findSlot(TileStreamer& _streamer, const TileKey& _key)
+{
+	for (int16_t ii = _streamer.m_buckets[hashKey(_key)]; -1 != ii; ii = _streamer.m_slots[ii].m_next)
+	{
+		TileSlot& slot = _streamer.m_slots[ii];
+		if (isEqual(slot.m_key, _key) )
+		{
+			return &slot;
+		}
+	}
+
+	return NULL;
+}
+
+static void unlinkSlot(TileStreamer& _streamer, TileSlot& _slot)
+{
+	int16_t* link = &_streamer.m_buckets[hashKey(_slot.m_key)];
+	while (&_streamer.m_slots[*link] != &_slot)
+	{
+		link = &_streamer.m_slots[*link].m_next;
+	}
+	*link = _slot.m_next;
+}
+
+// Slot not used this frame and not loading, least recently used first.
+static TileSlot* allocSlot(TileStreamer& _streamer, const TileKey& _key)
+{
+	TileSlot* best = NULL;
+	for (uint32_t ii = 0; ii < _streamer.m_numSlots; ++ii)
+	{
+		TileSlot& slot = _streamer.m_slots[ii];
+		if (TileState::Empty == slot.m_state)
+		{
+			best = &slot;
+			break;
+		}
+
+		if (TileState::Loading != slot.m_state
+		&&  slot.m_lastUsed != _streamer.m_frame
+		&&  (NULL == best || slot.m_lastUsed < best->m_lastUsed) )
+		{
+			best = &slot;
+		}
+	}
+
+	if (NULL == best)
+	{
+		++_streamer.m_stats.m_numDropped;
+		return NULL;
+	}
+
+	if (TileState::Empty != best->m_state)
+	{
+		_streamer.m_numQueued -= TileState::Queued == best->m_state ? 1 : 0;
+		unlinkSlot(_streamer, *best);
+	}
+
+	const int16_t index = int16_t(best - _streamer.m_slots);
+	const uint32_t bucket = hashKey(_key);
+	best->m_key   = _key;
+	best->m_state = TileState::Empty;
+	best->m_next  = _streamer.m_buckets[bucket];
+	_streamer.m_buckets[bucket] = index;
+	return best;
+}
+
+static void loadTileJob(void* _userData)
+{
+	TileSlot* slot = (TileSlot*)_userData;
+	const TileStreamer& streamer = *slot->m_streamer;
+	slot->m_loaded = streamer.m_load(slot->m_key, slot->m_data, streamer.m_tileBytes, streamer.m_userData);
+}
+
+static void loadTileDone(void* _userData)
+{
+	TileSlot* slot = (TileSlot*)_userData;
+	TileStreamer& streamer = *slot->m_streamer;
+	--streamer.m_numInFlight;
+	slot->m_state = slot->m_loaded ? TileState::Resident : TileState::Missing;
+}
+
+void tileStreamerCreate(TileStreamer& _streamer, uint32_t _maxResident, uint32_t _tileBytes, uint32_t _maxInFlight, TileLoadFn _load, void* _userData)
+{
+	BX_CHECK(_maxResident <= INT16_MAX, "Too many resident tiles %d.", _maxResident);
+
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::Streaming);
+
+	memset(&_streamer, 0, sizeof(_streamer) );
+	_streamer.m_slots       = (TileSlot*)BX_ALLOC(allocator, _maxResident * sizeof(TileSlot) );
+	_streamer.m_numSlots    = _maxResident;
+	_streamer.m_tileBytes   = _tileBytes;
+	_streamer.m_maxInFlight = _maxInFlight;
+	_streamer.m_load        = _load;
+	_streamer.m_userData    = _userData;
+	memset(_streamer.m_buckets, 0xff, sizeof(_streamer.m_buckets) );
+
+	uint8_t* data = (uint8_t*)BX_ALLOC(allocator, _maxResident * _tileBytes);
+	for (uint32_t ii = 0; ii < _maxResident; ++ii)
+	{
+		TileSlot& slot = _streamer.m_slots[ii];
+		memset(&slot, 0, sizeof(slot) );
+		slot.m_streamer = &_streamer;
+		slot.m_data     = &data[ii * _tileBytes];
+		slot.m_state    = TileState::Empty;
+		slot.m_next     = -1;
+	}
+}
+
+void tileStreamerDestroy(TileStreamer& _streamer)
+{
+	bx::AllocatorI* allocator = getAllocator(MemoryCategory::Streaming);
+	BX_FREE(allocator, _streamer.m_slots[0].m_data);
+	BX_FREE(allocator, _streamer.m_slots);
+	_streamer.m_slots = NULL;
+	_streamer.m_numSlots = 0;
+}
+
+void tileStreamerBeginFrame(TileStreamer& _streamer)
+{
+	for (uint32_t ii = 0; ii < _streamer.m_numSlots; ++ii)
+	{
+		TileSlot& slot = _streamer.m_slots[ii];
+		if (TileState::Queued == slot.m_state
+		&&  slot.m_lastUsed != _streamer.m_frame)
+		{
+			unlinkSlot(_streamer, slot);
+			slot.m_state = TileState::Empty;
+			--_streamer.m_numQueued;
+		}
+	}
+
+	++_streamer.m_frame;
+}
+
+const void* tileStreamerAcquire(TileStreamer& _streamer, const TileKey& _key, uint8_t _maxLod, uint8_t* _outLod)
+{
+	TileSlot* slot = findSlot(_streamer, _key);
+	if (NULL != slot
+	&&  TileState::Resident == slot->m_state)
+	{
+		++_streamer.m_stats.m_numHits;
+		if (slot->m_prefetched)
+		{
+			++_streamer.m_stats.m_numPrefetchUsed;
+			slot->m_prefetched = false;
+		}
+		slot->m_lastUsed = _streamer.m_frame;
+		*_outLod = _key.m_lod;
+		return slot->m_data;
+	}
+
+	++_streamer.m_stats.m_numMisses;
+	if (NULL == slot
+	||  TileState::Missing != slot->m_state)
+	{
+		tileStreamerRequest(_streamer, _key, 0.0f);
+	}
+
+	// coarser tiles stay wanted while they stand in
+	TileKey parent = _key;
+	while (parent.m_lod < _maxLod)
+	{
+		++parent.m_lod;
+		parent.m_x /= 2;
+		parent.m_z /= 2;
+
+		slot = findSlot(_streamer, parent);
+		if (NULL != slot
+		&&  TileState::Resident == slot->m_state)
+		{
+			++_streamer.m_stats.m_numFallbacks;
+			slot->m_lastUsed = _streamer.m_frame;
+			*_outLod = parent.m_lod;
+			return slot->m_data;
+		}
+	}
+
+	*_outLod = UINT8_MAX;
+	return NULL;
+}
+
+void tileStreamerRequest(TileStreamer& _streamer, const TileKey& _key, float _seconds)
+{
+	TileSlot* slot = findSlot(_streamer, _key);
+	if (NULL == slot)
+	{
+		slot = allocSlot(_streamer, _key);
+		if (NULL == slot)
+		{
+			return;
+		}
+
+		slot->m_state      = TileState::Queued;
+		slot->m_prefetched = 0.0f < _seconds;
+		slot->m_urgency    = _seconds;
+		++_streamer.m_numQueued;
+	}
+	else if (TileState::Queued == slot->m_state)
+	{
+		slot->m_urgency    = bx::min(slot->m_urgency, _seconds);
+		slot->m_prefetched = slot->m_prefetched && 0.0f < _seconds;
+	}
+
+	slot->m_lastUsed = _streamer.m_frame;
+}
+
+void tileStreamerUpdate(TileStreamer& _streamer)
+{
+	while (0 != _streamer.m_numQueued
+	&&     _streamer.m_numInFlight < _streamer.m_maxInFlight)
+	{
+		TileSlot* best = NULL;
+		for (uint32_t ii = 0; ii < _streamer.m_numSlots; ++ii)
+		{
+			TileSlot& slot = _streamer.m_slots[ii];
+			if (TileState::Queued == slot.m_state
+			&&  (NULL == best || slot.m_urgency < best->m_urgency) )
+			{
+				best = &slot;
+			}
+		}
+
+		best->m_state  = TileState::Loading;
+		best->m_loaded = false;
+		--_streamer.m_numQueued;
+		++_streamer.m_numInFlight;
+		++_streamer.m_stats.m_numLoads;
+		_streamer.m_stats.m_numPrefetchLoads += best->m_prefetched ? 1 : 0;
+		_streamer.m_stats.m_maxInFlight = bx::max(_streamer.m_stats.m_maxInFlight, _streamer.m_numInFlight);
+		assetSubmitJob(loadTileJob, loadTileDone, best);
+	}
+}
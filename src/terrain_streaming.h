@@ -0,0 +1,95 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_STREAMING_H_HEADER_GUARD
+#define TERRAIN_STREAMING_H_HEADER_GUARD
+
+#include <stdint.h>
+
+/// Per tile data of the world, streamed separately.
+struct TileLayer
+{
+	enum Enum
+	{
+		Height,
+		Normal,
+		Splat,
+
+		Count
+	};
+};
+
+/// Tile of LOD l covers 2^l x 2^l tiles of LOD 0 at the same resolution.
+struct TileKey
+{
+	uint8_t  m_layer;
+	uint8_t  m_lod;
+	uint16_t m_x;
+	uint16_t m_z;
+};
+
+/// Runs on a loader thread, fills _dst with _size bytes of the tile. Returns false if the tile
+/// doesn't exist.
+typedef bool (*TileLoadFn)(const TileKey& _key, void* _dst, uint32_t _size, void* _userData);
+
+/// Totals since tileStreamerCreate.
+struct TileStreamerStats
+{
+	uint32_t m_numHits;           //!< Acquired tiles that were resident.
+	uint32_t m_numMisses;         //!< Acquired tiles that weren't, includes fallbacks.
+	uint32_t m_numFallbacks;      //!< Misses answered by a coarser resident tile.
+	uint32_t m_numLoads;
+	uint32_t m_numPrefetchLoads;  //!< Loads started by a prefetch, before anything needed them.
+	uint32_t m_numPrefetchUsed;   //!< Prefetched tiles acquired later.
+	uint32_t m_numDropped;        //!< Requests without a free slot.
+	uint32_t m_maxInFlight;
+};
+
+///
+struct TileSlot;
+
+/// Fixed number of resident tiles of all layers, loaded on asset loader threads. Tiles are
+/// requested with the time until they are needed and the most urgent ones are loaded first,
+/// at most m_maxInFlight at once so that prefetching can't flood the loader and delay tiles
+/// the current frame is missing. Least recently used tiles are evicted.
+struct TileStreamer
+{
+	static constexpr uint32_t kNumBuckets = 1024;
+
+	TileSlot* m_slots;
+	uint32_t  m_numSlots;
+	uint32_t  m_tileBytes;
+	int16_t   m_buckets[kNumBuckets];
+	uint32_t  m_maxInFlight;
+	uint32_t  m_numInFlight;
+	uint32_t  m_numQueued;
+	uint32_t  m_frame;
+
+	TileLoadFn m_load;
+	void*      m_userData;
+
+	TileStreamerStats m_stats;
+};
+
+///
+void tileStreamerCreate(TileStreamer& _streamer, uint32_t _maxResident, uint32_t _tileBytes, uint32_t _maxInFlight, TileLoadFn _load, void* _userData);
+
+/// Call after assetLoaderDestroy, loads in flight write to the slots.
+void tileStreamerDestroy(TileStreamer& _streamer);
+
+/// Requests that weren't repeated since the last call are dropped.
+void tileStreamerBeginFrame(TileStreamer& _streamer);
+
+/// Returns data of the tile, or of the finest resident tile covering it up to _maxLod when it
+/// isn't resident yet. _outLod receives LOD of the returned tile. Missing tile is requested as
+/// needed right now. Returns NULL if nothing covers it.
+const void* tileStreamerAcquire(TileStreamer& _streamer, const TileKey& _key, uint8_t _maxLod, uint8_t* _outLod);
+
+/// Asks for a tile expected to be needed in _seconds. Does nothing if it's resident already.
+void tileStreamerRequest(TileStreamer& _streamer, const TileKey& _key, float _seconds);
+
+/// Starts loads of requested tiles, most urgent first, while fewer than m_maxInFlight run.
+void tileStreamerUpdate(TileStreamer& _streamer);
+
+#endif // TERRAIN_STREAMING_H_HEADER_GUARD
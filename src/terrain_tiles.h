@@ -0,0 +1,124 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_TILES_H_HEADER_GUARD
+#define TERRAIN_TILES_H_HEADER_GUARD
+
+#include <bx/bx.h>
+
+/// Rectangle in height map texels, [m_x0, m_x1) x [m_y0, m_y1).
+struct TileRect
+{
+	int32_t m_x0;
+	int32_t m_y0;
+	int32_t m_x1;
+	int32_t m_y1;
+};
+
+/// Height map split into square tiles. Every per tile cache (normals, splat, horizon, ...)
+/// is addressed through this grid so dirty rectangles map to the same tiles everywhere.
+struct TileGrid
+{
+	uint32_t m_width;
+	uint32_t m_height;
+	uint32_t m_tileSize;
+	uint32_t m_numTilesX;
+	uint32_t m_numTilesY;
+};
+
+///
+inline bool tileRectIsEmpty(const TileRect& _rect)
+{
+	return _rect.m_x0 >= _rect.m_x1 || _rect.m_y0 >= _rect.m_y1;
+}
+
+///
+inline TileRect tileRectUnion(const TileRect& _a, const TileRect& _b)
+{
+	if (tileRectIsEmpty(_a) )
+	{
+		return _b;
+	}
+
+	if (tileRectIsEmpty(_b) )
+	{
+		return _a;
+	}
+
+	TileRect result;
+	result.m_x0 = bx::min(_a.m_x0, _b.m_x0);
+	result.m_y0 = bx::min(_a.m_y0, _b.m_y0);
+	result.m_x1 = bx::max(_a.m_x1, _b.m_x1);
+	result.m_y1 = bx::max(_a.m_y1, _b.m_y1);
+	return result;
+}
+
+///
+inline TileRect tileRectIntersect(const TileRect& _a, const TileRect& _b)
+{
+	TileRect result;
+	result.m_x0 = bx::max(_a.m_x0, _b.m_x0);
+	result.m_y0 = bx::max(_a.m_y0, _b.m_y0);
+	result.m_x1 = bx::min(_a.m_x1, _b.m_x1);
+	result.m_y1 = bx::min(_a.m_y1, _b.m_y1);
+	return result;
+}
+
+///
+inline TileRect tileRectExpand(const TileRect& _rect, int32_t _border)
+{
+	TileRect result;
+	result.m_x0 = _rect.m_x0 - _border;
+	result.m_y0 = _rect.m_y0 - _border;
+	result.m_x1 = _rect.m_x1 + _border;
+	result.m_y1 = _rect.m_y1 + _border;
+	return result;
+}
+
+///
+inline void tileGridInit(TileGrid& _grid, uint32_t _width, uint32_t _height, uint32_t _tileSize)
+{
+	_grid.m_width     = _width;
+	_grid.m_height    = _height;
+	_grid.m_tileSize  = _tileSize;
+	_grid.m_numTilesX = (_width  + _tileSize - 1) / _tileSize;
+	_grid.m_numTilesY = (_height + _tileSize - 1) / _tileSize;
+}
+
+///
+inline TileRect tileGridFull(const TileGrid& _grid)
+{
+	TileRect result = { 0, 0, int32_t(_grid.m_width), int32_t(_grid.m_height) };
+	return result;
+}
+
+/// Texel rectangle covered by tile (_tileX, _tileY), clipped to the grid.
+inline TileRect tileGridTileRect(const TileGrid& _grid, uint32_t _tileX, uint32_t _tileY)
+{
+	TileRect result;
+	result.m_x0 = int32_t(_tileX * _grid.m_tileSize);
+	result.m_y0 = int32_t(_tileY * _grid.m_tileSize);
+	result.m_x1 = bx::min(result.m_x0 + int32_t(_grid.m_tileSize), int32_t(_grid.m_width) );
+	result.m_y1 = bx::min(result.m_y0 + int32_t(_grid.m_tileSize), int32_t(_grid.m_height) );
+	return result;
+}
+
+/// Range of tiles touched by texel rectangle, as [_outX0, _outX1) x [_outY0, _outY1).
+/// Returns false if rectangle is outside of the grid.
+inline bool tileGridRange(const TileGrid& _grid, const TileRect& _rect, uint32_t& _outX0, uint32_t& _outY0, uint32_t& _outX1, uint32_t& _outY1)
+{
+	const TileRect clipped = tileRectIntersect(_rect, tileGridFull(_grid) );
+	if (tileRectIsEmpty(clipped) )
+	{
+		return false;
+	}
+
+	_outX0 = uint32_t(clipped.m_x0) / _grid.m_tileSize;
+	_outY0 = uint32_t(clipped.m_y0) / _grid.m_tileSize;
+	_outX1 = (uint32_t(clipped.m_x1) + _grid.m_tileSize - 1) / _grid.m_tileSize;
+	_outY1 = (uint32_t(clipped.m_y1) + _grid.m_tileSize - 1) / _grid.m_tileSize;
+	return true;
+}
+
+#endif // TERRAIN_TILES_H_HEADER_GUARD
@@ -0,0 +1,290 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <bx/timer.h>
+#include "terrain_views.h"
+
+uint32_t viewLayoutGetRects(ViewLayout::Enum _layout, float _aspect, float* _outRects)
+{
+	switch (_layout)
+	{
+	case ViewLayout::Overview:
+		{
+			// square map in the top right corner
+			const float height = 0.3f;
+			const float width  = height / _aspect;
+			const float rects[] =
+			{
+				0.0f, 0.0f, 1.0f, 1.0f,
+				1.0f - width - 0.01f, 0.01f, width, height,
+			};
+			bx::memCopy(_outRects, rects, sizeof(rects) );
+			return 2;
+		}
+
+	case ViewLayout::SplitTwo:
+		{
+			const float rects[] =
+			{
+				0.0f, 0.0f, 0.5f, 1.0f,
+				0.5f, 0.0f, 0.5f, 1.0f,
+			};
+			bx::memCopy(_outRects, rects, sizeof(rects) );
+			return 2;
+		}
+
+	case ViewLayout::SplitFour:
+		{
+			const float rects[] =
+			{
+				0.0f, 0.0f, 0.5f, 0.5f,
+				0.5f, 0.0f, 0.5f, 0.5f,
+				0.0f, 0.5f, 0.5f, 0.5f,
+				0.5f, 0.5f, 0.5f, 0.5f,
+			};
+			bx::memCopy(_outRects, rects, sizeof(rects) );
+			return 4;
+		}
+
+	default:
+		break;
+	}
+
+	const float rect[] = { 0.0f, 0.0f, 1.0f, 1.0f };
+	bx::memCopy(_outRects, rect, sizeof(rect) );
+	return 1;
+}
+
+void viewSetup(TerrainView& _view, const float* _rect, const float* _viewMtx, const float* _proj, const bx::Vec3& _position, bool _homogeneousDepth)
+{
+	bx::memCopy(_view.m_rect, _rect, sizeof(_view.m_rect) );
+	_view.m_position = _position;
+	bx::mtxMul(_view.m_viewProj, _viewMtx, _proj);
+	viewComputeFrustumPlanes(_view.m_planes, _view.m_viewProj, _homogeneousDepth);
+
+	// squeezes NDC of the view into its rect of window NDC, y of the window points down
+	float toWindow[16];
+	bx::mtxIdentity(toWindow);
+	toWindow[ 0] = _rect[2];
+	toWindow[ 5] = _rect[3];
+	toWindow[12] = 2.0f * _rect[0] + _rect[2] - 1.0f;
+	toWindow[13] = 1.0f - 2.0f * _rect[1] - _rect[3];
+	bx::mtxMul(_view.m_windowViewProj, _view.m_viewProj, toWindow);
+	bx::mtxInverse(_view.m_invWindowViewProj, _view.m_windowViewProj);
+}
+
+void viewSetupTopDown(
+	  TerrainView& _view
+	, const float* _rect
+	, float _x
+	, float _z
+	, float _size
+	, float _aspect
+	, float _minHeight
+	, float _maxHeight
+	, bool _homogeneousDepth
+	, float* _outView
+	, float* _outProj
+	)
+{
+	const float halfSize = _size * 0.5f;
+	const bx::Vec3 center = { _x + halfSize, _maxHeight, _z + halfSize };
+	const bx::Vec3 eye = { center.x, _maxHeight + 100.0f, center.z };
+	bx::mtxLookAt(_outView, eye, { center.x, _minHeight, center.z }, { 0.0f, 0.0f, 1.0f });
+	bx::mtxOrtho(_outProj, -halfSize * _aspect, halfSize * _aspect, -halfSize, halfSize, 1.0f, _maxHeight - _minHeight + 200.0f, 0.0f, _homogeneousDepth);
+	viewSetup(_view, _rect, _outView, _outProj, center, _homogeneousDepth);
+}
+
+uint32_t viewGetLodPositions(const TerrainView* _views, uint32_t _numViews, bx::Vec3* _outPositions)
+{
+	uint32_t num = 0;
+	for (uint32_t ii = 0; ii < _numViews; ++ii)
+	{
+		if (_views[ii].m_selectsLod)
+		{
+			_outPositions[num++] = _views[ii].m_position;
+		}
+	}
+
+	return num;
+}
+
+uint32_t viewCullPatches(
+	  TerrainView& _view
+	, const QuadTreeNode* const* _nodes
+	, uint32_t _numNodes
+	, float _sectorSize
+	, uint32_t _patchesPerSide
+	, float _minHeight
+	, float _maxHeight
+	)
+{
+	const int64_t start = bx::getHPCounter();
+	const uint32_t patchesPerNode = _patchesPerSide * _patchesPerSide;
+
+	// Height of the box corner farthest along each plane is the same for every patch, and the
+	// test of a patch is linear in its row and column. Every plane leaves a span of columns of
+	// a row, a row costs a multiply per plane instead of a test per patch.
+	float cornerY[4];
+	float nearCornerY[4];
+	for (uint32_t ii = 0; ii < 4; ++ii)
+	{
+		const float* plane = &_view.m_planes[ii * 4];
+		cornerY[ii]     = plane[1] * (plane[1] > 0.0f ? _maxHeight : _minHeight) + plane[3];
+		nearCornerY[ii] = plane[1] * (plane[1] > 0.0f ? _minHeight : _maxHeight) + plane[3];
+	}
+
+	uint32_t numVisible = 0;
+	for (uint32_t nodeIndex = 0; nodeIndex < _numNodes; ++nodeIndex)
+	{
+		const QuadTreeNode& node = *_nodes[nodeIndex];
+		const float nodeSize = _sectorSize * float(1 << node.lod);
+		if (!viewIsBoxInFrustum(_view.m_planes, { node.x, _minHeight, node.z }, { node.x + nodeSize, _maxHeight, node.z + nodeSize }) )
+		{
+			continue;
+		}
+
+		const uint32_t firstPatch = nodeIndex * patchesPerNode;
+
+		// nodes away from the frustum edges are in with all their patches
+		bool inside = true;
+		for (uint32_t ii = 0; ii < 4 && inside; ++ii)
+		{
+			const float* plane = &_view.m_planes[ii * 4];
+			inside = nearCornerY[ii]
+				+ plane[0] * (node.x + (plane[0] > 0.0f ? 0.0f : nodeSize) )
+				+ plane[2] * (node.z + (plane[2] > 0.0f ? 0.0f : nodeSize) )
+				>= 0.0f
+				;
+		}
+
+		if (inside)
+		{
+			for (uint32_t ii = 0; ii < patchesPerNode; ++ii)
+			{
+				_view.m_patches[numVisible++] = firstPatch + ii;
+			}
+
+			continue;
+		}
+
+		const float patchSize = nodeSize / float(_patchesPerSide);
+
+		// offset of column 0 of row 0 and its change per row and column for every plane
+		float offset[4];
+		float rowStep[4];
+		float invStep[4];
+		for (uint32_t ii = 0; ii < 4; ++ii)
+		{
+			const float* plane = &_view.m_planes[ii * 4];
+			offset[ii] = cornerY[ii]
+				+ plane[0] * (node.x + (plane[0] > 0.0f ? patchSize : 0.0f) )
+				+ plane[2] * (node.z + (plane[2] > 0.0f ? patchSize : 0.0f) )
+				;
+			rowStep[ii] = plane[2] * patchSize;
+			invStep[ii] = 0.0f != plane[0] ? 1.0f / (plane[0] * patchSize) : 0.0f;
+		}
+
+		for (uint32_t jj = 0; jj < _patchesPerSide; ++jj)
+		{
+			float first = 0.0f;
+			float last  = float(_patchesPerSide - 1);
+			for (uint32_t ii = 0; ii < 4; ++ii)
+			{
+				// column i is in front of the plane while offset + i * step >= 0
+				const float rowOffset = offset[ii] + float(jj) * rowStep[ii];
+				if (invStep[ii] > 0.0f)
+				{
+					first = bx::max(first, bx::ceil(-rowOffset * invStep[ii]) );
+				}
+				else if (invStep[ii] < 0.0f)
+				{
+					last = bx::min(last, bx::floor(-rowOffset * invStep[ii]) );
+				}
+				else if (rowOffset < 0.0f)
+				{
+					last = -1.0f;
+				}
+			}
+
+			const uint32_t rowPatch = firstPatch + jj * _patchesPerSide;
+			const int32_t begin = int32_t(bx::min(first, float(_patchesPerSide) ) );
+			const int32_t end   = int32_t(bx::max(last, -1.0f) );
+			for (int32_t ii = begin; ii <= end; ++ii)
+			{
+				_view.m_patches[numVisible++] = rowPatch + uint32_t(ii);
+			}
+		}
+	}
+
+	_view.m_numPatches = numVisible;
+	_view.m_cullMs = float(double(bx::getHPCounter() - start) * 1000.0 / double(bx::getHPFrequency() ) );
+	return numVisible;
+}
+
+// Gribb & Hartmann, "Fast Extraction of Viewing Frustum Planes from the World-View-Projection
+// Matrix".
+void viewComputeFrustumPlanes(float* _outPlanes, const float* _viewProj, bool _homogeneousDepth)
+{
+	// bx matrices transform row vectors, clip space component ii is column ii
+	float column[4][4];
+	for (uint32_t ii = 0; ii < 4; ++ii)
+	{
+		for (uint32_t jj = 0; jj < 4; ++jj)
+		{
+			column[ii][jj] = _viewProj[jj * 4 + ii];
+		}
+	}
+
+	for (uint32_t ii = 0; ii < 4; ++ii)
+	{
+		_outPlanes[0 * 4 + ii] = column[3][ii] + column[0][ii]; // left
+		_outPlanes[1 * 4 + ii] = column[3][ii] - column[0][ii]; // right
+		_outPlanes[2 * 4 + ii] = column[3][ii] + column[1][ii]; // bottom
+		_outPlanes[3 * 4 + ii] = column[3][ii] - column[1][ii]; // top
+		_outPlanes[4 * 4 + ii] = _homogeneousDepth ? column[3][ii] + column[2][ii] : column[2][ii]; // near
+		_outPlanes[5 * 4 + ii] = column[3][ii] - column[2][ii]; // far
+	}
+
+	for (uint32_t ii = 0; ii < 6; ++ii)
+	{
+		float* plane = &_outPlanes[ii * 4];
+		const float invLength = 1.0f / bx::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		plane[0] *= invLength;
+		plane[1] *= invLength;
+		plane[2] *= invLength;
+		plane[3] *= invLength;
+	}
+}
+
+bool viewIsBoxInFrustum(const float* _planes, const bx::Vec3& _min, const bx::Vec3& _max)
+{
+	for (uint32_t ii = 0; ii < 4; ++ii)
+	{
+		const float* plane = &_planes[ii * 4];
+		const float x = plane[0] > 0.0f ? _max.x : _min.x;
+		const float y = plane[1] > 0.0f ? _max.y : _min.y;
+		const float z = plane[2] > 0.0f ? _max.z : _min.z;
+		if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0.0f)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+const char* getName(ViewLayout::Enum _layout)
+{
+	static const char* s_names[] =
+	{
+		"Single",
+		"Overview",
+		"Split two",
+		"Split four",
+	};
+	BX_STATIC_ASSERT(BX_COUNTOF(s_names) == ViewLayout::Count);
+
+	return s_names[_layout];
+}
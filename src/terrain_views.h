@@ -0,0 +1,97 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef TERRAIN_VIEWS_H_HEADER_GUARD
+#define TERRAIN_VIEWS_H_HEADER_GUARD
+
+#include <bx/math.h>
+#include "terrain_quadtree.h"
+
+/// How cameras share the window.
+struct ViewLayout
+{
+	enum Enum
+	{
+		Single,    //!< One camera fills the window.
+		Overview,  //!< Camera with a top-down map of the whole terrain in the corner.
+		SplitTwo,  //!< Two players side by side.
+		SplitFour, //!< Four players, a quarter of the window each.
+
+		Count
+	};
+};
+
+/// Camera drawing into its own part of the window and of the G-buffer. Patches are generated
+/// once per frame from a quadtree refined around every view selecting LOD, each view culls
+/// them on its own and draws only what it sees.
+struct TerrainView
+{
+	static constexpr uint32_t kMaxViews = 4;
+
+	float    m_rect[4];               //!< x, y, width, height in fractions of the window, origin top left.
+	float    m_viewProj[16];
+	float    m_windowViewProj[16];    //!< World to window clip space, the view squeezed into m_rect.
+	float    m_invWindowViewProj[16]; //!< Window NDC to world, for resolve and picking.
+	float    m_planes[6 * 4];         //!< Frustum planes, normals pointing inside.
+	bx::Vec3 m_position;
+	bool     m_selectsLod;            //!< Off for views that look at the whole map from afar.
+
+	uint32_t* m_patches;              //!< Indices of visible patches, lives in the frame arena.
+	uint32_t m_numPatches;
+	float    m_cullMs;                //!< CPU time of the last viewCullPatches.
+};
+
+/// Writes rects of views of _layout into _outRects, x, y, width and height each. _aspect is
+/// window width over height. Returns number of views.
+uint32_t viewLayoutGetRects(ViewLayout::Enum _layout, float _aspect, float* _outRects);
+
+/// Sets matrices and frustum of _view drawn into _rect of the window.
+void viewSetup(TerrainView& _view, const float* _rect, const float* _viewMtx, const float* _proj, const bx::Vec3& _position, bool _homogeneousDepth);
+
+/// Sets _view drawn into _rect to look straight down at the _size wide square from _x, _z, x to
+/// the right and z up. Terrain heights are bounded by _minHeight and _maxHeight. _aspect is
+/// width over height of the rect, the square is widened to fill it. Position of the view is
+/// the middle of the square at _maxHeight. Writes view and projection for the bgfx view.
+void viewSetupTopDown(
+	  TerrainView& _view
+	, const float* _rect
+	, float _x
+	, float _z
+	, float _size
+	, float _aspect
+	, float _minHeight
+	, float _maxHeight
+	, bool _homogeneousDepth
+	, float* _outView
+	, float* _outProj
+	);
+
+/// Writes positions of views selecting LOD into _outPositions. Returns number of positions.
+uint32_t viewGetLodPositions(const TerrainView* _views, uint32_t _numViews, bx::Vec3* _outPositions);
+
+/// Writes indices of patches inside the frustum of _view into _view.m_patches. Node _nodes[i]
+/// owns _patchesPerSide^2 patches starting at i * _patchesPerSide^2, row major over the node
+/// of LOD l, 2^l * _sectorSize wide. Nodes are tested before their patches, heights of all of
+/// them are bounded by _minHeight and _maxHeight. Returns number of visible patches.
+uint32_t viewCullPatches(
+	  TerrainView& _view
+	, const QuadTreeNode* const* _nodes
+	, uint32_t _numNodes
+	, float _sectorSize
+	, uint32_t _patchesPerSide
+	, float _minHeight
+	, float _maxHeight
+	);
+
+/// Extracts planes of _viewProj with normals pointing inside, left, right, bottom, top, near
+/// and far, 4 floats each.
+void viewComputeFrustumPlanes(float* _outPlanes, const float* _viewProj, bool _homogeneousDepth);
+
+/// Tests box against side planes only, boxes past near and far still count as in view.
+bool viewIsBoxInFrustum(const float* _planes, const bx::Vec3& _min, const bx::Vec3& _max);
+
+///
+const char* getName(ViewLayout::Enum _layout);
+
+#endif // TERRAIN_VIEWS_H_HEADER_GUARD
@@ -0,0 +1,526 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <math.h>
+#include <bx/bx.h>
+#include <bx/string.h>
+#include "dem_reader.h"
+
+struct TiffTag
+{
+	enum Enum
+	{
+		ImageWidth      = 256,
+		ImageLength     = 257,
+		BitsPerSample   = 258,
+		Compression     = 259,
+		StripOffsets    = 273,
+		SamplesPerPixel = 277,
+		RowsPerStrip    = 278,
+		TileWidth       = 322,
+		SampleFormat    = 339,
+		GdalNoData      = 42113,
+	};
+};
+
+struct TiffType
+{
+	enum Enum
+	{
+		Byte   = 1,
+		Ascii  = 2,
+		Short  = 3,
+		Long   = 4,
+		Long8  = 16,
+	};
+};
+
+static uint16_t swap16(uint16_t _value)
+{
+	return uint16_t(_value >> 8 | _value << 8);
+}
+
+static uint32_t swap32(uint32_t _value)
+{
+	return (_value >> 24)
+		| (_value >>  8 & 0x0000ff00)
+		| (_value <<  8 & 0x00ff0000)
+		| (_value << 24)
+		;
+}
+
+static uint64_t swap64(uint64_t _value)
+{
+	return uint64_t(swap32(uint32_t(_value) ) ) << 32 | swap32(uint32_t(_value >> 32) );
+}
+
+static uint16_t get16(const uint8_t* _ptr, bool _swap)
+{
+	uint16_t value;
+	bx::memCopy(&value, _ptr, sizeof(value) );
+	return _swap ? swap16(value) : value;
+}
+
+static uint32_t get32(const uint8_t* _ptr, bool _swap)
+{
+	uint32_t value;
+	bx::memCopy(&value, _ptr, sizeof(value) );
+	return _swap ? swap32(value) : value;
+}
+
+static uint64_t get64(const uint8_t* _ptr, bool _swap)
+{
+	uint64_t value;
+	bx::memCopy(&value, _ptr, sizeof(value) );
+	return _swap ? swap64(value) : value;
+}
+
+static bool seek(FILE* _file, uint64_t _offset)
+{
+#if BX_PLATFORM_WINDOWS
+	return 0 == _fseeki64(_file, int64_t(_offset), SEEK_SET);
+#else
+	return 0 == fseeko(_file, off_t(_offset), SEEK_SET);
+#endif
+}
+
+static uint64_t getFileSize(FILE* _file)
+{
+#if BX_PLATFORM_WINDOWS
+	_fseeki64(_file, 0, SEEK_END);
+	return uint64_t(_ftelli64(_file) );
+#else
+	fseeko(_file, 0, SEEK_END);
+	return uint64_t(ftello(_file) );
+#endif
+}
+
+static bool readAt(FILE* _file, uint64_t _offset, void* _dst, uint32_t _size)
+{
+	return seek(_file, _offset)
+		&& 1 == fread(_dst, _size, 1, _file)
+		;
+}
+
+static uint32_t getTypeSize(uint16_t _type)
+{
+	switch (_type)
+	{
+	case TiffType::Byte:
+	case TiffType::Ascii: return 1;
+	case TiffType::Short: return 2;
+	case TiffType::Long:  return 4;
+	case TiffType::Long8: return 8;
+	default: break;
+	}
+
+	return 0;
+}
+
+static bool readUint(FILE* _file, uint64_t _offset, uint32_t _size, bool _swap, uint64_t& _outValue)
+{
+	uint8_t data[8];
+	if (0 == _size
+	||  !readAt(_file, _offset, data, _size) )
+	{
+		return false;
+	}
+
+	switch (_size)
+	{
+	case 1:  _outValue = data[0];              break;
+	case 2:  _outValue = get16(data, _swap);   break;
+	case 4:  _outValue = get32(data, _swap);   break;
+	default: _outValue = get64(data, _swap);   break;
+	}
+
+	return true;
+}
+
+static bool openTiff(DemSource& _src)
+{
+	uint8_t header[16];
+	if (!readAt(_src.m_file, 0, header, sizeof(header) ) )
+	{
+		fprintf(stderr, "TIFF header can't be read.\n");
+		return false;
+	}
+
+	const bool bigEndian = 'M' == header[0];
+	_src.m_swap = bigEndian != !!BX_CPU_ENDIAN_BIG;
+
+	// BigTIFF only widens offsets and counts, the tags are the same
+	const bool big = 43 == get16(&header[2], _src.m_swap);
+	const uint32_t offsetSize = big ?  8 :  4;
+	const uint32_t entrySize  = big ? 20 : 12;
+	const uint64_t ifd = big ? get64(&header[8], _src.m_swap) : get32(&header[4], _src.m_swap);
+
+	uint64_t numEntries = 0;
+	if (!readUint(_src.m_file, ifd, big ? 8 : 2, _src.m_swap, numEntries) )
+	{
+		fprintf(stderr, "TIFF directory can't be read.\n");
+		return false;
+	}
+
+	uint64_t bitsPerSample   = 1;
+	uint64_t compression     = 1;
+	uint64_t samplesPerPixel = 1;
+	uint64_t sampleFormat    = 1;
+	uint64_t rowsPerStrip    = UINT32_MAX;
+	uint64_t numStrips       = 0;
+	bool tiled = false;
+
+	for (uint64_t ii = 0; ii < numEntries; ++ii)
+	{
+		const uint64_t entryOffset = ifd + (big ? 8 : 2) + ii * entrySize;
+		uint8_t entry[20];
+		if (!readAt(_src.m_file, entryOffset, entry, entrySize) )
+		{
+			fprintf(stderr, "TIFF directory can't be read.\n");
+			return false;
+		}
+
+		const uint16_t tag   = get16(&entry[0], _src.m_swap);
+		const uint16_t type  = get16(&entry[2], _src.m_swap);
+		const uint64_t count = big ? get64(&entry[4], _src.m_swap) : get32(&entry[4], _src.m_swap);
+		const uint32_t typeSize = getTypeSize(type);
+
+		// values that don't fit the entry are stored elsewhere
+		uint64_t valueOffset = entryOffset + (big ? 12 : 8);
+		if (count * typeSize > offsetSize)
+		{
+			readUint(_src.m_file, valueOffset, offsetSize, _src.m_swap, valueOffset);
+		}
+
+		uint64_t value = 0;
+		switch (tag)
+		{
+		case TiffTag::ImageWidth:
+			readUint(_src.m_file, valueOffset, typeSize, _src.m_swap, value);
+			_src.m_width = uint32_t(value);
+			break;
+
+		case TiffTag::ImageLength:
+			readUint(_src.m_file, valueOffset, typeSize, _src.m_swap, value);
+			_src.m_height = uint32_t(value);
+			break;
+
+		case TiffTag::BitsPerSample:   readUint(_src.m_file, valueOffset, typeSize, _src.m_swap, bitsPerSample);   break;
+		case TiffTag::Compression:     readUint(_src.m_file, valueOffset, typeSize, _src.m_swap, compression);     break;
+		case TiffTag::SamplesPerPixel: readUint(_src.m_file, valueOffset, typeSize, _src.m_swap, samplesPerPixel); break;
+		case TiffTag::RowsPerStrip:    readUint(_src.m_file, valueOffset, typeSize, _src.m_swap, rowsPerStrip);    break;
+		case TiffTag::SampleFormat:    readUint(_src.m_file, valueOffset, typeSize, _src.m_swap, sampleFormat);    break;
+		case TiffTag::TileWidth:       tiled = true; break;
+
+		case TiffTag::StripOffsets:
+			_src.m_stripTable     = valueOffset;
+			_src.m_stripEntrySize = typeSize;
+			numStrips = count;
+			break;
+
+		case TiffTag::GdalNoData:
+			{
+				char text[64] = {};
+				if (TiffType::Ascii == type
+				&&  readAt(_src.m_file, valueOffset, text, uint32_t(bx::min<uint64_t>(count, sizeof(text) - 1) ) ) )
+				{
+					_src.m_hasNoData = bx::fromString(&_src.m_noData, text);
+				}
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	if (tiled
+	||  1 != compression
+	||  1 != samplesPerPixel)
+	{
+		fprintf(stderr, "Only uncompressed, single channel, striped TIFF is supported, convert with\n"
+			"  gdal_translate -co TILED=NO -co COMPRESS=NONE -co BIGTIFF=IF_NEEDED\n"
+			);
+		return false;
+	}
+
+	if (16 == bitsPerSample && 1 == sampleFormat)
+	{
+		_src.m_format = DemFormat::UInt16;
+	}
+	else if (16 == bitsPerSample && 2 == sampleFormat)
+	{
+		_src.m_format = DemFormat::Int16;
+	}
+	else if (32 == bitsPerSample && 3 == sampleFormat)
+	{
+		_src.m_format = DemFormat::Float32;
+	}
+	else
+	{
+		fprintf(stderr, "TIFF samples are %u bit of format %u, only 16 bit integer and 32 bit float are supported.\n"
+			, uint32_t(bitsPerSample)
+			, uint32_t(sampleFormat)
+			);
+		return false;
+	}
+
+	_src.m_rowsPerStrip = uint32_t(bx::min<uint64_t>(rowsPerStrip, _src.m_height) );
+	_src.m_numStrips    = uint32_t(numStrips);
+	if (0 == _src.m_width
+	||  0 == _src.m_height
+	||  0 == _src.m_stripEntrySize
+	||  0 == _src.m_rowsPerStrip
+	||  _src.m_numStrips != (_src.m_height + _src.m_rowsPerStrip - 1) / _src.m_rowsPerStrip)
+	{
+		fprintf(stderr, "TIFF strips don't match the image size.\n");
+		return false;
+	}
+
+	return true;
+}
+
+static bool openRaw(DemSource& _src, const DemRawDesc& _raw)
+{
+	_src.m_format = _raw.m_format;
+	_src.m_swap   = _raw.m_bigEndian != !!BX_CPU_ENDIAN_BIG;
+	_src.m_width  = _raw.m_width;
+	_src.m_height = _raw.m_height;
+
+	const uint64_t size = getFileSize(_src.m_file);
+	const uint32_t sampleSize = demGetSampleSize(_raw.m_format);
+	if (0 == _src.m_width)
+	{
+		const uint64_t numSamples = size / sampleSize;
+		uint64_t side = uint64_t(sqrt(double(numSamples) ) );
+		side -= side * side > numSamples ? 1 : 0;
+		side += (side + 1) * (side + 1) <= numSamples ? 1 : 0;
+
+		if (side * side != numSamples)
+		{
+			fprintf(stderr, "RAW size isn't a square of %s samples, pass --raw-width and --raw-height.\n", demGetName(_raw.m_format) );
+			return false;
+		}
+
+		_src.m_width  = uint32_t(side);
+		_src.m_height = uint32_t(side);
+	}
+
+	if (0 == _src.m_width
+	||  0 == _src.m_height
+	||  uint64_t(_src.m_width) * _src.m_height * sampleSize > size)
+	{
+		fprintf(stderr, "RAW is smaller than %ux%u %s samples.\n", _src.m_width, _src.m_height, demGetName(_raw.m_format) );
+		return false;
+	}
+
+	return true;
+}
+
+bool demOpen(DemSource& _src, const char* _path, const DemRawDesc* _raw)
+{
+	bx::memSet(&_src, 0, sizeof(_src) );
+	_src.m_file = fopen(_path, "rb");
+	if (NULL == _src.m_file)
+	{
+		fprintf(stderr, "Unable to open %s.\n", _path);
+		return false;
+	}
+
+	const bool opened = NULL != _raw
+		? openRaw(_src, *_raw)
+		: openTiff(_src)
+		;
+	if (!opened)
+	{
+		demClose(_src);
+		return false;
+	}
+
+	return true;
+}
+
+void demClose(DemSource& _src)
+{
+	if (NULL != _src.m_file)
+	{
+		fclose(_src.m_file);
+		_src.m_file = NULL;
+	}
+}
+
+bool demIsTiff(const char* _path)
+{
+	FILE* file = fopen(_path, "rb");
+	if (NULL == file)
+	{
+		return false;
+	}
+
+	uint8_t magic[4] = {};
+	const bool read = 1 == fread(magic, sizeof(magic), 1, file);
+	fclose(file);
+
+	return read
+		&& ( (0 == bx::memCmp(magic, "II", 2) && (42 == magic[2] || 43 == magic[2]) && 0 == magic[3])
+		||   (0 == bx::memCmp(magic, "MM", 2) && 0 == magic[2] && (42 == magic[3] || 43 == magic[3]) ) )
+		;
+}
+
+uint32_t demGetSampleSize(DemFormat::Enum _format)
+{
+	static const uint32_t s_sizes[] =
+	{
+		2,
+		2,
+		4,
+	};
+	BX_STATIC_ASSERT(BX_COUNTOF(s_sizes) == DemFormat::Count);
+	return s_sizes[_format];
+}
+
+const char* demGetName(DemFormat::Enum _format)
+{
+	static const char* s_names[] =
+	{
+		"u16",
+		"s16",
+		"f32",
+	};
+	BX_STATIC_ASSERT(BX_COUNTOF(s_names) == DemFormat::Count);
+	return s_names[_format];
+}
+
+static bool getStripOffset(DemSource& _src, uint32_t _strip, uint64_t& _outOffset)
+{
+	if (_strip <  _src.m_stripCacheFirst
+	||  _strip >= _src.m_stripCacheFirst + _src.m_stripCacheNum)
+	{
+		uint8_t entries[DemSource::kStripCacheSize * 8];
+		const uint32_t num = bx::min(DemSource::kStripCacheSize, _src.m_numStrips - _strip);
+		if (!readAt(_src.m_file, _src.m_stripTable + uint64_t(_strip) * _src.m_stripEntrySize, entries, num * _src.m_stripEntrySize) )
+		{
+			return false;
+		}
+
+		for (uint32_t ii = 0; ii < num; ++ii)
+		{
+			const uint8_t* entry = &entries[ii * _src.m_stripEntrySize];
+			_src.m_stripCache[ii] = 2 == _src.m_stripEntrySize ? get16(entry, _src.m_swap)
+				: 4 == _src.m_stripEntrySize ? get32(entry, _src.m_swap)
+				: get64(entry, _src.m_swap)
+				;
+		}
+
+		_src.m_stripCacheFirst = _strip;
+		_src.m_stripCacheNum   = num;
+	}
+
+	_outOffset = _src.m_stripCache[_strip - _src.m_stripCacheFirst];
+	return true;
+}
+
+bool demReadRows(DemSource& _src, uint32_t _y0, uint32_t _numRows, uint32_t _x0, uint32_t _numCols, void* _dst)
+{
+	const uint64_t sampleSize = demGetSampleSize(_src.m_format);
+	const uint64_t rowSize = _numCols * sampleSize;
+	uint8_t* dst = (uint8_t*)_dst;
+
+	uint64_t runOffset = 0;
+	uint64_t runSize   = 0;
+	for (uint32_t yy = _y0; yy < _y0 + _numRows; ++yy)
+	{
+		uint64_t offset = _src.m_dataOffset + uint64_t(yy) * _src.m_width * sampleSize;
+		if (0 != _src.m_stripTable)
+		{
+			if (!getStripOffset(_src, yy / _src.m_rowsPerStrip, offset) )
+			{
+				return false;
+			}
+			offset += uint64_t(yy % _src.m_rowsPerStrip) * _src.m_width * sampleSize;
+		}
+		offset += _x0 * sampleSize;
+
+		if (0 != runSize
+		&&  runOffset + runSize != offset)
+		{
+			if (!readAt(_src.m_file, runOffset, dst, uint32_t(runSize) ) )
+			{
+				return false;
+			}
+			dst += runSize;
+			runSize = 0;
+		}
+
+		runOffset = 0 == runSize ? offset : runOffset;
+		runSize  += rowSize;
+	}
+
+	return 0 == runSize
+		|| readAt(_src.m_file, runOffset, dst, uint32_t(runSize) )
+		;
+}
+
+static double getElevation(const DemSource& _src, const void* _samples, uint32_t _index)
+{
+	switch (_src.m_format)
+	{
+	case DemFormat::UInt16:
+		return get16( (const uint8_t*)_samples + _index * 2, _src.m_swap);
+
+	case DemFormat::Int16:
+		return int16_t(get16( (const uint8_t*)_samples + _index * 2, _src.m_swap) );
+
+	default:
+		{
+			const uint32_t bits = get32( (const uint8_t*)_samples + _index * 4, _src.m_swap);
+			float value;
+			bx::memCopy(&value, &bits, sizeof(value) );
+			return value;
+		}
+	}
+}
+
+static bool isNoData(const DemSource& _src, double _elevation)
+{
+	return _elevation != _elevation
+		|| (_src.m_hasNoData && _elevation == _src.m_noData)
+		;
+}
+
+void demGetRange(const DemSource& _src, const void* _samples, uint32_t _num, double& _min, double& _max)
+{
+	for (uint32_t ii = 0; ii < _num; ++ii)
+	{
+		const double elevation = getElevation(_src, _samples, ii);
+		if (!isNoData(_src, elevation) )
+		{
+			_min = bx::min(_min, elevation);
+			_max = bx::max(_max, elevation);
+		}
+	}
+}
+
+void demToHeights(const DemSource& _src, const void* _samples, uint32_t _num, double _min, double _scale, uint16_t* _dst)
+{
+	// 16 bit source kept as is, only byte order may need fixing
+	if (DemFormat::UInt16 == _src.m_format
+	&&  !_src.m_hasNoData
+	&&  0.0 == _min
+	&&  1.0 == _scale)
+	{
+		for (uint32_t ii = 0; ii < _num; ++ii)
+		{
+			_dst[ii] = get16( (const uint8_t*)_samples + ii * 2, _src.m_swap);
+		}
+		return;
+	}
+
+	for (uint32_t ii = 0; ii < _num; ++ii)
+	{
+		const double elevation = getElevation(_src, _samples, ii);
+		const double height = (elevation - _min) * _scale + 0.5;
+		_dst[ii] = isNoData(_src, elevation) ? 0 : uint16_t(bx::clamp(height, 0.0, 65535.0) );
+	}
+}
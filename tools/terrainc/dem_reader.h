@@ -0,0 +1,86 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#ifndef DEM_READER_H_HEADER_GUARD
+#define DEM_READER_H_HEADER_GUARD
+
+#include <stdint.h>
+#include <stdio.h>
+
+/// Sample type of a DEM.
+struct DemFormat
+{
+	enum Enum
+	{
+		UInt16,
+		Int16,
+		Float32,
+
+		Count
+	};
+};
+
+/// Layout of a headerless RAW DEM.
+struct DemRawDesc
+{
+	uint32_t m_width;   //!< 0 for a square DEM sized from the file.
+	uint32_t m_height;
+	DemFormat::Enum m_format;
+	bool     m_bigEndian;
+};
+
+/// Single channel, uncompressed DEM read by rows, either RAW or a striped GeoTIFF/BigTIFF.
+/// Strip offsets are looked up in the file as rows are read, a few at a time, so nothing
+/// held in memory grows with the size of the DEM.
+struct DemSource
+{
+	static constexpr uint32_t kStripCacheSize = 64;
+
+	FILE*    m_file;
+	uint32_t m_width;
+	uint32_t m_height;
+	DemFormat::Enum m_format;
+	bool     m_swap;              //!< Byte order differs from the CPU.
+	bool     m_hasNoData;
+	double   m_noData;
+
+	uint64_t m_dataOffset;        //!< RAW: file offset of the first row.
+	uint64_t m_stripTable;        //!< TIFF: file offset of strip offsets, 0 for RAW.
+	uint32_t m_stripEntrySize;
+	uint32_t m_rowsPerStrip;
+	uint32_t m_numStrips;
+
+	uint64_t m_stripCache[kStripCacheSize];
+	uint32_t m_stripCacheFirst;
+	uint32_t m_stripCacheNum;
+};
+
+/// Opens GeoTIFF at _path, or RAW if _raw isn't NULL. Prints the reason and returns false if
+/// the file can't be read.
+bool demOpen(DemSource& _src, const char* _path, const DemRawDesc* _raw);
+
+///
+void demClose(DemSource& _src);
+
+/// Returns true if file at _path starts like a TIFF or BigTIFF.
+bool demIsTiff(const char* _path);
+
+///
+uint32_t demGetSampleSize(DemFormat::Enum _format);
+
+///
+const char* demGetName(DemFormat::Enum _format);
+
+/// Reads _numCols samples starting at column _x0 of _numRows rows starting at _y0 into _dst,
+/// rows packed back to back in file byte order. Rows adjacent in the file are read at once.
+bool demReadRows(DemSource& _src, uint32_t _y0, uint32_t _numRows, uint32_t _x0, uint32_t _numCols, void* _dst);
+
+/// Widens _min, _max to elevations of _num samples read by demReadRows, skipping no data.
+void demGetRange(const DemSource& _src, const void* _samples, uint32_t _num, double& _min, double& _max);
+
+/// Converts _num samples read by demReadRows to heights, (elevation - _min) * _scale rounded
+/// and clamped to R16. No data becomes 0.
+void demToHeights(const DemSource& _src, const void* _samples, uint32_t _num, double _min, double _scale, uint16_t* _dst);
+
+#endif // DEM_READER_H_HEADER_GUARD
@@ -0,0 +1,738 @@
+/*
+ * License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+ */
+
+#include <float.h>
+#include <stdio.h>
+#include <bx/allocator.h>
+#include <bx/commandline.h>
+#include <bx/cpu.h>
+#include <bx/mutex.h>
+#include <bx/semaphore.h>
+#include <bx/string.h>
+#include <bx/thread.h>
+#include <bx/timer.h>
+#include "dem_reader.h"
+#include "height_codec.h"
+#include "terrain_file.h"
+#include "terrain_pyramid.h"
+#include "terrain_tiles.h"
+
+// terrainc converts a DEM of any size to the height tile pyramid streamed by the terrain
+// renderer. The source is read top to bottom in bands of one tile row, split into stripes of
+// columns when it is wider than --stripe, so the band buffers have a fixed size. Tiles of
+// LOD 0 are cut from the bands and each coarser LOD is built from tiles of the previous one
+// read back from the output, so memory use doesn't depend on the size of the DEM.
+//
+// Reading runs on the main thread while worker threads convert, downsample, compress and
+// write tiles. A few bands are in flight so reading overlaps with encoding.
+
+namespace
+{
+	struct Band
+	{
+		uint8_t* m_samples;
+		uint32_t m_x0;
+		uint32_t m_y0;
+		uint32_t m_width;
+		uint32_t m_height;
+		int32_t  m_numPending;  //!< Tiles not yet cut from the band.
+		Band*    m_next;
+	};
+
+	/// Tile of LOD 0 is cut from m_band, tiles of other LODs are built from their children.
+	struct Work
+	{
+		Band*    m_band;
+		uint32_t m_lod;
+		uint32_t m_x;
+		uint32_t m_z;
+	};
+
+	struct Importer
+	{
+		static constexpr uint32_t kMaxThreads = 32;
+		static constexpr uint32_t kNumBands   = 4;
+		static constexpr uint32_t kQueueSize  = 256;
+		static constexpr uint32_t kExit       = UINT32_MAX;
+
+		DemSource* m_src;
+		const char* m_outDir;
+		uint32_t m_tileSize;
+		uint32_t m_numLods;
+		double   m_min;
+		double   m_scale;
+
+		bx::Thread m_threads[kMaxThreads];
+		uint32_t m_numThreads;
+
+		bx::Mutex m_mutex;
+		bx::Semaphore m_queued;     //!< Work in the queue.
+		bx::Semaphore m_free;       //!< Free entries in the queue.
+		bx::Semaphore m_done;       //!< Finished work.
+		bx::Semaphore m_freeBands;
+		Work     m_queue[kQueueSize];
+		uint32_t m_read;
+		uint32_t m_write;
+
+		Band  m_bands[kNumBands];
+		Band* m_freeBand;
+
+		int32_t  m_failed;
+		uint64_t m_bytesWritten;
+		uint32_t m_tilesWritten;
+		uint64_t m_memory;
+	};
+
+	static bx::DefaultAllocator s_allocator;
+}
+
+static double toSeconds(int64_t _ticks)
+{
+	return double(_ticks) / double(bx::getHPFrequency() );
+}
+
+static TileGrid getLodGrid(const Importer& _importer, uint32_t _lod)
+{
+	TileGrid grid;
+	tileGridInit(grid
+		, pyramidGetLodSize(_importer.m_src->m_width,  _lod)
+		, pyramidGetLodSize(_importer.m_src->m_height, _lod)
+		, _importer.m_tileSize
+		);
+	return grid;
+}
+
+static void pushWork(Importer& _importer, const Work& _work)
+{
+	_importer.m_free.wait();
+	{
+		bx::MutexScope lock(_importer.m_mutex);
+		_importer.m_queue[_importer.m_write % Importer::kQueueSize] = _work;
+		++_importer.m_write;
+	}
+	_importer.m_queued.post();
+}
+
+static Work popWork(Importer& _importer)
+{
+	_importer.m_queued.wait();
+	Work work;
+	{
+		bx::MutexScope lock(_importer.m_mutex);
+		work = _importer.m_queue[_importer.m_read % Importer::kQueueSize];
+		++_importer.m_read;
+	}
+	_importer.m_free.post();
+	return work;
+}
+
+static void releaseBand(Importer& _importer, Band* _band)
+{
+	{
+		bx::MutexScope lock(_importer.m_mutex);
+		_band->m_next = _importer.m_freeBand;
+		_importer.m_freeBand = _band;
+	}
+	_importer.m_freeBands.post();
+}
+
+static Band* acquireBand(Importer& _importer)
+{
+	_importer.m_freeBands.wait();
+	bx::MutexScope lock(_importer.m_mutex);
+	Band* band = _importer.m_freeBand;
+	_importer.m_freeBand = band->m_next;
+	return band;
+}
+
+static bool writeTile(Importer& _importer, uint32_t _lod, uint32_t _x, uint32_t _z, const void* _data, uint32_t _size)
+{
+	char path[512];
+	pyramidGetTilePath(_importer.m_outDir, _lod, _x, _z, path, BX_COUNTOF(path) );
+
+	FILE* file = fopen(path, "wb");
+	if (NULL == file)
+	{
+		return false;
+	}
+
+	const bool written = 1 == fwrite(_data, _size, 1, file);
+	return 0 == fclose(file) && written;
+}
+
+static bool readTile(Importer& _importer, uint32_t _lod, uint32_t _x, uint32_t _z, uint32_t _width, uint32_t _height, uint16_t* _dst, uint32_t _dstPitch)
+{
+	char path[512];
+	pyramidGetTilePath(_importer.m_outDir, _lod, _x, _z, path, BX_COUNTOF(path) );
+
+	FileMapping mapping;
+	if (!fileMap(mapping, path) )
+	{
+		return false;
+	}
+
+	const bool read = heightTileDecompress(_dst, _width, _height, _dstPitch, mapping.m_data, mapping.m_size);
+	fileUnmap(mapping);
+	return read;
+}
+
+/// Cuts tile from its band and converts it to heights.
+static void cutTile(Importer& _importer, const Work& _work, const TileRect& _rect, uint16_t* _tile)
+{
+	const Band& band = *_work.m_band;
+	const uint32_t sampleSize = demGetSampleSize(_importer.m_src->m_format);
+	for (int32_t yy = _rect.m_y0; yy < _rect.m_y1; ++yy)
+	{
+		const uint8_t* samples = &band.m_samples[ ( (yy - band.m_y0) * band.m_width + (_rect.m_x0 - band.m_x0) ) * sampleSize];
+		demToHeights(*_importer.m_src, samples, uint32_t(_rect.m_x1 - _rect.m_x0), _importer.m_min, _importer.m_scale, &_tile[(yy - _rect.m_y0) * _importer.m_tileSize]);
+	}
+}
+
+/// Builds tile from up to 2x2 tiles of the previous LOD with a box filter. Odd sized levels
+/// repeat their last row and column.
+static bool downsampleTile(Importer& _importer, const Work& _work, const TileRect& _rect, uint16_t* _tile, uint16_t* _children)
+{
+	const TileGrid prevGrid = getLodGrid(_importer, _work.m_lod - 1);
+	const uint32_t tileSize = _importer.m_tileSize;
+	const uint32_t pitch = tileSize * 2;
+
+	for (uint32_t ii = 0; ii < 4; ++ii)
+	{
+		const uint32_t xx = _work.m_x * 2 + (ii & 1);
+		const uint32_t zz = _work.m_z * 2 + (ii >> 1);
+		if (xx < prevGrid.m_numTilesX
+		&&  zz < prevGrid.m_numTilesY)
+		{
+			const TileRect child = tileGridTileRect(prevGrid, xx, zz);
+			if (!readTile(_importer, _work.m_lod - 1, xx, zz
+				, uint32_t(child.m_x1 - child.m_x0)
+				, uint32_t(child.m_y1 - child.m_y0)
+				, &_children[(ii & 1) * tileSize + (ii >> 1) * tileSize * pitch]
+				, pitch
+				) )
+			{
+				return false;
+			}
+		}
+	}
+
+	const int32_t lastX = bx::min(int32_t(prevGrid.m_width),  _rect.m_x1 * 2) - _rect.m_x0 * 2 - 1;
+	const int32_t lastY = bx::min(int32_t(prevGrid.m_height), _rect.m_y1 * 2) - _rect.m_y0 * 2 - 1;
+	for (int32_t yy = 0; yy < _rect.m_y1 - _rect.m_y0; ++yy)
+	{
+		const uint16_t* row0 = &_children[bx::min(yy * 2,     lastY) * pitch];
+		const uint16_t* row1 = &_children[bx::min(yy * 2 + 1, lastY) * pitch];
+		uint16_t* dst = &_tile[yy * tileSize];
+		for (int32_t xx = 0; xx < _rect.m_x1 - _rect.m_x0; ++xx)
+		{
+			const int32_t x0 = bx::min(xx * 2,     lastX);
+			const int32_t x1 = bx::min(xx * 2 + 1, lastX);
+			dst[xx] = uint16_t( (uint32_t(row0[x0]) + row0[x1] + row1[x0] + row1[x1] + 2) >> 2);
+		}
+	}
+
+	return true;
+}
+
+static int32_t workerThreadFunc(bx::Thread* /*_self*/, void* _userData)
+{
+	Importer& importer = *(Importer*)_userData;
+	const uint32_t tileSize = importer.m_tileSize;
+	const uint32_t bound = heightTileCompressBound(tileSize, tileSize);
+
+	uint16_t* tile     = (uint16_t*)BX_ALLOC(&s_allocator, tileSize * tileSize * sizeof(uint16_t) );
+	uint16_t* children = (uint16_t*)BX_ALLOC(&s_allocator, tileSize * tileSize * 4 * sizeof(uint16_t) );
+	uint8_t* compressed = (uint8_t*)BX_ALLOC(&s_allocator, bound);
+
+	for (;;)
+	{
+		const Work work = popWork(importer);
+		if (Importer::kExit == work.m_lod)
+		{
+			break;
+		}
+
+		const TileRect rect = tileGridTileRect(getLodGrid(importer, work.m_lod), work.m_x, work.m_z);
+		bool ok = true;
+		if (0 == work.m_lod)
+		{
+			cutTile(importer, work, rect, tile);
+			if (0 == bx::atomicSubAndFetch(&work.m_band->m_numPending, 1) )
+			{
+				releaseBand(importer, work.m_band);
+			}
+		}
+		else
+		{
+			ok = downsampleTile(importer, work, rect, tile, children);
+		}
+
+		if (ok)
+		{
+			const uint32_t size = heightTileCompress(compressed, bound, tile
+				, uint32_t(rect.m_x1 - rect.m_x0)
+				, uint32_t(rect.m_y1 - rect.m_y0)
+				, tileSize
+				, 0
+				);
+			ok = 0 != size && writeTile(importer, work.m_lod, work.m_x, work.m_z, compressed, size);
+			bx::atomicFetchAndAdd(&importer.m_bytesWritten, uint64_t(size) );
+		}
+
+		if (ok)
+		{
+			bx::atomicFetchAndAdd(&importer.m_tilesWritten, 1u);
+		}
+		else
+		{
+			bx::atomicCompareAndSwap(&importer.m_failed, 0, 1);
+		}
+
+		importer.m_done.post();
+	}
+
+	BX_FREE(&s_allocator, compressed);
+	BX_FREE(&s_allocator, children);
+	BX_FREE(&s_allocator, tile);
+	return 0;
+}
+
+static void waitDone(Importer& _importer, uint64_t _numWork)
+{
+	for (uint64_t ii = 0; ii < _numWork; ++ii)
+	{
+		_importer.m_done.wait();
+	}
+}
+
+/// Splits the DEM into stripes at most _stripe texels wide, whole tiles each.
+static uint32_t getNumStripes(const Importer& _importer, uint32_t _stripe)
+{
+	return (_importer.m_src->m_width + _stripe - 1) / _stripe;
+}
+
+/// Scans the whole DEM once for its elevation range, through the first band.
+static bool scanRange(Importer& _importer, uint32_t _stripe, double& _outMin, double& _outMax)
+{
+	DemSource& src = *_importer.m_src;
+	Band& band = _importer.m_bands[0];
+	_outMin =  DBL_MAX;
+	_outMax = -DBL_MAX;
+
+	for (uint32_t stripe = 0; stripe < getNumStripes(_importer, _stripe); ++stripe)
+	{
+		const uint32_t x0 = stripe * _stripe;
+		const uint32_t width = bx::min(_stripe, src.m_width - x0);
+		for (uint32_t y0 = 0; y0 < src.m_height; y0 += _importer.m_tileSize)
+		{
+			const uint32_t height = bx::min(_importer.m_tileSize, src.m_height - y0);
+			if (!demReadRows(src, y0, height, x0, width, band.m_samples) )
+			{
+				return false;
+			}
+			demGetRange(src, band.m_samples, width * height, _outMin, _outMax);
+		}
+	}
+
+	return _outMin <= _outMax;
+}
+
+/// Reads the DEM band by band and queues LOD 0 tiles of every band.
+static bool importLod0(Importer& _importer, uint32_t _stripe, double& _outReadSeconds)
+{
+	DemSource& src = *_importer.m_src;
+	const TileGrid grid = getLodGrid(_importer, 0);
+	uint64_t numWork = 0;
+	int64_t readTicks = 0;
+	uint32_t lastPercent = UINT32_MAX;
+	bool read = true;
+
+	for (uint32_t stripe = 0; stripe < getNumStripes(_importer, _stripe) && read; ++stripe)
+	{
+		const uint32_t x0 = stripe * _stripe;
+		const uint32_t width = bx::min(_stripe, src.m_width - x0);
+		const uint32_t tileX0 = x0 / _importer.m_tileSize;
+		const uint32_t tileX1 = (x0 + width + _importer.m_tileSize - 1) / _importer.m_tileSize;
+
+		for (uint32_t tileZ = 0; tileZ < grid.m_numTilesY && read; ++tileZ)
+		{
+			Band* band = acquireBand(_importer);
+			band->m_x0 = x0;
+			band->m_y0 = tileZ * _importer.m_tileSize;
+			band->m_width  = width;
+			band->m_height = bx::min(_importer.m_tileSize, src.m_height - band->m_y0);
+			band->m_numPending = int32_t(tileX1 - tileX0);
+
+			const int64_t start = bx::getHPCounter();
+			read = demReadRows(src, band->m_y0, band->m_height, band->m_x0, band->m_width, band->m_samples);
+			readTicks += bx::getHPCounter() - start;
+			if (!read)
+			{
+				releaseBand(_importer, band);
+				break;
+			}
+
+			for (uint32_t tileX = tileX0; tileX < tileX1; ++tileX)
+			{
+				Work work = { band, 0, tileX, tileZ };
+				pushWork(_importer, work);
+				++numWork;
+			}
+
+			const uint32_t percent = uint32_t( (stripe * grid.m_numTilesY + tileZ + 1) * 100 / (getNumStripes(_importer, _stripe) * grid.m_numTilesY) );
+			if (percent != lastPercent)
+			{
+				printf("\rLOD 0: %3u%%", percent);
+				fflush(stdout);
+				lastPercent = percent;
+			}
+		}
+	}
+
+	waitDone(_importer, numWork);
+	_outReadSeconds = toSeconds(readTicks);
+	printf("\n");
+	return read;
+}
+
+/// Builds every coarser LOD from the previous one, one LOD at a time.
+static void importLods(Importer& _importer)
+{
+	for (uint32_t lod = 1; lod < _importer.m_numLods && 0 == _importer.m_failed; ++lod)
+	{
+		const TileGrid grid = getLodGrid(_importer, lod);
+		for (uint32_t zz = 0; zz < grid.m_numTilesY; ++zz)
+		{
+			for (uint32_t xx = 0; xx < grid.m_numTilesX; ++xx)
+			{
+				Work work = { NULL, lod, xx, zz };
+				pushWork(_importer, work);
+			}
+		}
+
+		waitDone(_importer, uint64_t(grid.m_numTilesX) * grid.m_numTilesY);
+		printf("LOD %u: %ux%u tiles\n", lod, grid.m_numTilesX, grid.m_numTilesY);
+	}
+}
+
+static bool writeManifest(const Importer& _importer, double _min, double _max)
+{
+	PyramidHeader header;
+	header.m_magic        = PyramidHeader::kMagic;
+	header.m_version      = PyramidHeader::kVersion;
+	header.m_width        = _importer.m_src->m_width;
+	header.m_height       = _importer.m_src->m_height;
+	header.m_tileSize     = _importer.m_tileSize;
+	header.m_numLods      = _importer.m_numLods;
+	header.m_minElevation = float(_min);
+	header.m_maxElevation = float(_max);
+
+	char path[512];
+	char tempPath[512];
+	pyramidGetManifestPath(_importer.m_outDir, path, BX_COUNTOF(path) );
+	bx::snprintf(tempPath, BX_COUNTOF(tempPath), "%s.tmp", path);
+
+	FILE* file = fopen(tempPath, "wb");
+	if (NULL == file)
+	{
+		return false;
+	}
+
+	const bool written = 1 == fwrite(&header, sizeof(header), 1, file)
+		&& fileSync(file)
+		;
+	return 0 == fclose(file)
+		&& written
+		&& fileReplace(tempPath, path)
+		;
+}
+
+static bool parseUint(const bx::CommandLine& _cmdLine, const char* _option, uint32_t& _value)
+{
+	const char* text = _cmdLine.findOption(_option, NULL);
+	if (NULL != text
+	&&  !bx::fromString(&_value, text) )
+	{
+		fprintf(stderr, "--%s expects a number, got %s.\n", _option, text);
+		return false;
+	}
+
+	return true;
+}
+
+static bool parseDouble(const bx::CommandLine& _cmdLine, const char* _option, double& _value, bool& _outFound)
+{
+	const char* text = _cmdLine.findOption(_option, NULL);
+	_outFound = NULL != text;
+	if (_outFound
+	&&  !bx::fromString(&_value, text) )
+	{
+		fprintf(stderr, "--%s expects a number, got %s.\n", _option, text);
+		return false;
+	}
+
+	return true;
+}
+
+static void help(const char* _error = NULL)
+{
+	if (NULL != _error)
+	{
+		fprintf(stderr, "Error: %s\n\n", _error);
+	}
+
+	fprintf(stderr
+		, "terrainc, height tile pyramid importer\n"
+		  "\n"
+		  "Usage: terrainc -i <in> -o <dir> [options]\n"
+		  "\n"
+		  "Input is an uncompressed, striped GeoTIFF/BigTIFF or a headerless RAW DEM.\n"
+		  "\n"
+		  "Options:\n"
+		  "  -i <file>               Input DEM.\n"
+		  "  -o <dir>                Output directory, created if missing.\n"
+		  "  --raw-width <n>         RAW width, square RAW is sized from the file.\n"
+		  "  --raw-height <n>        RAW height.\n"
+		  "  --raw-format <format>   RAW samples, u16 (default), s16 or f32.\n"
+		  "  --raw-big-endian        RAW byte order is big endian.\n"
+		  "  --min <elevation>       Elevation stored as height 0.\n"
+		  "  --max <elevation>       Elevation stored as height 65535. Without --min and --max\n"
+		  "                          u16 is kept as is and other formats are scanned for their\n"
+		  "                          range first.\n"
+		  "  --nodata <elevation>    Elevation of missing samples, stored as 0.\n"
+		  "  --tile-size <n>         Tile size in texels (default 256).\n"
+		  "  --stripe <n>            Widest column stripe read at once, in texels (default 8192).\n"
+		  "  --threads <n>           Worker threads (default 4).\n"
+		);
+}
+
+int main(int _argc, const char* _argv[])
+{
+	bx::CommandLine cmdLine(_argc, _argv);
+	if (cmdLine.hasArg('h', "help") )
+	{
+		help();
+		return 0;
+	}
+
+	const char* input  = cmdLine.findOption('i');
+	const char* output = cmdLine.findOption('o');
+	if (NULL == input
+	||  NULL == output)
+	{
+		help("Input and output must be specified.");
+		return 1;
+	}
+
+	DemRawDesc raw;
+	raw.m_width     = 0;
+	raw.m_height    = 0;
+	raw.m_format    = DemFormat::UInt16;
+	raw.m_bigEndian = cmdLine.hasArg("raw-big-endian");
+
+	uint32_t tileSize = 256;
+	uint32_t stripe = 8192;
+	uint32_t numThreads = 4;
+	double minElevation = 0.0;
+	double maxElevation = 65535.0;
+	double noData = 0.0;
+	bool hasMin, hasMax, hasNoData;
+	if (!parseUint(cmdLine, "raw-width", raw.m_width)
+	||  !parseUint(cmdLine, "raw-height", raw.m_height)
+	||  !parseUint(cmdLine, "tile-size", tileSize)
+	||  !parseUint(cmdLine, "stripe", stripe)
+	||  !parseUint(cmdLine, "threads", numThreads)
+	||  !parseDouble(cmdLine, "min", minElevation, hasMin)
+	||  !parseDouble(cmdLine, "max", maxElevation, hasMax)
+	||  !parseDouble(cmdLine, "nodata", noData, hasNoData) )
+	{
+		return 1;
+	}
+
+	const char* format = cmdLine.findOption("raw-format", NULL);
+	if (NULL != format)
+	{
+		uint32_t ii = 0;
+		for (; ii < DemFormat::Count && 0 != bx::strCmp(format, demGetName(DemFormat::Enum(ii) ) ); ++ii)
+		{
+		}
+
+		if (DemFormat::Count == ii)
+		{
+			help("--raw-format must be u16, s16 or f32.");
+			return 1;
+		}
+		raw.m_format = DemFormat::Enum(ii);
+	}
+
+	if (hasMin != hasMax)
+	{
+		help("--min and --max must be specified together.");
+		return 1;
+	}
+
+	if (tileSize < 16
+	||  tileSize > 4096
+	||  !bx::isPowerOf2(tileSize) )
+	{
+		help("--tile-size must be a power of two between 16 and 4096.");
+		return 1;
+	}
+
+	const bool isRaw = NULL != format
+		|| 0 != raw.m_width
+		|| raw.m_bigEndian
+		|| !demIsTiff(input)
+		;
+
+	DemSource src;
+	if (!demOpen(src, input, isRaw ? &raw : NULL) )
+	{
+		return 1;
+	}
+
+	if (hasNoData)
+	{
+		src.m_hasNoData = true;
+		src.m_noData = noData;
+	}
+
+	Importer* importer = BX_NEW(&s_allocator, Importer);
+	importer->m_src      = &src;
+	importer->m_outDir   = output;
+	importer->m_tileSize = tileSize;
+	importer->m_numLods  = 1;
+	importer->m_read     = 0;
+	importer->m_write    = 0;
+	importer->m_failed   = 0;
+	importer->m_bytesWritten = 0;
+	importer->m_tilesWritten = 0;
+	importer->m_freeBand = NULL;
+	while (pyramidGetLodSize(src.m_width,  importer->m_numLods - 1) > tileSize
+	||     pyramidGetLodSize(src.m_height, importer->m_numLods - 1) > tileSize)
+	{
+		++importer->m_numLods;
+	}
+
+	printf("%s: %ux%u %s, %u LODs of %u texel tiles.\n", input, src.m_width, src.m_height, demGetName(src.m_format), importer->m_numLods, tileSize);
+
+	// the importer's whole working set, allocated up front
+	stripe = bx::min(stripe, src.m_width + tileSize - 1);
+	stripe = bx::max(stripe / tileSize, 1u) * tileSize;
+	const uint32_t bandSize = stripe * tileSize * demGetSampleSize(src.m_format);
+	for (uint32_t ii = 0; ii < Importer::kNumBands; ++ii)
+	{
+		Band& band = importer->m_bands[ii];
+		band.m_samples = (uint8_t*)BX_ALLOC(&s_allocator, bandSize);
+		releaseBand(*importer, &band);
+	}
+
+	numThreads = bx::clamp<uint32_t>(numThreads, 1, Importer::kMaxThreads);
+	importer->m_numThreads = numThreads;
+	importer->m_memory = uint64_t(bandSize) * Importer::kNumBands
+		+ uint64_t(numThreads) * (tileSize * tileSize * 5 * sizeof(uint16_t) + heightTileCompressBound(tileSize, tileSize) )
+		;
+	importer->m_free.post(Importer::kQueueSize);
+
+	const int64_t start = bx::getHPCounter();
+	bool ok = true;
+	if (!hasMin
+	&&  DemFormat::UInt16 != src.m_format)
+	{
+		ok = scanRange(*importer, stripe, minElevation, maxElevation);
+		if (ok)
+		{
+			printf("Elevation range %g .. %g.\n", minElevation, maxElevation);
+		}
+		else
+		{
+			fprintf(stderr, "DEM can't be read or has no valid samples.\n");
+		}
+	}
+
+	importer->m_min   = minElevation;
+	importer->m_scale = maxElevation > minElevation ? 65535.0 / (maxElevation - minElevation) : 0.0;
+
+	char path[512];
+	ok = ok && fileMakeDir(output);
+	for (uint32_t lod = 0; lod < importer->m_numLods && ok; ++lod)
+	{
+		pyramidGetLodPath(output, lod, path, BX_COUNTOF(path) );
+		ok = fileMakeDir(path);
+	}
+
+	if (ok)
+	{
+		// manifest of a previous import would describe a mix of old and new tiles
+		pyramidGetManifestPath(output, path, BX_COUNTOF(path) );
+		remove(path);
+	}
+	else
+	{
+		fprintf(stderr, "Unable to create %s.\n", output);
+	}
+
+	for (uint32_t ii = 0; ii < numThreads; ++ii)
+	{
+		importer->m_threads[ii].init(workerThreadFunc, importer, 0, "terrainc worker");
+	}
+
+	double readSeconds = 0.0;
+	if (ok)
+	{
+		ok = importLod0(*importer, stripe, readSeconds);
+		if (!ok)
+		{
+			fprintf(stderr, "DEM can't be read.\n");
+		}
+	}
+
+	const int64_t lod0End = bx::getHPCounter();
+	if (ok)
+	{
+		importLods(*importer);
+	}
+
+	for (uint32_t ii = 0; ii < numThreads; ++ii)
+	{
+		Work work = { NULL, Importer::kExit, 0, 0 };
+		pushWork(*importer, work);
+	}
+
+	for (uint32_t ii = 0; ii < numThreads; ++ii)
+	{
+		importer->m_threads[ii].shutdown();
+	}
+
+	ok = ok && 0 == importer->m_failed;
+	ok = ok && writeManifest(*importer, minElevation, maxElevation);
+	const int64_t end = bx::getHPCounter();
+
+	if (ok)
+	{
+		const double sourceMB = double(src.m_width) * src.m_height * demGetSampleSize(src.m_format) / (1024.0 * 1024.0);
+		printf("Wrote %u tiles, %.1f MB from %.1f MB of DEM in %.2f s (LOD 0 %.2f s, %.2f s of it reading).\n"
+			, importer->m_tilesWritten
+			, double(importer->m_bytesWritten) / (1024.0 * 1024.0)
+			, sourceMB
+			, toSeconds(end - start)
+			, toSeconds(lod0End - start)
+			, readSeconds
+			);
+		printf("Working memory %.1f MB, %u threads.\n", double(importer->m_memory) / (1024.0 * 1024.0), numThreads);
+	}
+	else
+	{
+		fprintf(stderr, "Import to %s failed.\n", output);
+	}
+
+	for (uint32_t ii = 0; ii < Importer::kNumBands; ++ii)
+	{
+		BX_FREE(&s_allocator, importer->m_bands[ii].m_samples);
+	}
+	BX_DELETE(&s_allocator, importer);
+	demClose(src);
+
+	return ok ? 0 : 1;
+}